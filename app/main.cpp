@@ -9,10 +9,17 @@
 #include <chrono>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <csignal>
+#include <unistd.h>
 #include "../include/DataVector.h"
 #include "../include/VamanaIndex.h"
 #include "../include/FilteredVamanaIndex.h"
 #include "../include/StichedVamanaIndex.h"
+#include "../include/RangeVamanaIndex.h"
 #include "../include/read_data.h"
 #include "../include/BQDataVectors.h"
 #include "../include/recall.h"
@@ -20,6 +27,10 @@
 #include "../include/groundtruth.h"
 #include "../include/distance.h"
 #include "../include/Filter.h"
+#include "../include/QueryPlanner.h"
+#include "../include/ThreadPool.h"
+#include "../include/IndexHandle.h"
+#include "../include/QueryServer.h"
 
 using ParametersMap = std::unordered_map<std::string, std::string>;
 using BaseVectors = std::vector<DataVector<float>>;
@@ -37,6 +48,20 @@ static bool getParameterValue(const ParametersMap& parameters, const std::string
   }
 }
 
+/**
+ * @brief Reads the thread count of a parallel phase. Every phase runs on the thread pool, so a count above the
+ * size of the pool is capped to it, with a warning that points to -threads.
+ */
+static int getPhaseThreads(const ParametersMap& parameters, const std::string& key) {
+  int threads = std::max(1, std::stoi(parameters.at(key)));
+  unsigned int poolThreads = ThreadPool::getInstance().getThreadsCount();
+  if ((unsigned int)threads > poolThreads) {
+    std::cerr << "Warning: " << key << " " << threads << " is capped to the " << poolThreads
+              << " threads of the pool, set -threads to use more" << std::endl;
+  }
+  return threads;
+}
+
 static std::set<DataVector<float>> getExactNearestNeighbors(
   BaseVectors base_vectors, const GroundTruthValues& groundtruth_values, const unsigned int query_number) 
 {
@@ -50,6 +75,34 @@ static std::set<DataVector<float>> getExactNearestNeighbors(
   return realNeighbors;
 }
 
+template <typename index_t>
+static bool saveIndex(index_t& index, const std::string& outputFile, const std::string& saveMode, const std::string& baseFile) {
+  if (saveMode == "graph") {
+    return index.saveGraphStructure(outputFile, baseFile);
+  }
+  return index.saveGraph(outputFile);
+}
+
+// The navigation layer is optional, so indexes only get one when a sampling rate is given
+template <typename index_t>
+static void buildNavigationLayer(index_t& index, const float samplingRate, const unsigned int maxSize, const unsigned int threads) {
+  if (samplingRate <= 0) {
+    return;
+  }
+  unsigned int sampled = index.buildNavigationLayer(samplingRate, maxSize, threads);
+  std::cout << std::endl << green << "Navigation layer sampled " << brightYellow << sampled << green << " points" << reset << std::endl;
+}
+
+// The start node cache is optional as well, so indexes only get one when a number of start nodes is given
+template <typename index_t>
+static void buildStartNodeCache(index_t& index, const unsigned int K, const unsigned int threads) {
+  if (K == 0) {
+    return;
+  }
+  unsigned int cached = index.buildStartNodeCache(K, threads);
+  std::cout << std::endl << green << "Start node cache holds " << brightYellow << cached << green << " nodes" << reset << std::endl;
+}
+
 std::unordered_map<std::string, std::string> parseArguments(int argc, char* argv[]) {
   std::unordered_map<std::string, std::string> args;
   for (unsigned int i = 2; i < (unsigned int)argc; i += 2) {
@@ -67,16 +120,15 @@ std::unordered_map<std::string, std::string> parseArguments(int argc, char* argv
 }
 
 void ComputeGroundtruth(std::unordered_map<std::string, std::string> args) {
-  using BaseVectorVector = std::vector<BaseDataVector<float>>;
-  using QueryVectorVector = std::vector<QueryDataVector<float>>;
-
   std::string baseFile, queryFile, groundtruthFile;
   unsigned int maxDistances = 1000;
+  unsigned int chunkSize = 0; // Default value, the whole base file is loaded in memory
+  unsigned int threads = ThreadPool::getInstance().getThreadsCount();
 
-  std::vector<std::string> validArguments = {"-base-file", "-query-file", "-gt-file", "-max-distances"};
+  std::vector<std::string> validArguments = {"-base-file", "-query-file", "-gt-file", "-max-distances", "-chunk-size"};
   for (auto arg : args) {
     if (std::find(validArguments.begin(), validArguments.end(), arg.first) == validArguments.end()) {
-      throw std::invalid_argument("Error: Invalid argument: " + arg.first + ". Valid arguments are: -base-file, -query-file, -gt-file, -max-distances");
+      throw std::invalid_argument("Error: Invalid argument: " + arg.first + ". Valid arguments are: -base-file, -query-file, -gt-file, -max-distances, -chunk-size, -threads, -pin-threads");
     }
   }
 
@@ -102,10 +154,36 @@ void ComputeGroundtruth(std::unordered_map<std::string, std::string> args) {
     maxDistances = std::stoi(args["-max-distances"]);
   }
 
-  BaseVectorVector base_vectors = ReadFilteredBaseVectorFile(baseFile);
-  QueryVectorVector query_vectors = ReadFilteredQueryVectorFile(queryFile);
+  if (args.find("-chunk-size") != args.end()) {
+    chunkSize = std::stoi(args["-chunk-size"]);
+    if (chunkSize == 0) {
+      throw std::invalid_argument("Error: -chunk-size must be a positive number");
+    }
+  }
 
-  std::vector<std::vector<int>> base_indexes = computeGroundtruth(base_vectors, query_vectors, maxDistances);
+  VectorStore queries;
+  if (!ReadFilteredQueryVectorStore(queryFile, queries)) {
+    return;
+  }
+
+  // Stream the base file in chunks of base vectors instead of loading it whole
+  if (chunkSize > 0) {
+    std::vector<std::vector<int>> base_indexes = computeGroundtruth(baseFile, queries, maxDistances, chunkSize, threads);
+    if (base_indexes.empty() && queries.count > 0) {
+      std::cerr << "Error: Failed to compute the groundtruth from " << baseFile << std::endl;
+      return;
+    }
+
+    saveGroundtruthToFile(base_indexes, groundtruthFile);
+    return;
+  }
+
+  VectorStore base;
+  if (!ReadFilteredBaseVectorStore(baseFile, base)) {
+    return;
+  }
+
+  std::vector<std::vector<int>> base_indexes = computeGroundtruth(base, queries, maxDistances, threads);
   saveGroundtruthToFile(base_indexes, groundtruthFile);
 }
 
@@ -115,19 +193,31 @@ void Create(std::unordered_map<std::string, std::string> args) {
 
   std::string indexType, baseFile, L, R, alpha, outputFile, connectionMode, distanceSaveMethod;
   std::string L_small, R_small, R_stiched;
+  std::string saveMode = "full"; // Default value
   bool save = false;
   bool leaveEmpty = false;
-  int distanceThreads = 1; // Default value
-  int computingThreads = 1; // Default value
-
-  std::vector<std::string> validArguments = {"-index-type", "-base-file", "-L", "-L-small", "-R", "-R-small", "-R-stiched", "-alpha", "-save", "-random-edges", "-connection-mode", "-distance-threads", "-distance-save"};
-  if (args["-index-type"] == "stiched") {
+  int distanceThreads = ThreadPool::getInstance().getThreadsCount(); // Default value
+  int computingThreads = ThreadPool::getInstance().getThreadsCount(); // Default value
+  int buildThreads = ThreadPool::getInstance().getThreadsCount(); // Default value
+  int leafSize = 1024; // Default value
+  float navigationRate = 0.0f; // Default value, no navigation layer
+  int navigationSize = 4096; // Default value
+  int startCacheSize = 0; // Default value
+
+  std::vector<std::string> validArguments = {"-index-type", "-base-file", "-L", "-L-small", "-R", "-R-small", "-R-stiched", "-alpha", "-save", "-save-mode", "-random-edges", "-connection-mode", "-distance-threads", "-distance-save", "-labels-file", "-nav-rate", "-nav-size", "-start-cache"};
+  if (args["-index-type"] == "stiched" || args["-index-type"] == "range") {
     validArguments.push_back("-computing-threads");
   }
+  if (args["-index-type"] == "simple" || args["-index-type"] == "filtered") {
+    validArguments.push_back("-build-threads");
+  }
+  if (args["-index-type"] == "range") {
+    validArguments.push_back("-leaf-size");
+  }
 
   for (auto arg : args) {
     if (std::find(validArguments.begin(), validArguments.end(), arg.first) == validArguments.end()) {
-      throw std::invalid_argument("Error: Invalid argument: " + arg.first + ". Valid arguments are: -index-type, -base-file, -L, -L-small, -R, -R-small, -R-stiched, -alpha, -save, -connection-mode, -distance-threads, -distance-save");
+      throw std::invalid_argument("Error: Invalid argument: " + arg.first + ". Valid arguments are: -index-type, -base-file, -L, -L-small, -R, -R-small, -R-stiched, -alpha, -save, -save-mode, -connection-mode, -distance-threads, -distance-save, -labels-file, -computing-threads, -build-threads, -leaf-size, -nav-rate, -nav-size, -start-cache, -threads, -pin-threads");
     }
   }
 
@@ -137,7 +227,7 @@ void Create(std::unordered_map<std::string, std::string> args) {
     indexType = args["-index-type"];
   }
 
-  if (indexType == "filtered" || indexType == "simple") {
+  if (indexType == "filtered" || indexType == "simple" || indexType == "range") {
     if (args.find("-L") == args.end()) {
       throw std::invalid_argument("Error: Missing required argument: -L");
     } else {
@@ -150,6 +240,22 @@ void Create(std::unordered_map<std::string, std::string> args) {
       R = args["-R"];
     }
 
+    if (args.find("-build-threads") != args.end()) {
+      buildThreads = getPhaseThreads(args, "-build-threads");
+    }
+
+    if (indexType == "range") {
+      if (args.find("-leaf-size") != args.end()) {
+        leafSize = std::stoi(args["-leaf-size"]);
+        if (leafSize <= 0) {
+          throw std::invalid_argument("Error: -leaf-size must be a positive number");
+        }
+      }
+      if (args.find("-computing-threads") != args.end()) {
+        computingThreads = getPhaseThreads(args, "-computing-threads");
+      }
+    }
+
   } else if (indexType == "stiched") {
     validArguments.push_back("-computing-threads");
 
@@ -172,10 +278,10 @@ void Create(std::unordered_map<std::string, std::string> args) {
     }
 
     if (args.find("-computing-threads") != args.end()) {
-      computingThreads = std::stoi(args["-computing-threads"]);
+      computingThreads = getPhaseThreads(args, "-computing-threads");
     }
   } else {
-    throw std::invalid_argument("Error: Invalid index type: " + indexType + ". Supported index types are: simple, filtered, stiched");
+    throw std::invalid_argument("Error: Invalid index type: " + indexType + ". Supported index types are: simple, filtered, stiched, range");
   }
 
   if (args.find("-base-file") == args.end()) {
@@ -184,6 +290,27 @@ void Create(std::unordered_map<std::string, std::string> args) {
     baseFile = args["-base-file"];
   }
 
+  // Giving only the size of the navigation layer samples the default rate
+  if (args.find("-nav-rate") != args.end() || args.find("-nav-size") != args.end()) {
+    navigationRate = args.find("-nav-rate") != args.end() ? std::stof(args["-nav-rate"]) : 0.02f;
+    if (navigationRate <= 0 || navigationRate > 1) {
+      throw std::invalid_argument("Error: -nav-rate must be greater than 0 and at most 1");
+    }
+    if (args.find("-nav-size") != args.end()) {
+      navigationSize = std::stoi(args["-nav-size"]);
+      if (navigationSize < 2) {
+        throw std::invalid_argument("Error: -nav-size must be at least 2");
+      }
+    }
+  }
+
+  if (args.find("-start-cache") != args.end()) {
+    startCacheSize = std::stoi(args["-start-cache"]);
+    if (startCacheSize < 1) {
+      throw std::invalid_argument("Error: -start-cache must be at least 1");
+    }
+  }
+
   if (args.find("-alpha") == args.end()) {
     throw std::invalid_argument("Error: Missing required argument: -alpha");
   } else {
@@ -198,6 +325,13 @@ void Create(std::unordered_map<std::string, std::string> args) {
     save = true;
   }
 
+  if (args.find("-save-mode") != args.end()) {
+    saveMode = args["-save-mode"];
+    if (saveMode != "full" && saveMode != "graph") {
+      throw std::invalid_argument("Error: Invalid value for -save-mode. Valid values are: full, graph");
+    }
+  }
+
   if (args.find("-connection-mode") != args.end()) {
     connectionMode = args["-connection-mode"];
     if (connectionMode == "empty") {
@@ -220,7 +354,7 @@ void Create(std::unordered_map<std::string, std::string> args) {
     if (distanceSaveMethod != "matrix") {
       throw std::invalid_argument("Error: -distance-threads can only be used if -distance-save is set to 'matrix'");
     }
-    distanceThreads = std::stoi(args["-distance-threads"]);
+    distanceThreads = getPhaseThreads(args, "-distance-threads");
   }
 
   if (indexType == "simple") {
@@ -237,11 +371,13 @@ void Create(std::unordered_map<std::string, std::string> args) {
       distanceSaveMethodEnum = MATRIX;
     }
 
-    VamanaIndex<DataVector<float>> vamanaIndex = VamanaIndex<DataVector<float>>();
-    vamanaIndex.createGraph(base_vectors, std::stof(alpha), std::stoi(L), std::stoi(R), distanceSaveMethodEnum, distanceThreads, true);
+    VamanaIndex<DataVector<float>> vamanaIndex;
+    vamanaIndex.createGraph(base_vectors, std::stof(alpha), std::stoi(L), std::stoi(R), distanceSaveMethodEnum, distanceThreads, true, nullptr, buildThreads);
+    buildNavigationLayer(vamanaIndex, navigationRate, navigationSize, buildThreads);
+    buildStartNodeCache(vamanaIndex, startCacheSize, buildThreads);
 
     if (save) {
-      if (!vamanaIndex.saveGraph(outputFile)) {
+      if (!saveIndex(vamanaIndex, outputFile, saveMode, baseFile)) {
         std::cerr << "Error opening file for writing." << std::endl;
         return;
       }
@@ -256,6 +392,12 @@ void Create(std::unordered_map<std::string, std::string> args) {
       filters.insert(filter);
     }
 
+    // Points may carry several labels, given in a separate file with one line per base vector
+    std::vector<std::vector<unsigned int>> labelSets;
+    if (args.find("-labels-file") != args.end() && !ReadLabelSets(args["-labels-file"], base_vectors, labelSets)) {
+      return;
+    }
+
     DISTANCE_SAVE_METHOD distanceSaveMethodEnum = NONE;
     if (distanceSaveMethod == "none") {
       distanceSaveMethodEnum = NONE;
@@ -265,28 +407,69 @@ void Create(std::unordered_map<std::string, std::string> args) {
 
     if (indexType == "filtered") {
       FilteredVamanaIndex<BaseDataVector<float>> index(filters);
-      index.createGraph(base_vectors, std::stoi(alpha), std::stoi(L), std::stoi(R), distanceSaveMethodEnum, distanceThreads, true, leaveEmpty);
+      index.setLabelSets(labelSets);
+      index.createGraph(base_vectors, std::stof(alpha), std::stoi(L), std::stoi(R), distanceSaveMethodEnum, distanceThreads, true, leaveEmpty, buildThreads);
+      buildNavigationLayer(index, navigationRate, navigationSize, buildThreads);
+      buildStartNodeCache(index, startCacheSize, buildThreads);
 
       if (save) {
-        index.saveGraph(outputFile);
+        if (!saveIndex(index, outputFile, saveMode, baseFile)) {
+          std::cerr << "Error opening file for writing." << std::endl;
+          return;
+        }
+        std::cout << std::endl << green << "Vamana Index was saved successfully to " << brightYellow << "`" << outputFile << "`" << reset << std::endl;
+      }
+    } else if (indexType == "range") {
+      RangeVamanaIndex<BaseDataVector<float>> index;
+      index.setLabelSets(labelSets);
+      index.createGraph(base_vectors, std::stof(alpha), std::stoi(L), std::stoi(R), leafSize, computingThreads, true);
+      buildNavigationLayer(index, navigationRate, navigationSize, computingThreads);
+      buildStartNodeCache(index, startCacheSize, computingThreads);
+
+      if (save) {
+        if (!saveIndex(index, outputFile, saveMode, baseFile)) {
+          std::cerr << "Error opening file for writing." << std::endl;
+          return;
+        }
         std::cout << std::endl << green << "Vamana Index was saved successfully to " << brightYellow << "`" << outputFile << "`" << reset << std::endl;
       }
     } else if (indexType == "stiched") {
       StichedVamanaIndex<BaseDataVector<float>> index(filters);
+      index.setLabelSets(labelSets);
       index.createGraph(base_vectors, std::stof(alpha), std::stoi(L_small), std::stoi(R_small), std::stoi(R_stiched), distanceSaveMethodEnum, distanceThreads, computingThreads, true, leaveEmpty);
+      buildNavigationLayer(index, navigationRate, navigationSize, computingThreads);
+      buildStartNodeCache(index, startCacheSize, computingThreads);
 
       if (save) {
-        index.saveGraph(outputFile);
+        if (!saveIndex(index, outputFile, saveMode, baseFile)) {
+          std::cerr << "Error opening file for writing." << std::endl;
+          return;
+        }
         std::cout << std::endl << green << "Vamana Index was saved successfully to " << brightYellow << "`" << outputFile << "`" << reset << std::endl;
       }
     }
   }
 }
 
+// Searches stop once they converge when -patience or -epsilon is given, and run until L is exhausted otherwise
+static SearchBudget getConvergenceBudget(std::unordered_map<std::string, std::string>& args) {
+  SearchBudget budget;
+  if (args.find("-patience") != args.end()) {
+    budget.patience = std::max(0, std::stoi(args["-patience"]));
+  }
+  if (args.find("-epsilon") != args.end()) {
+    budget.epsilon = std::stof(args["-epsilon"]);
+    if (budget.epsilon < 0) {
+      throw std::invalid_argument("Error: -epsilon must not be negative");
+    }
+  }
+  return budget;
+}
+
 void TestSimple(std::unordered_map<std::string, std::string> args) {
   using BaseVectors = std::vector<DataVector<float>>;
 
-  std::string indexFile, k, L, groundtruthFile, queryFile, queryNumber;
+  std::string indexFile, k, L, groundtruthFile, queryFile, queryNumber, baseFile;
 
   if (!getParameterValue(args, "-load", indexFile)) return;
   if (!getParameterValue(args, "-k", k)) return;
@@ -294,6 +477,9 @@ void TestSimple(std::unordered_map<std::string, std::string> args) {
   if (!getParameterValue(args, "-gt-file", groundtruthFile)) return;
   if (!getParameterValue(args, "-query-file", queryFile)) return;
   if (!getParameterValue(args, "-query", queryNumber)) return;
+  if (args.find("-base-file") != args.end()) {
+    baseFile = args["-base-file"];
+  }
 
   BaseVectors query_vectors = ReadVectorFile(queryFile);
   if (query_vectors.empty()) {
@@ -301,8 +487,8 @@ void TestSimple(std::unordered_map<std::string, std::string> args) {
     return;
   }
 
-  VamanaIndex<DataVector<float>> vamanaIndex = VamanaIndex<DataVector<float>>();
-  if (!vamanaIndex.loadGraph(indexFile)) {
+  VamanaIndex<DataVector<float>> vamanaIndex;
+  if (!vamanaIndex.loadGraph(indexFile, baseFile)) {
     std::cerr << "Error loading Vamana index from file" << std::endl;
     return;
   }
@@ -311,10 +497,19 @@ void TestSimple(std::unordered_map<std::string, std::string> args) {
     vamanaIndex.getPoints(), ReadGroundTruth(groundtruthFile), std::stoi(queryNumber)
   );
 
-  GraphNode<DataVector<float>> s = vamanaIndex.findMedoid(vamanaIndex.getGraph(), 1000);
+  // Graph files keep the medoid the index was built with, older index files have to pick one
+  GraphNode<DataVector<float>> s = vamanaIndex.getEntryPoints().empty() ?
+    vamanaIndex.findMedoid(vamanaIndex.getGraph(), false, 1000) : *vamanaIndex.getGraph().getNode(vamanaIndex.getMedoid());
   
+  SearchBudget budget = getConvergenceBudget(args);
+  const DataVector<float>& xq = query_vectors.at(std::stoi(queryNumber));
   auto start = std::chrono::high_resolution_clock::now();
-  SimpleGreedyResult greedyResult = GreedySearch(vamanaIndex, s, query_vectors.at(std::stoi(queryNumber)), std::stoi(k), std::stoi(L), NONE);
+
+  // Indexes with a navigation layer or a start node cache start from the point they find nearest to the query
+  if (!vamanaIndex.getNavigationLayer().nodes.empty() || !vamanaIndex.getStartNodeCache().nodes.empty()) {
+    s = GraphNode<DataVector<float>>(vamanaIndex.getPoint(vamanaIndex.findSearchStart(xq)));
+  }
+  SimpleGreedyResult greedyResult = GreedySearch(vamanaIndex, s, xq, std::stoi(k), std::stoi(L), NONE, &budget);
   auto end = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> elapsed = end - start;
 
@@ -330,13 +525,14 @@ void TestSimple(std::unordered_map<std::string, std::string> args) {
   else if (recall < 0.8) std::cout << brightCyan;
   else std::cout << brightGreen;
   std::cout << recall*100 << "%" << reset << " | ";
+  std::cout << "Hops: " << budget.hops << (budget.converged ? " (converged)" : "") << " | ";
   std::cout << "Time: " << cyan << elapsed.count() << " seconds" << std::endl;
 }
 
 void TestFilteredOrStiched(std::unordered_map<std::string, std::string> args) {
   using QueryVectorVector = std::vector<QueryDataVector<float>>;
 
-  std::string indexFile, k, L, groundtruthFile, queryFile, queryNumber, testOn, saveRecallsFile;
+  std::string indexFile, k, L, groundtruthFile, queryFile, queryNumber, testOn, saveRecallsFile, baseFile;
 
   if (!getParameterValue(args, "-load", indexFile)) return;
   if (!getParameterValue(args, "-k", k)) return;
@@ -358,17 +554,40 @@ void TestFilteredOrStiched(std::unordered_map<std::string, std::string> args) {
     }
     saveRecallsFile = args["-save-recalls"];
   }
+  if (args.find("-base-file") != args.end()) {
+    baseFile = args["-base-file"];
+  }
+  QUERY_PLAN forcedPlan = AUTO_PLAN;
+  if (args.find("-plan") != args.end() && !QueryPlanner<BaseDataVector<float>>::parsePlan(args["-plan"], forcedPlan)) {
+    std::cerr << "Error: Invalid plan: " << args["-plan"] << ". Supported plans are: auto, brute-force, filtered, unfiltered" << std::endl;
+    return;
+  }
 
   QueryVectorVector query_vectors = ReadFilteredQueryVectorFile(queryFile);
-  FilteredVamanaIndex<BaseDataVector<float>> index;
-  index.loadGraph(indexFile);
-  std::vector<std::vector<int>> groundtruth = readGroundtruthFromFile(groundtruthFile);
-  std::map<Filter, GraphNode<BaseDataVector<float>>> medoids = index.findFilteredMedoid(std::stoi(L)); 
-  std::vector<GraphNode<BaseDataVector<float>>> start_nodes;
-  for (auto filter : index.getFilters()) {
-    start_nodes.push_back(medoids[filter]);
+  // Range indexes answer the queries with a timestamp range from their segments, and the rest through the planner
+  std::string indexType = args["-index-type"];
+  unsigned int searchThreads = ThreadPool::getInstance().getThreadsCount();
+  if (args.find("-search-threads") != args.end()) {
+    if (indexType != "range") {
+      std::cerr << "Error: The -search-threads argument can only be used with the range index type." << std::endl;
+      return;
+    }
+    searchThreads = getPhaseThreads(args, "-search-threads");
   }
 
+  FilteredVamanaIndex<BaseDataVector<float>> filteredIndex;
+  RangeVamanaIndex<BaseDataVector<float>> rangeIndex;
+  FilteredVamanaIndex<BaseDataVector<float>>& index = indexType == "range" ? rangeIndex : filteredIndex;
+  if (indexType == "range" ? !rangeIndex.loadGraph(indexFile, baseFile) : !index.loadGraph(indexFile, baseFile)) {
+    std::cerr << "Error loading Vamana index from file" << std::endl;
+    return;
+  }
+  std::vector<std::vector<int>> groundtruth = readGroundtruthFromFile(groundtruthFile);
+
+  // Every query starts only from the start nodes of its own labels, which the planner looks up in the index
+  QueryPlanner<BaseDataVector<float>> planner(index, forcedPlan);
+  std::map<std::string, unsigned int> planCounts;
+
   std::ofstream recallFile;
   if (!saveRecallsFile.empty()) {
     recallFile.open(saveRecallsFile);
@@ -378,62 +597,139 @@ void TestFilteredOrStiched(std::unordered_map<std::string, std::string> args) {
     }
   }
 
-  auto processQuery = [&](int queryIdx) {
-    QueryDataVector<float> xq = query_vectors[queryIdx];
-    if (xq.getQueryType() > 1) {
-      return;
-    }
+  // Every query is answered into its own report, so that a batch of queries can run on the threads of the pool
+  // while the reports are printed in query order
+  struct QueryReport {
+    std::string output;
+    std::string planName;
+    double recall = 0.0;
+    double time = 0.0;
+    unsigned int hops = 0;
+    bool converged = false;
+    bool evaluated = false;
+  };
+  const SearchBudget convergenceBudget = getConvergenceBudget(args);
 
-    std::vector<CategoricalAttributeFilter> Fx;
-    if (xq.getQueryType() == 1) {
-      Fx.push_back(CategoricalAttributeFilter(xq.getV()));
+  auto processQuery = [&](int queryIdx) {
+    QueryReport report;
+    std::ostringstream out;
+    out.copyfmt(std::cout);
+    const QueryDataVector<float>& xq = query_vectors[queryIdx];
+
+    if (groundtruth[queryIdx].empty()) {
+      out << reset << "Current Query: " << brightCyan << queryIdx << reset << " | No base vector satisfies the query filters" << std::endl;
+      report.output = out.str();
+      return report;
     }
 
-    std::vector<GraphNode<BaseDataVector<float>>> P = index.getNodes();
     std::set<BaseDataVector<float>> exactNeighbors;
-
     for (auto idx : groundtruth[queryIdx]) {
-      exactNeighbors.insert(P[idx].getData());
+      exactNeighbors.insert(index.getGraph().getNode(idx)->getData());
       if ((int)exactNeighbors.size() >= std::stoi(k)) {
         break;
       }
     }
 
+    SearchBudget budget = convergenceBudget;
     auto start = std::chrono::high_resolution_clock::now();
-    FilteredGreedyResult greedyResult = FilteredGreedySearch(index, start_nodes, xq, std::stoi(k), std::stoi(L), Fx, NONE);
+    std::string planName = "segments";
+    FilteredGreedyResult greedyResult;
+    if (indexType == "range" && (xq.getQueryType() == l_LEQ_T_LEQ_r || xq.getQueryType() == C_EQUALS_v_AND_l_LEQ_T_LEQ_r)) {
+      greedyResult = rangeIndex.rangeSearch(xq, std::stoi(k), std::stoi(L), searchThreads);
+    } else {
+      QUERY_PLAN plan;
+      greedyResult = planner.search(xq, std::stoi(k), std::stoi(L), plan, &budget);
+      planName = QueryPlanner<BaseDataVector<float>>::getPlanName(plan);
+    }
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end - start;
 
     std::set<BaseDataVector<float>> approximateNeighbors = greedyResult.first;
     double recall = calculateRecallEvaluation(approximateNeighbors, exactNeighbors);
 
-    // std::cout << brightMagenta << std::endl << "Results for query " << queryIdx << ":" << reset << std::endl;
-    std::cout << reset << "Current Query: " << brightCyan << queryIdx << reset << " | ";
-    std::cout << reset << "Query Type: ";
-    if (xq.getQueryType() == 0) std::cout << brightBlack << "Unfiltered" << reset << " | ";
-    else std::cout << brightWhite << "Filtered  " << reset << " | ";
-    std::cout << reset << "Recall: ";
-    if (recall < 0.2) std::cout << brightRed;
-    else if (recall < 0.4) std::cout << brightOrange;
-    else if (recall < 0.6) std::cout << brightYellow;
-    else if (recall < 0.8) std::cout << brightCyan;
-    else std::cout << brightGreen;
-    std::cout << recall*100 << "%" << reset << " | ";
-    std::cout << "Time: " << cyan << elapsed.count() << " seconds" << std::endl;
+    // out << brightMagenta << std::endl << "Results for query " << queryIdx << ":" << reset << std::endl;
+    out << reset << "Current Query: " << brightCyan << queryIdx << reset << " | ";
+    out << reset << "Query Type: ";
+    if (xq.getQueryType() == NO_FILTER) out << brightBlack << "Unfiltered" << reset << " | ";
+    else if (xq.getQueryType() == C_EQUALS_v) out << brightWhite << "Filtered  " << reset << " | ";
+    else if (xq.getQueryType() == l_LEQ_T_LEQ_r) out << brightWhite << "Timestamp " << reset << " | ";
+    else out << brightWhite << "Filt+Time " << reset << " | ";
+    out << reset << "Recall: ";
+    if (recall < 0.2) out << brightRed;
+    else if (recall < 0.4) out << brightOrange;
+    else if (recall < 0.6) out << brightYellow;
+    else if (recall < 0.8) out << brightCyan;
+    else out << brightGreen;
+    out << recall*100 << "%" << reset << " | ";
+    out << "Plan: " << brightWhite << planName << reset << " | ";
+    out << "Time: " << cyan << elapsed.count() << " seconds" << std::endl;
+
+    report.output = out.str();
+    report.planName = planName;
+    report.recall = recall;
+    report.time = elapsed.count();
+    report.hops = budget.hops;
+    report.converged = budget.converged;
+    report.evaluated = true;
+    return report;
+  };
+
+  double totalRecall = 0.0, totalTime = 0.0;
+  unsigned long long totalHops = 0;
+  unsigned int evaluated = 0, converged = 0;
+  auto printReport = [&](int queryIdx, const QueryReport& report) {
+    std::cout << report.output;
+    if (!report.evaluated) {
+      return;
+    }
+    planCounts[report.planName]++;
+    totalRecall += report.recall;
+    totalTime += report.time;
+    totalHops += report.hops;
+    evaluated++;
+    converged += report.converged;
 
     if (recallFile.is_open()) {
-      recallFile << "Query " << queryIdx << ": " << recall * 100 << "%" << std::endl;
+      recallFile << "Query " << queryIdx << ": " << report.recall * 100 << "%" << std::endl;
     }
   };
 
   if (queryNumber == "-1") {
+    std::vector<unsigned int> selected;
     for (size_t i = 0; i < query_vectors.size(); ++i) {
-      if (testOn == "filtered" && query_vectors[i].getQueryType() != 1) continue;
-      if (testOn == "unfiltered" && query_vectors[i].getQueryType() != 0) continue;
-      processQuery(i);
+      if (testOn == "filtered" && query_vectors[i].getQueryType() != C_EQUALS_v) continue;
+      if (testOn == "unfiltered" && query_vectors[i].getQueryType() != NO_FILTER) continue;
+      if (testOn == "timestamp" && query_vectors[i].getQueryType() != l_LEQ_T_LEQ_r) continue;
+      if (testOn == "filtered-timestamp" && query_vectors[i].getQueryType() != C_EQUALS_v_AND_l_LEQ_T_LEQ_r) continue;
+      selected.push_back(i);
+    }
+
+    std::vector<QueryReport> reports(selected.size());
+    ThreadPool::getInstance().parallelFor(0, selected.size(), [&](unsigned int i) {
+      reports[i] = processQuery(selected[i]);
+    }, 0, 1);
+
+    for (unsigned int i = 0; i < selected.size(); i++) {
+      printReport(selected[i], reports[i]);
     }
   } else {
-    processQuery(std::stoi(queryNumber));
+    printReport(std::stoi(queryNumber), processQuery(std::stoi(queryNumber)));
+  }
+
+  if (queryNumber == "-1") {
+    std::cout << "Plans chosen:";
+    for (auto& count : planCounts) {
+      std::cout << " " << count.first << "=" << count.second;
+    }
+    std::cout << std::endl;
+
+    // Averages over the evaluated queries, to compare the early termination with a fixed L
+    if (evaluated > 0) {
+      std::cout << "Average recall: " << totalRecall / evaluated * 100 << "% | ";
+      std::cout << "Average time: " << totalTime / evaluated << " seconds | ";
+      std::cout << "Average hops: " << (double)totalHops / evaluated << " | ";
+      std::cout << "Converged early: " << converged << "/" << evaluated << std::endl;
+    }
   }
 
   if (recallFile.is_open()) {
@@ -448,10 +744,221 @@ void Test(std::unordered_map<std::string, std::string> args) {
 
   if (indexType == "simple") {
     TestSimple(args);
-  } else if (indexType == "filtered" || indexType == "stiched") {
+  } else if (indexType == "filtered" || indexType == "stiched" || indexType == "range") {
     TestFilteredOrStiched(args);
   } else {
-    std::cerr << "Error: Invalid index type: " << indexType << ". Supported index types are: simple, filtered, stiched" << std::endl;
+    std::cerr << "Error: Invalid index type: " << indexType << ". Supported index types are: simple, filtered, stiched, range" << std::endl;
+  }
+}
+
+// The server that SIGINT and SIGTERM stop, set while --serve runs
+static QueryServer* activeServer = nullptr;
+
+static void stopActiveServer(int) {
+  if (activeServer != nullptr) {
+    activeServer->stop();
+  }
+}
+
+// Turns the points a search returned into the neighbors of a response, nearest first
+template <typename vector_t>
+static std::vector<QueryResult> toQueryResults(const std::set<vector_t>& points, const DataVector<float>& xq, const unsigned int k) {
+  std::vector<QueryResult> results;
+  for (const vector_t& point : points) {
+    results.push_back({point.getIndex(), (float)euclideanDistance(point, xq)});
+  }
+  std::sort(results.begin(), results.end(), [](const QueryResult& a, const QueryResult& b) {
+    return a.distance < b.distance || (a.distance == b.distance && a.index < b.index);
+  });
+  if (results.size() > k) {
+    results.resize(k);
+  }
+  return results;
+}
+
+// Loads an index into a handle and answers queries on it until the input ends or the server is stopped. Every
+// snapshot of the index is prepared once into the state its queries need, and while reloading is enabled a
+// watcher thread loads the index file again when it changes, so that the queries move to the new snapshot
+// without pausing.
+template <typename index_t, typename snapshot_t>
+static void ServeIndex(
+  std::unordered_map<std::string, std::string>& args, IndexHandle<index_t>& handle,
+  const std::function<std::shared_ptr<snapshot_t>(const std::shared_ptr<index_t>&)>& prepare,
+  const std::function<std::vector<QueryResult>(const snapshot_t&, const QueryRequest&)>& answer)
+{
+  std::string indexFile = args["-load"];
+  std::string baseFile = args.find("-base-file") != args.end() ? args["-base-file"] : "";
+  std::string socketPath = args.find("-socket") != args.end() ? args["-socket"] : "";
+  unsigned int batchSize = args.find("-batch-size") != args.end() ? std::max(1, std::stoi(args["-batch-size"])) : 64;
+  double reportInterval = args.find("-report-interval") != args.end() ? std::max(0.0, std::stod(args["-report-interval"])) : 10.0;
+  bool reload = args.find("-reload") == args.end() || args["-reload"] == "true";
+
+  // Without a socket the responses go to the standard output, so everything else that is printed, such as the
+  // progress of the loads, is sent to the standard error instead
+  int outputFd = STDOUT_FILENO;
+  if (socketPath.empty()) {
+    std::cout.flush();
+    outputFd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  }
+
+  if (!handle.load(indexFile, baseFile)) {
+    std::cerr << "Error loading Vamana index from file" << std::endl;
+    return;
+  }
+  std::shared_ptr<snapshot_t> snapshot = prepare(handle.acquire());
+
+  QueryServer server([&](const QueryRequest& request) {
+    std::shared_ptr<snapshot_t> current = std::atomic_load(&snapshot);
+    return answer(*current, request);
+  }, batchSize, reportInterval);
+
+  std::mutex watcherMutex;
+  std::condition_variable watcherWakeup;
+  bool serving = true;
+  std::thread watcher;
+  if (reload) {
+    watcher = std::thread([&]() {
+      std::unique_lock<std::mutex> lock(watcherMutex);
+      while (!watcherWakeup.wait_for(lock, std::chrono::seconds(1), [&]() { return !serving; })) {
+        lock.unlock();
+        if (handle.reloadIfModified()) {
+          std::atomic_store(&snapshot, prepare(handle.acquire()));
+          std::cerr << "Reloaded the index from " << indexFile << " (generation " << handle.getGeneration() << ")" << std::endl;
+        }
+        lock.lock();
+      }
+    });
+  }
+
+  activeServer = &server;
+  std::signal(SIGINT, stopActiveServer);
+  std::signal(SIGTERM, stopActiveServer);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  if (socketPath.empty()) {
+    std::cerr << "Serving queries on the standard input" << std::endl;
+    server.serve(STDIN_FILENO, outputFd);
+    close(outputFd);
+  } else {
+    std::cerr << "Serving queries on " << socketPath << std::endl;
+    server.serveSocket(socketPath);
+  }
+
+  std::signal(SIGINT, SIG_DFL);
+  std::signal(SIGTERM, SIG_DFL);
+  activeServer = nullptr;
+
+  if (watcher.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(watcherMutex);
+      serving = false;
+    }
+    watcherWakeup.notify_all();
+    watcher.join();
+  }
+}
+
+void Serve(std::unordered_map<std::string, std::string> args) {
+  using SimpleIndex = VamanaIndex<DataVector<float>>;
+  using FilteredIndex = FilteredVamanaIndex<BaseDataVector<float>>;
+  using RangeIndex = RangeVamanaIndex<BaseDataVector<float>>;
+  using Planner = QueryPlanner<BaseDataVector<float>>;
+
+  std::vector<std::string> validArguments = {"-index-type", "-load", "-base-file", "-socket", "-batch-size", "-report-interval", "-reload", "-plan"};
+  for (auto arg : args) {
+    if (std::find(validArguments.begin(), validArguments.end(), arg.first) == validArguments.end()) {
+      throw std::invalid_argument("Error: Invalid argument: " + arg.first + ". Valid arguments are: -index-type, -load, -base-file, -socket, -batch-size, -report-interval, -reload, -plan, -threads, -pin-threads");
+    }
+  }
+
+  std::string indexType, indexFile;
+  if (!getParameterValue(args, "-index-type", indexType)) return;
+  if (!getParameterValue(args, "-load", indexFile)) return;
+  if (args.find("-reload") != args.end() && args["-reload"] != "true" && args["-reload"] != "false") {
+    throw std::invalid_argument("Error: Invalid value for -reload. Valid values are: true, false");
+  }
+  QUERY_PLAN forcedPlan = AUTO_PLAN;
+  if (args.find("-plan") != args.end() && !Planner::parsePlan(args["-plan"], forcedPlan)) {
+    std::cerr << "Error: Invalid plan: " << args["-plan"] << ". Supported plans are: auto, brute-force, filtered, unfiltered" << std::endl;
+    return;
+  }
+
+  // Every query carries its own k, L and filters, and a query the index cannot answer fails on its own
+  auto checkRequest = [](const QueryRequest& request, const unsigned int dimension) {
+    if (request.vector.size() != dimension) {
+      throw std::invalid_argument("Error: The query has dimension " + std::to_string(request.vector.size()) + " instead of " + std::to_string(dimension));
+    }
+    if (request.queryType > C_EQUALS_v_AND_l_LEQ_T_LEQ_r || request.k == 0 || request.L < request.k) {
+      throw std::invalid_argument("Error: Invalid query parameters");
+    }
+  };
+
+  if (indexType == "simple") {
+    // Unfiltered queries start from the navigation layer or the start node cache, or from the medoid, which older
+    // index files do not store
+    struct Snapshot {
+      std::shared_ptr<SimpleIndex> index;
+      GraphNode<DataVector<float>> start;
+    };
+
+    IndexHandle<SimpleIndex> handle;
+    ServeIndex<SimpleIndex, Snapshot>(args, handle, [](const std::shared_ptr<SimpleIndex>& index) {
+      GraphNode<DataVector<float>> start = index->getEntryPoints().empty() ?
+        index->findMedoid(index->getGraph(), false) : GraphNode<DataVector<float>>(index->getGraph().getNode(index->getMedoid())->getData());
+      return std::shared_ptr<Snapshot>(new Snapshot{index, start});
+    }, [&](const Snapshot& snapshot, const QueryRequest& request) {
+      checkRequest(request, snapshot.start.getData().getDimension());
+      if (request.queryType != NO_FILTER) {
+        throw std::invalid_argument("Error: Simple indexes only answer unfiltered queries");
+      }
+      DataVector<float> xq(request.vector.size(), 0);
+      for (unsigned int i = 0; i < request.vector.size(); i++) {
+        xq.setDataAtIndex(request.vector[i], i);
+      }
+      if (!snapshot.index->getNavigationLayer().nodes.empty() || !snapshot.index->getStartNodeCache().nodes.empty()) {
+        GraphNode<DataVector<float>> start(snapshot.index->getPoint(snapshot.index->findSearchStart(xq)));
+        return toQueryResults(GreedySearch(*snapshot.index, start, xq, request.k, request.L, NONE).first, xq, request.k);
+      }
+      return toQueryResults(GreedySearch(*snapshot.index, snapshot.start, xq, request.k, request.L, NONE).first, xq, request.k);
+    });
+  } else if (indexType == "filtered" || indexType == "stiched" || indexType == "range") {
+    // Filtered queries go through a planner over the snapshot, and range indexes answer the queries with a
+    // timestamp range from their segments
+    struct Snapshot {
+      std::shared_ptr<FilteredIndex> index;
+      RangeIndex* range;
+      std::unique_ptr<Planner> planner;
+    };
+    auto answer = [&](const Snapshot& snapshot, const QueryRequest& request) {
+      if (snapshot.index->getGraph().getNodesCount() == 0) {
+        throw std::invalid_argument("Error: The index is empty");
+      }
+      checkRequest(request, snapshot.index->getGraph().getNode(0)->getData().getDimension());
+      QueryDataVector<float> xq(request.vector.size(), 0, request.queryType, request.v, request.l, request.r);
+      for (unsigned int i = 0; i < request.vector.size(); i++) {
+        xq.setDataAtIndex(request.vector[i], i);
+      }
+      if (snapshot.range != nullptr && (request.queryType == l_LEQ_T_LEQ_r || request.queryType == C_EQUALS_v_AND_l_LEQ_T_LEQ_r)) {
+        return toQueryResults(snapshot.range->rangeSearch(xq, request.k, request.L, 1).first, xq, request.k);
+      }
+      QUERY_PLAN plan;
+      return toQueryResults(snapshot.planner->search(xq, request.k, request.L, plan).first, xq, request.k);
+    };
+
+    if (indexType == "range") {
+      IndexHandle<RangeIndex> handle;
+      ServeIndex<RangeIndex, Snapshot>(args, handle, [&](const std::shared_ptr<RangeIndex>& index) {
+        return std::shared_ptr<Snapshot>(new Snapshot{index, index.get(), std::unique_ptr<Planner>(new Planner(*index, forcedPlan))});
+      }, answer);
+    } else {
+      IndexHandle<FilteredIndex> handle;
+      ServeIndex<FilteredIndex, Snapshot>(args, handle, [&](const std::shared_ptr<FilteredIndex>& index) {
+        return std::shared_ptr<Snapshot>(new Snapshot{index, nullptr, std::unique_ptr<Planner>(new Planner(*index, forcedPlan))});
+      }, answer);
+    }
+  } else {
+    std::cerr << "Error: Invalid index type: " << indexType << ". Supported index types are: simple, filtered, stiched, range" << std::endl;
   }
 }
 
@@ -464,6 +971,7 @@ int main(int argc, char* argv[]) {
     std::cerr << "1)  --compute-gt" << std::endl;
     std::cerr << "2)  --create" << std::endl;
     std::cerr << "3)  --test" << std::endl;
+    std::cerr << "4)  --serve" << std::endl;
     return 1;
   }
 
@@ -473,17 +981,37 @@ int main(int argc, char* argv[]) {
   try {
     args = parseArguments(argc, argv);
 
+    // All the parallel phases run on the same thread pool, which is sized once for the whole execution, by default
+    // with a thread for every hardware thread
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool pinThreads = false;
+    if (args.find("-threads") != args.end()) {
+      threads = std::max(1, std::stoi(args["-threads"]));
+      args.erase("-threads");
+    }
+    if (args.find("-pin-threads") != args.end()) {
+      if (args["-pin-threads"] != "true" && args["-pin-threads"] != "false") {
+        throw std::invalid_argument("Error: Invalid value for -pin-threads. Valid values are: true, false");
+      }
+      pinThreads = args["-pin-threads"] == "true";
+      args.erase("-pin-threads");
+    }
+    ThreadPool::configure(threads, pinThreads);
+
     if (executeMode == "--compute-gt") {
       ComputeGroundtruth(args);
     } else if (executeMode == "--create") {
       Create(args);
     } else if (executeMode == "--test") {
       Test(args);  
+    } else if (executeMode == "--serve") {
+      Serve(args);
     } else {
       std::cerr << "Error: Invalid execution mode: " << executeMode << ". Available execution modes are:" << std::endl;
       std::cerr << "1)  --compute-gt" << std::endl;
       std::cerr << "2)  --create" << std::endl;
       std::cerr << "3)  --test" << std::endl;
+      std::cerr << "4)  --serve" << std::endl;
       return 1;
     }
   } catch (std::invalid_argument& e) {
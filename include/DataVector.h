@@ -135,6 +135,13 @@ public:
     */
     inline dvector_t getDataAtIndex(const unsigned int index) const { return this->data[index]; }
 
+    /**
+     * @brief Retrieves the contiguous array of the data of the vector, for the distance kernels that work on arrays.
+     * 
+     * @return a pointer to the first value of the vector
+    */
+    inline const dvector_t* getRawData(void) const { return this->data; }
+
     /**
      * @brief Retrieves the dimension of the vector.
      * 
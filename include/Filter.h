@@ -14,6 +14,14 @@ enum FilterType {
 
 };
 
+// Enum to define how the categorical filters of a query are combined, for points that carry several labels
+enum LabelMatch {
+
+  MATCH_ALL = 0,                   // The point must carry every label of the query (AND).
+  MATCH_ANY = 1                    // The point must carry at least one label of the query (OR).
+
+};
+
 struct CategoricalAttributeFilter {
 
 private:
@@ -51,6 +59,33 @@ public:
 
 };
 
+struct TimestampRangeFilter {
+
+private:
+  float l;
+  float r;
+
+public:
+
+  TimestampRangeFilter() : l(0), r(0) {}
+
+  TimestampRangeFilter(float l_value, float r_value) : l(l_value), r(r_value) {}
+
+  inline float getL() const { 
+    return l;
+  }
+
+  inline float getR() const { 
+    return r;
+  }
+
+  // Checks whether a timestamp satisfies the constraint l ≤ T ≤ r
+  inline bool contains(float T) const {
+    return l <= T && T <= r;
+  }
+
+};
+
 // std::ostream& operator<<(std::ostream& out, const CategoricalAttributeFilter& filter) {
 //   out << filter.getC();
 //   return out;
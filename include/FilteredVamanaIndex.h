@@ -4,17 +4,171 @@
 #include <iostream>
 #include <map>
 #include "VamanaIndex.h"
+#include "LabelIndex.h"
 #include "Filter.h"
 
 using Filter = CategoricalAttributeFilter;
 
 template <typename vamana_t> class VamanaIndex;
+struct StartNodeCache;
+struct GraphFileSection;
 
 template <typename vamana_t> class FilteredVamanaIndex : public VamanaIndex<vamana_t> {
 
 protected:
 
   std::set<CategoricalAttributeFilter> F;
+  std::vector<unsigned int> timestampOrder;   // Indexes of the points, sorted by their timestamp
+  std::vector<float> sortedTimestamps;        // Timestamps of the points, in the order of timestampOrder
+  std::vector<unsigned int> recentOrder;      // Indexes of the inserted points that are not merged yet, sorted by timestamp
+  std::vector<float> recentTimestamps;        // Timestamps of the inserted points, in the order of recentOrder
+  LabelIndex labels;                          // Posting lists and bitmaps of the categorical labels
+  std::vector<std::vector<unsigned int>> labelSets; // Label set of every point, if the points carry several labels
+  std::vector<unsigned int> labelStartNodes;  // Start node of every label, indexed by the slot of the label
+  std::vector<StartNodeCache> labelStartCaches; // Diverse start nodes of every label, empty without a start node cache
+
+  // Shared by the searches that read the label index, the timestamp index and the start nodes, exclusive while an
+  // inserted point is added to them
+  mutable ReadWriteLock filtersLock;
+
+  /**
+   * @brief Builds the sorted-by-T index of the points, which is used to enumerate the points that satisfy a
+   * timestamp range filter without scanning the whole dataset.
+   */
+  void buildTimestampIndex(void);
+
+  /**
+   * @brief Merges the inserted points of the side run of the timestamp index into its main run.
+   */
+  void mergeRecentTimestamps(void);
+
+  /**
+   * @brief Builds the label index of the points: the posting list of every categorical label, and a bitmap for
+   * every dense label. The labels of a point are its label set if one was given with setLabelSets, otherwise its
+   * categorical attribute C. The filters of the index become the labels the points carry, and the sizes of the
+   * lists are the label cardinalities used by the query planner.
+   */
+  void buildLabelIndex(void);
+
+  /**
+   * @brief Selects the start node of every label with the load-balanced sampling of the Filtered-DiskANN paper: for
+   * every label a random sample of tau points that carry it is drawn, and the sampled point that is already the
+   * start node of the fewest labels is chosen.
+   * 
+   * @param tau The size of the sample of every label.
+   * @return The index of the start node of every label, indexed by the slot of the label.
+   */
+  std::vector<unsigned int> selectStartNodes(const unsigned int tau) const;
+
+  /**
+   * @brief Selects the start node of every label and keeps them, also as the entry points of the index, so that
+   * they are stored with the graph and looked up directly at query time.
+   * 
+   * @param tau The size of the sample of every label.
+   */
+  void buildStartNodes(const unsigned int tau);
+
+  /**
+   * @brief Searches the candidate neighbors of an inserted point with a FilteredGreedySearch from the start nodes of
+   * its labels, visiting the points that share at least one label with it.
+   * 
+   * @param point the index of the inserted point
+   * @param s the start node of the unfiltered search, not used
+   * @param L the parameter L
+   * @param distanceSaveMethod the method used to compute the distances
+   * 
+   * @return the visited nodes of the search
+   */
+  std::set<vamana_t> searchInsertCandidates(
+    const unsigned int point, 
+    const GraphNode<vamana_t>& s, 
+    const unsigned int L, 
+    const DISTANCE_SAVE_METHOD distanceSaveMethod
+  ) const override;
+
+  /**
+   * @brief Prunes the neighbors of a node, together with a set of candidates, with the index-based
+   * FilteredRobustPrune. Only the list of the given node is modified.
+   * 
+   * @param node the node whose neighbors are pruned
+   * @param V the candidate neighbors of the node
+   * @param alpha the parameter alpha
+   * @param R the parameter R
+   * @param distanceSaveMethod the method used to compute the distances
+   */
+  void pruneInsertNeighbors(
+    GraphNode<vamana_t>& node, 
+    std::set<vamana_t>& V, 
+    const float alpha, 
+    const unsigned int R, 
+    const DISTANCE_SAVE_METHOD distanceSaveMethod
+  ) override;
+
+  /**
+   * @brief Appends an inserted point with its categorical attribute C as its only label.
+   * 
+   * @param point the point to append
+   * 
+   * @return the index of the appended point
+   */
+  unsigned int appendPoint(const vamana_t& point) override;
+
+  /**
+   * @brief Appends an inserted point to the vector store and the graph, and adds it to the label index and the
+   * timestamp index. A point that carries a label no other point carries becomes the start node of the label.
+   * It is always called with the append mutex held.
+   * 
+   * @param point the point to append
+   * @param pointLabels the labels of the point
+   * 
+   * @return the index of the appended point
+   */
+  unsigned int appendPoint(const vamana_t& point, const std::vector<unsigned int>& pointLabels);
+
+  /**
+   * @brief Renumbers the points after the removed points are consolidated, and rebuilds the label index and the
+   * timestamp index on the remaining points. Labels keep their start node, unless it was removed, and their cached
+   * start nodes that were not removed.
+   * 
+   * @param newIndexes the new index of every point, or NO_POINT for the removed points
+   */
+  void compactPoints(const std::vector<unsigned int>& newIndexes) override;
+
+  /**
+   * @brief Returns the label index, the start nodes and the start node caches of the labels as sections of
+   * graph-only index files, so that they are not rebuilt on loading.
+   * 
+   * @return the sections of the index
+   */
+  std::vector<GraphFileSection> getGraphFileSections(void) const override;
+
+  /**
+   * @brief Loads the label index, the start nodes or the start node caches of the labels from their sections of a
+   * graph-only index file.
+   * 
+   * @param section the section that was read
+   * 
+   * @return true if the section was recognized and loaded, false otherwise
+   */
+  bool loadGraphFileSection(const GraphFileSection& section) override;
+
+  /**
+   * @brief Writes the start nodes of the labels as a block of text index files, keyed by label value.
+   * 
+   * @param out the stream of the index file
+   */
+  void saveGraphTextBlocks(std::ostream& out) const override;
+
+  /**
+   * @brief Reads the start nodes of the labels from their block of a text index file. The label index is built from
+   * the loaded points first, so that the labels of the block can be found.
+   * 
+   * @param tag the tag of the block
+   * @param in the stream of the index file, right after the tag
+   * 
+   * @return true if the block was recognized and read, false otherwise
+   */
+  bool loadGraphTextBlock(const std::string& tag, std::istream& in) override;
 
 public:
   
@@ -44,6 +198,37 @@ public:
    */
   void setFilters(std::set<CategoricalAttributeFilter> filters) { this->F = filters; }
 
+  /**
+   * @brief Set the label set of every point, for datasets whose points carry several labels. It must be called
+   * before createGraph, and replaces the categorical attribute C of the points as their labels.
+   * 
+   * @param labelSets The labels of every point, in the order of the points given to createGraph.
+   */
+  void setLabelSets(const std::vector<std::vector<unsigned int>>& labelSets) { this->labelSets = labelSets; }
+
+  /**
+   * @brief Inserts a point with its categorical attribute C as its only label. Multi-label indexes refuse it,
+   * since their points must be inserted with their label set.
+   * 
+   * @param point the point to insert
+   * @param index output parameter, set to the index of the inserted point
+   * 
+   * @return true if the point was inserted, false otherwise
+   */
+  bool insert(const vamana_t& point, unsigned int& index) override;
+
+  /**
+   * @brief Inserts a point that carries a set of labels. Labels other than the attribute C of the point turn the
+   * index into a multi-label one. Insertions may run together with queries, as with the plain index.
+   * 
+   * @param point the point to insert
+   * @param pointLabels the labels of the point, which must not be empty
+   * @param index output parameter, set to the index of the inserted point
+   * 
+   * @return true if the point was inserted, false if it has no labels or the index has no build parameters
+   */
+  virtual bool insert(const vamana_t& point, const std::vector<unsigned int>& pointLabels, unsigned int& index);
+
   /**
    * @brief Get nodes that match a specific categorical value filter.
    * 
@@ -52,6 +237,121 @@ public:
    */
   std::vector<GraphNode<vamana_t>> getNodesWithCategoricalValueFilter(const CategoricalAttributeFilter& filter);
 
+  /**
+   * @brief Get the label index of the points, which answers label membership tests in constant time.
+   * 
+   * @return The label index.
+   */
+  inline const LabelIndex& getLabelIndex(void) const { return this->labels; }
+
+  /**
+   * @brief Get the lock of the label index, the timestamp index and the start nodes. Searches that read them while
+   * points may be inserted hold its shared side for short sections, must not take it again before they release
+   * it, and must not wait for the lock of a graph node while they hold it.
+   * 
+   * @return The lock of the filters.
+   */
+  inline ReadWriteLock& getFiltersLock(void) const { return this->filtersLock; }
+
+  /**
+   * @brief Get the start node of a categorical label, which was selected when the index was built.
+   * 
+   * @param filter The CategoricalAttributeFilter of the label.
+   * @return The index of the start node, or LabelIndex::NO_LABEL if no point carries the label.
+   */
+  inline unsigned int getStartNode(const CategoricalAttributeFilter& filter) const {
+    unsigned int slot = this->labels.findLabel(filter.getC());
+    return slot < this->labelStartNodes.size() ? this->labelStartNodes[slot] : LabelIndex::NO_LABEL;
+  }
+
+  /**
+   * @brief Get the start nodes of all the labels, in the order of the labels of the label index.
+   * 
+   * @return The indexes of the start nodes.
+   */
+  inline const std::vector<unsigned int>& getStartNodes(void) const { return this->labelStartNodes; }
+
+  /**
+   * @brief Get the start nodes of a query: the start node of every label of the query, looked up by slot, or the
+   * global medoid for a query without labels. Labels that no point carries are skipped, so the search can fall
+   * back to the posting lists.
+   * 
+   * @param queryFilters The categorical filters of the query.
+   * @return The start nodes of the traversal, which are as many as the labels of the query at most.
+   */
+  std::vector<GraphNode<vamana_t>> getQueryStartNodes(const std::vector<CategoricalAttributeFilter>& queryFilters) const;
+
+  /**
+   * @brief Get the start nodes of a query, choosing them by the query vector: for every label of the query the
+   * cached start node of the label nearest to the query, or the start node of the label if the index has no start
+   * node cache, and for a query without labels the start node that findSearchStart finds.
+   * 
+   * @param queryFilters The categorical filters of the query.
+   * @param xq The query vector.
+   * @return The start nodes of the traversal, which are as many as the labels of the query at most.
+   */
+  std::vector<GraphNode<vamana_t>> getQueryStartNodes(const std::vector<CategoricalAttributeFilter>& queryFilters, const DataVector<float>& xq) const;
+
+  /**
+   * @brief Builds the start node cache of the index, and a start node cache for every label: K diverse points
+   * that carry the label, chosen with k-means++ seeding starting from the start node of the label. Filtered
+   * searches start from the cached node of every query label that is nearest to the query.
+   * 
+   * @param K the number of start nodes of the index and of every label
+   * @param threads the number of threads of the pool that build the caches
+   * 
+   * @return the number of start nodes of the index
+   */
+  unsigned int buildStartNodeCache(const unsigned int K, const unsigned int threads = 1) override;
+
+  /**
+   * @brief Drops the start node caches of the index and of the labels.
+   */
+  void clearStartNodeCache(void) override;
+
+  /**
+   * @brief Get the start node caches of the labels, in the order of the labels of the label index.
+   * 
+   * @return The caches, empty if the index has no start node cache.
+   */
+  inline const std::vector<StartNodeCache>& getLabelStartCaches(void) const { return this->labelStartCaches; }
+
+  /**
+   * @brief Get the indexes of the points that carry a categorical label.
+   * 
+   * @param filter The CategoricalAttributeFilter of the label.
+   * @return The posting list of the label, empty if no point carries it.
+   */
+  const std::vector<unsigned int>& getNodesWithLabel(const CategoricalAttributeFilter& filter) const;
+
+  /**
+   * @brief Get the number of points that carry a categorical label.
+   * 
+   * @param filter The CategoricalAttributeFilter of the label.
+   * @return The cardinality of the label.
+   */
+  unsigned int getLabelCardinality(const CategoricalAttributeFilter& filter) const {
+    ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+    return this->getNodesWithLabel(filter).size();
+  }
+
+  /**
+   * @brief Get the indexes of the points whose timestamp lies inside a range. The points are found with a binary
+   * search on the sorted-by-T index, so the cost depends only on the number of points in the range.
+   * 
+   * @param range The TimestampRangeFilter the points must satisfy.
+   * @return The indexes of the matching points, in ascending timestamp order.
+   */
+  std::vector<unsigned int> getNodesInTimestampRange(const TimestampRangeFilter& range) const;
+
+  /**
+   * @brief Count the points whose timestamp lies inside a range.
+   * 
+   * @param range The TimestampRangeFilter the points must satisfy.
+   * @return The number of matching points.
+   */
+  unsigned int countNodesInTimestampRange(const TimestampRangeFilter& range) const;
+
   /**
    * @brief Create the graph with the given parameters.
    * 
@@ -59,6 +359,7 @@ public:
    * @param alpha A float parameter.
    * @param L An unsigned int parameter.
    * @param R An unsigned int parameter.
+   * @param build_threads The number of threads that insert the points, 1 for the sequential insertion order.
    */
   void createGraph(
     const std::vector<vamana_t>& P, 
@@ -68,7 +369,8 @@ public:
     const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE,
     unsigned int distance_threads = 1, 
     bool visualized = true, 
-    bool empty = true
+    bool empty = true,
+    unsigned int build_threads = 1
   );
 
   /**
@@ -77,18 +379,17 @@ public:
    * production making it easy to use an index with specific parameters just by loading it instead of creating it again.
    * 
    * @param filename the full path of the file containing the graph
+   * @param baseFile optional path of the dataset file, used by graph-only index files
    * 
    * @return true if the graph was loaded successfully, false otherwise
   */
-  bool loadGraph(const std::string& filename);
+  bool loadGraph(const std::string& filename, const std::string& baseFile = "");
 
   /**
-   * @brief Finds the set of medoid nodes in the graph using a sample of nodes.
-   *
-   * The medoid is the node with the minimum average distance to all other nodes in the sample.
-   * This function uses Euclidean distance to calculate the distances between nodes.
+   * @brief Finds the set of medoid nodes in the graph using a sample of nodes. The start nodes of an index that
+   * was built or loaded are already available through getStartNode, without running this method again.
    *
-   * @param tau The graph from which to find the medoid.
+   * @param tau The size of the sample of every label.
    * @return A map containing the medoid node for each filter.
    */
   std::map<Filter, GraphNode<vamana_t>> findFilteredMedoid(const unsigned int tau);
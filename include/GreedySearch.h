@@ -14,6 +14,8 @@
 #include "distance.h"
 #include <queue>
 #include <cmath>
+#include <chrono>
+#include <limits>
 #include "VamanaIndex.h"
 #include "FilteredVamanaIndex.h"
 
@@ -29,6 +31,60 @@ enum EXEC_MODE {
 };
 
 
+/**
+ * @brief Optional limits on the work of a greedy search, for callers that would rather lose some recall than
+ * exceed a latency target. Every limit is disabled by default (0, or no deadline). Before each expansion the search
+ * checks the limits, and once one is reached it stops and returns the nearest points it found so far with the
+ * truncated flag set. The limits are checked between expansions, so a search may overshoot the distance
+ * computations by the degree of one node.
+ *
+ * The budget may also stop a search once it converged, so that easy queries finish before L candidates are
+ * exhausted: when the k-th nearest distance found has not improved for `patience` consecutive expansions, or when
+ * the nearest unvisited candidate is farther than (1 + epsilon) times the k-th nearest distance. Both are disabled
+ * by default, and a search they stop sets the converged flag instead of the truncated one.
+ *
+ * The search adds what it spent to the counters of the budget, so a budget passed to several searches bounds
+ * them together.
+ */
+struct SearchBudget {
+  unsigned int maxDistanceComputations = 0;   // Distances to the query computed, at most one per point and search
+  unsigned int maxHops = 0;                   // Nodes whose neighbors are expanded
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  unsigned int patience = 0;                  // Expansions without improving the k-th distance before stopping
+  float epsilon = std::numeric_limits<float>::infinity();
+
+  unsigned int distanceComputations = 0;
+  unsigned int hops = 0;
+  bool truncated = false;                     // Set when a search stopped because of a limit
+  bool converged = false;                     // Set when a search stopped because of patience or epsilon
+
+  /**
+   * @brief Sets the deadline a number of seconds from now.
+   *
+   * @param seconds the time the searches may take
+   */
+  inline void setTimeout(const double seconds) {
+    this->deadline = std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+  }
+
+  /**
+   * @brief Returns whether one of the limits has been reached.
+   */
+  inline bool isExhausted(void) const {
+    return (this->maxDistanceComputations > 0 && this->distanceComputations >= this->maxDistanceComputations) ||
+           (this->maxHops > 0 && this->hops >= this->maxHops) ||
+           (this->deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= this->deadline);
+  }
+
+  /**
+   * @brief Returns whether the search should track its convergence, for patience or epsilon.
+   */
+  inline bool stopsOnConvergence(void) const {
+    return this->patience > 0 || this->epsilon != std::numeric_limits<float>::infinity();
+  }
+};
+
 template <typename vamana_t> class VamanaIndex;
 template <typename vamana_t> class FilteredVamanaIndex;
 
@@ -36,7 +92,8 @@ template <typename vamana_t> class FilteredVamanaIndex;
  * @brief Greedy search algorithm for finding the k nearest nodes in a graph relative to a query vector.
  * 
  * This function implements a greedy search that iteratively explores the closest nodes to the query vector.
- * It maintains a candidate set of nodes to visit and a visited set of nodes already processed.
+ * It maintains a candidate set of nodes to visit and a visited set of nodes already processed. The neighbors of
+ * a node are read under the shared lock of the node, so the search may run while points are inserted.
  * 
  * @param graph_t Type of data stored in the graph nodes
  * @param G The graph to search
@@ -44,6 +101,8 @@ template <typename vamana_t> class FilteredVamanaIndex;
  * @param xq Query vector for distance computation
  * @param k Number of nearest nodes to return
  * @param L Maximum number of nodes in the candidate set
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param budget Optional limits of the search, which also receive the work it spent and whether it was truncated
  * 
  * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
  */
@@ -53,7 +112,8 @@ template <typename graph_t, typename query_t> std::pair<std::set<graph_t>, std::
     const query_t& xq, 
     unsigned int k, 
     unsigned int L,
-    const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE
+    const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE,
+    SearchBudget* budget = nullptr
 );
 
 /**
@@ -62,6 +122,8 @@ template <typename graph_t, typename query_t> std::pair<std::set<graph_t>, std::
  * This function implements a greedy search that iteratively explores the closest nodes to the query vector.
  * It maintains a candidate set of nodes to visit and a visited set of nodes already processed. This version
  * of the function is used with a FilteredVamanaIndex, which applies additional filtering criteria to the search.
+ * It takes the shared filters lock of the index only around its label lookups, never while it waits for the lock
+ * of a node, so a pending insertion does not stall it. The caller must not hold the filters lock.
  * 
  * @param graph_t Type of data stored in the graph nodes
  * @param query_t Type of the query vector
@@ -71,7 +133,10 @@ template <typename graph_t, typename query_t> std::pair<std::set<graph_t>, std::
  * @param k Number of nearest nodes to return
  * @param L Maximum number of nodes in the candidate set
  * @param queryFilters A vector of CategoricalAttributeFilter objects to apply to the search
- * @param mode Execution mode for the algorithm
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param rangeFilters A vector of TimestampRangeFilter objects to apply to the search
+ * @param labelMatch Whether the points must carry all the labels of queryFilters (MATCH_ALL) or any of them (MATCH_ANY)
+ * @param budget Optional limits of the search, which also receive the work it spent and whether it was truncated
  * 
  * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
  * 
@@ -83,8 +148,103 @@ template <typename graph_t, typename query_t> std::pair<std::set<graph_t>, std::
     const unsigned int k, 
     const unsigned int L,  
     const std::vector<CategoricalAttributeFilter>& queryFilters,
+    const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE,
+    const std::vector<TimestampRangeFilter>& rangeFilters = std::vector<TimestampRangeFilter>(),
+    const LabelMatch labelMatch = MATCH_ALL,
+    SearchBudget* budget = nullptr
+);
+
+/**
+ * @brief Filtered greedy search that starts only from the start nodes of the labels of the query, or from the
+ * start node the navigation layer or the start node cache finds for a query without labels, which is the global
+ * medoid of an index without either. With a start node cache every label starts from its cached start node that
+ * is nearest to the query. The start nodes are looked up by label slot, so the cost of starting a search does not
+ * depend on the number of labels of the index.
+ * 
+ * @param graph_t Type of data stored in the graph nodes
+ * @param query_t Type of the query vector
+ * @param index The FilteredVamanaIndex to search
+ * @param xq Query vector for distance computation
+ * @param k Number of nearest nodes to return
+ * @param L Maximum number of nodes in the candidate set
+ * @param queryFilters A vector of CategoricalAttributeFilter objects to apply to the search
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param rangeFilters A vector of TimestampRangeFilter objects to apply to the search
+ * @param labelMatch Whether the points must carry all the labels of queryFilters (MATCH_ALL) or any of them (MATCH_ANY)
+ * @param budget Optional limits of the search, which also receive the work it spent and whether it was truncated
+ * 
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+ */
+template <typename graph_t, typename query_t> std::pair<std::set<graph_t>, std::set<graph_t>> FilteredGreedySearch(
+    const FilteredVamanaIndex<graph_t>& index, 
+    const query_t& xq,  
+    const unsigned int k, 
+    const unsigned int L,  
+    const std::vector<CategoricalAttributeFilter>& queryFilters,
+    const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE,
+    const std::vector<TimestampRangeFilter>& rangeFilters = std::vector<TimestampRangeFilter>(),
+    const LabelMatch labelMatch = MATCH_ALL,
+    SearchBudget* budget = nullptr
+);
+
+/**
+ * @brief Exhaustive search over a list of points of the index. Computes the distance between the query vector and
+ * every point of the list that is not removed and keeps the k nearest ones, so the result is exact.
+ * 
+ * @param graph_t Type of data stored in the graph nodes
+ * @param query_t Type of the query vector
+ * @param index The VamanaIndex that stores the points
+ * @param points The indexes of the points to scan
+ * @param xq Query vector for distance computation
+ * @param k Number of nearest nodes to return
+ * @param distanceSaveMethod The method used to compute the distances
+ * 
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all scanned nodes
+ */
+template <typename graph_t, typename query_t> std::pair<std::set<graph_t>, std::set<graph_t>> ExhaustiveSearch(
+    const VamanaIndex<graph_t>& index, 
+    const std::vector<unsigned int>& points, 
+    const query_t& xq,  
+    const unsigned int k, 
     const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE
 );
+
+/**
+ * @brief Search algorithm for queries with a timestamp range filter (query types 2 and 3).
+ * 
+ * The points that satisfy the range are enumerated with the sorted-by-T index of the FilteredVamanaIndex. If at
+ * most `bruteForceLimit` points satisfy all the filters of the query, they are scanned exhaustively, which is both
+ * exact and cheaper than a graph traversal. Otherwise a FilteredGreedySearch with the range predicate is executed,
+ * seeded with the start nodes that pass the filters and with points spread evenly across the range, so that the
+ * traversal can start even when none of the start nodes lies inside the range.
+ * 
+ * @param graph_t Type of data stored in the graph nodes
+ * @param query_t Type of the query vector
+ * @param index The FilteredVamanaIndex to search
+ * @param S Starting nodes for the search
+ * @param xq Query vector for distance computation
+ * @param k Number of nearest nodes to return
+ * @param L Maximum number of nodes in the candidate set
+ * @param queryFilters A vector of CategoricalAttributeFilter objects to apply to the search
+ * @param range The TimestampRangeFilter of the query
+ * @param bruteForceLimit The maximum number of qualifying points that are scanned exhaustively
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param budget Optional limits of the graph traversal, the exhaustive scan is not limited
+ * 
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+ */
+template <typename graph_t, typename query_t> std::pair<std::set<graph_t>, std::set<graph_t>> TimestampRangeSearch(
+    const FilteredVamanaIndex<graph_t>& index, 
+    const std::vector<GraphNode<graph_t>>& S, 
+    const query_t& xq,  
+    const unsigned int k, 
+    const unsigned int L,  
+    const std::vector<CategoricalAttributeFilter>& queryFilters,
+    const TimestampRangeFilter& range,
+    const unsigned int bruteForceLimit = 5000,
+    const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE,
+    SearchBudget* budget = nullptr
+);
                      
 
 #endif // GREEDY_SEARCH_H
@@ -0,0 +1,99 @@
+#ifndef INDEX_HANDLE_H
+#define INDEX_HANDLE_H
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
+
+/**
+ * @brief Handle through which a long-lived process searches an index that may be replaced while it runs. The
+ * handle holds the current snapshot of the index behind a reference-counted pointer: every search acquires the
+ * snapshot once and keeps it for its whole duration, and a new snapshot, freshly built or loaded from a file, is
+ * published with an atomic pointer swap. Searches that started on the previous snapshot finish on it, and the
+ * previous snapshot is freed when the last of them releases it, so replacing an index never pauses the searches.
+ *
+ * @param index_t The type of the index, which must be default constructible and provide loadGraph
+ */
+template <typename index_t> class IndexHandle {
+
+private:
+  std::shared_ptr<index_t> current;       // Read and written only with the atomic shared_ptr operations
+  std::atomic<unsigned long long> generation;
+
+  std::mutex reloadMutex;                 // Serializes the loads, which also update the file bookkeeping below
+  std::string loadedFile;
+  std::string loadedBaseFile;
+  long long loadedTime;                   // Modification time of the loaded file, in nanoseconds
+
+  /**
+   * @brief Returns the last modification time of a file, in nanoseconds where the file system records them, so that
+   * a file replaced within the same second as the last load is still seen as modified.
+   *
+   * @param filename the full path of the file
+   * @param time output parameter, set to the modification time of the file
+   * @return true if the file exists, false otherwise
+   */
+  static bool getModificationTime(const std::string& filename, long long& time);
+
+public:
+
+  /**
+   * @brief Constructor of the IndexHandle. Creates a handle without an index.
+   */
+  IndexHandle(void) : generation(0), loadedTime(0) {}
+
+  /**
+   * @brief Constructor of the IndexHandle. Creates a handle that publishes an index that is already built.
+   *
+   * @param index the first snapshot of the handle
+   */
+  explicit IndexHandle(const std::shared_ptr<index_t>& index) : current(index), generation(index ? 1 : 0), loadedTime(0) {}
+
+  IndexHandle(const IndexHandle&) = delete;
+  IndexHandle& operator=(const IndexHandle&) = delete;
+
+  /**
+   * @brief Returns the current snapshot of the index. The snapshot stays valid for as long as the returned pointer
+   * is kept, even if another snapshot is published meanwhile, so a search should acquire it once and use it to the end.
+   *
+   * @return the current snapshot, or an empty pointer if no index was published yet
+   */
+  std::shared_ptr<index_t> acquire(void) const;
+
+  /**
+   * @brief Publishes a new snapshot of the index to the searches that start from now on.
+   *
+   * @param index the new snapshot
+   * @return the previous snapshot, which is freed once the caller and the searches that still use it release it
+   */
+  std::shared_ptr<index_t> publish(const std::shared_ptr<index_t>& index);
+
+  /**
+   * @brief Loads an index from a file into a new snapshot and publishes it. The current snapshot keeps serving the
+   * searches while the file is loaded, and stays published if the file cannot be loaded.
+   *
+   * @param filename the full path of the index file
+   * @param baseFile optional path of the dataset file of a graph-only index file
+   * @return true if the index was loaded and published, false otherwise
+   */
+  bool load(const std::string& filename, const std::string& baseFile = "");
+
+  /**
+   * @brief Loads the index file of the last load again if the file was modified since, for example because an
+   * index created with --create replaced it.
+   *
+   * @return true if a new snapshot was published, false if the file did not change or could not be loaded
+   */
+  bool reloadIfModified(void);
+
+  /**
+   * @brief Returns the number of snapshots that were published, so that a process can tell that the index changed.
+   *
+   * @return the generation of the current snapshot
+   */
+  inline unsigned long long getGeneration(void) const { return this->generation.load(); }
+
+};
+
+#endif /* INDEX_HANDLE_H */
@@ -0,0 +1,219 @@
+#ifndef LABEL_INDEX_H
+#define LABEL_INDEX_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include <algorithm>
+
+/**
+ * @brief Inverted index of the categorical labels of a dataset, where every point carries a set of labels. For
+ * every distinct label it keeps the posting list of the points that carry it, in ascending point order, and for
+ * the dense labels (those carried by at least 1 / denseDivisor of the points) a bitmap over all the points as well.
+ * The label set of every point is kept as a small sorted array of label slots.
+ *
+ * Labels are addressed by their slot, their position in the sorted list of distinct labels, so that a search can
+ * resolve the labels of its query once and then answer every membership test without a lookup: dense labels with
+ * a single bit test, and sparse labels with a search in the (usually one or two element) label set of the point.
+ */
+class LabelIndex {
+
+private:
+  unsigned int pointsCount;
+  std::vector<unsigned int> labels;                 // Distinct label values, sorted
+  std::vector<std::vector<unsigned int>> postings;  // Points that carry every label, sorted
+  std::vector<unsigned int> pointOffsets;           // Offset of the label set of every point in pointSlots
+  std::vector<unsigned int> pointSlots;             // Sorted label slots of every point, one after the other
+  std::vector<unsigned int> bitmapOffsets;          // Offset of the bitmap of every label in bitmaps, or NO_BITMAP
+  std::vector<uint64_t> bitmaps;                    // Bitmaps of the dense labels, one bit per point
+  unsigned int bitmapPoints;                        // Points covered by the bitmaps, later points are not in them
+  std::vector<unsigned int> labelSlots;             // Slot of every label value, when the label values are small
+
+  static const unsigned int NO_BITMAP = UINT_MAX;
+
+  /**
+   * @brief Builds the bitmaps of the labels whose cardinality reaches the density threshold.
+   *
+   * @param denseDivisor a label is dense if it is carried by at least pointsCount / denseDivisor points
+   */
+  void buildBitmaps(const unsigned int denseDivisor);
+
+  /**
+   * @brief Builds the label sets of the points from the posting lists.
+   */
+  void buildPointSlots(void);
+
+  /**
+   * @brief Builds a direct lookup table from label values to slots, if the label values are small enough for
+   * the table to be at most a few times larger than the list of labels. Otherwise labels are found with a
+   * binary search.
+   */
+  void buildLabelLookup(void);
+
+public:
+
+  static const unsigned int NO_LABEL = UINT_MAX;
+
+  /**
+   * @brief Default constructor of the LabelIndex. Creates an empty index.
+   */
+  LabelIndex(void) : pointsCount(0), bitmapPoints(0) {}
+
+  /**
+   * @brief Builds the index from the label of every point.
+   *
+   * @param pointLabels the label of every point, indexed by point
+   * @param denseDivisor a label gets a bitmap if it is carried by at least pointsCount / denseDivisor points
+   */
+  void build(const std::vector<unsigned int>& pointLabels, const unsigned int denseDivisor = 32);
+
+  /**
+   * @brief Builds the index from the label set of every point.
+   *
+   * @param pointLabels the labels of every point, indexed by point (duplicates are ignored)
+   * @param denseDivisor a label gets a bitmap if it is carried by at least pointsCount / denseDivisor points
+   */
+  void build(const std::vector<std::vector<unsigned int>>& pointLabels, const unsigned int denseDivisor = 32);
+
+  /**
+   * @brief Appends a point to the index, as the point after the last one. The point is added to the end of the
+   * posting lists of its labels and is not added to the bitmaps, which keep covering the points of the last build,
+   * so appending takes amortized constant time. A label that no point carried before gets a slot of its own, which
+   * moves the slots of the labels that sort after it.
+   *
+   * @param pointLabels the labels of the point (duplicates are ignored)
+   * @return the labels that no point carried before, sorted
+   */
+  std::vector<unsigned int> addPoint(const std::vector<unsigned int>& pointLabels);
+
+  /**
+   * @brief Removes the contents of the index.
+   */
+  void clear(void);
+
+  /**
+   * @brief Finds the slot of a label, with a single table lookup when the label values are small.
+   *
+   * @param label the label value
+   * @return the slot of the label, or NO_LABEL if no point carries it
+   */
+  inline unsigned int findLabel(const unsigned int label) const {
+    if (!this->labelSlots.empty()) {
+      return label < this->labelSlots.size() ? this->labelSlots[label] : NO_LABEL;
+    }
+    auto it = std::lower_bound(this->labels.begin(), this->labels.end(), label);
+    return (it == this->labels.end() || *it != label) ? NO_LABEL : it - this->labels.begin();
+  }
+
+  /**
+   * @brief Checks whether a point carries the label of a slot. Dense labels are answered with a bit test and the
+   * rest with a binary search in the label set of the point, which holds a handful of labels at most.
+   *
+   * @param slot the slot of the label, as returned by findLabel
+   * @param point the index of the point
+   * @return true if the point carries the label, false otherwise (always false for NO_LABEL)
+   */
+  inline bool contains(const unsigned int slot, const unsigned int point) const {
+    if (slot >= this->labels.size() || point >= this->pointsCount) {
+      return false;
+    }
+    unsigned int offset = this->bitmapOffsets[slot];
+    if (offset != NO_BITMAP && point < this->bitmapPoints) {
+      return (this->bitmaps[offset + (point >> 6)] >> (point & 63)) & 1;
+    }
+    const unsigned int* first = this->pointSlots.data() + this->pointOffsets[point];
+    const unsigned int* last = this->pointSlots.data() + this->pointOffsets[point + 1];
+    first = std::lower_bound(first, last, slot);
+    return first != last && *first == slot;
+  }
+
+  /**
+   * @brief Returns the label set of a point as a sorted array of label slots.
+   *
+   * @param point the index of the point
+   * @return pointer to the first slot of the point, followed by getPointLabelsCount(point) - 1 more
+   */
+  inline const unsigned int* getPointSlots(const unsigned int point) const { return this->pointSlots.data() + this->pointOffsets[point]; }
+
+  /**
+   * @brief Returns the number of labels a point carries.
+   *
+   * @param point the index of the point
+   * @return the size of the label set of the point
+   */
+  inline unsigned int getPointLabelsCount(const unsigned int point) const { return this->pointOffsets[point + 1] - this->pointOffsets[point]; }
+
+  /**
+   * @brief Returns the number of 64-bit words of the label masks relative to a reference point.
+   *
+   * @param reference the index of the reference point
+   * @return the number of words needed for one bit per label of the reference point
+   */
+  inline unsigned int getMaskWords(const unsigned int reference) const { return (this->getPointLabelsCount(reference) + 63) / 64; }
+
+  /**
+   * @brief Computes the label set of a point relative to the label set of a reference point, as a bitset where
+   * bit i is set if the point carries the i-th label of the reference. Two such masks turn the intersections and
+   * subset tests between label sets into a few word operations.
+   *
+   * @param point the index of the point
+   * @param reference the index of the reference point
+   * @param mask output array of getMaskWords(reference) words
+   */
+  void getLabelMask(const unsigned int point, const unsigned int reference, uint64_t* mask) const;
+
+  /**
+   * @brief Returns the posting list of the label of a slot.
+   *
+   * @param slot the slot of the label
+   * @return the indexes of the points that carry the label, empty for NO_LABEL
+   */
+  const std::vector<unsigned int>& getPoints(const unsigned int slot) const;
+
+  /**
+   * @brief Returns the number of points that carry the label of a slot.
+   *
+   * @param slot the slot of the label
+   * @return the cardinality of the label, 0 for NO_LABEL
+   */
+  inline unsigned int getCardinality(const unsigned int slot) const { return this->getPoints(slot).size(); }
+
+  /**
+   * @brief Checks whether the label of a slot has a bitmap.
+   *
+   * @param slot the slot of the label
+   * @return true if the label is dense, false otherwise
+   */
+  inline bool isDense(const unsigned int slot) const { return slot < this->labels.size() && this->bitmapOffsets[slot] != NO_BITMAP; }
+
+  /**
+   * @brief Returns the distinct labels of the index, sorted.
+   */
+  inline const std::vector<unsigned int>& getLabels(void) const { return this->labels; }
+
+  /**
+   * @brief Returns the number of points the index was built on.
+   */
+  inline unsigned int getPointsCount(void) const { return this->pointsCount; }
+
+  /**
+   * @brief Writes the index into a binary stream: the labels with their posting lists, followed by the bitmaps
+   * of the dense labels.
+   *
+   * @param out the stream to write to
+   * @return true if the index was written successfully, false otherwise
+   */
+  bool save(std::ostream& out) const;
+
+  /**
+   * @brief Reads an index that was written with save.
+   *
+   * @param in the stream to read from
+   * @return true if the index was read successfully, false otherwise (the index is left empty)
+   */
+  bool load(std::istream& in);
+
+};
+
+#endif /* LABEL_INDEX_H */
@@ -0,0 +1,66 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Read-only view of the whole contents of a file. The file is memory mapped when the operating system
+ * allows it, so that the readers can parse it in place without issuing a read call per value. If mapping fails
+ * the file is read into memory with a single bulk read instead.
+ */
+class MappedFile {
+
+private:
+  const char* bytes;
+  size_t fileSize;
+  bool mapped;
+  std::vector<char> buffer;
+
+public:
+
+  /**
+   * @brief Default constructor of the MappedFile. Creates an empty view.
+   */
+  MappedFile(void) : bytes(nullptr), fileSize(0), mapped(false) {}
+
+  /**
+   * @brief Destructor of the MappedFile. Unmaps the file if it was mapped.
+   */
+  ~MappedFile(void);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * @brief Opens a file and maps its contents. Any previously opened file is closed first.
+   *
+   * @param filename the full path of the file
+   *
+   * @return true if the file was opened successfully, false otherwise
+   */
+  bool open(const std::string& filename);
+
+  /**
+   * @brief Releases the mapping or the buffer of the currently opened file.
+   */
+  void close(void);
+
+  /**
+   * @brief Returns a pointer to the first byte of the file.
+   *
+   * @return the contents of the file
+   */
+  inline const char* data(void) const { return this->bytes; }
+
+  /**
+   * @brief Returns the size of the file in bytes.
+   *
+   * @return the size of the file
+   */
+  inline size_t size(void) const { return this->fileSize; }
+
+};
+
+#endif /* MAPPED_FILE_H */
@@ -0,0 +1,125 @@
+#ifndef QUERY_PLANNER_H
+#define QUERY_PLANNER_H
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <string>
+#include "FilteredVamanaIndex.h"
+#include "BQDataVectors.h"
+#include "Filter.h"
+#include "distance.h"
+
+/**
+ * @brief Enum to define the strategy used to answer a filtered query.
+ *
+ * BRUTE_FORCE scans the points that satisfy the filters of the query exhaustively, FILTERED_GRAPH traverses the
+ * graph visiting only points that satisfy the filters, and UNFILTERED_GRAPH traverses the graph ignoring the filters
+ * with an enlarged L and filters the results afterwards. AUTO_PLAN lets the planner choose.
+ */
+enum QUERY_PLAN {
+  AUTO_PLAN = 0,
+  BRUTE_FORCE = 1,
+  FILTERED_GRAPH = 2,
+  UNFILTERED_GRAPH = 3
+};
+
+/**
+ * @brief Selectivity-aware query planner placed in front of a FilteredVamanaIndex (or StichedVamanaIndex).
+ *
+ * For every query the planner estimates how many points satisfy its filters, using the label cardinalities and the
+ * sorted-by-T index of the index, and picks the plan with the lowest estimated number of distance computations:
+ *
+ * - brute force costs one distance per qualifying point,
+ * - a filtered traversal costs about L * d * penalty, where d is the average out-degree of the graph and the
+ *   penalty accounts for the weaker connectivity of the points that satisfy the filters,
+ * - an unfiltered traversal costs about (L / s) * d, where s is the selectivity of the filters, since L / s
+ *   candidates are needed to keep about L qualifying ones after the post-filtering.
+ *
+ * The unfiltered plan is only considered when the enlarged L does not exceed `maxExpansion` times L.
+ *
+ * @tparam vamana_t the type of the points stored in the index
+ */
+template <typename vamana_t> class QueryPlanner {
+
+private:
+  const FilteredVamanaIndex<vamana_t>& index;
+  QUERY_PLAN forcedPlan;
+  float filteredPenalty;
+  unsigned int maxExpansion;
+  double averageDegree;
+
+public:
+
+  /**
+   * @brief Constructor of the QueryPlanner.
+   *
+   * @param index The index the queries are executed on. Every traversal starts from the start nodes of the labels
+   * of its query, or from the global medoid of the index for queries without a label.
+   * @param forcedPlan The plan to use for every query, or AUTO_PLAN to let the planner choose.
+   * @param filteredPenalty The relative cost of a filtered traversal step compared to an unfiltered one.
+   * @param maxExpansion The maximum factor by which L can be enlarged for an unfiltered traversal.
+   */
+  QueryPlanner(
+    const FilteredVamanaIndex<vamana_t>& index,
+    const QUERY_PLAN forcedPlan = AUTO_PLAN,
+    const float filteredPenalty = 2.0f,
+    const unsigned int maxExpansion = 10
+  );
+
+  /**
+   * @brief Estimates the number of points that satisfy the filters of a query.
+   *
+   * @param xq The query vector.
+   * @return The exact number of qualifying points for query types 0, 1 and 2, and an upper bound for type 3.
+   */
+  unsigned int estimateQualifyingPoints(const QueryDataVector<float>& xq) const;
+
+  /**
+   * @brief Chooses the plan with the lowest estimated cost for a query.
+   *
+   * @param xq The query vector.
+   * @param L The size of the candidate list of the graph traversals.
+   * @return The chosen plan (the forced plan, if the planner was given one).
+   */
+  QUERY_PLAN choosePlan(const QueryDataVector<float>& xq, const unsigned int L) const;
+
+  /**
+   * @brief Executes a query with the plan chosen by choosePlan.
+   *
+   * @param xq The query vector.
+   * @param k The number of nearest neighbors to return.
+   * @param L The size of the candidate list of the graph traversals.
+   * @param plan Output parameter, set to the plan that was executed.
+   * @param budget Optional limits of the graph traversals, the exhaustive scans are not limited.
+   *
+   * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+   */
+  std::pair<std::set<vamana_t>, std::set<vamana_t>> search(
+    const QueryDataVector<float>& xq,
+    const unsigned int k,
+    const unsigned int L,
+    QUERY_PLAN& plan,
+    SearchBudget* budget = nullptr
+  ) const;
+
+  /**
+   * @brief Returns a printable name for a plan.
+   *
+   * @param plan The plan.
+   * @return The name of the plan.
+   */
+  static std::string getPlanName(const QUERY_PLAN plan);
+
+  /**
+   * @brief Parses a plan from its name, as accepted on the command line (auto, brute-force, filtered, unfiltered).
+   *
+   * @param name The name of the plan.
+   * @param plan Output parameter, set to the parsed plan.
+   * @return true if the name is valid, false otherwise.
+   */
+  static bool parsePlan(const std::string& name, QUERY_PLAN& plan);
+
+};
+
+#endif /* QUERY_PLANNER_H */
@@ -0,0 +1,265 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief A query sent to the query server. On the wire a request is a header of eight 32-bit fields in the native
+ * byte order of the machine (id, k, L, query type, v, l, r, dimension), where v, l and r are floats, followed by the
+ * dimension floats of the query vector.
+ */
+struct QueryRequest {
+  uint32_t id;          // Chosen by the client and echoed in the response
+  uint32_t k;
+  uint32_t L;
+  uint32_t queryType;   // As in the query files: 0 unfiltered, 1 label, 2 timestamp range, 3 label and range
+  float v;
+  float l;
+  float r;
+  std::vector<float> vector;
+};
+
+/**
+ * @brief A neighbor returned by the query server: the index of the point and its distance to the query.
+ */
+struct QueryResult {
+  uint32_t index;
+  float distance;
+};
+
+/**
+ * @brief Status of a response of the query server.
+ */
+enum QUERY_STATUS {
+  QUERY_OK = 0,
+  QUERY_FAILED = 1      // The query could not be executed, for example because its dimension is wrong
+};
+
+/**
+ * @brief Decodes the first request of a buffer.
+ *
+ * @param bytes the received bytes
+ * @param size the number of received bytes
+ * @param request output parameter, set to the decoded request
+ * @param consumed output parameter, set to the size of the request in bytes, or 0 if the buffer does not hold a
+ * whole request yet
+ * @return false if the buffer starts with a malformed request, true otherwise
+ */
+bool decodeQueryRequest(const char* bytes, const size_t size, QueryRequest& request, size_t& consumed);
+
+/**
+ * @brief Encodes a request, as clients of the query server send it.
+ *
+ * @param request the request
+ * @return the bytes of the request
+ */
+std::string encodeQueryRequest(const QueryRequest& request);
+
+/**
+ * @brief Encodes a response. On the wire a response is a header of three 32-bit fields (id, status, count) followed
+ * by count pairs of a 32-bit point index and a float distance, nearest first.
+ *
+ * @param id the id of the request
+ * @param status the status of the query
+ * @param results the neighbors of the query
+ * @return the bytes of the response
+ */
+std::string encodeQueryResponse(const uint32_t id, const QUERY_STATUS status, const std::vector<QueryResult>& results);
+
+/**
+ * @brief Decodes the first response of a buffer, as clients of the query server receive it.
+ *
+ * @param bytes the received bytes
+ * @param size the number of received bytes
+ * @param id output parameter, set to the id of the request
+ * @param status output parameter, set to the status of the query
+ * @param results output parameter, set to the neighbors of the query
+ * @return the size of the response in bytes, or 0 if the buffer does not hold a whole response yet
+ */
+size_t decodeQueryResponse(const char* bytes, const size_t size, uint32_t& id, QUERY_STATUS& status, std::vector<QueryResult>& results);
+
+/**
+ * @brief Histogram of latencies with logarithmic buckets, 100 per decade from one microsecond to 1000 seconds, so
+ * that percentiles are accurate to about 2% and the memory does not grow with the number of queries.
+ */
+class LatencyHistogram {
+
+private:
+  std::vector<unsigned long long> buckets;
+  unsigned long long count;
+
+public:
+
+  /**
+   * @brief Constructor of the LatencyHistogram. Creates an empty histogram.
+   */
+  LatencyHistogram(void);
+
+  /**
+   * @brief Records a latency.
+   *
+   * @param seconds the latency in seconds
+   */
+  void record(const double seconds);
+
+  /**
+   * @brief Returns a percentile of the recorded latencies.
+   *
+   * @param percentile the percentile, between 0 and 100
+   * @return the latency in seconds, or 0 if nothing was recorded
+   */
+  double getPercentile(const double percentile) const;
+
+  /**
+   * @brief Returns the number of recorded latencies.
+   */
+  inline unsigned long long getCount(void) const { return this->count; }
+
+  /**
+   * @brief Forgets the recorded latencies.
+   */
+  void clear(void);
+
+};
+
+/**
+ * @brief Long-running query server that keeps an index resident and answers the queries of its clients, either
+ * over a pair of file descriptors (such as stdin and stdout) or over a Unix domain socket.
+ *
+ * The server reads every request that is already available, up to a batch size, and runs the batch on the thread
+ * pool, so queries that arrive together are answered in parallel while a lone query is answered at once. Every
+ * connection gets its responses in the order of its requests. The latency of a query is measured from the moment
+ * its request is read until its response is written, and the p50 and p99 latency and the throughput are reported
+ * periodically and when the server stops.
+ */
+class QueryServer {
+
+public:
+  typedef std::function<std::vector<QueryResult>(const QueryRequest&)> Executor;
+
+private:
+
+  /**
+   * @brief A client of the server, with the bytes it sent that do not form a whole request yet.
+   */
+  struct Connection {
+    int inputFd;
+    int outputFd;
+    std::string buffer;
+    bool closed;        // The client closed its side, or the connection failed
+    bool owned;         // The server closes the descriptors when the connection ends
+  };
+
+  /**
+   * @brief A request that was read and waits in the current batch.
+   */
+  struct PendingQuery {
+    unsigned int connection;
+    QueryRequest request;
+    double received;
+  };
+
+  Executor executor;
+  unsigned int batchSize;
+  double reportInterval;
+  std::function<void(void)> idle;
+  int stopPipe[2];
+  std::atomic<bool> stopping;
+
+  std::vector<Connection> connections;
+  std::vector<PendingQuery> pending;
+
+  LatencyHistogram windowLatencies;
+  LatencyHistogram totalLatencies;
+  double startTime;
+  double windowStart;
+  unsigned long long batches;
+
+  /**
+   * @brief Serves the connections, and accepts new ones on a listening socket if it is valid, until the server is
+   * stopped or, without a listening socket, until every connection is closed.
+   *
+   * @param listenFd the listening socket, or -1
+   */
+  void run(const int listenFd);
+
+  /**
+   * @brief Moves the whole requests of the buffer of a connection to the current batch, as long as it has room.
+   *
+   * @param connection the index of the connection
+   */
+  void parseRequests(const unsigned int connection);
+
+  /**
+   * @brief Executes the current batch on the thread pool and writes the responses.
+   */
+  void runBatch(void);
+
+  /**
+   * @brief Prints the latency and the throughput of the queries since the last report.
+   *
+   * @param final whether the server is stopping, in which case the totals are printed as well
+   */
+  void report(const bool final);
+
+public:
+
+  /**
+   * @brief Constructor of the QueryServer.
+   *
+   * @param executor the function that answers a query, which is called from the threads of the pool at once
+   * @param batchSize the maximum number of queries that are executed together
+   * @param reportInterval the seconds between two reports of the latency, or 0 to report only when stopping
+   */
+  QueryServer(const Executor& executor, const unsigned int batchSize = 64, const double reportInterval = 10.0);
+
+  /**
+   * @brief Destructor of the QueryServer. Closes the descriptors that the server opened.
+   */
+  ~QueryServer(void);
+
+  QueryServer(const QueryServer&) = delete;
+  QueryServer& operator=(const QueryServer&) = delete;
+
+  /**
+   * @brief Sets a function that the server calls between batches and at least once per second while it waits, on
+   * the thread that serves, for example to pick up a reloaded index.
+   *
+   * @param idle the function to call
+   */
+  inline void setIdleHandler(const std::function<void(void)>& idle) { this->idle = idle; }
+
+  /**
+   * @brief Serves a single client over a pair of file descriptors, until the input reaches its end.
+   *
+   * @param inputFd the descriptor the requests are read from
+   * @param outputFd the descriptor the responses are written to
+   */
+  void serve(const int inputFd, const int outputFd);
+
+  /**
+   * @brief Serves the clients of a Unix domain socket, until stop is called.
+   *
+   * @param path the path of the socket, which is replaced if it exists and removed when the server stops
+   * @return false if the socket could not be created, true otherwise
+   */
+  bool serveSocket(const std::string& path);
+
+  /**
+   * @brief Stops the server after the current batch. It may be called from any thread and from signal handlers.
+   */
+  void stop(void);
+
+  /**
+   * @brief Returns the latencies of all the queries the server answered.
+   */
+  inline const LatencyHistogram& getLatencies(void) const { return this->totalLatencies; }
+
+};
+
+#endif /* QUERY_SERVER_H */
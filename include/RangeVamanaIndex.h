@@ -0,0 +1,204 @@
+#ifndef RANGE_VAMANA_INDEX_H
+#define RANGE_VAMANA_INDEX_H
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include "FilteredVamanaIndex.h"
+#include "BQDataVectors.h"
+
+/**
+ * @brief Graph layer of a RangeVamanaIndex. The layer of depth d splits the points, in ascending timestamp order,
+ * into 2^d consecutive segments, and keeps a Vamana graph inside every segment that has more than leafSize points.
+ * The adjacency lists are stored in CSR form and address the points by their position in timestamp order, so that
+ * the neighbors of a point never leave its segment.
+ */
+struct RangeLayer {
+  std::vector<unsigned int> offsets;    // Offset of the neighbors of every position in neighbors
+  std::vector<unsigned int> neighbors;  // Positions of the neighbors of every position, one list after the other
+  std::vector<unsigned int> entries;    // Position of the entry point of every segment of the layer
+};
+
+/**
+ * @brief Index for queries with a timestamp range filter (l <= T <= r, query types 2 and 3).
+ *
+ * The points are sorted by their timestamp and split recursively in halves, which forms a segment tree over the
+ * timestamp order. Every segment with more than leafSize points gets its own Vamana graph, built only on its points,
+ * while smaller segments are leaves that are scanned exhaustively. A range query is answered by the O(log n)
+ * segments that cover the range exactly: the graph of every covering segment is searched without any filter, since
+ * all of its points satisfy the range, at most two partially covered leaves are scanned, and the results are merged.
+ *
+ * The graph of the root segment is the graph of the index, so unfiltered queries and the inherited label structures
+ * keep working, and the other layers are stored as a section of graph-only index files.
+ *
+ * @tparam vamana_t the type of the points stored in the index
+ */
+template <typename vamana_t> class RangeVamanaIndex : public FilteredVamanaIndex<vamana_t> {
+
+protected:
+
+  unsigned int leafSize;
+  std::vector<RangeLayer> layers;
+  std::vector<unsigned int> positions;    // Position of every point in timestamp order
+
+  /**
+   * @brief Returns the positions covered by a segment of a layer.
+   *
+   * @param depth the depth of the layer
+   * @param segment the index of the segment inside the layer
+   * @param begin output parameter, set to the first position of the segment
+   * @param end output parameter, set to one past the last position of the segment
+   */
+  void getSegmentBounds(const unsigned int depth, const unsigned int segment, unsigned int& begin, unsigned int& end) const;
+
+  /**
+   * @brief Rebuilds the root layer from the graph of the index, which is stored with the graph itself.
+   */
+  void buildRootLayer(void);
+
+  /**
+   * @brief Searches the graph of a single segment, with a best-first traversal of at most L candidates.
+   *
+   * @param depth the depth of the layer of the segment
+   * @param segment the index of the segment inside the layer
+   * @param xq the query vector
+   * @param k the number of nearest points to return
+   * @param L the size of the candidate list
+   * @param slot the slot of the label the results must carry, or LabelIndex::NO_LABEL for no label
+   * @param results output vector, receives the distances and the indexes of the nearest points of the segment
+   * @param visited output vector, receives the indexes of the expanded points
+   */
+  void searchSegment(
+    const unsigned int depth,
+    const unsigned int segment,
+    const QueryDataVector<float>& xq,
+    const unsigned int k,
+    const unsigned int L,
+    const unsigned int slot,
+    std::vector<std::pair<double, unsigned int>>& results,
+    std::vector<unsigned int>& visited
+  ) const;
+
+  /**
+   * @brief Returns the segment layers (all but the root) as a section of graph-only index files, together with the
+   * sections of the filtered index.
+   *
+   * @return the sections of the index
+   */
+  std::vector<GraphFileSection> getGraphFileSections(void) const override;
+
+  /**
+   * @brief Loads the segment layers from their section of a graph-only index file, or passes the section on to
+   * the filtered index.
+   *
+   * @param section the section that was read
+   *
+   * @return true if the section was recognized and loaded, false otherwise
+   */
+  bool loadGraphFileSection(const GraphFileSection& section) override;
+
+public:
+
+  /**
+   * @brief Default constructor of the RangeVamanaIndex.
+   */
+  RangeVamanaIndex(void) : FilteredVamanaIndex<vamana_t>(), leafSize(0) {}
+
+  /**
+   * @brief Returns the maximum number of points of the leaf segments, which are scanned instead of searched.
+   */
+  inline unsigned int getLeafSize(void) const { return this->leafSize; }
+
+  /**
+   * @brief Returns the number of layers of the segment tree that hold graphs, including the root layer.
+   */
+  inline unsigned int getLayersCount(void) const { return this->layers.size(); }
+
+  /**
+   * @brief Creates the segment tree and the graph of every segment with more than leafSize points. The graphs of
+   * the segments are independent, so they are built in parallel, the largest ones first.
+   *
+   * @param P the vector containing the data points
+   * @param alpha the parameter alpha of every segment graph
+   * @param L the parameter L of every segment graph
+   * @param R the parameter R of every segment graph
+   * @param leafSize the maximum number of points of the segments that are scanned instead of getting a graph
+   * @param threads the number of threads that build the segment graphs
+   * @param visualized whether to display the progress of the construction
+   */
+  void createGraph(
+    const std::vector<vamana_t>& P,
+    const float& alpha,
+    const unsigned int L,
+    const unsigned int R,
+    const unsigned int leafSize = 1024,
+    unsigned int threads = 1,
+    bool visualized = true
+  );
+
+  /**
+   * @brief Load a graph from a file, together with its segment layers. Files without the layers (or saved with
+   * the full save mode) rebuild them with the build parameters stored in the file.
+   *
+   * @param filename the full path of the file containing the graph
+   * @param baseFile optional path of the dataset file, used by graph-only index files
+   *
+   * @return true if the graph was loaded successfully, false otherwise
+   */
+  bool loadGraph(const std::string& filename, const std::string& baseFile = "");
+
+  /**
+   * @brief Rejects the insertion of a point, since the segment layers address the points by their position in
+   * timestamp order, which an inserted point would shift.
+   *
+   * @param point the point to insert
+   * @param index output parameter, left unchanged
+   *
+   * @return false, since range indexes must be built again to add points
+   */
+  bool insert(const vamana_t& point, unsigned int& index) override;
+
+  /**
+   * @brief Rejects the insertion of a point with a label set, like the insertion of any other point.
+   *
+   * @param point the point to insert
+   * @param pointLabels the labels of the point
+   * @param index output parameter, left unchanged
+   *
+   * @return false, since range indexes must be built again to add points
+   */
+  bool insert(const vamana_t& point, const std::vector<unsigned int>& pointLabels, unsigned int& index) override;
+
+  /**
+   * @brief Rejects the removal of a point, since consolidating it would shift the positions of the segment layers.
+   *
+   * @param index the index of the point
+   *
+   * @return false, since range indexes must be built again to drop points
+   */
+  bool remove(const unsigned int index) override;
+
+  /**
+   * @brief Searches the k nearest points of a query whose timestamp lies inside [l, r]. Query types 2 and 3 use
+   * the segments that cover the range, the label of a type 3 query is checked on the results of every segment.
+   * Ranges or label subsets with at most bruteForceLimit points are scanned exhaustively.
+   *
+   * @param xq the query vector, of type 2 or 3
+   * @param k the number of nearest points to return
+   * @param L the size of the candidate list of every segment search
+   * @param threads the number of threads that search the covering segments
+   * @param bruteForceLimit the maximum number of qualifying points that are scanned exhaustively
+   *
+   * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+   */
+  std::pair<std::set<vamana_t>, std::set<vamana_t>> rangeSearch(
+    const QueryDataVector<float>& xq,
+    const unsigned int k,
+    const unsigned int L,
+    const unsigned int threads = 1,
+    const unsigned int bruteForceLimit = 0
+  ) const;
+
+};
+
+#endif /* RANGE_VAMANA_INDEX_H */
@@ -0,0 +1,184 @@
+#ifndef READ_WRITE_LOCK_H
+#define READ_WRITE_LOCK_H
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Lock that is held either by any number of readers or by a single writer. Writers are preferred: once a
+ * writer waits, new readers wait behind it, so a steady stream of readers cannot starve the updates.
+ *
+ * The exclusive side follows the interface of std::mutex, so it is taken with std::lock_guard or std::unique_lock,
+ * and the shared side is taken with a ReadLockGuard.
+ */
+class ReadWriteLock {
+
+private:
+  std::mutex mutex;
+  std::condition_variable released;
+  unsigned int readers;
+  unsigned int waitingWriters;
+  bool writing;
+
+public:
+
+  /**
+   * @brief Constructor of the ReadWriteLock. Creates an unlocked lock.
+   */
+  ReadWriteLock(void) : readers(0), waitingWriters(0), writing(false) {}
+
+  ReadWriteLock(const ReadWriteLock&) = delete;
+  ReadWriteLock& operator=(const ReadWriteLock&) = delete;
+
+  /**
+   * @brief Takes the lock exclusively, waiting for the current readers and writer to release it.
+   */
+  void lock(void);
+
+  /**
+   * @brief Releases the exclusive lock.
+   */
+  void unlock(void);
+
+  /**
+   * @brief Takes the lock shared with other readers, waiting while a writer holds it or waits for it.
+   */
+  void lock_shared(void);
+
+  /**
+   * @brief Releases the shared lock.
+   */
+  void unlock_shared(void);
+
+};
+
+/**
+ * @brief Lock with the same interface as ReadWriteLock that spins instead of sleeping, for critical sections that
+ * only last a few instructions, such as swapping the neighbor list of a graph node. Its state is a single word, so
+ * one lock can be kept for every node. Writers are preferred: a writer sets its flag first, which keeps new readers
+ * out, and then waits for the current readers to leave.
+ */
+class SpinReadWriteLock {
+
+private:
+  static const unsigned int WRITER = 1u << 31;
+  std::atomic<unsigned int> state;    // Number of readers, and the WRITER flag while a writer holds or waits for it
+
+public:
+
+  /**
+   * @brief Constructor of the SpinReadWriteLock. Creates an unlocked lock.
+   */
+  SpinReadWriteLock(void) : state(0) {}
+
+  SpinReadWriteLock(const SpinReadWriteLock&) = delete;
+  SpinReadWriteLock& operator=(const SpinReadWriteLock&) = delete;
+
+  /**
+   * @brief Takes the lock exclusively, spinning until the current readers and writer release it.
+   */
+  inline void lock(void) {
+    unsigned int expected = this->state.load(std::memory_order_relaxed);
+    while ((expected & WRITER) || !this->state.compare_exchange_weak(expected, expected | WRITER, std::memory_order_acquire)) {
+      std::this_thread::yield();
+      expected = this->state.load(std::memory_order_relaxed);
+    }
+    while (this->state.load(std::memory_order_acquire) != WRITER) {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * @brief Releases the exclusive lock.
+   */
+  inline void unlock(void) { this->state.store(0, std::memory_order_release); }
+
+  /**
+   * @brief Takes the lock shared with other readers, spinning while a writer holds it or waits for it.
+   */
+  inline void lock_shared(void) {
+    unsigned int expected = this->state.load(std::memory_order_relaxed);
+    while ((expected & WRITER) || !this->state.compare_exchange_weak(expected, expected + 1, std::memory_order_acquire)) {
+      std::this_thread::yield();
+      expected = this->state.load(std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Releases the shared lock.
+   */
+  inline void unlock_shared(void) { this->state.fetch_sub(1, std::memory_order_release); }
+
+};
+
+/**
+ * @brief Holds the shared side of a ReadWriteLock or a SpinReadWriteLock for the lifetime of the guard.
+ *
+ * @param lock_t The type of the lock
+ */
+template <typename lock_t> class ReadLockGuard {
+
+private:
+  lock_t& lock;
+
+public:
+
+  /**
+   * @brief Constructor of the ReadLockGuard. Takes the shared side of the lock.
+   *
+   * @param lock the lock to take
+   */
+  explicit ReadLockGuard(lock_t& lock) : lock(lock) { this->lock.lock_shared(); }
+
+  /**
+   * @brief Destructor of the ReadLockGuard. Releases the shared side of the lock.
+   */
+  ~ReadLockGuard(void) { this->lock.unlock_shared(); }
+
+  ReadLockGuard(const ReadLockGuard&) = delete;
+  ReadLockGuard& operator=(const ReadLockGuard&) = delete;
+
+};
+
+/**
+ * @brief Holds a ReadWriteLock, shared or exclusively, for the lifetime of the guard, and lets the thread that holds
+ * it take it again through nested guards. A nested guard leaves the lock alone, so a thread that holds the shared
+ * side never waits behind a writer that waits for that very thread, and a writer may call code that takes the
+ * shared side. A thread that holds the shared side must not ask for the exclusive one.
+ */
+class ReentrantLockGuard {
+
+private:
+  ReadWriteLock& lock;
+  bool exclusive;
+  bool owner;     // Whether this guard took the lock, rather than an outer guard of the same thread
+
+  /**
+   * @brief Returns the locks that the calling thread holds through its guards.
+   */
+  static std::vector<const ReadWriteLock*>& getHeldLocks(void);
+
+public:
+
+  /**
+   * @brief Constructor of the ReentrantLockGuard. Takes the lock unless the calling thread already holds it.
+   *
+   * @param lock the lock to take
+   * @param exclusive whether to take the exclusive side rather than the shared one
+   */
+  ReentrantLockGuard(ReadWriteLock& lock, const bool exclusive = false);
+
+  /**
+   * @brief Destructor of the ReentrantLockGuard. Releases the lock if this guard took it.
+   */
+  ~ReentrantLockGuard(void);
+
+  ReentrantLockGuard(const ReentrantLockGuard&) = delete;
+  ReentrantLockGuard& operator=(const ReentrantLockGuard&) = delete;
+
+};
+
+#endif /* READ_WRITE_LOCK_H */
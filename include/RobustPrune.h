@@ -60,3 +60,29 @@ void FilteredRobustPrune(
   int R,
   const DISTANCE_SAVE_METHOD distanceSaveMethod
 );
+
+/**
+ * @brief Prunes a candidate list of neighbors of a point with the filtered robust pruning rule, working only on
+ * point indexes. The candidates are sorted once by their distance to the point and then scanned in that order,
+ * so every selected neighbor p* removes the later candidates p' that it occludes (alpha * d(p*, p') <= d(p, p'))
+ * and that share no label with p which p* does not carry as well.
+ *
+ * The graph is neither read nor modified, so the lists of different points can be pruned in parallel.
+ *
+ * @tparam graph_t The type of the graph nodes.
+ * @param index The filtered index that holds the points and their labels.
+ * @param p The index of the point whose neighbors are pruned.
+ * @param V The indexes of the candidate neighbors, replaced by the selected neighbors in ascending distance.
+ * @param alpha A float value used as a multiplier for the distance threshold.
+ * @param R An integer specifying the maximum number of neighbors to retain.
+ * @param distanceSaveMethod The method used to compute the distances.
+ */
+template <typename graph_t>
+void FilteredRobustPrune(
+  const FilteredVamanaIndex<graph_t>& index, 
+  const unsigned int p,
+  std::vector<unsigned int>& V, 
+  float alpha,
+  unsigned int R,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod
+);
@@ -0,0 +1,84 @@
+#ifndef SEARCH_CANDIDATES_H
+#define SEARCH_CANDIDATES_H
+
+#include <set>
+#include <iterator>
+#include <utility>
+#include <unordered_map>
+
+/**
+ * @brief Candidate set of a best-first search with a list of at most L candidates, used by the greedy searches,
+ * by the segment searches of range indexes and by the traversal of the navigation layer. The distance of a point
+ * to the query is computed once, when the point first becomes a candidate, and is kept even if the point is
+ * trimmed away, so a point that becomes a candidate again costs nothing. The candidates are ordered by their
+ * distance, as are the ones not expanded yet, so picking the nearest unvisited candidate and trimming the set to
+ * L compute no distances at all.
+ */
+class SearchCandidates {
+
+private:
+  std::unordered_map<unsigned int, float> distances;      // Every point whose distance to the query was computed
+  std::set<std::pair<float, unsigned int>> ranked;         // The candidates, nearest first
+  std::set<std::pair<float, unsigned int>> unvisited;      // The candidates that were not expanded yet, nearest first
+
+public:
+
+  /**
+   * @brief Adds an unvisited point to the candidates.
+   * 
+   * @param i the index of the point
+   * @param computeDistance function that returns the distance of the point to the query, called only if the
+   * distance of the point was never computed
+   * @param distanceComputations counter of the computed distances of the search
+   * 
+   * @return true if the point was added, false if it already is a candidate
+   */
+  template <typename distance_f>
+  inline bool insert(const unsigned int i, const distance_f& computeDistance, unsigned int& distanceComputations) {
+    auto known = this->distances.find(i);
+    if (known == this->distances.end()) {
+      known = this->distances.emplace(i, computeDistance(i)).first;
+      distanceComputations++;
+    }
+    if (!this->ranked.insert({known->second, i}).second) {
+      return false;
+    }
+    this->unvisited.insert({known->second, i});
+    return true;
+  }
+
+  /**
+   * @brief Returns the distance of a point that was a candidate at some point of the search.
+   */
+  inline float getDistance(const unsigned int i) const { return this->distances.at(i); }
+
+  inline bool hasUnvisited(void) const { return !this->unvisited.empty(); }
+
+  /**
+   * @brief Returns the nearest unvisited candidate, with its distance, and marks it as visited.
+   */
+  inline std::pair<float, unsigned int> visitNearest(void) {
+    std::pair<float, unsigned int> nearest = *this->unvisited.begin();
+    this->unvisited.erase(this->unvisited.begin());
+    return nearest;
+  }
+
+  /**
+   * @brief Keeps only the L nearest candidates, visited or not.
+   */
+  inline void trim(const unsigned int L) {
+    while (this->ranked.size() > L) {
+      auto farthest = std::prev(this->ranked.end());
+      this->unvisited.erase(*farthest);
+      this->ranked.erase(farthest);
+    }
+  }
+
+  /**
+   * @brief Returns the candidates, nearest first.
+   */
+  inline const std::set<std::pair<float, unsigned int>>& getRanked(void) const { return this->ranked; }
+
+};
+
+#endif /* SEARCH_CANDIDATES_H */
@@ -25,12 +25,15 @@ public:
     : FilteredVamanaIndex<vamana_t>(filters) {}
 
   /**
-   * @brief Create the graph with the given parameters.
+   * @brief Create the graph with the given parameters. Every label gets its own Vamana sub-index, and the edges
+   * of the sub-indexes are stitched into the graph. The labels are built in parallel from the largest to the
+   * smallest, and labels larger than the share of a single thread are built with all the threads.
    * 
    * @param P A vector of vamana_t elements.
    * @param alpha A float parameter.
    * @param L An unsigned int parameter.
    * @param R An unsigned int parameter.
+   * @param compute_threads The number of threads that build the sub-indexes.
    */
   void createGraph(
     const std::vector<vamana_t>& P, 
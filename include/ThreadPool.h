@@ -0,0 +1,164 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+/**
+ * @brief Process-wide pool of worker threads, shared by all the parallel phases of the program (distance matrix,
+ * graph construction, groundtruth, batch search and loading).
+ *
+ * A parallel loop is published as a job whose indexes are handed out in chunks through an atomic counter. The
+ * calling thread always works on its own job, and idle workers steal chunks from the most recent job that still
+ * has some left. A loop that is started from inside another one (such as the sub-index builds inside the stitched
+ * build) becomes a job of the same pool, so nested phases share the same threads instead of spawning more of them.
+ */
+class ThreadPool {
+
+private:
+
+  /**
+   * @brief A parallel loop that is being executed by the pool.
+   */
+  struct Job {
+    const std::function<void(unsigned int, unsigned int)>& body;  // Runs the indexes [first, last) of a chunk
+    const unsigned int end;
+    const unsigned int chunk;
+    const unsigned int maxHelpers;      // Workers that may join the job, besides the calling thread
+    unsigned int helpers;               // Workers currently running the job, guarded by the mutex of the pool
+    std::atomic<unsigned int> next;     // First index of the next chunk to hand out
+    std::exception_ptr error;           // First exception thrown by the body, guarded by errorMutex
+    std::mutex errorMutex;
+
+    Job(const std::function<void(unsigned int, unsigned int)>& body, const unsigned int begin, const unsigned int end,
+      const unsigned int chunk, const unsigned int maxHelpers)
+      : body(body), end(end), chunk(chunk), maxHelpers(maxHelpers), helpers(0), next(begin) {}
+
+    /**
+     * @brief Returns whether the job still has chunks to hand out.
+     */
+    inline bool hasWork(void) const { return this->next.load() < this->end; }
+
+    /**
+     * @brief Runs chunks of the job until none are left.
+     */
+    void run(void);
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<Job*> jobs;
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable helpersDone;
+  unsigned int threadsCount;
+  bool pinned;
+  bool stopping;
+
+  /**
+   * @brief Constructor of the ThreadPool. Starts the workers of the default number of threads.
+   */
+  ThreadPool(void);
+
+  /**
+   * @brief Starts the workers of the pool.
+   *
+   * @param threads the number of threads, the calling thread included
+   * @param pin whether to pin every thread to its own CPU
+   */
+  void start(const unsigned int threads, const bool pin);
+
+  /**
+   * @brief Stops and joins the workers of the pool.
+   */
+  void stop(void);
+
+  /**
+   * @brief Main loop of every worker: waits for a job with chunks left and helps run it.
+   */
+  void workerLoop(void);
+
+  /**
+   * @brief Returns the most recent job that still has chunks left and room for another worker, or nullptr.
+   * Must be called with the mutex held.
+   */
+  Job* findJob(void);
+
+public:
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief Destructor of the ThreadPool. Stops and joins the workers.
+   */
+  ~ThreadPool(void);
+
+  /**
+   * @brief Returns the pool of the process. It starts with one thread per hardware thread, until it is configured.
+   */
+  static ThreadPool& getInstance(void);
+
+  /**
+   * @brief Restarts the pool of the process with the given number of threads. It must not be called while a
+   * parallel loop is running.
+   *
+   * @param threads the number of threads, the calling thread included (0 for one per hardware thread)
+   * @param pin whether to pin every thread to its own CPU, which is ignored where affinity is not supported
+   */
+  static void configure(const unsigned int threads, const bool pin = false);
+
+  /**
+   * @brief Returns the number of threads of the pool, the calling thread included.
+   */
+  inline unsigned int getThreadsCount(void) const { return this->threadsCount; }
+
+  /**
+   * @brief Returns whether the threads of the pool are pinned to CPUs.
+   */
+  inline bool isPinned(void) const { return this->pinned; }
+
+  /**
+   * @brief Runs a function for every chunk of a range of indexes. The chunks are handed out dynamically, so the
+   * threads that finish early take over the remaining work. Exceptions thrown by the function stop the loop and
+   * are rethrown to the caller.
+   *
+   * @param begin the first index of the range
+   * @param end one past the last index of the range
+   * @param body the function to run for every chunk, with the first index and one past the last index of the chunk
+   * @param maxThreads the maximum number of threads that run the loop, the calling thread included (0 for all)
+   * @param chunk the number of indexes of every chunk (0 to pick it from the size of the range)
+   */
+  void parallelForChunks(
+    const unsigned int begin,
+    const unsigned int end,
+    const std::function<void(unsigned int, unsigned int)>& body,
+    const unsigned int maxThreads = 0,
+    unsigned int chunk = 0
+  );
+
+  /**
+   * @brief Runs a function for every index of a range, on the threads of the pool.
+   *
+   * @param begin the first index of the range
+   * @param end one past the last index of the range
+   * @param func the function to run for every index
+   * @param maxThreads the maximum number of threads that run the loop, the calling thread included (0 for all)
+   * @param chunk the number of indexes handed out at a time (0 to pick it from the size of the range)
+   */
+  template <typename func_t> void parallelFor(
+    const unsigned int begin, const unsigned int end, const func_t& func, const unsigned int maxThreads = 0, const unsigned int chunk = 0) {
+    this->parallelForChunks(begin, end, [&func](unsigned int first, unsigned int last) {
+      for (unsigned int i = first; i < last; i++) {
+        func(i);
+      }
+    }, maxThreads, chunk);
+  }
+
+};
+
+#endif /* THREAD_POOL_H */
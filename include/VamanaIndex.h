@@ -3,13 +3,20 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <climits>
 #include <set>
+#include <mutex>
+#include <atomic>
+#include <random>
 #include <fstream>
 #include <sstream>
 #include "graph.h"
 #include "recall.h"
 #include "GreedySearch.h"
 #include "RobustPrune.h"
+#include "ReadWriteLock.h"
 
 //for filtered medoid
 #include <map>
@@ -18,6 +25,40 @@
 
 using namespace std;
 
+/**
+ * @brief Optional section of a graph-only index file. Derived indexes use sections to store their own structures
+ * next to the graph, identified by a four character tag, so that readers can skip the sections they do not know.
+ */
+struct GraphFileSection {
+  uint32_t tag;
+  std::string bytes;
+};
+
+/**
+ * @brief Navigation layer of a VamanaIndex, in the spirit of the upper layers of HNSW: a small Vamana graph over a
+ * random sample of the points. A query walks the layer first, which is cheap since the layer is small, and the
+ * nearest sampled point it reaches becomes the start node of its search on the full graph, instead of the medoid.
+ * The adjacency lists are stored in CSR form and address the sampled points by their position in nodes.
+ */
+struct NavigationLayer {
+  std::vector<unsigned int> nodes;      // Index of every sampled point in the index
+  std::vector<unsigned int> offsets;    // Offset of the neighbors of every position in neighbors
+  std::vector<unsigned int> neighbors;  // Positions of the neighbors of every position, one list after the other
+  unsigned int entry;                   // Position of the entry point of the layer
+  float samplingRate;                   // Fraction of the points that were sampled
+  unsigned int maxSize;                 // Maximum number of sampled points
+};
+
+/**
+ * @brief Cache of diverse start nodes, chosen with k-means++ seeding over a set of points. The vectors of the start
+ * nodes are kept in contiguous rows, so that the start node nearest to a query is found with a single scan of SIMD
+ * distance computations.
+ */
+struct StartNodeCache {
+  std::vector<unsigned int> nodes;      // Indexes of the start nodes
+  std::vector<float> vectors;           // Vector of every start node, one row after the other
+};
+
 
 /**
  * @brief Class that represents the Vamana Index entity of the application. It provides methods for creating
@@ -32,6 +73,21 @@ protected:
   std::vector<vamana_t> P;
   double** distanceMatrix;
 
+  unsigned int medoid;
+  std::vector<unsigned int> entryPoints;
+
+  float alpha;
+  unsigned int L;
+  unsigned int R;
+
+  mutable ReadWriteLock updateLock;   // Shared by searches, insertions and removals, exclusive during consolidate
+  std::mutex appendMutex;     // Serializes appending the inserted points to the vector store and the graph
+
+  std::atomic<unsigned int> deletedCount;   // Removed points that are not consolidated yet, marked on their graph nodes
+
+  NavigationLayer navigation;     // Empty unless buildNavigationLayer was called, or the index file stores a layer
+  StartNodeCache startCache;     // Empty unless buildStartNodeCache was called, or the index file stores a cache
+
   /**
    * @brief Fills the graph nodes with the given dataset points. 
   */
@@ -49,16 +105,180 @@ protected:
    * @brief Computes the distances between every node in the dataset and stores them in the distance matrix.
    * 
    * @param visualize a boolean flag to visualize the progress of the computation
-   * @param numThreads the number of threads to use for computation
+   * @param numThreads the maximum number of threads of the pool that compute the distances
    */
   void computeDistances(const bool visualize = true, const unsigned int numThreads = 1);
 
+  /**
+   * @brief Searches the candidate neighbors of a point that is inserted into the graph. The plain index runs a
+   * GreedySearch from the start node, derived indexes override it to apply their own search.
+   * 
+   * @param point the index of the inserted point
+   * @param s the start node of the search
+   * @param L the parameter L
+   * @param distanceSaveMethod the method used to compute the distances
+   * 
+   * @return the visited nodes of the search
+   */
+  virtual std::set<vamana_t> searchInsertCandidates(
+    const unsigned int point, 
+    const GraphNode<vamana_t>& s, 
+    const unsigned int L, 
+    const DISTANCE_SAVE_METHOD distanceSaveMethod
+  ) const;
+
+  /**
+   * @brief Prunes the neighbors of a node, together with a set of candidates, down to at most R neighbors. The
+   * plain index applies RobustPrune, derived indexes override it to apply their own pruning rule. Only the list of
+   * the given node is modified.
+   * 
+   * @param node the node whose neighbors are pruned
+   * @param V the candidate neighbors of the node
+   * @param alpha the parameter alpha
+   * @param R the parameter R
+   * @param distanceSaveMethod the method used to compute the distances
+   */
+  virtual void pruneInsertNeighbors(
+    GraphNode<vamana_t>& node, 
+    std::set<vamana_t>& V, 
+    const float alpha, 
+    const unsigned int R, 
+    const DISTANCE_SAVE_METHOD distanceSaveMethod
+  );
+
+  /**
+   * @brief Adds neighbors to the list of a node while searches may be reading it. The new list is built on a copy
+   * and swapped in under the lock of the node only if no other thread replaced the list meanwhile, otherwise it
+   * is built again, so searches never wait longer than the swap. A list that exceeds R neighbors is pruned with
+   * pruneInsertNeighbors.
+   * 
+   * @param index the index of the node
+   * @param added the neighbors to add, which are skipped if the node already links to them
+   */
+  void linkNeighbors(const unsigned int index, const std::vector<vamana_t>& added);
+
+  /**
+   * @brief Appends a point to the vector store and a node to the graph, when a point is inserted into the index.
+   * The first point of an empty index becomes its medoid. Derived indexes override it to add the point to their
+   * own structures, and it is always called with the append mutex held.
+   * 
+   * @param point the point to append
+   * 
+   * @return the index of the appended point
+   */
+  virtual unsigned int appendPoint(const vamana_t& point);
+
+  /**
+   * @brief Links a point that was just appended into the graph, as the second part of an insertion. It must be
+   * called with the shared side of the update lock held, and without the append mutex.
+   * 
+   * @param index the index of the appended point
+   */
+  void linkInsertedPoint(const unsigned int index);
+
+  /**
+   * @brief Renumbers the points after the removed points are consolidated, dropping the removed ones from the vector
+   * store and the graph. Derived indexes override it to renumber their own structures as well.
+   * 
+   * @param newIndexes the new index of every point, or NO_POINT for the removed points
+   */
+  virtual void compactPoints(const std::vector<unsigned int>& newIndexes);
+
+  /**
+   * @brief Chooses diverse start nodes among a set of points with k-means++ seeding: the first start node is given,
+   * and every next one is drawn with probability proportional to the squared distance of a point to its nearest
+   * start node so far. The seeding stops early once every point coincides with a start node.
+   * 
+   * @param points the indexes of the points
+   * @param first the index of the first start node
+   * @param K the maximum number of start nodes
+   * @param generator the random number generator of the seeding
+   * @param threads the number of threads of the pool that compute the distances
+   * 
+   * @return the start nodes, with their vectors
+   */
+  StartNodeCache seedStartNodes(
+    const std::vector<unsigned int>& points, 
+    const unsigned int first, 
+    const unsigned int K, 
+    std::mt19937& generator, 
+    const unsigned int threads = 1
+  ) const;
+
+  /**
+   * @brief Finds the start node of a cache that is nearest to a query, scanning the rows of the cache.
+   * 
+   * @param cache the start node cache
+   * @param xq the query vector
+   * 
+   * @return the index of the nearest start node, or NO_POINT if the cache is empty or has another dimension
+   */
+  unsigned int findNearestStartNode(const StartNodeCache& cache, const DataVector<float>& xq) const;
+
+  /**
+   * @brief Renumbers the start nodes of a cache after the removed points are consolidated, dropping the removed ones.
+   * 
+   * @param cache the start node cache
+   * @param newIndexes the new index of every point, or NO_POINT for the removed points
+   */
+  void compactStartNodes(StartNodeCache& cache, const std::vector<unsigned int>& newIndexes) const;
+
+  /**
+   * @brief Writes the start nodes of a cache into a binary stream. The vectors are not written, since they are
+   * read again from the points.
+   * 
+   * @param out the output stream
+   * @param cache the start node cache
+   */
+  void writeStartNodes(std::ostream& out, const StartNodeCache& cache) const;
+
+  /**
+   * @brief Reads the start nodes of a cache from a binary stream, and fills their vectors from the points.
+   * 
+   * @param in the input stream
+   * @param cache output parameter, set to the cache that was read
+   * 
+   * @return false if the stream ended or refers to points the index does not have, true otherwise
+   */
+  bool readStartNodes(std::istream& in, StartNodeCache& cache) const;
+
+  /**
+   * @brief Inserts the points into the graph in batches of growing size, where the points of a batch are searched
+   * and pruned in parallel on the graph of the previous batches, and their reverse edges are applied per target.
+   * 
+   * @param sigma the insertion order of the points
+   * @param s the start node of the searches
+   * @param alpha the parameter alpha
+   * @param L the parameter L
+   * @param R the parameter R
+   * @param distanceSaveMethod the method used to compute the distances
+   * @param threads the number of threads that insert the points
+   * @param visualize whether to visualize the progress
+   */
+  void insertBatches(
+    const std::vector<int>& sigma, 
+    const GraphNode<vamana_t>& s, 
+    const float alpha, 
+    const unsigned int L, 
+    const unsigned int R,
+    const DISTANCE_SAVE_METHOD distanceSaveMethod, 
+    const unsigned int threads, 
+    const bool visualize
+  );
+
 public:
 
+  static const unsigned int NO_POINT = UINT_MAX;
+
   /**
    * @brief Default Constructor for the VamanaIndex. Exists to avoid errors.
    */
-  VamanaIndex(void) {}
+  VamanaIndex(void) : distanceMatrix(nullptr), medoid(0), alpha(0.0f), L(0), R(0), deletedCount(0), navigation(), startCache() {}
+
+  /**
+   * @brief Destructor of the VamanaIndex. Virtual, since derived indexes override the graph file section hooks.
+   */
+  virtual ~VamanaIndex(void) {}
 
   /**
    * @brief Returns the graph of the Vamana Index entity as a constant reference.
@@ -74,6 +294,15 @@ public:
   */
   inline std::vector<vamana_t> getPoints(void) const { return this->P; }
 
+  /**
+   * @brief Returns a single dataset point of the Vamana Index entity, without copying it. The point is read from
+   * its graph node, which never moves, so it stays valid while other points are inserted.
+   * 
+   * @param index the index of the point
+   * @return the point as a constant reference
+  */
+  inline const vamana_t& getPoint(const unsigned int index) const { return this->G.getNode(index)->getDataReference(); }
+
   /**
    * @brief Returns the nodes of the Vamana Index entity as a vector.
    * 
@@ -88,6 +317,82 @@ public:
    */
   inline double** getDistanceMatrix(void) const { return this->distanceMatrix; }
 
+  /**
+   * @brief Returns the index of the start node (medoid) that was used while building the graph. Graph files
+   * store it, so that queries can start from the same node after loading the index.
+   * 
+   * @return the index of the medoid node
+   */
+  inline unsigned int getMedoid(void) const { return this->medoid; }
+
+  /**
+   * @brief Returns the indexes of the entry points of the graph. For a simple index this is just the medoid,
+   * whereas for filtered indexes it contains the start node of every filter.
+   * 
+   * @return the entry points vector
+   */
+  inline const std::vector<unsigned int>& getEntryPoints(void) const { return this->entryPoints; }
+
+  /**
+   * @brief Builds the navigation layer of the index over a random sample of its points, replacing the current one.
+   * The layer is a Vamana graph with the build parameters of the index, and index files store it next to the graph.
+   * Points inserted later are reached from the sampled points through the graph, and consolidate builds the layer
+   * again if it drops sampled points. Queries must not run while the layer is built.
+   * 
+   * @param samplingRate the fraction of the points that are sampled, between 0 and 1
+   * @param maxSize the maximum number of sampled points
+   * @param threads the number of threads that build the layer
+   * 
+   * @return the number of sampled points, or 0 if the index has too few points for a layer
+   */
+  unsigned int buildNavigationLayer(const float samplingRate, const unsigned int maxSize, const unsigned int threads = 1);
+
+  /**
+   * @brief Drops the navigation layer, so that queries start from the medoid again.
+   */
+  inline void clearNavigationLayer(void) { this->navigation = NavigationLayer(); }
+
+  /**
+   * @brief Returns the navigation layer of the index, which has no nodes if the index has no layer.
+   */
+  inline const NavigationLayer& getNavigationLayer(void) const { return this->navigation; }
+
+  /**
+   * @brief Builds the start node cache of the index: K diverse start nodes chosen with k-means++ seeding over its
+   * points, starting from the medoid, replacing the current cache. Queries start from the cached node nearest to
+   * them, and index files store the cache next to the graph. Derived indexes override it to build caches of their
+   * own as well. Queries must not run while the cache is built.
+   * 
+   * @param K the number of start nodes
+   * @param threads the number of threads of the pool that build the cache
+   * 
+   * @return the number of start nodes, which is less than K if the index has fewer distinct points
+   */
+  virtual unsigned int buildStartNodeCache(const unsigned int K, const unsigned int threads = 1);
+
+  /**
+   * @brief Drops the start node cache, so that queries start from the medoid again. Derived indexes override it to
+   * drop their own caches as well.
+   */
+  virtual void clearStartNodeCache(void) { this->startCache = StartNodeCache(); }
+
+  /**
+   * @brief Returns the start node cache of the index, which has no nodes if the index has no cache.
+   */
+  inline const StartNodeCache& getStartNodeCache(void) const { return this->startCache; }
+
+  /**
+   * @brief Finds the start node of the search of a query. Indexes with a navigation layer walk the layer with a
+   * best-first traversal of at most L candidates and return the nearest sampled point they reach, indexes with a
+   * start node cache return the cached node nearest to the query, and others return the medoid.
+   * 
+   * @param xq the query vector
+   * @param L the size of the candidate list of the traversal of the layer
+   * 
+   * @return the index of the start node
+   */
+  unsigned int findSearchStart(const DataVector<float>& xq, const unsigned int L = 8) const;
+
   /**
    * @brief Creates a Vamana Index Graph according to the provided dataset points and the given parameters.
    * Specifically this method follows the Vamana algorithm found on the paper:
@@ -101,6 +406,11 @@ public:
    * @param alpha the parameter alpha
    * @param L the parameter L
    * @param R the parameter R
+   * @param distanceSaveMethod the method used to compute the distances
+   * @param distance_threads the number of threads that compute the distance matrix
+   * @param visualize whether to visualize the progress
+   * @param distanceMatrix optional precomputed distance matrix
+   * @param build_threads the number of threads that insert the points, 1 for the sequential insertion order
    * 
   */
   void createGraph(
@@ -111,9 +421,92 @@ public:
     const DISTANCE_SAVE_METHOD distanceSaveMethod = NONE,
     unsigned int distance_threads = 1, 
     bool visualize = true, 
-    double** distanceMatrix = nullptr
+    double** distanceMatrix = nullptr,
+    unsigned int build_threads = 1
   );
 
+  /**
+   * @brief Inserts a single point into the index, which keeps the index usable as the dataset grows. A GreedySearch
+   * from the medoid finds the candidate neighbors of the point, RobustPrune selects its neighbors, and every
+   * neighbor gets a reverse edge to the point, pruning its list again if it exceeds R neighbors. The point and its
+   * node are appended to the vector store and the graph in amortized constant time.
+   * 
+   * Insertions and queries may run from several threads at once. Only appending the points is serialized: the
+   * searches and prunes of the insertions run in parallel, and the neighbor lists they change are replaced one
+   * node at a time, so concurrent searches always read a complete list and never wait for a whole insertion.
+   * 
+   * @param point the point to insert
+   * @param index output parameter, set to the index of the inserted point
+   * 
+   * @return true if the point was inserted, false if the index has no build parameters
+   */
+  virtual bool insert(const vamana_t& point, unsigned int& index);
+
+  /**
+   * @brief Removes a point from the index lazily, by marking it with a tombstone. Searches still traverse the
+   * point, so the graph stays navigable, but never return it. The graph is repaired by consolidate. Removals may
+   * run together with insertions and queries.
+   * 
+   * @param index the index of the point
+   * 
+   * @return true if the point was removed, false if it does not exist or is already removed
+   */
+  virtual bool remove(const unsigned int index);
+
+  /**
+   * @brief Returns whether a point was removed and is waiting for consolidation.
+   * 
+   * @param index the index of the point
+   * @return true if the point carries a tombstone, false otherwise
+   */
+  inline bool isDeleted(const unsigned int index) const {
+    return index < this->G.getNodesCount() && this->G.getNodeSync(index).removed.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns the number of removed points that are waiting for consolidation.
+   */
+  inline unsigned int getDeletedCount(void) const { return this->deletedCount; }
+
+  /**
+   * @brief Get the update lock of the index. Searches, insertions and removals hold its shared side through a
+   * ReentrantLockGuard, and consolidate holds it exclusively. A caller that picks the start node of a search, for
+   * example with findSearchStart, holds the lock across both calls, so that consolidate cannot renumber the points
+   * in between.
+   * 
+   * @return The update lock.
+   */
+  inline ReadWriteLock& getUpdateLock(void) const { return this->updateLock; }
+
+  /**
+   * @brief Consolidates the removed points, as in FreshDiskANN: every remaining point that links to removed points
+   * replaces them with their own neighbors and prunes the result, and then the removed points are dropped and the
+   * remaining ones get consecutive indexes. Index files should be saved after consolidating, since they do not
+   * store the tombstones. The consolidation is not a background task: it stops the world, since it holds the update
+   * lock exclusively, so searches, insertions and removals wait until the graph is rebuilt. A serving process that
+   * must keep answering queries meanwhile consolidates a separate copy of the index, for example one loaded from its
+   * file, and publishes it through an IndexHandle once it is done.
+   * 
+   * @param threads the number of threads of the pool that repair the neighbors
+   * 
+   * @return the new index of every point, or NO_POINT for the removed points
+   */
+  std::vector<unsigned int> consolidate(const unsigned int threads = 1);
+
+  /**
+   * @brief Sets the build parameters that are used by insert. Indexes that are built, or loaded from a graph-only
+   * file, already have them.
+   * 
+   * @param alpha the parameter alpha
+   * @param L the parameter L
+   * @param R the parameter R
+   */
+  inline void setParameters(const float alpha, const unsigned int L, const unsigned int R) {
+    this->alpha = alpha;
+    this->L = L;
+    this->R = R;
+  }
+
   /**
    * @brief Saves a specific graph into a file. Specifically this method is used to save the contents of a Vamana 
    * Index Graph, inside a file in order to be loaded later for further usage. The main point of this method is to 
@@ -134,7 +527,22 @@ public:
    * 
    * @return true if the graph was loaded successfully, false otherwise
   */
-  bool loadGraph(const std::string& filename);
+  bool loadGraph(const std::string& filename, const std::string& baseFile = "");
+
+  /**
+   * @brief Saves only the structure of the graph into a binary file, without the base vectors. Specifically the
+   * file contains the metadata of the index (nodes count, dimension and build parameters), the medoid and the entry
+   * points, the adjacency lists as node indexes, and a reference to the base vectors file together with its size
+   * and checksum. The base vectors are read again from the dataset file when the index is loaded.
+   * The file ends with the sections of derived indexes, such as the label index of a filtered index, and
+   * the navigation layer and the start node cache of the index if it has them.
+   * 
+   * @param filename the full path of the file in which the graph is going to be saved
+   * @param baseFile the full path of the dataset file the graph was built on
+   * 
+   * @return true if the graph was saved successfully, false otherwise
+  */
+  bool saveGraphStructure(const std::string& filename, const std::string& baseFile);
 
   /**
    * @brief Finds the medoid node in the graph using a sample of nodes.
@@ -149,6 +557,65 @@ public:
    */
   GraphNode<vamana_t> findMedoid(const Graph<vamana_t>& graph, bool visualize = true, int sample_size = 100);
 
+protected:
+
+  /**
+   * @brief Loads a graph that was saved with saveGraphStructure. The base vectors are read from the dataset file
+   * the graph refers to, or from the given base file if it is not empty.
+   * 
+   * @param filename the full path of the file containing the graph
+   * @param baseFile optional path of the dataset file that overrides the one stored in the graph file
+   * 
+   * @return true if the graph was loaded successfully, false otherwise
+   */
+  bool loadGraphStructure(const std::string& filename, const std::string& baseFile);
+
+  /**
+   * @brief Returns the sections that are written after the adjacency lists of a graph-only index file. The plain
+   * index has none, derived indexes override it to persist their own structures.
+   * 
+   * @return the sections of the index
+   */
+  virtual std::vector<GraphFileSection> getGraphFileSections(void) const { return {}; }
+
+  /**
+   * @brief Receives a section read from a graph-only index file. Sections the index does not recognize are ignored.
+   * 
+   * @param section the section that was read
+   * 
+   * @return true if the section was recognized and loaded, false otherwise
+   */
+  virtual bool loadGraphFileSection(const GraphFileSection& section) { return false; }
+
+  /**
+   * @brief Writes the blocks of derived indexes after the edges of a text index file, each one starting with its
+   * four character tag. The plain index has none.
+   * 
+   * @param out the stream of the index file
+   */
+  virtual void saveGraphTextBlocks(std::ostream& out) const {}
+
+  /**
+   * @brief Reads a block of a text index file with a tag the plain index does not know. Derived indexes override it
+   * to read their own blocks, and set the failbit of the stream if a block is corrupted.
+   * 
+   * @param tag the tag of the block
+   * @param in the stream of the index file, right after the tag
+   * 
+   * @return true if the block was recognized and read, false otherwise
+   */
+  virtual bool loadGraphTextBlock(const std::string& tag, std::istream& in) { return false; }
+
+  /**
+   * @brief Replaces the navigation layer with a layer read from an index file, if the layer is consistent with the
+   * points of the index.
+   * 
+   * @param layer the layer that was read
+   * 
+   * @return true if the layer was valid and replaced the current one, false otherwise
+   */
+  bool setNavigationLayer(NavigationLayer& layer);
+
 };
 
 /**
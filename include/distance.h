@@ -57,6 +57,43 @@ struct EuclideanDistanceOrder {
 */
 double euclideanDistance(const DataVector<float>& a, const DataVector<float>& b);
 
+/**
+ * @brief Function to calculate Euclidean distance between two vectors stored in contiguous arrays, such as
+ * the rows of a VectorStore.
+ * 
+ * @param a the first vector
+ * @param b the second vector
+ * @param dimension the dimension of both vectors
+ * 
+ * @return the Euclidean distance between those two vector.
+*/
+double euclideanDistance(const float* a, const float* b, const unsigned int dimension);
+
+/**
+ * @brief Function to calculate the squared Euclidean distance between two vectors stored in contiguous arrays. The
+ * computation uses the SIMD instructions of the target (AVX or SSE) when they are available, and is meant for hot
+ * loops where only the order of the distances matters.
+ * 
+ * @param a the first vector
+ * @param b the second vector
+ * @param dimension the dimension of both vectors
+ * 
+ * @return the squared Euclidean distance between those two vector.
+*/
+float squaredEuclideanDistance(const float* a, const float* b, const unsigned int dimension);
+
+/**
+ * @brief Batched version of squaredEuclideanDistance. Computes the squared Euclidean distances between a query
+ * vector and `count` vectors stored one after the other in a contiguous array.
+ * 
+ * @param query the query vector
+ * @param vectors the contiguous array of vectors
+ * @param count the number of vectors in the array
+ * @param dimension the dimension of all vectors
+ * @param distances the output array, which must have room for `count` distances
+*/
+void squaredEuclideanDistances(const float* query, const float* vectors, const unsigned int count, const unsigned int dimension, float* distances);
+
 /**
  * @brief Function to calculate Manhattan distance between two DataVector objects. It uses
  * the Manhattan Distance formula for vectors of dimension n and calculates their distance.
@@ -7,7 +7,22 @@
 #include "graph_node.h"
 #include <numeric>  
 #include <random>
+#include <atomic>
 #include "graphics.h"
+#include "ReadWriteLock.h"
+
+/**
+ * @brief Synchronization state of a graph node, which lets searches read the neighbors of a node while other
+ * threads update them. Writers build the new list aside and only swap it in under the lock, and the version tells
+ * them whether someone else replaced the list after they read it.
+ */
+struct GraphNodeSync {
+  SpinReadWriteLock lock;     // Shared while the neighbors are read, exclusive while they are replaced
+  unsigned int version;       // Number of times the neighbors were replaced, changed with the lock held exclusively
+  std::atomic<bool> removed;  // Tombstone of the point of the node
+
+  GraphNodeSync(void) : version(0), removed(false) {}
+};
 
 /**
  * @brief Implements a directed, unweighted graph data structure. Each node in the graph contains 
@@ -18,10 +33,53 @@
 template <typename graph_t> class Graph {
 
 private:
-  GraphNode<graph_t>* nodes;
-  std::set<graph_t> nodesSet;
-  std::vector<GraphNode<graph_t>> nodesVector;
-  unsigned int nodesCount;
+
+  // The nodes are stored in segments that are never moved, so that pointers to nodes stay valid while nodes are
+  // added. The first segment holds the nodes of setNodesCount, and every later segment doubles the capacity.
+  // Every segment of nodes has a segment of the same size with the synchronization state of the nodes.
+  static const unsigned int MAX_SEGMENTS = 32;
+  static const unsigned int MIN_SEGMENT_SIZE = 1024;
+
+  GraphNode<graph_t>* segments[MAX_SEGMENTS];
+  GraphNodeSync* syncSegments[MAX_SEGMENTS];
+  unsigned int segmentsEnd[MAX_SEGMENTS];     // One past the index of the last node of every segment
+  unsigned int segmentsCount;
+  std::atomic<unsigned int> nodesCount;       // Stored after a new node is complete, so readers never see it half set
+
+  /**
+   * @brief Releases the segments of the nodes and allocates a first segment for a number of nodes.
+   * 
+   * @param capacity the number of nodes of the first segment
+   */
+  void resetSegments(const unsigned int capacity);
+
+  /**
+   * @brief Returns the segment that holds an index, which must be inside the allocated segments.
+   * 
+   * @param index Index of the node
+   * @return The number of the segment
+   */
+  inline unsigned int findSegment(const unsigned int index) const {
+    unsigned int segment = 0;
+    while (index >= this->segmentsEnd[segment]) {
+      segment++;
+    }
+    return segment;
+  }
+
+  /**
+   * @brief Returns the node at an index, which must be inside the allocated segments.
+   * 
+   * @param index Index of the node
+   * @return Reference to the node
+   */
+  inline GraphNode<graph_t>& nodeAt(const unsigned int index) const {
+    if (index < this->segmentsEnd[0]) {
+      return this->segments[0][index];
+    }
+    unsigned int segment = this->findSegment(index);
+    return this->segments[segment][index - this->segmentsEnd[segment - 1]];
+  }
 
 public:
 
@@ -60,18 +118,27 @@ public:
   void setNodesCount(const unsigned int nodesCount);
 
   /**
-   * @brief Retrieves the data from all nodes in the graph.
+   * @brief Appends a node with the given data and no neighbors. The storage grows by whole segments, so adding a
+   * node takes amortized constant time and never moves the existing nodes.
+   * 
+   * @param data Data to assign to the node
+   * @return Index of the new node
+   */
+  unsigned int addNode(const graph_t& data);
+
+  /**
+   * @brief Collects the data from all nodes in the graph.
    * 
    * @return set of data from all nodes
   */
-  std::set<graph_t> getNodesSet(void) const { return this->nodesSet; }
+  std::set<graph_t> getNodesSet(void) const;
 
   /**
-   * @brief Retrieves the data from all nodes in the graph.
+   * @brief Copies all nodes of the graph.
    * 
-   * @return vector of data from all nodes
+   * @return vector of all nodes
    */
-  std::vector<GraphNode<graph_t>> getNodesVector(void) const { return this->nodesVector; }
+  std::vector<GraphNode<graph_t>> getNodesVector(void) const;
 
   /**
    * @brief Retrieves the data from a specific node by its index.
@@ -89,6 +156,21 @@ public:
    */
   GraphNode<graph_t>* getNode(const unsigned int index) const;
 
+  /**
+   * @brief Retrieves the synchronization state of the node at a specified index. Searches take its lock shared
+   * while they read the neighbors of the node, and updates take it exclusively to replace them.
+   * 
+   * @param index Index of the node, which must be less than the nodes count
+   * @return Reference to the synchronization state of the node
+   */
+  inline GraphNodeSync& getNodeSync(const unsigned int index) const {
+    if (index < this->segmentsEnd[0]) {
+      return this->syncSegments[0][index];
+    }
+    unsigned int segment = this->findSegment(index);
+    return this->syncSegments[segment][index - this->segmentsEnd[segment - 1]];
+  }
+
   /**
    * @brief Finds and returns a pointer to the first node that contains the specified data.
    * 
@@ -110,7 +192,7 @@ public:
    * 
    * @return Total node count
    */
-  unsigned int getNodesCount(void) const { return this->nodesCount; }
+  unsigned int getNodesCount(void) const { return this->nodesCount.load(std::memory_order_acquire); }
 
   /**
    * @brief Connects two nodes in the graph by their data, creating a directed edge from the first 
@@ -68,6 +68,13 @@ public:
    */
   inline node_t getData(void) const { return this->data; }
 
+  /**
+   * @brief Retrieves the data stored in this node, without copying it.
+   * 
+   * @return A constant reference to the data contained in the node
+   */
+  inline const node_t& getDataReference(void) const { return this->data; }
+
   /**
    * @brief Retrieves the list of neighbors for this node.
    * 
@@ -6,6 +6,10 @@
 #include <iomanip>
 #include <functional>
 #include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 const std::string black = "\033[0;30m";
 const std::string red = "\033[0;31m";
@@ -54,6 +58,73 @@ void displayProgressBar(
   const unsigned int barWidth = 30
 );
 
+/**
+ * @brief Progress of a loop, rendered as a progress bar by a ticker thread.
+ *
+ * The work loop only adds to a relaxed atomic counter, so it can be updated from any number of threads without
+ * formatting or flushing anything. The ticker renders the counter at a fixed interval, and the last state is
+ * rendered once when the loop finishes, so loops with cheap items do not pay for the bar. Nothing is rendered
+ * when the standard output is not a terminal.
+ */
+class ProgressReporter {
+
+private:
+  const std::string message;
+  const unsigned int total;
+  const unsigned int barWidth;
+  const std::chrono::steady_clock::time_point startTime;
+  const bool enabled;
+  std::atomic<unsigned int> current;
+  std::thread ticker;
+  std::mutex mutex;
+  std::condition_variable stopCondition;
+  bool finished;
+
+  /**
+   * @brief Main loop of the ticker: renders the progress at every interval until the reporter finishes.
+   */
+  void tick(void);
+
+public:
+
+  /**
+   * @brief Constructor of the ProgressReporter. Starts the ticker if the progress is rendered.
+   *
+   * @param total the number of items of the loop
+   * @param message the message to display before the progress bar
+   * @param visualize whether to render the progress, which is ignored when the standard output is not a terminal
+   * @param barWidth the width of the progress bar in characters
+   */
+  ProgressReporter(const unsigned int total, const std::string& message, const bool visualize = true, const unsigned int barWidth = 30);
+
+  /**
+   * @brief Destructor of the ProgressReporter. Finishes the reporter if it was not finished yet.
+   */
+  ~ProgressReporter(void);
+
+  ProgressReporter(const ProgressReporter&) = delete;
+  ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+  /**
+   * @brief Adds finished items to the progress. Safe to call from any thread.
+   *
+   * @param count the number of items that were finished
+   */
+  inline void add(const unsigned int count = 1) { this->current.fetch_add(count, std::memory_order_relaxed); }
+
+  /**
+   * @brief Stops the ticker and renders the final state of the progress, followed by a new line.
+   */
+  void finish(void);
+
+  /**
+   * @brief Returns whether progress bars are rendered at all, which is the case when the standard output is a
+   * terminal.
+   */
+  static bool isTerminal(void);
+
+};
+
 /**
  * @brief Function to execute a function with a progress bar.
  * 
@@ -63,12 +134,21 @@ void displayProgressBar(
  * @param func The function to execute.
  * @param barWidth The width of the progress bar in characters.
  */
-void withProgress(
+template <typename func_t> void withProgress(
   const unsigned int start, 
   const unsigned int end, 
-  const std::string message,
-  std::function<void(int)> func, 
+  const std::string& message,
+  const func_t& func, 
   const unsigned int barWidth = 30
-);
+) {
+
+  ProgressReporter progress(end - start, message, true, barWidth);
+  for (unsigned int i = start; i < end; i++) {
+    func(i);
+    progress.add();
+  }
+  progress.finish();
+
+}
 
 #endif /* GRAPHICS_H */
@@ -8,26 +8,76 @@
 #include "graphics.h"
 #include "Filter.h"
 #include "distance.h"
+#include "read_data.h"
 
 
 /**
  * @brief Compute the groundtruth for a set of base and query vectors.
  * 
  * This function computes the groundtruth for a set of base and query vectors by calculating the Euclidean distance
- * between each query vector and all base vectors. The function supports only two query types: 0 and 1. For query type 0,
- * the function computes the distances between the query vector and all base vectors. For query type 1, the function computes
- * the distances between the query vector and the base vectors with the same C value.
+ * between each query vector and all base vectors. The function supports all four query types. For query type 0, the
+ * function computes the distances between the query vector and all base vectors. For query type 1, the function computes
+ * the distances between the query vector and the base vectors with the same C value. For query type 2, only the base
+ * vectors with l ≤ T ≤ r are considered, and for query type 3 both constraints must hold.
  * 
  * @param base_vectors A vector of BaseDataVector objects representing the base vectors
  * @param query_vectors A vector of QueryDataVector objects representing the query vectors
- * @param maxDistances The maximum number of distances to compute for each query vector
+ * @param maxBaseVectors The maximum number of nearest base vectors to keep for each query vector
+ * @param numThreads The number of threads to use
  * 
- * @return A 2D vector containing the computed distances for each query vector
+ * @return A 2D vector containing the indexes of the nearest base vectors for each query vector
  */
 std::vector<std::vector<int>> computeGroundtruth(
-  const std::vector<BaseDataVector<float>> base_vectors, 
-  const std::vector<QueryDataVector<float>> query_vectors, 
-  const unsigned int maxBaseVectors
+  const std::vector<BaseDataVector<float>>& base_vectors, 
+  const std::vector<QueryDataVector<float>>& query_vectors, 
+  const unsigned int maxBaseVectors,
+  const unsigned int numThreads = 1
+);
+
+/**
+ * @brief Compute the groundtruth for a set of base and query vectors stored in contiguous stores.
+ * 
+ * The queries and the base vectors are compared tile by tile with the batched distance kernel, using multiple
+ * threads, and a bounded max-heap keeps the nearest base vectors of every query. The supported query types
+ * are the same as in the version of the function that takes vectors of DataVector objects.
+ * 
+ * @param base The base vectors, together with their C and T values
+ * @param queries The query vectors, together with their query type and filter value
+ * @param maxBaseVectors The maximum number of nearest base vectors to keep for each query vector
+ * @param numThreads The number of threads to use
+ * 
+ * @return A 2D vector containing the indexes of the nearest base vectors for each query vector
+ */
+std::vector<std::vector<int>> computeGroundtruth(
+  const VectorStore& base,
+  const VectorStore& queries,
+  const unsigned int maxBaseVectors,
+  const unsigned int numThreads = 1
+);
+
+/**
+ * @brief Compute the groundtruth for a set of query vectors by streaming the base vectors from their file.
+ * 
+ * The base file is scanned in chunks of `chunkSize` vectors with a ChunkedVectorReader, so only one chunk of base
+ * vectors is kept in memory at a time. Every chunk is compared against all the queries in the same way as in the
+ * in-memory version of the function, and the bounded heaps of the queries carry the nearest base vectors from one
+ * chunk to the next.
+ * 
+ * @param baseFile The path of the base vectors file (SIGMOD base format)
+ * @param queries The query vectors, together with their query type and filter value
+ * @param maxBaseVectors The maximum number of nearest base vectors to keep for each query vector
+ * @param chunkSize The number of base vectors read from the file at a time
+ * @param numThreads The number of threads to use
+ * 
+ * @return A 2D vector containing the indexes of the nearest base vectors for each query vector, or an empty vector
+ * if the base file could not be read
+ */
+std::vector<std::vector<int>> computeGroundtruth(
+  const std::string& baseFile,
+  const VectorStore& queries,
+  const unsigned int maxBaseVectors,
+  const unsigned int chunkSize,
+  const unsigned int numThreads = 1
 );
 
 /**
@@ -3,12 +3,169 @@
 
 #include <vector>           // Required for std::vector
 #include <string>           // Required for std::string
+#include <fstream>          // Required for std::ifstream
 #include "DataVector.h"
 #include "BQDataVectors.h"
 
 
 using namespace std;        // Optional: can avoid repeating std::
 
+/**
+ * @brief Enum to define the layout of a dataset file.
+ * 
+ * FVECS files are the texmex files of the first part (every vector starts with its dimension), while SIGMOD_BASE
+ * and SIGMOD_QUERY are the base and query files of the SIGMOD 2024 contest datasets.
+ */
+enum DATASET_FORMAT {
+  FVECS = 0,
+  SIGMOD_BASE = 1,
+  SIGMOD_QUERY = 2
+};
+
+/**
+ * @brief Contiguous storage for the vectors of a dataset file. The values of all the vectors are placed one after
+ * the other in a single array (row-major), and the attributes of the SIGMOD datasets are kept in separate arrays
+ * indexed by the vector index. It avoids allocating a separate object for every vector when the readers only need
+ * to scan the data, e.g. for computing the groundtruth.
+ */
+struct VectorStore {
+
+  unsigned int count;
+  unsigned int dimension;
+  unsigned int offset;              // Index of the first vector of the store inside its file
+  vector<float> data;
+
+  vector<unsigned int> C;           // Categorical attribute of the base vectors
+  vector<float> T;                  // Timestamp attribute of the base vectors
+
+  vector<unsigned int> queryType;   // Query type of the query vectors
+  vector<float> V;                  // Categorical value of the query vectors
+  vector<float> L;                  // Lower timestamp bound of the query vectors
+  vector<float> R;                  // Upper timestamp bound of the query vectors
+
+  VectorStore(void) : count(0), dimension(0), offset(0) {}
+
+  /**
+   * @brief Returns a pointer to the first value of a vector inside the store.
+   * 
+   * @param index the index of the vector
+   * @return pointer to the values of the vector
+   */
+  inline const float* getVector(const unsigned int index) const { return this->data.data() + (size_t)index * this->dimension; }
+
+};
+
+/**
+ * @brief Reads an `.fvecs` file into a contiguous vector store. The file is mapped and parsed in place, the
+ * dimension is taken from the header of the first vector and the number of vectors from the size of the file.
+ * 
+ * @param filename The name of the input file to read vector data from.
+ * @param store The store in which the vectors are going to be placed.
+ * 
+ * @return true if the file was read successfully, false otherwise.
+ */
+bool ReadVectorStore(const string& filename, VectorStore& store);
+
+/**
+ * @brief Reads a SIGMOD base vectors `.bin` file into a contiguous vector store. The file starts with the number
+ * of vectors, followed by the records of the vectors, each one being the C and T attributes and the vector values.
+ * The dimension is derived from the size of the file.
+ * 
+ * @param filename The name of the input file to read vector data from.
+ * @param store The store in which the vectors and their attributes are going to be placed.
+ * 
+ * @return true if the file was read successfully, false otherwise.
+ */
+bool ReadFilteredBaseVectorStore(const string& filename, VectorStore& store);
+
+/**
+ * @brief Reads a SIGMOD query vectors `.bin` file into a contiguous vector store. The file starts with the number
+ * of queries, followed by the records of the queries, each one being the query type, v, l and r attributes and the
+ * vector values. The dimension is derived from the size of the file.
+ * 
+ * @param filename The name of the input file to read vector data from.
+ * @param store The store in which the vectors and their attributes are going to be placed.
+ * 
+ * @return true if the file was read successfully, false otherwise.
+ */
+bool ReadFilteredQueryVectorStore(const string& filename, VectorStore& store);
+
+/**
+ * @brief Streaming reader that yields the vectors of a dataset file in fixed-size chunks. Only one chunk is kept in
+ * memory at a time, so datasets larger than the available memory can be scanned with bounded memory usage. Every
+ * chunk is read with a single bulk read and placed in a VectorStore, together with the C/T or query attributes
+ * of its vectors. Typical usage:
+ * 
+ *   ChunkedVectorReader reader;
+ *   VectorStore chunk;
+ *   if (reader.open(filename, SIGMOD_BASE, 100000)) {
+ *     while (reader.next(chunk)) { ... chunk.offset + i is the index of the i-th vector in the file ... }
+ *   }
+ */
+class ChunkedVectorReader {
+
+private:
+  ifstream file;
+  DATASET_FORMAT format;
+  unsigned int chunkSize;
+  unsigned int count;
+  unsigned int dimension;
+  unsigned int position;
+  size_t headerSize;
+  size_t recordSize;
+  vector<char> buffer;
+
+public:
+
+  /**
+   * @brief Default constructor of the ChunkedVectorReader. The reader has to be opened before it is used.
+   */
+  ChunkedVectorReader(void) : format(FVECS), chunkSize(0), count(0), dimension(0), position(0), headerSize(0), recordSize(0) {}
+
+  /**
+   * @brief Opens a dataset file and parses its header. The number of vectors and their dimension are derived from
+   * the header and the size of the file.
+   * 
+   * @param filename The name of the dataset file.
+   * @param format The layout of the file.
+   * @param chunkSize The maximum number of vectors returned by every call of next.
+   * 
+   * @return true if the file was opened successfully, false otherwise.
+   */
+  bool open(const string& filename, const DATASET_FORMAT format, const unsigned int chunkSize);
+
+  /**
+   * @brief Reads the next chunk of vectors of the file.
+   * 
+   * @param chunk The store in which the vectors of the chunk are placed. Its offset is set to the index of the
+   * first vector of the chunk inside the file.
+   * 
+   * @return true if a chunk was read, false if the end of the file was reached or an error occurred.
+   */
+  bool next(VectorStore& chunk);
+
+  /**
+   * @brief Moves the reader back to the first vector of the file.
+   */
+  void rewind(void);
+
+  /**
+   * @brief Returns the total number of vectors in the file.
+   */
+  inline unsigned int getCount(void) const { return this->count; }
+
+  /**
+   * @brief Returns the dimension of the vectors in the file.
+   */
+  inline unsigned int getDimension(void) const { return this->dimension; }
+
+  /**
+   * @brief Returns the number of chunks the file is split into.
+   */
+  inline unsigned int getChunksCount(void) const { return this->chunkSize == 0 ? 0 : (this->count + this->chunkSize - 1) / this->chunkSize; }
+
+};
+
 /**
  * @brief Function to read a file and convert its data into a vector of DataVector<float> objects.
  * The file is assumed to be in a binary format where each vector starts with its dimensionality (int),
@@ -65,4 +222,52 @@ vector<BaseDataVector<float>> ReadFilteredBaseVectorFile(const string& filename)
  */
 vector<QueryDataVector<float>> ReadFilteredQueryVectorFile(const string& filename);
 
+/**
+ * @brief Reads the base vectors of a simple (unfiltered) index. It is an overload used by the index classes
+ * to load the dataset that a graph file refers to, without knowing the exact file format in advance. The
+ * `.fvecs` format is assumed here.
+ * 
+ * @param filename The name of the base vectors file.
+ * @param points The vector in which the read points are going to be stored.
+ * 
+ * @return true if at least one vector was read, false otherwise.
+ */
+bool ReadBaseVectors(const string& filename, vector<DataVector<float>>& points);
+
+/**
+ * @brief Reads the base vectors of a filtered index. It is an overload used by the index classes to load the
+ * dataset that a graph file refers to. The SIGMOD `.bin` format is assumed here.
+ * 
+ * @param filename The name of the base vectors file.
+ * @param points The vector in which the read points are going to be stored.
+ * 
+ * @return true if at least one vector was read, false otherwise.
+ */
+bool ReadBaseVectors(const string& filename, vector<BaseDataVector<float>>& points);
+
+/**
+ * @brief Reads the label sets of the points of a filtered dataset, for datasets whose points carry several
+ * categorical labels. The file is a text file with one line per base vector, holding its labels separated by
+ * spaces or commas. An empty line keeps the categorical attribute C of the point as its only label.
+ * 
+ * @param filename The name of the labels file.
+ * @param points The base vectors the labels refer to, in the same order.
+ * @param labelSets The vector in which the label set of every point is going to be stored.
+ * 
+ * @return true if the file has exactly one line per base vector and every label is valid, false otherwise.
+ */
+bool ReadLabelSets(const string& filename, const vector<BaseDataVector<float>>& points, vector<vector<unsigned int>>& labelSets);
+
+/**
+ * @brief Computes a 64-bit FNV-1a checksum over the whole contents of a file. It is used by the graph-only
+ * index files to make sure that the base vectors they point to are the same ones the graph was built on.
+ * 
+ * @param filename The name of the file.
+ * @param checksum The computed checksum.
+ * @param fileSize The size of the file in bytes.
+ * 
+ * @return true if the file could be read, false otherwise.
+ */
+bool ComputeFileChecksum(const string& filename, unsigned long long& checksum, unsigned long long& fileSize);
+
 #endif // READ_DATA_H
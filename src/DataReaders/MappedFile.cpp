@@ -0,0 +1,87 @@
+#include <iostream>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../../include/MappedFile.h"
+
+/**
+ * @brief Destructor of the MappedFile. Unmaps the file if it was mapped.
+ */
+MappedFile::~MappedFile(void) {
+  this->close();
+}
+
+/**
+ * @brief Opens a file and maps its contents. Any previously opened file is closed first.
+ *
+ * @param filename the full path of the file
+ *
+ * @return true if the file was opened successfully, false otherwise
+ */
+bool MappedFile::open(const std::string& filename) {
+
+  this->close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Error opening file: " << filename << std::endl;
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    std::cerr << "Error reading the size of file: " << filename << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  this->fileSize = static_cast<size_t>(fileStat.st_size);
+  if (this->fileSize == 0) {
+    ::close(fd);
+    return true;
+  }
+
+  // Map the file and let the kernel know it is going to be read sequentially
+  void* address = mmap(nullptr, this->fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (address != MAP_FAILED) {
+    madvise(address, this->fileSize, MADV_SEQUENTIAL);
+    this->bytes = static_cast<const char*>(address);
+    this->mapped = true;
+    return true;
+  }
+
+  // Fall back to a single bulk read of the whole file if it can not be mapped
+  std::ifstream file(filename, std::ios::binary);
+  this->buffer.resize(this->fileSize);
+  if (!file.read(this->buffer.data(), this->fileSize)) {
+    std::cerr << "Error reading file: " << filename << std::endl;
+    this->buffer.clear();
+    this->fileSize = 0;
+    return false;
+  }
+
+  this->bytes = this->buffer.data();
+  return true;
+
+}
+
+/**
+ * @brief Releases the mapping or the buffer of the currently opened file.
+ */
+void MappedFile::close(void) {
+
+  if (this->mapped) {
+    munmap(const_cast<char*>(this->bytes), this->fileSize);
+  }
+
+  this->buffer.clear();
+  this->buffer.shrink_to_fit();
+  this->bytes = nullptr;
+  this->fileSize = 0;
+  this->mapped = false;
+
+}
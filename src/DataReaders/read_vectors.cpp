@@ -1,60 +1,394 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
 #include "../../include/DataVector.h"
 #include "../../include/read_data.h"
-#include "../../include/graphics.h"
+#include "../../include/MappedFile.h"
 
 
 using namespace std;
 
 /**
- * @brief Function to read a file and convert its data into a vector of DataVector<float> objects.
- * The file is assumed to be in a binary format where each vector starts with its dimensionality (int),
- * followed by the float values representing the vector data.
+ * @brief Copies consecutive texmex records (the dimension followed by the values of the vector) into a contiguous
+ * array of values, checking that every record has the expected dimension.
+ * 
+ * @param records Pointer to the first record.
+ * @param count The number of records to parse.
+ * @param dimension The expected dimension of every record.
+ * @param values The array in which the values are placed, with room for count * dimension values.
+ * 
+ * @return true if all records have the expected dimension, false otherwise.
+ */
+template <typename value_t>
+static bool ParseTexmexRecords(const char* records, const unsigned int count, const unsigned int dimension, value_t* values) {
+
+    const size_t recordSize = sizeof(int) + (size_t)dimension * sizeof(value_t);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        const char* record = records + i * recordSize;
+        int d;
+        memcpy(&d, record, sizeof(d));
+        if ((unsigned int)d != dimension) {
+            return false;
+        }
+        memcpy(values + (size_t)i * dimension, record + sizeof(int), dimension * sizeof(value_t));
+    }
+
+    return true;
+}
+
+/**
+ * @brief Copies consecutive SIGMOD records (the attributes followed by the values of the vector) into a vector
+ * store. The store is resized to hold exactly `count` vectors of the given dimension.
+ * 
+ * @param records Pointer to the first record.
+ * @param count The number of records to parse.
+ * @param dimension The dimension of the vectors.
+ * @param format The format of the records, either SIGMOD_BASE or SIGMOD_QUERY.
+ * @param store The store in which the vectors and their attributes are placed.
+ */
+static void ParseSigmodRecords(const char* records, const unsigned int count, const unsigned int dimension, const DATASET_FORMAT format, VectorStore& store) {
+
+    const unsigned int attributesCount = format == SIGMOD_BASE ? 2 : 4;
+    const size_t recordSize = (attributesCount + dimension) * sizeof(float);
+
+    store.count = count;
+    store.dimension = dimension;
+    store.data.resize((size_t)count * dimension);
+
+    if (format == SIGMOD_BASE) {
+        store.C.resize(count);
+        store.T.resize(count);
+    } else {
+        store.queryType.resize(count);
+        store.V.resize(count);
+        store.L.resize(count);
+        store.R.resize(count);
+    }
+
+    for (unsigned int i = 0; i < count; ++i) {
+        const char* record = records + i * recordSize;
+        float attributes[4];
+        memcpy(attributes, record, attributesCount * sizeof(float));
+        memcpy(&store.data[(size_t)i * dimension], record + attributesCount * sizeof(float), dimension * sizeof(float));
+
+        if (format == SIGMOD_BASE) {
+            store.C[i] = attributes[0];
+            store.T[i] = attributes[1];
+        } else {
+            store.queryType[i] = attributes[0];
+            store.V[i] = attributes[1];
+            store.L[i] = attributes[2];
+            store.R[i] = attributes[3];
+        }
+    }
+
+}
+
+/**
+ * @brief Parses a file of the texmex format (`.fvecs` / `.ivecs`), where every vector starts with its dimension
+ * followed by the values of the vector, all of them being 4 bytes long. The dimension of the first vector is used
+ * for the whole file and the vectors are copied into one contiguous array.
+ * 
+ * @param file The mapped contents of the file.
+ * @param filename The name of the file, used for error messages.
+ * @param values The array in which the values of the vectors are placed.
+ * @param count The number of vectors in the file.
+ * @param dimension The dimension of the vectors.
+ * 
+ * @return true if the file has the expected layout, false otherwise.
+ */
+template <typename value_t>
+static bool ParseTexmexFile(const MappedFile& file, const string& filename, vector<value_t>& values, unsigned int& count, unsigned int& dimension) {
+
+    count = dimension = 0;
+    values.clear();
+
+    // Every file holds at least the header of its first vector
+    if (file.size() < sizeof(int)) {
+        cerr << "Error: Invalid vector file layout: " << filename << endl;
+        return false;
+    }
+
+    // Parse the header of the first vector once, every record has the same size after that
+    int d;
+    memcpy(&d, file.data(), sizeof(d));
+    size_t recordSize = sizeof(int) + (size_t)d * sizeof(value_t);
+
+    if (d <= 0 || file.size() % recordSize != 0) {
+        cerr << "Error: Invalid vector file layout: " << filename << endl;
+        return false;
+    }
+
+    dimension = d;
+    count = file.size() / recordSize;
+    values.resize((size_t)count * dimension);
+
+    if (!ParseTexmexRecords(file.data(), count, dimension, values.data())) {
+        cerr << "Error: Vectors of different dimensions in file: " << filename << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Parses the header of a SIGMOD `.bin` file and derives the dimension of its vectors from the size of the file.
+ * 
+ * @param file The mapped contents of the file.
+ * @param filename The name of the file, used for error messages.
+ * @param attributesCount The number of attributes (4 bytes each) stored in front of the values of every vector.
+ * @param count The number of vectors in the file.
+ * @param dimension The dimension of the vectors.
+ * 
+ * @return true if the file has the expected layout, false otherwise.
+ */
+static bool ParseSigmodHeader(const MappedFile& file, const string& filename, const unsigned int attributesCount, unsigned int& count, unsigned int& dimension) {
+
+    count = dimension = 0;
+    if (file.size() < sizeof(unsigned int)) {
+        cerr << "Error: Invalid vector file layout: " << filename << endl;
+        return false;
+    }
+
+    memcpy(&count, file.data(), sizeof(count));
+    if (count == 0) {
+        return true;
+    }
+
+    size_t payload = file.size() - sizeof(unsigned int);
+    size_t recordSize = payload / count;
+    if (payload % count != 0 || recordSize % sizeof(float) != 0 || recordSize / sizeof(float) <= attributesCount) {
+        cerr << "Error: Invalid vector file layout: " << filename << endl;
+        return false;
+    }
+
+    dimension = recordSize / sizeof(float) - attributesCount;
+    return true;
+}
+
+/**
+ * @brief Reads an `.fvecs` file into a contiguous vector store. The file is mapped and parsed in place, the
+ * dimension is taken from the header of the first vector and the number of vectors from the size of the file.
  * 
  * @param filename The name of the input file to read vector data from.
+ * @param store The store in which the vectors are going to be placed.
  * 
- * @return A vector of DataVector<float> objects containing the read data.
+ * @return true if the file was read successfully, false otherwise.
  */
-vector<DataVector<float>> ReadVectorFile(const string& filename){
-    ifstream file(filename, ios::binary);
+bool ReadVectorStore(const string& filename, VectorStore& store) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
 
-    if (!file.is_open()) {
+    store = VectorStore();
+    return ParseTexmexFile(file, filename, store.data, store.count, store.dimension);
+}
+
+/**
+ * @brief Reads a SIGMOD base vectors `.bin` file into a contiguous vector store. The file starts with the number
+ * of vectors, followed by the records of the vectors, each one being the C and T attributes and the vector values.
+ * The dimension is derived from the size of the file.
+ * 
+ * @param filename The name of the input file to read vector data from.
+ * @param store The store in which the vectors and their attributes are going to be placed.
+ * 
+ * @return true if the file was read successfully, false otherwise.
+ */
+bool ReadFilteredBaseVectorStore(const string& filename, VectorStore& store) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    unsigned int count, dimension;
+    store = VectorStore();
+    if (!ParseSigmodHeader(file, filename, 2, count, dimension)) {
+        return false;
+    }
+
+    ParseSigmodRecords(file.data() + sizeof(unsigned int), count, dimension, SIGMOD_BASE, store);
+    return true;
+}
+
+/**
+ * @brief Reads a SIGMOD query vectors `.bin` file into a contiguous vector store. The file starts with the number
+ * of queries, followed by the records of the queries, each one being the query type, v, l and r attributes and the
+ * vector values. The dimension is derived from the size of the file.
+ * 
+ * @param filename The name of the input file to read vector data from.
+ * @param store The store in which the vectors and their attributes are going to be placed.
+ * 
+ * @return true if the file was read successfully, false otherwise.
+ */
+bool ReadFilteredQueryVectorStore(const string& filename, VectorStore& store) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    unsigned int count, dimension;
+    store = VectorStore();
+    if (!ParseSigmodHeader(file, filename, 4, count, dimension)) {
+        return false;
+    }
+
+    ParseSigmodRecords(file.data() + sizeof(unsigned int), count, dimension, SIGMOD_QUERY, store);
+    return true;
+}
+
+/**
+ * @brief Opens a dataset file and parses its header. The number of vectors and their dimension are derived from
+ * the header and the size of the file.
+ * 
+ * @param filename The name of the dataset file.
+ * @param format The layout of the file.
+ * @param chunkSize The maximum number of vectors returned by every call of next.
+ * 
+ * @return true if the file was opened successfully, false otherwise.
+ */
+bool ChunkedVectorReader::open(const string& filename, const DATASET_FORMAT format, const unsigned int chunkSize) {
+
+    if (this->file.is_open()) {
+        this->file.close();
+    }
+    this->file.clear();
+    this->file.open(filename, ios::binary);
+
+    if (!this->file.is_open() || chunkSize == 0) {
         cerr << "Error opening file: " << filename << endl;
-        return {};
+        return false;
     }
 
-    vector<DataVector<float>> dataVectors; // Vector to store DataVector objects
-    int nb_vectors = 0;
+    this->format = format;
+    this->chunkSize = chunkSize;
+    this->count = this->dimension = this->position = 0;
 
-    while (file) {
-        int d;  // Dimensionality of the vector (first 4 bytes)
+    this->file.seekg(0, ios::end);
+    size_t fileSize = this->file.tellg();
+    this->file.seekg(0, ios::beg);
 
-        // Read dimensionality (4 bytes)
-        file.read(reinterpret_cast<char*>(&d), sizeof(d));
+    if (fileSize == 0) {
+        this->headerSize = this->recordSize = 0;
+        return true;
+    }
 
-        if (file.eof())
-            break; // Exit loop if end of file is reached
+    if (format == FVECS) {
+        // Every vector has the same dimension, so the header of the first one describes the whole file
+        int d = 0;
+        this->file.read(reinterpret_cast<char*>(&d), sizeof(d));
+        this->headerSize = 0;
+        this->recordSize = sizeof(int) + (size_t)d * sizeof(float);
 
-        // Create a DataVector object with the given dimension
-        DataVector<float> dataVector(d);
+        if (!this->file || d <= 0 || fileSize % this->recordSize != 0) {
+            cerr << "Error: Invalid vector file layout: " << filename << endl;
+            return false;
+        }
 
-        // Read the actual vector data (d * 4 bytes for float data)
-        for (int i = 0; i < d; ++i) {
-            float value;
-            file.read(reinterpret_cast<char*>(&value), sizeof(value));
-            dataVector.setDataAtIndex(value, i);  // Set the data at the respective index
+        this->dimension = d;
+        this->count = fileSize / this->recordSize;
+    } 
+    else {
+        // The SIGMOD files store the number of vectors, the dimension is derived from the size of the records
+        const unsigned int attributesCount = format == SIGMOD_BASE ? 2 : 4;
+        this->file.read(reinterpret_cast<char*>(&this->count), sizeof(this->count));
+        this->headerSize = sizeof(unsigned int);
+
+        size_t payload = fileSize - this->headerSize;
+        if (!this->file || this->count == 0 || payload % this->count != 0 || (payload / this->count) % sizeof(float) != 0 ||
+            payload / this->count / sizeof(float) <= attributesCount) {
+            cerr << "Error: Invalid vector file layout: " << filename << endl;
+            this->count = 0;
+            return false;
         }
 
-        dataVector.setIndex(nb_vectors); // Set the index of the data vector for easy and fast accessing
+        this->recordSize = payload / this->count;
+        this->dimension = this->recordSize / sizeof(float) - attributesCount;
+    }
 
-        // Add the DataVector object to the vector
-        dataVectors.push_back(dataVector);
-        nb_vectors++;
+    this->rewind();
+    return true;
+}
+
+/**
+ * @brief Reads the next chunk of vectors of the file.
+ * 
+ * @param chunk The store in which the vectors of the chunk are placed. Its offset is set to the index of the
+ * first vector of the chunk inside the file.
+ * 
+ * @return true if a chunk was read, false if the end of the file was reached or an error occurred.
+ */
+bool ChunkedVectorReader::next(VectorStore& chunk) {
+
+    if (this->position >= this->count) {
+        return false;
     }
 
-    file.close();
+    // Read all the records of the chunk with a single read call
+    unsigned int chunkCount = min(this->chunkSize, this->count - this->position);
+    this->buffer.resize(chunkCount * this->recordSize);
+    if (!this->file.read(this->buffer.data(), this->buffer.size())) {
+        cerr << "Error: Unexpected end of vector file" << endl;
+        return false;
+    }
+
+    if (this->format == FVECS) {
+        chunk.count = chunkCount;
+        chunk.dimension = this->dimension;
+        chunk.data.resize((size_t)chunkCount * this->dimension);
+        if (!ParseTexmexRecords(this->buffer.data(), chunkCount, this->dimension, chunk.data.data())) {
+            cerr << "Error: Vectors of different dimensions in vector file" << endl;
+            return false;
+        }
+    } 
+    else {
+        ParseSigmodRecords(this->buffer.data(), chunkCount, this->dimension, this->format, chunk);
+    }
+
+    chunk.offset = this->position;
+    this->position += chunkCount;
+    return true;
+}
+
+/**
+ * @brief Moves the reader back to the first vector of the file.
+ */
+void ChunkedVectorReader::rewind(void) {
+    this->file.clear();
+    this->file.seekg(this->headerSize, ios::beg);
+    this->position = 0;
+}
+
+/**
+ * @brief Function to read a file and convert its data into a vector of DataVector<float> objects.
+ * The file is assumed to be in a binary format where each vector starts with its dimensionality (int),
+ * followed by the float values representing the vector data.
+ * 
+ * @param filename The name of the input file to read vector data from.
+ * 
+ * @return A vector of DataVector<float> objects containing the read data.
+ */
+vector<DataVector<float>> ReadVectorFile(const string& filename){
+    VectorStore store;
+    if (!ReadVectorStore(filename, store)) {
+        return {};
+    }
+
+    vector<DataVector<float>> dataVectors; // Vector to store DataVector objects
+    dataVectors.reserve(store.count);
+
+    for (unsigned int i = 0; i < store.count; ++i) {
+        // Create a DataVector object with the given dimension and copy the values from the store
+        dataVectors.emplace_back(store.dimension, i);
+        const float* values = store.getVector(i);
+        for (unsigned int j = 0; j < store.dimension; ++j) {
+            dataVectors.back().setDataAtIndex(values[j], j);
+        }
+    }
 
     return dataVectors; // Return the array of DataVector objects
 }
@@ -70,40 +404,27 @@ vector<DataVector<float>> ReadVectorFile(const string& filename){
  * @return A vector of DataVector<int> objects.
  */
 vector<DataVector<int>> ReadGroundTruth(const string& filename) {
-    ifstream file(filename, ios::binary);
+    MappedFile file;
+    if (!file.open(filename)) {
+        return {};
+    }
 
-    if (!file.is_open()) {
-        cerr << "Error opening file: " << filename << endl;
+    vector<int> values;
+    unsigned int count, dimension;
+    if (!ParseTexmexFile(file, filename, values, count, dimension)) {
         return {};
     }
 
     vector<DataVector<int>> dataVectors; // Vector to store DataVector objects
+    dataVectors.reserve(count);
 
-    while (file) {
-        int d;  // Dimensionality of the vector (first 4 bytes)
-
-        // Read dimensionality (4 bytes)
-        file.read(reinterpret_cast<char*>(&d), sizeof(d));
-
-        if (file.eof())
-            break; // Exit loop if end of file is reached
-
-        // Create a DataVector object with the given dimension
-        DataVector<int> dataVector(d);
-
-        // Read the actual vector data (d * 4 bytes for float data)
-        for (int i = 0; i < d; ++i) {
-            int value;
-            file.read(reinterpret_cast<char*>(&value), sizeof(value));
-            dataVector.setDataAtIndex(value, i);  // Set the data at the respective index
+    for (unsigned int i = 0; i < count; ++i) {
+        dataVectors.emplace_back(dimension);
+        for (unsigned int j = 0; j < dimension; ++j) {
+            dataVectors.back().setDataAtIndex(values[(size_t)i * dimension + j], j);
         }
-
-        // Add the DataVector object to the vector
-        dataVectors.push_back(dataVector);
     }
 
-    file.close();
-
     return dataVectors; // Return the array of DataVector objects
 }
 
@@ -149,38 +470,22 @@ void saveVectors(const vector<DataVector<float>>& dataVectors, const string& out
  * @return A vector of BaseDataVector<float> objects containing the read data.
  */
 std::vector<BaseDataVector<float>> ReadFilteredBaseVectorFile(const string& filename) {
-    ifstream file(filename, ios::binary);
-
-    if (!file.is_open()) {
-        cerr << "Error opening file: " << filename << endl;
+    VectorStore store;
+    if (!ReadFilteredBaseVectorStore(filename, store)) {
         return {};
     }
 
-    unsigned int num_vectors;
-    file.read(reinterpret_cast<char*>(&num_vectors), sizeof(num_vectors));
-
     vector<BaseDataVector<float>> dataVectors;
-    dataVectors.reserve(num_vectors);
-
-    withProgress(0, num_vectors, "Reading base vectors", [&](int i) {
-
-        float C, T;
-        file.read(reinterpret_cast<char*>(&C), sizeof(C));
-        file.read(reinterpret_cast<char*>(&T), sizeof(T));
+    dataVectors.reserve(store.count);
 
-        BaseDataVector<float> dataVector(100, i, C, T);
-
-        for (unsigned int j = 0; j < 100; ++j) {
-            float currentData;
-            file.read(reinterpret_cast<char*>(&currentData), sizeof(currentData));
-            dataVector.setDataAtIndex(currentData, j);
+    for (unsigned int i = 0; i < store.count; ++i) {
+        dataVectors.emplace_back(store.dimension, i, store.C[i], store.T[i]);
+        const float* values = store.getVector(i);
+        for (unsigned int j = 0; j < store.dimension; ++j) {
+            dataVectors.back().setDataAtIndex(values[j], j);
         }
+    }
 
-        dataVectors.push_back(dataVector);
-        
-    });
-
-    file.close();
     return dataVectors;
 }
 
@@ -195,40 +500,149 @@ std::vector<BaseDataVector<float>> ReadFilteredBaseVectorFile(const string& file
  * @return A vector of QueryDataVector<float> objects containing the read data.
  */
 std::vector<QueryDataVector<float>> ReadFilteredQueryVectorFile(const string& filename) {
+    VectorStore store;
+    if (!ReadFilteredQueryVectorStore(filename, store)) {
+        return {};
+    }
 
-    ifstream file(filename, ios::binary);
+    vector<QueryDataVector<float>> dataVectors;
+    dataVectors.reserve(store.count);
+
+    for (unsigned int i = 0; i < store.count; ++i) {
+        dataVectors.emplace_back(store.dimension, i, store.queryType[i], store.V[i], store.L[i], store.R[i]);
+        const float* values = store.getVector(i);
+        for (unsigned int j = 0; j < store.dimension; ++j) {
+            dataVectors.back().setDataAtIndex(values[j], j);
+        }
+    }
+
+    return dataVectors;
+}
+
+/**
+ * @brief Reads the base vectors of a simple (unfiltered) index. It is an overload used by the index classes
+ * to load the dataset that a graph file refers to, without knowing the exact file format in advance. The
+ * `.fvecs` format is assumed here.
+ * 
+ * @param filename The name of the base vectors file.
+ * @param points The vector in which the read points are going to be stored.
+ * 
+ * @return true if at least one vector was read, false otherwise.
+ */
+bool ReadBaseVectors(const string& filename, vector<DataVector<float>>& points) {
+    points = ReadVectorFile(filename);
+    return !points.empty();
+}
+
+/**
+ * @brief Reads the base vectors of a filtered index. It is an overload used by the index classes to load the
+ * dataset that a graph file refers to. The SIGMOD `.bin` format is assumed here.
+ * 
+ * @param filename The name of the base vectors file.
+ * @param points The vector in which the read points are going to be stored.
+ * 
+ * @return true if at least one vector was read, false otherwise.
+ */
+bool ReadBaseVectors(const string& filename, vector<BaseDataVector<float>>& points) {
+    points = ReadFilteredBaseVectorFile(filename);
+    return !points.empty();
+}
+
+/**
+ * @brief Reads the label sets of the points of a filtered dataset, for datasets whose points carry several
+ * categorical labels. The file is a text file with one line per base vector, holding its labels separated by
+ * spaces or commas. An empty line keeps the categorical attribute C of the point as its only label.
+ * 
+ * @param filename The name of the labels file.
+ * @param points The base vectors the labels refer to, in the same order.
+ * @param labelSets The vector in which the label set of every point is going to be stored.
+ * 
+ * @return true if the file has exactly one line per base vector and every label is valid, false otherwise.
+ */
+bool ReadLabelSets(const string& filename, const vector<BaseDataVector<float>>& points, vector<vector<unsigned int>>& labelSets) {
+    ifstream file(filename);
 
     if (!file.is_open()) {
         cerr << "Error opening file: " << filename << endl;
-        return {};
+        return false;
     }
 
-    unsigned int num_vectors;
-    file.read(reinterpret_cast<char*>(&num_vectors), sizeof(num_vectors));
+    labelSets.clear();
+    labelSets.reserve(points.size());
 
-    vector<QueryDataVector<float>> dataVectors;
-    dataVectors.reserve(num_vectors);
+    string line;
+    while (getline(file, line)) {
+        if (labelSets.size() == points.size()) {
+            cerr << "Error: " << filename << " has more lines than the " << points.size() << " base vectors" << endl;
+            return false;
+        }
 
-    for (unsigned int i = 0; i < num_vectors; ++i) {
-        float query_type, v, l, r;
+        replace(line.begin(), line.end(), ',', ' ');
+        vector<unsigned int> labels;
+        const char* cursor = line.c_str();
+        char* end = nullptr;
+        while (true) {
+            while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') cursor++;
+            if (*cursor == '\0') break;
+            unsigned long label = strtoul(cursor, &end, 10);
+            if (end == cursor) {
+                cerr << "Error: Invalid label in line " << labelSets.size() + 1 << " of " << filename << endl;
+                return false;
+            }
+            labels.push_back(static_cast<unsigned int>(label));
+            cursor = end;
+        }
 
-        file.read(reinterpret_cast<char*>(&query_type), sizeof(query_type));
-        file.read(reinterpret_cast<char*>(&v), sizeof(v));
-        file.read(reinterpret_cast<char*>(&l), sizeof(l));
-        file.read(reinterpret_cast<char*>(&r), sizeof(r));
+        if (labels.empty()) {
+            labels.push_back(points[labelSets.size()].getC());
+        }
+        labelSets.push_back(labels);
+    }
 
-        QueryDataVector<float> dataVector(100, i, query_type, v, l, r);
+    if (labelSets.size() != points.size()) {
+        cerr << "Error: " << filename << " has " << labelSets.size() << " lines, expected one per base vector (" << points.size() << ")" << endl;
+        return false;
+    }
 
-        for (unsigned int j = 0; j < 100; ++j) {
-            float currentData;
-            file.read(reinterpret_cast<char*>(&currentData), sizeof(currentData));
-            dataVector.setDataAtIndex(currentData, j);
-        }
+    return true;
+}
 
-        dataVectors.push_back(dataVector);
+/**
+ * @brief Computes a 64-bit FNV-1a checksum over the whole contents of a file. It is used by the graph-only
+ * index files to make sure that the base vectors they point to are the same ones the graph was built on.
+ * 
+ * @param filename The name of the file.
+ * @param checksum The computed checksum.
+ * @param fileSize The size of the file in bytes.
+ * 
+ * @return true if the file could be read, false otherwise.
+ */
+bool ComputeFileChecksum(const string& filename, unsigned long long& checksum, unsigned long long& fileSize) {
+    ifstream file(filename, ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return false;
     }
 
-    file.close();
-    return dataVectors;
+    // Read the file in large blocks and fold every byte into the FNV-1a hash
+    const size_t blockSize = 1 << 20;
+    vector<char> buffer(blockSize);
+
+    checksum = 14695981039346656037ULL;
+    fileSize = 0;
 
+    while (file) {
+        file.read(buffer.data(), blockSize);
+        streamsize bytesRead = file.gcount();
+
+        for (streamsize i = 0; i < bytesRead; ++i) {
+            checksum ^= static_cast<unsigned char>(buffer[i]);
+            checksum *= 1099511628211ULL;
+        }
+        fileSize += bytesRead;
+    }
+
+    file.close();
+    return true;
 }
@@ -5,6 +5,10 @@
 #include "../../include/distance.h"
 #include "../../include/BQDataVectors.h" 
 
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 /**
@@ -62,6 +66,102 @@ double euclideanDistance(const DataVector<float>& a, const DataVector<float>& b)
     return sqrt(sum);
 }
 
+/**
+ * @brief Function to calculate Euclidean distance between two vectors stored in contiguous arrays, such as
+ * the rows of a VectorStore.
+ * 
+ * @param a the first vector
+ * @param b the second vector
+ * @param dimension the dimension of both vectors
+ * 
+ * @return the Euclidean distance between those two vector
+*/
+double euclideanDistance(const float* a, const float* b, const unsigned int dimension){
+    double sum = 0.0;
+    for (unsigned int i = 0; i < dimension; ++i) {
+        double diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sqrt(sum);
+}
+
+/**
+ * @brief Function to calculate the squared Euclidean distance between two vectors stored in contiguous arrays. The
+ * computation uses the SIMD instructions of the target (AVX or SSE) when they are available, and is meant for hot
+ * loops where only the order of the distances matters.
+ * 
+ * @param a the first vector
+ * @param b the second vector
+ * @param dimension the dimension of both vectors
+ * 
+ * @return the squared Euclidean distance between those two vector
+*/
+float squaredEuclideanDistance(const float* a, const float* b, const unsigned int dimension){
+    unsigned int i = 0;
+    float sum = 0.0f;
+
+#if defined(__AVX__)
+    // Two independent accumulators of 8 floats hide the latency of the additions
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    for (; i + 16 <= dimension; i += 16) {
+        __m256 diff0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 diff1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(diff0, diff0));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(diff1, diff1));
+    }
+    for (; i + 8 <= dimension; i += 8) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(diff, diff));
+    }
+    sum0 = _mm256_add_ps(sum0, sum1);
+    __m128 partial = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+    partial = _mm_add_ps(partial, _mm_movehl_ps(partial, partial));
+    partial = _mm_add_ss(partial, _mm_shuffle_ps(partial, partial, 1));
+    sum = _mm_cvtss_f32(partial);
+#elif defined(__SSE__)
+    // Two independent accumulators of 4 floats hide the latency of the additions
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    for (; i + 8 <= dimension; i += 8) {
+        __m128 diff0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        __m128 diff1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(diff0, diff0));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(diff1, diff1));
+    }
+    for (; i + 4 <= dimension; i += 4) {
+        __m128 diff = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(diff, diff));
+    }
+    sum0 = _mm_add_ps(sum0, sum1);
+    sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+    sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+    sum = _mm_cvtss_f32(sum0);
+#endif
+
+    // Scalar tail (or the whole computation when no SIMD instructions are available)
+    for (; i < dimension; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+/**
+ * @brief Batched version of squaredEuclideanDistance. Computes the squared Euclidean distances between a query
+ * vector and `count` vectors stored one after the other in a contiguous array.
+ * 
+ * @param query the query vector
+ * @param vectors the contiguous array of vectors
+ * @param count the number of vectors in the array
+ * @param dimension the dimension of all vectors
+ * @param distances the output array, which must have room for `count` distances
+*/
+void squaredEuclideanDistances(const float* query, const float* vectors, const unsigned int count, const unsigned int dimension, float* distances){
+    for (unsigned int j = 0; j < count; ++j) {
+        distances[j] = squaredEuclideanDistance(query, vectors + (size_t)j * dimension, dimension);
+    }
+}
 
 /**
  * @brief Function to calculate Manhattan distance between two DataVector objects. It uses
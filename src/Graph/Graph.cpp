@@ -2,11 +2,16 @@
 #include "../../include/DataVector.h"
 #include "../../include/BQDataVectors.h"
 
+#include <stdexcept>
+
+template <typename graph_t> const unsigned int Graph<graph_t>::MAX_SEGMENTS;
+template <typename graph_t> const unsigned int Graph<graph_t>::MIN_SEGMENT_SIZE;
+
 /**
  * @brief Default Constructor of the Grpah. Exists to avoid errors.
  */
-template <typename graph_t> Graph<graph_t>::Graph(void) : nodesCount(0) {
-  this->nodes = new GraphNode<graph_t>[0];
+template <typename graph_t> Graph<graph_t>::Graph(void) : segmentsCount(0), nodesCount(0) {
+  this->resetSegments(0);
 }
 
 /**
@@ -14,16 +19,11 @@ template <typename graph_t> Graph<graph_t>::Graph(void) : nodesCount(0) {
  * 
  * @param nodesCount_ Number of nodes in the graph
  */
-template <typename graph_t> Graph<graph_t>::Graph(unsigned int nodesCount_) : nodesCount(nodesCount_) {
+template <typename graph_t> Graph<graph_t>::Graph(unsigned int nodesCount_) : segmentsCount(0), nodesCount(nodesCount_) {
 
-  this->nodes = new GraphNode<graph_t>[nodesCount_];
+  this->resetSegments(nodesCount_);
   for (unsigned int i = 0; i < nodesCount_; i++) {
-    this->nodes[i].setIndex(i);
-  }
-
-  for (unsigned int i = 0; i < this->nodesCount; i++) {
-    this->nodesSet.insert(this->nodes[i].getData());
-    this->nodesVector.push_back(this->nodes[i]);
+    this->nodeAt(i).setIndex(i);
   }
 
 }
@@ -32,7 +32,29 @@ template <typename graph_t> Graph<graph_t>::Graph(unsigned int nodesCount_) : no
  * @brief Destructor for the Graph. Releases the memory allocated for nodes.
  */
 template <typename graph_t> Graph<graph_t>::~Graph(void) {
-  delete[] this->nodes;
+  for (unsigned int segment = 0; segment < this->segmentsCount; segment++) {
+    delete[] this->segments[segment];
+    delete[] this->syncSegments[segment];
+  }
+}
+
+/**
+ * @brief Releases the segments of the nodes and allocates a first segment for a number of nodes.
+ * 
+ * @param capacity the number of nodes of the first segment
+ */
+template <typename graph_t> void Graph<graph_t>::resetSegments(const unsigned int capacity) {
+
+  for (unsigned int segment = 0; segment < this->segmentsCount; segment++) {
+    delete[] this->segments[segment];
+    delete[] this->syncSegments[segment];
+  }
+
+  this->segments[0] = new GraphNode<graph_t>[capacity];
+  this->syncSegments[0] = new GraphNodeSync[capacity];
+  this->segmentsEnd[0] = capacity;
+  this->segmentsCount = 1;
+
 }
 
 /**
@@ -42,9 +64,7 @@ template <typename graph_t> Graph<graph_t>::~Graph(void) {
  * @param data Data to assign to the node
  */
 template <typename graph_t> void Graph<graph_t>::setNodeData(unsigned int index, const graph_t& data) {
-  this->nodes[index].setData(data);
-  this->nodesSet.insert(data);
-  this->nodesVector[index].setData(data);
+  this->nodeAt(index).setData(data);
 }
 
 /**
@@ -57,19 +77,48 @@ template <typename graph_t> void Graph<graph_t>::setNodeData(unsigned int index,
 template <typename graph_t> void Graph<graph_t>::setNodesCount(const unsigned int nodesCount) {
 
   this->nodesCount = nodesCount;
-  delete [] this->nodes;
+  this->resetSegments(nodesCount);
 
-  this->nodesSet.clear();
-  this->nodesVector.clear();
-
-  this->nodes = new GraphNode<graph_t>[nodesCount];
   for (unsigned int i = 0; i < nodesCount; i++) {
-    this->nodes[i].setIndex(i);
-    this->nodesVector.push_back(this->nodes[i]);
+    this->nodeAt(i).setIndex(i);
   }
 
 }
 
+/**
+ * @brief Appends a node with the given data and no neighbors. When the allocated segments are full, a new segment
+ * twice the size of the previous one is added (the first one added is at least MIN_SEGMENT_SIZE nodes), and the
+ * existing nodes stay where they are. The nodes count is stored last, so searches that run meanwhile either do not
+ * see the new node or see it complete. Nodes must not be added by several threads at once.
+ * 
+ * @param data Data to assign to the node
+ * @return Index of the new node
+ */
+template <typename graph_t> unsigned int Graph<graph_t>::addNode(const graph_t& data) {
+
+  unsigned int index = this->nodesCount.load(std::memory_order_relaxed);
+  unsigned int capacity = this->segmentsEnd[this->segmentsCount - 1];
+  if (index == capacity) {
+    if (this->segmentsCount == MAX_SEGMENTS) {
+      throw std::length_error("Graph node storage is full");
+    }
+
+    unsigned int size = std::max(this->segmentsEnd[0], MIN_SEGMENT_SIZE) << (this->segmentsCount - 1);
+    this->segments[this->segmentsCount] = new GraphNode<graph_t>[size];
+    this->syncSegments[this->segmentsCount] = new GraphNodeSync[size];
+    this->segmentsEnd[this->segmentsCount] = capacity + size;
+    this->segmentsCount++;
+  }
+
+  GraphNode<graph_t>& node = this->nodeAt(index);
+  node.setIndex(index);
+  node.setData(data);
+
+  this->nodesCount.store(index + 1, std::memory_order_release);
+  return index;
+
+}
+
 /**
  * @brief Retrieves the data from a specific node by its index.
  * 
@@ -77,7 +126,41 @@ template <typename graph_t> void Graph<graph_t>::setNodesCount(const unsigned in
  * @return Data stored in the node
  */
 template <typename graph_t> graph_t Graph<graph_t>::getNodeData(const unsigned int index) const {
-  return this->nodes[index].getData();
+  return this->nodeAt(index).getData();
+}
+
+/**
+ * @brief Collects the data from all nodes in the graph. The set is built on every call, so it should not be used in
+ * hot paths.
+ * 
+ * @return set of data from all nodes
+ */
+template <typename graph_t> std::set<graph_t> Graph<graph_t>::getNodesSet(void) const {
+
+  std::set<graph_t> nodesSet;
+  unsigned int nodesCount = this->getNodesCount();
+  for (unsigned int i = 0; i < nodesCount; i++) {
+    nodesSet.insert(this->nodeAt(i).getData());
+  }
+  return nodesSet;
+
+}
+
+/**
+ * @brief Copies all nodes of the graph. The vector is built on every call, so it should not be used in hot paths.
+ * 
+ * @return vector of all nodes
+ */
+template <typename graph_t> std::vector<GraphNode<graph_t>> Graph<graph_t>::getNodesVector(void) const {
+
+  std::vector<GraphNode<graph_t>> nodesVector;
+  unsigned int nodesCount = this->getNodesCount();
+  nodesVector.reserve(nodesCount);
+  for (unsigned int i = 0; i < nodesCount; i++) {
+    nodesVector.push_back(this->nodeAt(i));
+  }
+  return nodesVector;
+
 }
 
 /**
@@ -88,10 +171,10 @@ template <typename graph_t> graph_t Graph<graph_t>::getNodeData(const unsigned i
  */
 template <typename graph_t> GraphNode<graph_t>* Graph<graph_t>::getNode(const unsigned int index) const {
 
-  if (index >= this->nodesCount) {
+  if (index >= this->getNodesCount()) {
     return nullptr;
   }
-  return &this->nodes[index];
+  return &this->nodeAt(index);
 
 }
 
@@ -104,8 +187,8 @@ template <typename graph_t> GraphNode<graph_t>* Graph<graph_t>::getNode(const un
 template <typename graph_t> GraphNode<graph_t>* Graph<graph_t>::getNodeWithData(const graph_t data) const {
 
   for (unsigned int i = 0; i < this->nodesCount; i++) {
-    if (this->nodes[i].getData() == data) {
-      return &this->nodes[i];
+    if (this->nodeAt(i).getData() == data) {
+      return &this->nodeAt(i);
     }
   }
   return nullptr;
@@ -120,10 +203,10 @@ template <typename graph_t> GraphNode<graph_t>* Graph<graph_t>::getNodeWithData(
  */
 template <typename graph_t> std::vector<graph_t>* Graph<graph_t>::getNodeNeighbors(const unsigned int index) const {
 
-  if (index >= this->nodesCount) {
+  if (index >= this->getNodesCount()) {
     return nullptr;
   }
-  return this->nodes[index].getNeighborsVector();
+  return this->nodeAt(index).getNeighborsVector();
 
 }
 
@@ -170,7 +253,7 @@ template <typename graph_t> bool Graph<graph_t>::connectNodesByIndex(const unsig
     return false;
   }
 
-  this->nodes[index1].addNeighbor(this->nodes[index2].getData());
+  this->nodeAt(index1).addNeighbor(this->nodeAt(index2).getData());
   return true;
 
 }
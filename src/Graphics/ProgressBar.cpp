@@ -1,8 +1,17 @@
 #include "../include/graphics.h"
 #include <locale>
 #include <codecvt>
+#include <cstdio>
 
-bool firstTime = true;
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// Interval at which the ticker of a ProgressReporter renders the progress
+static const std::chrono::milliseconds TICK_INTERVAL(100);
+
+// Serializes the rendering of the progress bars, which share the header and the animation state
+static std::mutex displayMutex;
 
 bool isUtf8Supported() {
   try {
@@ -29,7 +38,10 @@ bool isUtf8Supported() {
 void displayProgressBar(
   const int current, const int total, const std::string& message, const std::chrono::steady_clock::time_point& startTime, const unsigned int barWidth) {
 
+  std::lock_guard<std::mutex> lock(displayMutex);
+
   static bool utf8Supported = isUtf8Supported();
+  static bool firstTime = true;
   static const char loadingSymbols[] = {'-', '\\', '|', '/'};
   static int loadingIndex = 0;
   static int callCounter = 0; // Counter to slow down the animation
@@ -54,7 +66,7 @@ void displayProgressBar(
     firstTime = false;
   }
 
-  float progress = static_cast<float>(current) / total;
+  float progress = total > 0 ? static_cast<float>(current) / total : 1.0f;
   unsigned int position = barWidth * progress;
 
   // Calculate elapsed time
@@ -136,26 +148,75 @@ void displayProgressBar(
 }
 
 /**
- * @brief Function to execute a function with a progress bar.
- * 
- * @param start The starting value of the progress bar.
- * @param end The ending value of the progress bar.
- * @param message The message to display before the progress bar.
- * @param func The function to execute.
- * @param barWidth The width of the progress bar in characters.
+ * @brief Constructor of the ProgressReporter. Starts the ticker if the progress is rendered.
+ *
+ * @param total the number of items of the loop
+ * @param message the message to display before the progress bar
+ * @param visualize whether to render the progress, which is ignored when the standard output is not a terminal
+ * @param barWidth the width of the progress bar in characters
+ */
+ProgressReporter::ProgressReporter(const unsigned int total, const std::string& message, const bool visualize, const unsigned int barWidth)
+  : message(message), total(total), barWidth(barWidth), startTime(std::chrono::steady_clock::now()),
+    enabled(visualize && isTerminal()), current(0), finished(false) {
+
+  if (this->enabled) {
+    this->ticker = std::thread(&ProgressReporter::tick, this);
+  }
+
+}
+
+/**
+ * @brief Destructor of the ProgressReporter. Finishes the reporter if it was not finished yet.
+ */
+ProgressReporter::~ProgressReporter(void) {
+  this->finish();
+}
+
+/**
+ * @brief Main loop of the ticker: renders the progress at every interval until the reporter finishes.
  */
-void withProgress(
-  const unsigned int start, const unsigned int end, const std::string message, std::function<void(int)> func, const unsigned int barWidth) {
+void ProgressReporter::tick(void) {
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (!this->stopCondition.wait_for(lock, TICK_INTERVAL, [this]() { return this->finished; })) {
+    displayProgressBar(this->current.load(std::memory_order_relaxed), this->total, this->message, this->startTime, this->barWidth);
+  }
+
+}
 
-  int total = end - start;
-  auto startTime = std::chrono::steady_clock::now();
+/**
+ * @brief Stops the ticker and renders the final state of the progress, followed by a new line.
+ */
+void ProgressReporter::finish(void) {
 
-  for (unsigned int i = start; i < end; i++) {
-    displayProgressBar(i - start, total, message, startTime, barWidth);
-    func(i);
-    displayProgressBar(i - start + 1, total, message, startTime, barWidth);
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->finished) {
+      return;
+    }
+    this->finished = true;
   }
+  this->stopCondition.notify_all();
 
-  std::cout << std::endl;
+  if (this->enabled) {
+    this->ticker.join();
+    displayProgressBar(this->current.load(std::memory_order_relaxed), this->total, this->message, this->startTime, this->barWidth);
+    std::cout << std::endl;
+  }
+
+}
+
+/**
+ * @brief Returns whether progress bars are rendered at all, which is the case when the standard output is a
+ * terminal.
+ */
+bool ProgressReporter::isTerminal(void) {
+
+#ifndef _WIN32
+  static const bool terminal = isatty(fileno(stdout));
+#else
+  static const bool terminal = true;
+#endif
+  return terminal;
 
 }
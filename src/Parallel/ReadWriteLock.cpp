@@ -0,0 +1,110 @@
+#include "../../include/ReadWriteLock.h"
+
+#include <algorithm>
+
+/**
+ * @brief Takes the lock exclusively, waiting for the current readers and writer to release it. The writer is
+ * counted as waiting meanwhile, which keeps new readers out.
+ */
+void ReadWriteLock::lock(void) {
+
+  std::unique_lock<std::mutex> guard(this->mutex);
+  this->waitingWriters++;
+  this->released.wait(guard, [this]() { return !this->writing && this->readers == 0; });
+  this->waitingWriters--;
+  this->writing = true;
+
+}
+
+/**
+ * @brief Releases the exclusive lock.
+ */
+void ReadWriteLock::unlock(void) {
+
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    this->writing = false;
+  }
+  this->released.notify_all();
+
+}
+
+/**
+ * @brief Takes the lock shared with other readers, waiting while a writer holds it or waits for it.
+ */
+void ReadWriteLock::lock_shared(void) {
+
+  std::unique_lock<std::mutex> guard(this->mutex);
+  this->released.wait(guard, [this]() { return !this->writing && this->waitingWriters == 0; });
+  this->readers++;
+
+}
+
+/**
+ * @brief Releases the shared lock. The last reader wakes up the waiting writers.
+ */
+void ReadWriteLock::unlock_shared(void) {
+
+  bool last;
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    last = --this->readers == 0;
+  }
+  if (last) {
+    this->released.notify_all();
+  }
+
+}
+
+/**
+ * @brief Returns the locks that the calling thread holds through its guards. Threads hold a few locks at most, so
+ * the list is scanned.
+ */
+std::vector<const ReadWriteLock*>& ReentrantLockGuard::getHeldLocks(void) {
+
+  static thread_local std::vector<const ReadWriteLock*> held;
+  return held;
+
+}
+
+/**
+ * @brief Constructor of the ReentrantLockGuard. Takes the lock unless the calling thread already holds it.
+ *
+ * @param lock the lock to take
+ * @param exclusive whether to take the exclusive side rather than the shared one
+ */
+ReentrantLockGuard::ReentrantLockGuard(ReadWriteLock& lock, const bool exclusive) : lock(lock), exclusive(exclusive) {
+
+  std::vector<const ReadWriteLock*>& held = getHeldLocks();
+  this->owner = std::find(held.begin(), held.end(), &lock) == held.end();
+  if (!this->owner) {
+    return;
+  }
+
+  if (exclusive) {
+    this->lock.lock();
+  } else {
+    this->lock.lock_shared();
+  }
+  held.push_back(&lock);
+
+}
+
+/**
+ * @brief Destructor of the ReentrantLockGuard. Releases the lock if this guard took it.
+ */
+ReentrantLockGuard::~ReentrantLockGuard(void) {
+
+  if (!this->owner) {
+    return;
+  }
+
+  std::vector<const ReadWriteLock*>& held = getHeldLocks();
+  held.erase(std::find(held.begin(), held.end(), &this->lock));
+  if (this->exclusive) {
+    this->lock.unlock();
+  } else {
+    this->lock.unlock_shared();
+  }
+
+}
@@ -0,0 +1,227 @@
+#include "../../include/ThreadPool.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Number of chunks every thread gets on average when the chunk size is picked from the size of the range, so that
+// the threads which finish early can take over the chunks of the slower ones
+static const unsigned int CHUNKS_PER_THREAD = 8;
+
+/**
+ * @brief Pins a thread to a single CPU. Does nothing where thread affinity is not supported.
+ *
+ * @param thread the thread to pin, or nullptr for the calling thread
+ * @param cpu the index of the CPU, wrapped around the number of hardware threads
+ */
+static void pinThread(std::thread* thread, const unsigned int cpu) {
+
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &set);
+  pthread_setaffinity_np(thread != nullptr ? thread->native_handle() : pthread_self(), sizeof(set), &set);
+#else
+  (void)thread;
+  (void)cpu;
+#endif
+
+}
+
+/**
+ * @brief Runs chunks of the job until none are left. The first exception thrown by the body is kept for the
+ * caller, and the chunks that were not handed out yet are dropped.
+ */
+void ThreadPool::Job::run(void) {
+
+  for (unsigned int first = this->next.fetch_add(this->chunk); first < this->end; first = this->next.fetch_add(this->chunk)) {
+    try {
+      this->body(first, std::min(this->end, first + this->chunk));
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(this->errorMutex);
+      if (!this->error) {
+        this->error = std::current_exception();
+      }
+      this->next.store(this->end);
+    }
+  }
+
+}
+
+/**
+ * @brief Constructor of the ThreadPool. Starts the workers of the default number of threads.
+ */
+ThreadPool::ThreadPool(void) : threadsCount(1), pinned(false), stopping(false) {
+  this->start(0, false);
+}
+
+/**
+ * @brief Destructor of the ThreadPool. Stops and joins the workers.
+ */
+ThreadPool::~ThreadPool(void) {
+  this->stop();
+}
+
+/**
+ * @brief Returns the pool of the process. It starts with one thread per hardware thread, until it is configured.
+ */
+ThreadPool& ThreadPool::getInstance(void) {
+  static ThreadPool pool;
+  return pool;
+}
+
+/**
+ * @brief Restarts the pool of the process with the given number of threads. It must not be called while a
+ * parallel loop is running.
+ *
+ * @param threads the number of threads, the calling thread included (0 for one per hardware thread)
+ * @param pin whether to pin every thread to its own CPU, which is ignored where affinity is not supported
+ */
+void ThreadPool::configure(const unsigned int threads, const bool pin) {
+
+  ThreadPool& pool = getInstance();
+  pool.stop();
+  pool.start(threads, pin);
+
+}
+
+/**
+ * @brief Starts the workers of the pool. The calling thread counts as the first thread of the pool, since it
+ * always works on the loops it starts.
+ *
+ * @param threads the number of threads, the calling thread included
+ * @param pin whether to pin every thread to its own CPU
+ */
+void ThreadPool::start(const unsigned int threads, const bool pin) {
+
+  this->threadsCount = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+  this->pinned = pin;
+  this->stopping = false;
+
+  if (pin) {
+    pinThread(nullptr, 0);
+  }
+
+  for (unsigned int t = 1; t < this->threadsCount; t++) {
+    this->workers.emplace_back(&ThreadPool::workerLoop, this);
+    if (pin) {
+      pinThread(&this->workers.back(), t);
+    }
+  }
+
+}
+
+/**
+ * @brief Stops and joins the workers of the pool.
+ */
+void ThreadPool::stop(void) {
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->workAvailable.notify_all();
+
+  for (auto& worker : this->workers) {
+    worker.join();
+  }
+  this->workers.clear();
+
+}
+
+/**
+ * @brief Returns the most recent job that still has chunks left and room for another worker, or nullptr. Nested
+ * loops are published after the loop that started them, so the workers help finish them first. Must be called
+ * with the mutex held.
+ */
+ThreadPool::Job* ThreadPool::findJob(void) {
+
+  for (auto it = this->jobs.rbegin(); it != this->jobs.rend(); it++) {
+    if ((*it)->hasWork() && (*it)->helpers < (*it)->maxHelpers) {
+      return *it;
+    }
+  }
+  return nullptr;
+
+}
+
+/**
+ * @brief Main loop of every worker: waits for a job with chunks left and helps run it.
+ */
+void ThreadPool::workerLoop(void) {
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+
+  while (true) {
+    Job* job = nullptr;
+    this->workAvailable.wait(lock, [&]() { return this->stopping || (job = this->findJob()) != nullptr; });
+    if (job == nullptr) {
+      return;
+    }
+
+    // The job stays alive until its helpers are done, since its caller waits for them before returning
+    job->helpers++;
+    lock.unlock();
+    job->run();
+    lock.lock();
+    if (--job->helpers == 0) {
+      this->helpersDone.notify_all();
+    }
+  }
+
+}
+
+/**
+ * @brief Runs a function for every chunk of a range of indexes. The chunks are handed out dynamically, so the
+ * threads that finish early take over the remaining work. Exceptions thrown by the function stop the loop and
+ * are rethrown to the caller.
+ *
+ * @param begin the first index of the range
+ * @param end one past the last index of the range
+ * @param body the function to run for every chunk, with the first index and one past the last index of the chunk
+ * @param maxThreads the maximum number of threads that run the loop, the calling thread included (0 for all)
+ * @param chunk the number of indexes of every chunk (0 to pick it from the size of the range)
+ */
+void ThreadPool::parallelForChunks(
+  const unsigned int begin, const unsigned int end, const std::function<void(unsigned int, unsigned int)>& body,
+  const unsigned int maxThreads, unsigned int chunk) {
+
+  if (end <= begin) {
+    return;
+  }
+
+  unsigned int threads = maxThreads == 0 ? this->threadsCount : std::min(maxThreads, this->threadsCount);
+  if (chunk == 0) {
+    chunk = std::max(1u, (end - begin) / (threads * CHUNKS_PER_THREAD));
+  }
+  threads = std::min(threads, (end - begin + chunk - 1) / chunk);
+
+  if (threads <= 1) {
+    body(begin, end);
+    return;
+  }
+
+  Job job(body, begin, end, chunk, threads - 1);
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->jobs.push_back(&job);
+  }
+  this->workAvailable.notify_all();
+
+  job.run();
+
+  // All the chunks are handed out, so the job is withdrawn and only the chunks of its helpers are left
+  {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->jobs.erase(std::find(this->jobs.begin(), this->jobs.end(), &job));
+    this->helpersDone.wait(lock, [&]() { return job.helpers == 0; });
+  }
+
+  if (job.error) {
+    std::rethrow_exception(job.error);
+  }
+
+}
@@ -0,0 +1,538 @@
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../../include/QueryServer.h"
+#include "../../include/ThreadPool.h"
+
+static const size_t REQUEST_HEADER_SIZE = 8 * sizeof(uint32_t);
+static const size_t RESPONSE_HEADER_SIZE = 3 * sizeof(uint32_t);
+static const size_t RESULT_SIZE = sizeof(uint32_t) + sizeof(float);
+static const uint32_t MAX_DIMENSION = 1 << 20;   // Larger dimensions are taken for a corrupted stream
+static const size_t READ_SIZE = 1 << 16;
+
+static const int BUCKETS_PER_DECADE = 100;
+static const int MIN_DECADE = -6;                 // One microsecond
+static const int DECADES = 9;                     // Up to 1000 seconds
+
+/**
+ * @brief Returns the seconds on a monotonic clock.
+ */
+static double now(void) {
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+}
+
+/**
+ * @brief Appends the bytes of a value to a buffer.
+ */
+template <typename value_t> static void put(std::string& bytes, const value_t value) {
+
+  bytes.append(reinterpret_cast<const char*>(&value), sizeof(value_t));
+
+}
+
+/**
+ * @brief Reads a value from a buffer and moves past it.
+ */
+template <typename value_t> static value_t get(const char*& bytes) {
+
+  value_t value;
+  std::memcpy(&value, bytes, sizeof(value_t));
+  bytes += sizeof(value_t);
+  return value;
+
+}
+
+/**
+ * @brief Writes a whole buffer to a file descriptor, retrying on interrupted and partial writes.
+ *
+ * @return true if every byte was written, false if the descriptor failed
+ */
+static bool writeAll(const int fd, const std::string& bytes) {
+
+  size_t written = 0;
+  while (written < bytes.size()) {
+    ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    written += n;
+  }
+  return true;
+
+}
+
+bool decodeQueryRequest(const char* bytes, const size_t size, QueryRequest& request, size_t& consumed) {
+
+  consumed = 0;
+  if (size < REQUEST_HEADER_SIZE) {
+    return true;
+  }
+
+  const char* p = bytes;
+  request.id = get<uint32_t>(p);
+  request.k = get<uint32_t>(p);
+  request.L = get<uint32_t>(p);
+  request.queryType = get<uint32_t>(p);
+  request.v = get<float>(p);
+  request.l = get<float>(p);
+  request.r = get<float>(p);
+  uint32_t dimension = get<uint32_t>(p);
+
+  if (dimension > MAX_DIMENSION) {
+    return false;
+  }
+  size_t total = REQUEST_HEADER_SIZE + (size_t)dimension * sizeof(float);
+  if (size < total) {
+    return true;
+  }
+
+  request.vector.resize(dimension);
+  if (dimension > 0) {
+    std::memcpy(request.vector.data(), p, dimension * sizeof(float));
+  }
+  consumed = total;
+  return true;
+
+}
+
+std::string encodeQueryRequest(const QueryRequest& request) {
+
+  std::string bytes;
+  bytes.reserve(REQUEST_HEADER_SIZE + request.vector.size() * sizeof(float));
+  put(bytes, request.id);
+  put(bytes, request.k);
+  put(bytes, request.L);
+  put(bytes, request.queryType);
+  put(bytes, request.v);
+  put(bytes, request.l);
+  put(bytes, request.r);
+  put(bytes, (uint32_t)request.vector.size());
+  for (float value : request.vector) {
+    put(bytes, value);
+  }
+  return bytes;
+
+}
+
+std::string encodeQueryResponse(const uint32_t id, const QUERY_STATUS status, const std::vector<QueryResult>& results) {
+
+  std::string bytes;
+  bytes.reserve(RESPONSE_HEADER_SIZE + results.size() * RESULT_SIZE);
+  put(bytes, id);
+  put(bytes, (uint32_t)status);
+  put(bytes, (uint32_t)results.size());
+  for (const QueryResult& result : results) {
+    put(bytes, result.index);
+    put(bytes, result.distance);
+  }
+  return bytes;
+
+}
+
+size_t decodeQueryResponse(const char* bytes, const size_t size, uint32_t& id, QUERY_STATUS& status, std::vector<QueryResult>& results) {
+
+  if (size < RESPONSE_HEADER_SIZE) {
+    return 0;
+  }
+
+  const char* p = bytes;
+  id = get<uint32_t>(p);
+  status = (QUERY_STATUS)get<uint32_t>(p);
+  uint32_t count = get<uint32_t>(p);
+  size_t total = RESPONSE_HEADER_SIZE + (size_t)count * RESULT_SIZE;
+  if (size < total) {
+    return 0;
+  }
+
+  results.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    results[i].index = get<uint32_t>(p);
+    results[i].distance = get<float>(p);
+  }
+  return total;
+
+}
+
+LatencyHistogram::LatencyHistogram(void) : buckets(DECADES * BUCKETS_PER_DECADE, 0), count(0) {}
+
+/**
+ * @brief Records a latency in the bucket of its logarithm. Latencies outside the range of the histogram fall into
+ * its first or its last bucket.
+ *
+ * @param seconds the latency in seconds
+ */
+void LatencyHistogram::record(const double seconds) {
+
+  int bucket = seconds <= 0.0 ? 0 : (int)std::floor((std::log10(seconds) - MIN_DECADE) * BUCKETS_PER_DECADE);
+  bucket = std::min(std::max(bucket, 0), (int)this->buckets.size() - 1);
+  this->buckets[bucket]++;
+  this->count++;
+
+}
+
+/**
+ * @brief Returns a percentile of the recorded latencies, as the upper bound of the bucket that holds it.
+ *
+ * @param percentile the percentile, between 0 and 100
+ * @return the latency in seconds, or 0 if nothing was recorded
+ */
+double LatencyHistogram::getPercentile(const double percentile) const {
+
+  if (this->count == 0) {
+    return 0.0;
+  }
+
+  unsigned long long rank = (unsigned long long)std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100.0 * this->count);
+  rank = std::max(rank, 1ULL);
+  unsigned long long seen = 0;
+  unsigned int bucket = 0;
+  for (; bucket < this->buckets.size() - 1; bucket++) {
+    seen += this->buckets[bucket];
+    if (seen >= rank) {
+      break;
+    }
+  }
+  return std::pow(10.0, (double)(bucket + 1) / BUCKETS_PER_DECADE + MIN_DECADE);
+
+}
+
+void LatencyHistogram::clear(void) {
+
+  std::fill(this->buckets.begin(), this->buckets.end(), 0);
+  this->count = 0;
+
+}
+
+QueryServer::QueryServer(const Executor& executor, const unsigned int batchSize, const double reportInterval)
+  : executor(executor), batchSize(std::max(1u, batchSize)), reportInterval(reportInterval), stopping(false),
+    startTime(0.0), windowStart(0.0), batches(0) {
+
+  // Stopping writes to a pipe that the loop polls, so that a signal handler can wake the server up
+  if (pipe(this->stopPipe) != 0) {
+    this->stopPipe[0] = this->stopPipe[1] = -1;
+    std::cerr << "Error: Could not create the stop pipe of the query server: " << std::strerror(errno) << std::endl;
+    return;
+  }
+  fcntl(this->stopPipe[1], F_SETFL, O_NONBLOCK);
+
+}
+
+QueryServer::~QueryServer(void) {
+
+  if (this->stopPipe[0] >= 0) {
+    close(this->stopPipe[0]);
+    close(this->stopPipe[1]);
+  }
+
+}
+
+/**
+ * @brief Stops the server after the current batch. Only an atomic store and a write are made, so that it is safe to
+ * call from signal handlers.
+ */
+void QueryServer::stop(void) {
+
+  this->stopping = true;
+  if (this->stopPipe[1] >= 0) {
+    char byte = 0;
+    ssize_t ignored = write(this->stopPipe[1], &byte, 1);
+    (void)ignored;
+  }
+
+}
+
+/**
+ * @brief Moves the whole requests of the buffer of a connection to the current batch, as long as it has room. A
+ * malformed request ends the input of the connection, since the rest of its stream cannot be framed any more.
+ *
+ * @param connection the index of the connection
+ */
+void QueryServer::parseRequests(const unsigned int connection) {
+
+  Connection& c = this->connections[connection];
+  size_t offset = 0;
+  while (this->pending.size() < this->batchSize) {
+    PendingQuery query;
+    size_t consumed;
+    if (!decodeQueryRequest(c.buffer.data() + offset, c.buffer.size() - offset, query.request, consumed)) {
+      std::cerr << "Error: Malformed query request, closing the connection" << std::endl;
+      c.closed = true;
+      c.buffer.clear();
+      return;
+    }
+    if (consumed == 0) {
+      break;
+    }
+    offset += consumed;
+    query.connection = connection;
+    query.received = now();
+    this->pending.push_back(std::move(query));
+  }
+  c.buffer.erase(0, offset);
+
+}
+
+/**
+ * @brief Executes the current batch on the thread pool, one query per task, and writes the responses in the order
+ * the requests were read. A query whose executor throws gets a failed response, and a connection whose output fails
+ * is closed without affecting the others.
+ */
+void QueryServer::runBatch(void) {
+
+  if (this->pending.empty()) {
+    return;
+  }
+
+  std::vector<std::string> responses(this->pending.size());
+  ThreadPool::getInstance().parallelFor(0, this->pending.size(), [&](unsigned int i) {
+    const QueryRequest& request = this->pending[i].request;
+    try {
+      responses[i] = encodeQueryResponse(request.id, QUERY_OK, this->executor(request));
+    } catch (...) {
+      responses[i] = encodeQueryResponse(request.id, QUERY_FAILED, std::vector<QueryResult>());
+    }
+  }, 0, 1);
+
+  for (unsigned int i = 0; i < this->pending.size(); i++) {
+    Connection& c = this->connections[this->pending[i].connection];
+    if (c.outputFd < 0) {
+      continue;
+    }
+    if (!writeAll(c.outputFd, responses[i])) {
+      c.closed = true;
+      if (c.owned) {
+        close(c.outputFd);
+      }
+      c.outputFd = -1;
+      continue;
+    }
+    double latency = now() - this->pending[i].received;
+    this->windowLatencies.record(latency);
+    this->totalLatencies.record(latency);
+  }
+  this->pending.clear();
+  this->batches++;
+
+}
+
+/**
+ * @brief Prints the number of queries, the throughput and the p50 and p99 latency since the last report to the
+ * standard error, so that they do not mix with the responses when the server answers on the standard output.
+ *
+ * @param final whether the server is stopping, in which case the totals are printed as well
+ */
+void QueryServer::report(const bool final) {
+
+  double current = now();
+  double elapsed = std::max(current - this->windowStart, 1e-9);
+  if (this->windowLatencies.getCount() > 0) {
+    std::cerr << std::fixed << std::setprecision(3) << "Served " << this->windowLatencies.getCount() << " queries | "
+              << "QPS: " << this->windowLatencies.getCount() / elapsed << " | "
+              << "p50: " << this->windowLatencies.getPercentile(50) * 1000 << " ms | "
+              << "p99: " << this->windowLatencies.getPercentile(99) * 1000 << " ms" << std::endl;
+  }
+  if (final) {
+    double total = std::max(current - this->startTime, 1e-9);
+    std::cerr << std::fixed << std::setprecision(3) << "Total: " << this->totalLatencies.getCount() << " queries in "
+              << this->batches << " batches | "
+              << "QPS: " << this->totalLatencies.getCount() / total << " | "
+              << "p50: " << this->totalLatencies.getPercentile(50) * 1000 << " ms | "
+              << "p99: " << this->totalLatencies.getPercentile(99) * 1000 << " ms" << std::endl;
+  }
+  this->windowLatencies.clear();
+  this->windowStart = current;
+
+}
+
+/**
+ * @brief Serves the connections until the server is stopped or, without a listening socket, until every connection
+ * is closed. Each round reads what is ready without waiting while the batch has room, and runs the batch once a
+ * round brings nothing new or the batch is full. The loop only blocks while no query is pending.
+ *
+ * @param listenFd the listening socket, or -1
+ */
+void QueryServer::run(const int listenFd) {
+
+  this->startTime = this->windowStart = now();
+  this->totalLatencies.clear();
+  this->windowLatencies.clear();
+  this->batches = 0;
+  std::vector<char> chunk(READ_SIZE);
+
+  while (!this->stopping) {
+
+    // Requests left over from a full batch are taken before reading more
+    for (unsigned int i = 0; i < this->connections.size(); i++) {
+      this->parseRequests(i);
+    }
+    if (this->pending.size() >= this->batchSize) {
+      this->runBatch();
+      continue;
+    }
+
+    // Closed connections are dropped only between batches, since pending queries refer to them by position
+    if (this->pending.empty()) {
+      for (auto it = this->connections.begin(); it != this->connections.end();) {
+        if (!it->closed) {
+          ++it;
+          continue;
+        }
+        if (it->owned) {
+          close(it->inputFd);
+          if (it->outputFd >= 0 && it->outputFd != it->inputFd) {
+            close(it->outputFd);
+          }
+        }
+        it = this->connections.erase(it);
+      }
+      if (listenFd < 0 && this->connections.empty()) {
+        break;
+      }
+    }
+
+    std::vector<struct pollfd> fds;
+    fds.push_back({this->stopPipe[0], POLLIN, 0});
+    if (listenFd >= 0) {
+      fds.push_back({listenFd, POLLIN, 0});
+    }
+    size_t firstConnection = fds.size();
+    for (const Connection& c : this->connections) {
+      fds.push_back({c.closed ? -1 : c.inputFd, POLLIN, 0});
+    }
+
+    int timeout = 1000;
+    if (!this->pending.empty()) {
+      timeout = 0;
+    } else if (this->reportInterval > 0) {
+      double untilReport = this->windowStart + this->reportInterval - now();
+      timeout = std::max(0, std::min(timeout, (int)(untilReport * 1000)));
+    }
+
+    int ready = poll(fds.data(), fds.size(), timeout);
+    if (ready < 0 && errno != EINTR) {
+      std::cerr << "Error: poll failed in the query server: " << std::strerror(errno) << std::endl;
+      break;
+    }
+
+    bool received = false;
+    if (ready > 0) {
+      if (listenFd >= 0 && (fds[1].revents & POLLIN)) {
+        int client = accept(listenFd, nullptr, nullptr);
+        if (client >= 0) {
+          this->connections.push_back({client, client, std::string(), false, true});
+        }
+      }
+      for (size_t i = firstConnection; i < fds.size(); i++) {
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+          continue;
+        }
+        Connection& c = this->connections[i - firstConnection];
+        ssize_t n = read(c.inputFd, chunk.data(), chunk.size());
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          c.closed = true;
+          continue;
+        }
+        c.buffer.append(chunk.data(), n);
+        received = true;
+        this->parseRequests(i - firstConnection);
+      }
+    }
+
+    if (!this->pending.empty() && !received) {
+      this->runBatch();
+      if (this->idle) {
+        this->idle();
+      }
+    } else if (ready == 0 && this->pending.empty() && this->idle) {
+      this->idle();
+    }
+
+    if (this->reportInterval > 0 && now() - this->windowStart >= this->reportInterval) {
+      this->report(false);
+    }
+
+  }
+
+  // The queries that were read before stopping are still answered
+  this->runBatch();
+  for (const Connection& c : this->connections) {
+    if (c.owned) {
+      close(c.inputFd);
+      if (c.outputFd >= 0 && c.outputFd != c.inputFd) {
+        close(c.outputFd);
+      }
+    }
+  }
+  this->connections.clear();
+  this->report(true);
+
+}
+
+/**
+ * @brief Serves a single client over a pair of file descriptors, until the input reaches its end or the server is
+ * stopped. The descriptors are left open.
+ *
+ * @param inputFd the descriptor the requests are read from
+ * @param outputFd the descriptor the responses are written to
+ */
+void QueryServer::serve(const int inputFd, const int outputFd) {
+
+  this->connections.push_back({inputFd, outputFd, std::string(), false, false});
+  this->run(-1);
+
+}
+
+/**
+ * @brief Serves the clients of a Unix domain socket until stop is called. Every client may send any number of
+ * requests over its connection and gets its responses in the same order.
+ *
+ * @param path the path of the socket, which is replaced if it exists and removed when the server stops
+ * @return false if the socket could not be created, true otherwise
+ */
+bool QueryServer::serveSocket(const std::string& path) {
+
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Error: The socket path " << path << " is too long" << std::endl;
+    return false;
+  }
+  std::strcpy(address.sun_path, path.c_str());
+
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    std::cerr << "Error: Could not create the socket: " << std::strerror(errno) << std::endl;
+    return false;
+  }
+  unlink(path.c_str());
+  if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+    std::cerr << "Error: Could not listen on the socket " << path << ": " << std::strerror(errno) << std::endl;
+    close(listenFd);
+    return false;
+  }
+
+  this->run(listenFd);
+  close(listenFd);
+  unlink(path.c_str());
+  return true;
+
+}
@@ -2,8 +2,25 @@
 #include "../../../include/GreedySearch.h"
 #include "../../../include/RobustPrune.h"
 #include "../../../include/Filter.h"
+#include "../../../include/ThreadPool.h"
 #include <map>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
 
+// Tags of the label index and start nodes sections in graph-only index files ("LBLS" and "STRT" when read as bytes)
+static const uint32_t LABEL_INDEX_SECTION = 0x534c424c;
+static const uint32_t START_NODES_SECTION = 0x54525453;
+
+// Tag of the start node caches of the labels in graph-only index files ("LSTC" when read as bytes)
+static const uint32_t LABEL_START_CACHES_SECTION = 0x4354534c;
+
+// Tag of the start nodes block in text index files
+static const char START_NODES_TAG[] = "STRT";
+
+// Inserted points wait in a side run of the timestamp index until it holds this many points, or the square root
+// of the points of the main run if that is larger, and then both runs are merged
+static const unsigned int MIN_RECENT_TIMESTAMPS = 1024;
 
 /**
  * @brief Generates a random permutation of integers in a specified range. This function creates a vector 
@@ -56,19 +73,431 @@ template <typename vamana_t>
 std::vector<GraphNode<vamana_t>> 
 FilteredVamanaIndex<vamana_t>::getNodesWithCategoricalValueFilter(const CategoricalAttributeFilter& filter) {
 
+  // Copy only the nodes of the posting list of the label, instead of every node of the graph
+  const std::vector<unsigned int>& points = this->getNodesWithLabel(filter);
   std::vector<GraphNode<vamana_t>> filteredNodes;
-  std::vector<GraphNode<vamana_t>> graphNodes = this->getNodes();
+  filteredNodes.reserve(points.size());
 
-  for (auto node : graphNodes) {
-    if (node.getData().getC() == filter.getC()) {
-      filteredNodes.push_back(node);
-    }
+  for (auto i : points) {
+    filteredNodes.push_back(*this->G.getNode(i));
   }
 
   return filteredNodes;
 
 }
 
+/**
+ * @brief Builds the sorted-by-T index of the points, which is used to enumerate the points that satisfy a
+ * timestamp range filter without scanning the whole dataset.
+ */
+template <typename vamana_t>
+void FilteredVamanaIndex<vamana_t>::buildTimestampIndex(void) {
+
+  unsigned int n = this->P.size();
+  this->timestampOrder.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    this->timestampOrder[i] = i;
+  }
+
+  std::sort(this->timestampOrder.begin(), this->timestampOrder.end(), [this](unsigned int a, unsigned int b) {
+    return this->P[a].getT() < this->P[b].getT();
+  });
+
+  this->sortedTimestamps.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    this->sortedTimestamps[i] = this->P[this->timestampOrder[i]].getT();
+  }
+
+  this->recentOrder.clear();
+  this->recentTimestamps.clear();
+
+}
+
+/**
+ * @brief Merges the side run of the timestamp index into its main run. Points with the same timestamp keep the
+ * points of the main run first, so the order is the order in which the points were added.
+ */
+template <typename vamana_t>
+void FilteredVamanaIndex<vamana_t>::mergeRecentTimestamps(void) {
+
+  unsigned int n = this->sortedTimestamps.size(), m = this->recentTimestamps.size();
+  std::vector<unsigned int> order(n + m);
+  std::vector<float> timestamps(n + m);
+
+  unsigned int i = 0, j = 0;
+  for (unsigned int position = 0; position < n + m; position++) {
+    if (j == m || (i < n && this->sortedTimestamps[i] <= this->recentTimestamps[j])) {
+      order[position] = this->timestampOrder[i];
+      timestamps[position] = this->sortedTimestamps[i++];
+    } else {
+      order[position] = this->recentOrder[j];
+      timestamps[position] = this->recentTimestamps[j++];
+    }
+  }
+
+  this->timestampOrder.swap(order);
+  this->sortedTimestamps.swap(timestamps);
+  this->recentOrder.clear();
+  this->recentTimestamps.clear();
+
+}
+
+/**
+ * @brief Builds the label index of the points: the posting list of every categorical label, and a bitmap for
+ * every dense label. The labels of a point are its label set if one was given with setLabelSets, otherwise its
+ * categorical attribute C. The filters of the index become the labels the points carry, and the sizes of the
+ * lists are the label cardinalities used by the query planner.
+ */
+template <typename vamana_t>
+void FilteredVamanaIndex<vamana_t>::buildLabelIndex(void) {
+
+  if (!this->labelSets.empty() && this->labelSets.size() == this->P.size()) {
+    this->labels.build(this->labelSets);
+  } else {
+    std::vector<unsigned int> pointLabels(this->P.size());
+    for (unsigned int i = 0; i < this->P.size(); i++) {
+      pointLabels[i] = this->P[i].getC();
+    }
+    this->labels.build(pointLabels);
+  }
+
+  this->F.clear();
+  for (auto label : this->labels.getLabels()) {
+    this->F.insert(CategoricalAttributeFilter(label));
+  }
+
+}
+
+/**
+ * @brief Returns the label index, the start nodes and the start node caches of the labels as sections of
+ * graph-only index files, so that they are not rebuilt on loading.
+ * 
+ * @return the sections of the index
+ */
+template <typename vamana_t>
+std::vector<GraphFileSection> FilteredVamanaIndex<vamana_t>::getGraphFileSections(void) const {
+
+  std::ostringstream labelsOut, startsOut;
+  this->labels.save(labelsOut);
+
+  uint32_t startNodesCount = this->labelStartNodes.size();
+  startsOut.write(reinterpret_cast<const char*>(&startNodesCount), sizeof(startNodesCount));
+  for (uint32_t startNode : this->labelStartNodes) {
+    startsOut.write(reinterpret_cast<const char*>(&startNode), sizeof(startNode));
+  }
+
+  std::vector<GraphFileSection> sections = {
+    GraphFileSection{LABEL_INDEX_SECTION, labelsOut.str()}, GraphFileSection{START_NODES_SECTION, startsOut.str()}
+  };
+
+  // The caches of the labels follow the order of the label index, which the file stores as well
+  if (!this->labelStartCaches.empty()) {
+    std::ostringstream cachesOut;
+    uint32_t cachesCount = this->labelStartCaches.size();
+    cachesOut.write(reinterpret_cast<const char*>(&cachesCount), sizeof(cachesCount));
+    for (const auto& cache : this->labelStartCaches) {
+      this->writeStartNodes(cachesOut, cache);
+    }
+    sections.push_back(GraphFileSection{LABEL_START_CACHES_SECTION, cachesOut.str()});
+  }
+
+  return sections;
+
+}
+
+/**
+ * @brief Loads the label index, the start nodes or the start node caches of the labels from their sections of a
+ * graph-only index file.
+ * 
+ * @param section the section that was read
+ * 
+ * @return true if the section was recognized and loaded, false otherwise
+ */
+template <typename vamana_t>
+bool FilteredVamanaIndex<vamana_t>::loadGraphFileSection(const GraphFileSection& section) {
+
+  std::istringstream in(section.bytes);
+
+  if (section.tag == LABEL_INDEX_SECTION) {
+    return this->labels.load(in);
+  }
+
+  if (section.tag == START_NODES_SECTION) {
+    uint32_t startNodesCount = 0;
+    in.read(reinterpret_cast<char*>(&startNodesCount), sizeof(startNodesCount));
+    if (!in || section.bytes.size() != sizeof(uint32_t) * (1 + (uint64_t)startNodesCount)) {
+      return false;
+    }
+    this->labelStartNodes.resize(startNodesCount);
+    in.read(reinterpret_cast<char*>(this->labelStartNodes.data()), startNodesCount * sizeof(uint32_t));
+    return true;
+  }
+
+  if (section.tag == LABEL_START_CACHES_SECTION) {
+    uint32_t cachesCount = 0;
+    in.read(reinterpret_cast<char*>(&cachesCount), sizeof(cachesCount));
+    if (!in || cachesCount > this->P.size()) {
+      return false;
+    }
+    std::vector<StartNodeCache> caches(cachesCount);
+    for (auto& cache : caches) {
+      if (!this->readStartNodes(in, cache)) {
+        return false;
+      }
+    }
+    this->labelStartCaches = std::move(caches);
+    return true;
+  }
+
+  return false;
+
+}
+
+/**
+ * @brief Writes the start nodes of the labels as a block of text index files: the tag and the number of labels,
+ * followed by the value and the start node of every label.
+ */
+template <typename vamana_t>
+void FilteredVamanaIndex<vamana_t>::saveGraphTextBlocks(std::ostream& out) const {
+
+  const std::vector<unsigned int>& labels = this->labels.getLabels();
+  if (this->labelStartNodes.size() != labels.size()) {
+    return;
+  }
+
+  out << START_NODES_TAG << " " << labels.size() << std::endl;
+  for (unsigned int slot = 0; slot < labels.size(); slot++) {
+    out << labels[slot] << " " << this->labelStartNodes[slot] << " ";
+  }
+  out << std::endl;
+
+}
+
+/**
+ * @brief Reads the start nodes of the labels from their block of a text index file. Text files do not store the
+ * label index, so it is built from the loaded points before the labels of the block are looked up.
+ */
+template <typename vamana_t>
+bool FilteredVamanaIndex<vamana_t>::loadGraphTextBlock(const std::string& tag, std::istream& in) {
+
+  if (tag != START_NODES_TAG) {
+    return false;
+  }
+
+  if (this->labels.getPointsCount() != this->P.size()) {
+    this->buildLabelIndex();
+  }
+
+  unsigned int count = 0;
+  in >> count;
+  if (!in || count != this->labels.getLabels().size()) {
+    in.setstate(std::ios::failbit);
+    return true;
+  }
+
+  std::vector<unsigned int> startNodes(count, VamanaIndex<vamana_t>::NO_POINT);
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int label = 0, startNode = 0;
+    in >> label >> startNode;
+    unsigned int slot = this->labels.findLabel(label);
+    if (!in || slot == LabelIndex::NO_LABEL || startNode >= this->P.size()) {
+      in.setstate(std::ios::failbit);
+      return true;
+    }
+    startNodes[slot] = startNode;
+  }
+  this->labelStartNodes = std::move(startNodes);
+  return true;
+
+}
+
+/**
+ * @brief Get the indexes of the points that carry a categorical label.
+ * 
+ * @param filter The CategoricalAttributeFilter of the label.
+ * @return The posting list of the label, empty if no point carries it.
+ */
+template <typename vamana_t>
+const std::vector<unsigned int>& FilteredVamanaIndex<vamana_t>::getNodesWithLabel(const CategoricalAttributeFilter& filter) const {
+
+  return this->labels.getPoints(this->labels.findLabel(filter.getC()));
+
+}
+
+/**
+ * @brief Get the start nodes of a query: the start node of every label of the query, looked up by slot, or the
+ * global medoid for a query without labels. Labels that no point carries are skipped, so the search can fall
+ * back to the posting lists.
+ * 
+ * @param queryFilters The categorical filters of the query.
+ * @return The start nodes of the traversal, which are as many as the labels of the query at most.
+ */
+template <typename vamana_t>
+std::vector<GraphNode<vamana_t>> FilteredVamanaIndex<vamana_t>::getQueryStartNodes(const std::vector<CategoricalAttributeFilter>& queryFilters) const {
+
+  ReentrantLockGuard updateLock(this->updateLock);
+  std::vector<GraphNode<vamana_t>> S;
+
+  // The start nodes are copied without their neighbors, which insertions may change meanwhile
+  if (queryFilters.empty()) {
+    if (this->medoid < this->G.getNodesCount()) {
+      S.push_back(GraphNode<vamana_t>(this->G.getNode(this->medoid)->getData()));
+    }
+    return S;
+  }
+
+  ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+  for (const auto& filter : queryFilters) {
+    unsigned int startNode = this->getStartNode(filter);
+    if (startNode < this->G.getNodesCount()) {
+      S.push_back(GraphNode<vamana_t>(this->G.getNode(startNode)->getData()));
+    }
+  }
+
+  return S;
+
+}
+
+/**
+ * @brief Get the start nodes of a query, choosing them by the query vector: for every label of the query the
+ * cached start node of the label nearest to the query, or the start node of the label if the index has no start
+ * node cache, and for a query without labels the start node that findSearchStart finds.
+ * 
+ * @param queryFilters The categorical filters of the query.
+ * @param xq The query vector.
+ * @return The start nodes of the traversal, which are as many as the labels of the query at most.
+ */
+template <typename vamana_t>
+std::vector<GraphNode<vamana_t>> FilteredVamanaIndex<vamana_t>::getQueryStartNodes(
+  const std::vector<CategoricalAttributeFilter>& queryFilters, const DataVector<float>& xq) const {
+
+  ReentrantLockGuard updateLock(this->updateLock);
+  std::vector<GraphNode<vamana_t>> S;
+
+  if (queryFilters.empty()) {
+    unsigned int startNode = this->findSearchStart(xq);
+    if (startNode < this->G.getNodesCount()) {
+      S.push_back(GraphNode<vamana_t>(this->G.getNode(startNode)->getData()));
+    }
+    return S;
+  }
+
+  ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+  for (const auto& filter : queryFilters) {
+    unsigned int slot = this->labels.findLabel(filter.getC());
+    if (slot >= this->labelStartNodes.size()) {
+      continue;
+    }
+    unsigned int startNode = slot < this->labelStartCaches.size() ? this->findNearestStartNode(this->labelStartCaches[slot], xq) : VamanaIndex<vamana_t>::NO_POINT;
+    if (startNode == VamanaIndex<vamana_t>::NO_POINT) {
+      startNode = this->labelStartNodes[slot];
+    }
+    if (startNode < this->G.getNodesCount()) {
+      S.push_back(GraphNode<vamana_t>(this->G.getNode(startNode)->getData()));
+    }
+  }
+
+  return S;
+
+}
+
+/**
+ * @brief Builds the start node cache of the index, and a start node cache for every label: K diverse points
+ * that carry the label, chosen with k-means++ seeding starting from the start node of the label. The labels are
+ * seeded in parallel, each one on a single thread.
+ * 
+ * @param K the number of start nodes of the index and of every label
+ * @param threads the number of threads of the pool that build the caches
+ * 
+ * @return the number of start nodes of the index
+ */
+template <typename vamana_t>
+unsigned int FilteredVamanaIndex<vamana_t>::buildStartNodeCache(const unsigned int K, const unsigned int threads) {
+
+  unsigned int count = VamanaIndex<vamana_t>::buildStartNodeCache(K, threads);
+
+  std::vector<StartNodeCache> caches(this->labelStartNodes.size());
+  ThreadPool::getInstance().parallelFor(0, caches.size(), [&](unsigned int slot) {
+    std::vector<unsigned int> points;
+    for (unsigned int point : this->labels.getPoints(slot)) {
+      if (!this->isDeleted(point)) {
+        points.push_back(point);
+      }
+    }
+    unsigned int first = this->labelStartNodes[slot];
+    if (points.empty() || this->isDeleted(first)) {
+      return;
+    }
+    std::mt19937 generator(std::random_device{}());
+    caches[slot] = this->seedStartNodes(points, first, K, generator, 1);
+  }, std::max(1u, threads), 1);
+
+  this->labelStartCaches = std::move(caches);
+  return count;
+
+}
+
+/**
+ * @brief Drops the start node caches of the index and of the labels.
+ */
+template <typename vamana_t>
+void FilteredVamanaIndex<vamana_t>::clearStartNodeCache(void) {
+
+  VamanaIndex<vamana_t>::clearStartNodeCache();
+  this->labelStartCaches.clear();
+
+}
+
+/**
+ * @brief Get the indexes of the points whose timestamp lies inside a range. The points are found with a binary
+ * search on the sorted-by-T index, so the cost depends only on the number of points in the range.
+ * 
+ * @param range The TimestampRangeFilter the points must satisfy.
+ * @return The indexes of the matching points, in ascending timestamp order.
+ */
+template <typename vamana_t>
+std::vector<unsigned int> FilteredVamanaIndex<vamana_t>::getNodesInTimestampRange(const TimestampRangeFilter& range) const {
+
+  ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+  auto first = std::lower_bound(this->sortedTimestamps.begin(), this->sortedTimestamps.end(), range.getL());
+  auto last = std::upper_bound(first, this->sortedTimestamps.end(), range.getR());
+  auto recentFirst = std::lower_bound(this->recentTimestamps.begin(), this->recentTimestamps.end(), range.getL());
+  auto recentLast = std::upper_bound(recentFirst, this->recentTimestamps.end(), range.getR());
+
+  // Merge the matching points of both runs of the index, which are each sorted by timestamp
+  std::vector<unsigned int> nodes;
+  nodes.reserve((last - first) + (recentLast - recentFirst));
+  while (first != last || recentFirst != recentLast) {
+    if (recentFirst == recentLast || (first != last && *first <= *recentFirst)) {
+      nodes.push_back(this->timestampOrder[first++ - this->sortedTimestamps.begin()]);
+    } else {
+      nodes.push_back(this->recentOrder[recentFirst++ - this->recentTimestamps.begin()]);
+    }
+  }
+
+  return nodes;
+
+}
+
+/**
+ * @brief Count the points whose timestamp lies inside a range.
+ * 
+ * @param range The TimestampRangeFilter the points must satisfy.
+ * @return The number of matching points.
+ */
+template <typename vamana_t>
+unsigned int FilteredVamanaIndex<vamana_t>::countNodesInTimestampRange(const TimestampRangeFilter& range) const {
+
+  ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+  auto first = std::lower_bound(this->sortedTimestamps.begin(), this->sortedTimestamps.end(), range.getL());
+  auto last = std::upper_bound(first, this->sortedTimestamps.end(), range.getR());
+  auto recentFirst = std::lower_bound(this->recentTimestamps.begin(), this->recentTimestamps.end(), range.getL());
+  auto recentLast = std::upper_bound(recentFirst, this->recentTimestamps.end(), range.getR());
+
+  return (last - first) + (recentLast - recentFirst);
+
+}
+
 /**
  * @brief Create the graph with the given parameters.
  * 
@@ -76,11 +505,12 @@ FilteredVamanaIndex<vamana_t>::getNodesWithCategoricalValueFilter(const Categori
  * @param alpha A float parameter.
  * @param L An unsigned int parameter.
  * @param R An unsigned int parameter.
+ * @param build_threads The number of threads that insert the points, 1 for the sequential insertion order.
  */
 template <typename vamana_t>
 void FilteredVamanaIndex<vamana_t>::createGraph(
   const std::vector<vamana_t>& P, const float& alpha, const unsigned int L, const unsigned int R, const DISTANCE_SAVE_METHOD distanceSaveMethod,
-  unsigned int distance_threads, bool visualized, bool empty) {
+  unsigned int distance_threads, bool visualized, bool empty, unsigned int build_threads) {
 
   using Filter = CategoricalAttributeFilter;
   using GreedyResult = std::pair<std::set<vamana_t>, std::set<vamana_t>>;
@@ -88,6 +518,11 @@ void FilteredVamanaIndex<vamana_t>::createGraph(
   // Initialize graph memory
   unsigned int n = P.size();
   this->P = P;
+  this->alpha = alpha;
+  this->L = L;
+  this->R = R;
+  this->buildTimestampIndex();
+  this->buildLabelIndex();
 
   // Compute the distances between the points if it is specified to save the distances in a matrix
   if (distanceSaveMethod == MATRIX) {
@@ -106,35 +541,36 @@ void FilteredVamanaIndex<vamana_t>::createGraph(
   if (!empty) {
     this->createRandomEdges(R);
   }
-  GraphNode<vamana_t> s = this->findMedoid(this->G, 1000);
+  GraphNode<vamana_t> s = this->findMedoid(this->G, visualized, 1000);
+  this->medoid = s.getData().getIndex();
 
-  // Let st(f) be the start node for filter label f for every f in F.
-  std::map<Filter, GraphNode<vamana_t>> st = this->findFilteredMedoid(1000);
+  // Let st(f) be the start node for filter label f for every f in F, kept with the graph
+  this->buildStartNodes(1000);
 
   // Let sigma be a random permutation of the indices of [n]
   std::vector<int> sigma = generateRandomPermutation(0, n-1);
 
-  // Let Fx be the label-set for every x in P
-  std::map<vamana_t, Filter> Fx;
-  for (auto node : P) {
-    Fx[node] = CategoricalAttributeFilter(node.getC());
-  }
+  // The main for loop execution of the algorithm, for a single point
+  auto insertPoint = [&](int i) {
 
-  // Execute the main for loop execution of the algorithm, but with the addition of a progress bar
-  withProgress(0, n, "Creating Filtered Vamana", [&](int i) {
+    // Let F_x_sigma[i] be the label-set of x_sigma[i], read from the label index
+    const unsigned int* slots = this->labels.getPointSlots(sigma[i]);
+    std::vector<Filter> F_x_sigma_i;
+    for (unsigned int j = 0; j < this->labels.getPointLabelsCount(sigma[i]); j++) {
+      F_x_sigma_i.push_back(Filter(this->labels.getLabels()[slots[j]]));
+    }
 
     // Let S_F_x_sigma[i] = { st(f) : f in F_X_sigma[i] }
     std::vector<GraphNode<vamana_t>> S_F_x_sigma_i;
-    vamana_t x = P[sigma[i]];
-    Filter F_x_sigma_i = Fx[x];
-    S_F_x_sigma_i.push_back(st[F_x_sigma_i]);
-
-    // Run Filtered Greedy Search with S = S_F_x_sigma[i], query = x_sigm[i], 
-    // and query filters = F_x_sigma[i]
-    std::vector<Filter> queryFilters;
-    queryFilters.push_back(F_x_sigma_i);
+    for (unsigned int j = 0; j < this->labels.getPointLabelsCount(sigma[i]); j++) {
+      S_F_x_sigma_i.push_back(*this->G.getNode(this->labelStartNodes[slots[j]]));
+    }
 
-    GreedyResult greedyResult = FilteredGreedySearch(*this, S_F_x_sigma_i, this->P[sigma[i]], 0, L, queryFilters, distanceSaveMethod);
+    // Run Filtered Greedy Search with S = S_F_x_sigma[i], query = x_sigm[i], and query filters = F_x_sigma[i],
+    // visiting the points that share at least one label with x_sigma[i]
+    GreedyResult greedyResult = FilteredGreedySearch(
+      *this, S_F_x_sigma_i, this->P[sigma[i]], 0, L, F_x_sigma_i, distanceSaveMethod, std::vector<TimestampRangeFilter>(), MATCH_ANY
+    );
 
     // Construct the V_F_x_sigma[i] based on the second greedy result item
     std::set<vamana_t> V_F_x_sigma_i = greedyResult.second;
@@ -161,7 +597,15 @@ void FilteredVamanaIndex<vamana_t>::createGraph(
 
     }
 
-  });
+  };
+
+  // Execute it with the addition of a progress bar, or with several threads in parallel batches, which search and
+  // prune the points with searchInsertCandidates and pruneInsertNeighbors
+  if (build_threads > 1) {
+    this->insertBatches(sigma, s, alpha, L, R, distanceSaveMethod, build_threads, visualized);
+  } else {
+    withProgress(0, n, "Creating Filtered Vamana", insertPoint);
+  }
 
   // Free up the memory allocated for the distance matrix
   if (distanceSaveMethod == MATRIX) {
@@ -173,78 +617,396 @@ void FilteredVamanaIndex<vamana_t>::createGraph(
 
 }
 
+/**
+ * @brief Searches the candidate neighbors of an inserted point with a FilteredGreedySearch from the start nodes of
+ * its labels, visiting the points that share at least one label with it.
+ * 
+ * @param point the index of the inserted point
+ * @param s the start node of the unfiltered search, not used
+ * @param L the parameter L
+ * @param distanceSaveMethod the method used to compute the distances
+ * 
+ * @return the visited nodes of the search
+ */
+template <typename vamana_t>
+std::set<vamana_t> FilteredVamanaIndex<vamana_t>::searchInsertCandidates(
+  const unsigned int point, const GraphNode<vamana_t>&, const unsigned int L, const DISTANCE_SAVE_METHOD distanceSaveMethod) const {
+
+  // The labels of the point and their start nodes are read from the label index by the index of the point, and
+  // the lock is released before the search takes it again
+  std::vector<CategoricalAttributeFilter> Fx;
+  std::vector<GraphNode<vamana_t>> S;
+  {
+    ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+    const unsigned int* slots = this->labels.getPointSlots(point);
+    for (unsigned int j = 0; j < this->labels.getPointLabelsCount(point); j++) {
+      Fx.push_back(CategoricalAttributeFilter(this->labels.getLabels()[slots[j]]));
+      S.push_back(GraphNode<vamana_t>(this->G.getNode(this->labelStartNodes[slots[j]])->getData()));
+    }
+  }
+
+  return FilteredGreedySearch(*this, S, this->getPoint(point), 0, L, Fx, distanceSaveMethod, std::vector<TimestampRangeFilter>(), MATCH_ANY).second;
+
+}
+
+/**
+ * @brief Prunes the neighbors of a node, together with a set of candidates, with the index-based
+ * FilteredRobustPrune. Only the list of the given node is modified.
+ * 
+ * @param node the node whose neighbors are pruned
+ * @param V the candidate neighbors of the node
+ * @param alpha the parameter alpha
+ * @param R the parameter R
+ * @param distanceSaveMethod the method used to compute the distances
+ */
+template <typename vamana_t>
+void FilteredVamanaIndex<vamana_t>::pruneInsertNeighbors(
+  GraphNode<vamana_t>& node, std::set<vamana_t>& V, const float alpha, const unsigned int R, const DISTANCE_SAVE_METHOD distanceSaveMethod) {
+
+  std::vector<unsigned int> candidates;
+  candidates.reserve(node.getNeighborsVector()->size() + V.size());
+  for (const auto& neighbor : *node.getNeighborsVector()) {
+    candidates.push_back(neighbor.getIndex());
+  }
+  for (const auto& v : V) {
+    candidates.push_back(v.getIndex());
+  }
+
+  {
+    ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+    FilteredRobustPrune(*this, node.getData().getIndex(), candidates, alpha, R, distanceSaveMethod);
+  }
+
+  std::vector<vamana_t> neighbors;
+  neighbors.reserve(candidates.size());
+  for (auto v : candidates) {
+    neighbors.push_back(this->G.getNode(v)->getData());
+  }
+  node.getNeighborsVector()->swap(neighbors);
+
+}
+
+/**
+ * @brief Inserts a point with its categorical attribute C as its only label. Multi-label indexes refuse it, since
+ * their points must be inserted with their label set.
+ * 
+ * @param point the point to insert
+ * @param index output parameter, set to the index of the inserted point
+ * 
+ * @return true if the point was inserted, false otherwise
+ */
+template <typename vamana_t> bool FilteredVamanaIndex<vamana_t>::insert(const vamana_t& point, unsigned int& index) {
+
+  bool multiLabel;
+  {
+    ReadLockGuard<ReadWriteLock> lock(this->filtersLock);
+    multiLabel = !this->labelSets.empty();
+  }
+  if (multiLabel) {
+    std::cerr << "Error: the points of a multi-label index must be inserted with their label set." << std::endl;
+    return false;
+  }
+
+  return this->insert(point, std::vector<unsigned int>{(unsigned int)point.getC()}, index);
+
+}
+
+/**
+ * @brief Inserts a point that carries a set of labels. The point is appended to the vector store, the graph and
+ * the filter indexes, and then linked to the points that share a label with it, like any inserted point.
+ * 
+ * @param point the point to insert
+ * @param pointLabels the labels of the point, which must not be empty
+ * @param index output parameter, set to the index of the inserted point
+ * 
+ * @return true if the point was inserted, false if it has no labels or the index has no build parameters
+ */
+template <typename vamana_t>
+bool FilteredVamanaIndex<vamana_t>::insert(const vamana_t& point, const std::vector<unsigned int>& pointLabels, unsigned int& index) {
+
+  if (this->L == 0 || this->R == 0) {
+    std::cerr << "Error: the index has no build parameters to insert points with." << std::endl;
+    return false;
+  }
+  if (pointLabels.empty()) {
+    std::cerr << "Error: an inserted point must carry at least one label." << std::endl;
+    return false;
+  }
+
+  ReentrantLockGuard lock(this->updateLock);
+  {
+    std::lock_guard<std::mutex> append(this->appendMutex);
+    index = this->appendPoint(point, pointLabels);
+  }
+  this->linkInsertedPoint(index);
+
+  return true;
+
+}
+
+/**
+ * @brief Appends an inserted point with its categorical attribute C as its only label.
+ * 
+ * @param point the point to append
+ * 
+ * @return the index of the appended point
+ */
+template <typename vamana_t> unsigned int FilteredVamanaIndex<vamana_t>::appendPoint(const vamana_t& point) {
+
+  return this->appendPoint(point, std::vector<unsigned int>{(unsigned int)point.getC()});
+
+}
+
+/**
+ * @brief Appends an inserted point to the vector store and the graph, and adds it to the label index and the
+ * timestamp index. New labels shift the slots of the labels after them, so the start nodes are moved to the new
+ * slots, and the point becomes the start node of every new label. A point whose labels differ from its attribute
+ * C turns the index into a multi-label one, with a label set for every point. The point waits in the side run of
+ * the timestamp index, so adding it only costs a merge of the runs once in a while.
+ * 
+ * @param point the point to append
+ * @param pointLabels the labels of the point
+ * 
+ * @return the index of the appended point
+ */
+template <typename vamana_t>
+unsigned int FilteredVamanaIndex<vamana_t>::appendPoint(const vamana_t& point, const std::vector<unsigned int>& pointLabels) {
+
+  unsigned int index = VamanaIndex<vamana_t>::appendPoint(point);
+  std::vector<unsigned int> added = pointLabels;
+  std::sort(added.begin(), added.end());
+  added.erase(std::unique(added.begin(), added.end()), added.end());
+  std::lock_guard<ReadWriteLock> lock(this->filtersLock);
+
+  if (this->labelSets.empty() && (added.size() != 1 || added[0] != (unsigned int)this->P[index].getC())) {
+    this->labelSets.resize(index);
+    for (unsigned int i = 0; i < index; i++) {
+      this->labelSets[i] = {(unsigned int)this->P[i].getC()};
+    }
+  }
+  if (!this->labelSets.empty() && this->labelSets.size() == index) {
+    this->labelSets.push_back(added);
+  }
+
+  std::vector<unsigned int> newLabels = this->labels.addPoint(added);
+
+  if (!newLabels.empty()) {
+    // The labels that were already carried keep their order, so their old slots are found by skipping the new ones
+    const std::vector<unsigned int>& labels = this->labels.getLabels();
+    std::vector<unsigned int> moved;
+    for (unsigned int slot = 0; slot < labels.size(); slot++) {
+      if (!std::binary_search(newLabels.begin(), newLabels.end(), labels[slot])) {
+        moved.push_back(slot);
+      }
+    }
+
+    std::vector<unsigned int> startNodes(labels.size(), index);
+    for (unsigned int slot = 0; slot < moved.size() && slot < this->labelStartNodes.size(); slot++) {
+      startNodes[moved[slot]] = this->labelStartNodes[slot];
+    }
+    this->labelStartNodes = startNodes;
+    this->entryPoints = startNodes;
+
+    // The point is the only start node of its new labels in the cache as well
+    std::vector<StartNodeCache> caches(this->labelStartCaches.empty() ? 0 : startNodes.size());
+    for (unsigned int slot = 0; slot < moved.size() && slot < this->labelStartCaches.size(); slot++) {
+      caches[moved[slot]] = std::move(this->labelStartCaches[slot]);
+    }
+    for (unsigned int label : newLabels) {
+      this->F.insert(CategoricalAttributeFilter(label));
+      if (!caches.empty()) {
+        StartNodeCache& cache = caches[this->labels.findLabel(label)];
+        cache.nodes.push_back(index);
+        cache.vectors.assign(this->P[index].getRawData(), this->P[index].getRawData() + this->P[index].getDimension());
+      }
+    }
+    this->labelStartCaches.swap(caches);
+  }
+
+  // The point goes after the points of the side run with the same timestamp, and the runs are merged once the
+  // side run outgrows the square root of the main run
+  float timestamp = this->P[index].getT();
+  unsigned int position = std::upper_bound(this->recentTimestamps.begin(), this->recentTimestamps.end(), timestamp) - this->recentTimestamps.begin();
+  this->recentTimestamps.insert(this->recentTimestamps.begin() + position, timestamp);
+  this->recentOrder.insert(this->recentOrder.begin() + position, index);
+  if (this->recentOrder.size() >= std::max(MIN_RECENT_TIMESTAMPS, (unsigned int)std::sqrt((double)this->sortedTimestamps.size()))) {
+    this->mergeRecentTimestamps();
+  }
+
+  return index;
+
+}
+
+/**
+ * @brief Renumbers the points after the removed points are consolidated, and rebuilds the label index and the
+ * timestamp index on the remaining points. A label whose start node was removed starts from the first point of
+ * its posting list instead, removed points are dropped from the start node caches of the labels, and labels that
+ * only removed points carried are dropped.
+ * 
+ * @param newIndexes the new index of every point, or NO_POINT for the removed points
+ */
+template <typename vamana_t> void FilteredVamanaIndex<vamana_t>::compactPoints(const std::vector<unsigned int>& newIndexes) {
+
+  // The slots change with the labels, so the start nodes and their caches are kept by label value
+  std::map<unsigned int, unsigned int> startNodes;
+  std::map<unsigned int, StartNodeCache> startCaches;
+  for (unsigned int slot = 0; slot < this->labelStartNodes.size() && slot < this->labels.getLabels().size(); slot++) {
+    unsigned int startNode = this->labelStartNodes[slot];
+    if (startNode < newIndexes.size() && newIndexes[startNode] != VamanaIndex<vamana_t>::NO_POINT) {
+      startNodes[this->labels.getLabels()[slot]] = newIndexes[startNode];
+    }
+    if (slot < this->labelStartCaches.size()) {
+      this->compactStartNodes(this->labelStartCaches[slot], newIndexes);
+      startCaches[this->labels.getLabels()[slot]] = std::move(this->labelStartCaches[slot]);
+    }
+  }
+
+  if (this->labelSets.size() == newIndexes.size()) {
+    std::vector<std::vector<unsigned int>> labelSets;
+    for (unsigned int i = 0; i < newIndexes.size(); i++) {
+      if (newIndexes[i] != VamanaIndex<vamana_t>::NO_POINT) {
+        labelSets.push_back(this->labelSets[i]);
+      }
+    }
+    this->labelSets.swap(labelSets);
+  }
+
+  VamanaIndex<vamana_t>::compactPoints(newIndexes);
+  this->buildLabelIndex();
+  this->buildTimestampIndex();
+
+  this->labelStartNodes.resize(this->labels.getLabels().size());
+  for (unsigned int slot = 0; slot < this->labelStartNodes.size(); slot++) {
+    auto it = startNodes.find(this->labels.getLabels()[slot]);
+    this->labelStartNodes[slot] = it != startNodes.end() ? it->second : this->labels.getPoints(slot).front();
+  }
+  if (!this->labelStartNodes.empty()) {
+    this->entryPoints = this->labelStartNodes;
+  }
+
+  // Labels that lost all of their cached start nodes fall back to their start node
+  if (!this->labelStartCaches.empty()) {
+    this->labelStartCaches.assign(this->labelStartNodes.size(), StartNodeCache());
+    for (unsigned int slot = 0; slot < this->labelStartCaches.size(); slot++) {
+      auto it = startCaches.find(this->labels.getLabels()[slot]);
+      if (it != startCaches.end()) {
+        this->labelStartCaches[slot] = std::move(it->second);
+      }
+    }
+  }
+
+}
+
 /**
  * @brief Load a graph from a file. Specifically this method is used to receive the contents of a Vamana Index Graph
  * stored inside a file and create the Vamana Index object based on those contents. It is used to save time of the 
  * production making it easy to use an index with specific parameters just by loading it instead of creating it again.
  * 
  * @param filename the full path of the file containing the graph
+ * @param baseFile optional path of the dataset file, used by graph-only index files
  * 
  * @return true if the graph was loaded successfully, false otherwise
 */
-template <typename vamana_t> bool FilteredVamanaIndex<vamana_t>::loadGraph(const std::string& filename) {
+template <typename vamana_t> bool FilteredVamanaIndex<vamana_t>::loadGraph(const std::string& filename, const std::string& baseFile) {
 
-  // Load the graph from the file using the VamanaIndex loadGraph method
-  if (!VamanaIndex<vamana_t>::loadGraph(filename)) {
+  // Load the graph from the file using the VamanaIndex loadGraph method, which reads the stored start nodes
+  this->labelStartNodes.clear();
+  if (!VamanaIndex<vamana_t>::loadGraph(filename, baseFile)) {
     return false;
   }
 
-  // Initialize the filters from the graph nodes
-  // IMPORTANT: This version of the application only supports CategoricalAttributeFilter
+  // Rebuild the label index, unless it was stored in the graph file and matches the loaded points. The label
+  // sets of multi-label points are only kept by graph-only files, other files fall back to the attribute C.
+  if (this->labels.getPointsCount() != this->P.size()) {
+    this->buildLabelIndex();
+  }
+
+  // Points whose labels differ from their attribute C make a multi-label index, whose label sets are kept so that
+  // inserted points carry theirs and consolidation does not fall back to the attribute C
+  if (this->labelSets.size() != this->P.size()) {
+    this->labelSets.clear();
+    const std::vector<unsigned int>& labelValues = this->labels.getLabels();
+    bool multiLabel = false;
+    for (unsigned int i = 0; i < this->P.size() && !multiLabel; i++) {
+      multiLabel = this->labels.getPointLabelsCount(i) != 1 || labelValues[*this->labels.getPointSlots(i)] != (unsigned int)this->P[i].getC();
+    }
+    for (unsigned int i = 0; multiLabel && i < this->P.size(); i++) {
+      const unsigned int* slots = this->labels.getPointSlots(i);
+      std::vector<unsigned int> pointLabels;
+      for (unsigned int k = 0; k < this->labels.getPointLabelsCount(i); k++) {
+        pointLabels.push_back(labelValues[slots[k]]);
+      }
+      this->labelSets.push_back(pointLabels);
+    }
+  }
+
+  // Initialize the filters from the labels of the graph nodes
   std::set<CategoricalAttributeFilter> filters;
-  for (auto vector : this->P) {
-    CategoricalAttributeFilter filter(vector.getC());
-    filters.insert(filter);
+  for (auto label : this->labels.getLabels()) {
+    filters.insert(CategoricalAttributeFilter(label));
   }
   this->setFilters(filters);
+  this->buildTimestampIndex();
+
+  // Use the stored start nodes of the labels. Graph-only files of the first version keep them only as entry
+  // points, in the order of the labels, and files without either select them again.
+  unsigned int labelsCount = this->labels.getLabels().size();
+  bool validStartNodes = this->labelStartNodes.size() == labelsCount;
+  for (unsigned int slot = 0; validStartNodes && slot < labelsCount; slot++) {
+    validStartNodes = this->labelStartNodes[slot] < this->P.size();
+  }
+
+  if (!validStartNodes) {
+    if (this->entryPoints.size() == labelsCount) {
+      this->labelStartNodes = this->entryPoints;
+    } else {
+      this->buildStartNodes(1000);
+    }
+  }
+
+  // The start node caches of the labels are only kept by graph-only files with the same labels
+  if (this->labelStartCaches.size() != labelsCount) {
+    this->labelStartCaches.clear();
+  }
 
   return true;
 
 }
 
 /**
- * @brief Finds the set of medoid nodes in the graph using a sample of nodes.
- *
- * The medoid is the node with the minimum average distance to all other nodes in the sample.
- * This function uses Euclidean distance to calculate the distances between nodes.
- *
- * @param tau The graph from which to find the medoid.
- * @return A map containing the medoid node for each filter.
+ * @brief Selects the start node of every label with the load-balanced sampling of the Filtered-DiskANN paper: for
+ * every label a random sample of tau points that carry it is drawn, and the sampled point that is already the
+ * start node of the fewest labels is chosen.
+ * 
+ * @param tau The size of the sample of every label.
+ * @return The index of the start node of every label, indexed by the slot of the label.
  */
 template <typename vamana_t>
-std::map<Filter, GraphNode<vamana_t>> FilteredVamanaIndex<vamana_t>::findFilteredMedoid(const unsigned int tau) {
+std::vector<unsigned int> FilteredVamanaIndex<vamana_t>::selectStartNodes(const unsigned int tau) const {
 
-  // Initialize M to be an empty map, and T to a zero map
-  std::map<Filter, GraphNode<vamana_t>> M;
-  std::map<GraphNode<vamana_t>, unsigned int> T;
-  for (unsigned int i = 0; i < this->G.getNodesCount(); i++) {
-    T[*this->G.getNode(i)] = 0;
-  }
+  // Initialize M to be an empty map, and T to a zero map, both indexed by point
+  unsigned int labelsCount = this->labels.getLabels().size();
+  std::vector<unsigned int> M(labelsCount);
+  std::vector<unsigned int> T(this->P.size(), 0);
+  std::mt19937 gen(std::random_device{}());
 
   // Foreach f in F, the set of all filters do
-  withProgress(0, this->F.size(), "Finding Filtered Medoid", [&](int i) {
-
-    // Get the filter
-    Filter filter = *std::next(this->F.begin(), i);
+  withProgress(0, labelsCount, "Finding Filtered Medoid", [&](int slot) {
 
     // Let Pf be the set of points with label f in F
-    std::vector<GraphNode<vamana_t>> Pf = this->getNodesWithCategoricalValueFilter(filter);
-
-    // Let Rf be a random sample of tau points from Pf
-    std::vector<int> Rf_indexes = generateRandomPermutation(0, std::min(tau, (unsigned int)Pf.size()) - 1);
-    std::vector<GraphNode<vamana_t>> Rf;
-    for (auto i : Rf_indexes) {
-      Rf.push_back(Pf[i]);
-    }
+    const std::vector<unsigned int>& Pf = this->labels.getPoints(slot);
 
-    // p* <- argmin_{p in Rf} T[p]
-    GraphNode<vamana_t> p_star = Rf[0];
-    for (auto p : Rf) {
-      if (T[p] < T[p_star]) p_star = p;
+    // Let Rf be a random sample of tau points from Pf, and p* <- argmin_{p in Rf} T[p]
+    std::uniform_int_distribution<size_t> position(0, Pf.size() - 1);
+    bool sample = Pf.size() > tau;
+    unsigned int p_star = Pf[0];
+    for (unsigned int j = 0; j < std::min(tau, (unsigned int)Pf.size()); j++) {
+      unsigned int p = sample ? Pf[position(gen)] : Pf[j];
+      if (j == 0 || T[p] < T[p_star]) p_star = p;
     }
 
     // Update M[f] <- p* and T[p*] <- T[p*] + 1
-    M[filter] = p_star;
+    M[slot] = p_star;
     T[p_star]++;
 
   });
@@ -253,4 +1015,39 @@ std::map<Filter, GraphNode<vamana_t>> FilteredVamanaIndex<vamana_t>::findFiltere
 
 }
 
+/**
+ * @brief Selects the start node of every label and keeps them, also as the entry points of the index, so that
+ * they are stored with the graph and looked up directly at query time.
+ * 
+ * @param tau The size of the sample of every label.
+ */
+template <typename vamana_t>
+void FilteredVamanaIndex<vamana_t>::buildStartNodes(const unsigned int tau) {
+
+  this->labelStartNodes = this->selectStartNodes(tau);
+  this->entryPoints = this->labelStartNodes;
+
+}
+
+/**
+ * @brief Finds the set of medoid nodes in the graph using a sample of nodes. The start nodes of an index that
+ * was built or loaded are already available through getStartNode, without running this method again.
+ *
+ * @param tau The size of the sample of every label.
+ * @return A map containing the medoid node for each filter.
+ */
+template <typename vamana_t>
+std::map<Filter, GraphNode<vamana_t>> FilteredVamanaIndex<vamana_t>::findFilteredMedoid(const unsigned int tau) {
+
+  std::vector<unsigned int> startNodes = this->selectStartNodes(tau);
+
+  std::map<Filter, GraphNode<vamana_t>> M;
+  for (unsigned int slot = 0; slot < startNodes.size(); slot++) {
+    M[Filter(this->labels.getLabels()[slot])] = *this->G.getNode(startNodes[slot]);
+  }
+
+  return M;
+
+}
+
 template class FilteredVamanaIndex<BaseDataVector<float>>;
@@ -1,58 +1,173 @@
 #include "../../../include/GreedySearch.h"
+#include "../../../include/SearchCandidates.h"
 
 /**
- * @brief Computes the difference between two sets, returning elements
- * that are in the first set but not in the second.
+ * @brief Resolves the categorical filters of a query to the slots of their labels in the label index, so that
+ * the membership tests of a search do not have to look the labels up again.
  * 
- * @param set_t Type of elements in the sets
- * @param set1 The first set
- * @param set2 The second set
+ * @param labels The label index of the searched index
+ * @param queryFilters The categorical filters of the query
  * 
- * @return A set containing elements that are in set1 but not in set2
+ * @return The slot of every filter, LabelIndex::NO_LABEL for labels no point carries
  */
-template <typename set_t> 
-static std::set<set_t> getSetDifference(const std::set<set_t>& set1, const std::set<set_t>& set2) {
-  
-  std::set<set_t> result; // Resulting set to hold the difference
+static std::vector<unsigned int> findLabelSlots(const LabelIndex& labels, const std::vector<CategoricalAttributeFilter>& queryFilters) {
 
-  // Compute difference and store in result
-  std::set_difference(
-    set1.begin(), set1.end(), 
-    set2.begin(), set2.end(), 
-    std::inserter(result, result.begin())
-  );
+  std::vector<unsigned int> slots;
+  slots.reserve(queryFilters.size());
+  for (const auto& filter : queryFilters) {
+    slots.push_back(labels.findLabel(filter.getC()));
+  }
 
-  return result;
+  return slots;
 
 }
 
 /**
- * @brief Retrieves the element at a specific index in a set. This function enables index-based access in a set, 
- * even though sets are not indexed containers.
+ * @brief Checks whether a point satisfies the categorical and timestamp range filters of a query. The categorical
+ * filters are answered by the label index with constant time membership tests, and are combined according to the
+ * label match of the query: the point must carry all of their labels, or at least one of them.
  * 
- * @param set_t Type of elements in the set
- * @param index The zero-based index of the desired element
- * @param set The set from which to retrieve the element
+ * @param graph_t Type of data stored in the graph nodes
+ * @param labels The label index of the searched index
+ * @param labelSlots The slots of the categorical filters of the query, as returned by findLabelSlots
+ * @param labelMatch How the categorical filters are combined (MATCH_ALL or MATCH_ANY)
+ * @param p The point to check
+ * @param rangeFilters The timestamp range filters of the query
  * 
- * @return The element at the specified index
- * @throws std::invalid_argument if the index is out of range
+ * @return true if the point passes the filters, false otherwise
  */
-template <typename set_t>
-static set_t getSetItemAtIndex(const unsigned int& index, const std::set<set_t>& set) {
+template <typename graph_t>
+static inline bool passesQueryFilters(
+  const LabelIndex& labels, const std::vector<unsigned int>& labelSlots, const LabelMatch labelMatch, const graph_t& p, 
+  const std::vector<TimestampRangeFilter>& rangeFilters) {
+
+  if (labelMatch == MATCH_ANY && !labelSlots.empty()) {
+    bool carriesAny = false;
+    for (auto slot : labelSlots) {
+      if (labels.contains(slot, p.getIndex())) {
+        carriesAny = true;
+        break;
+      }
+    }
+    if (!carriesAny) {
+      return false;
+    }
+  } else {
+    for (auto slot : labelSlots) {
+      if (!labels.contains(slot, p.getIndex())) {
+        return false;
+      }
+    }
+  }
 
-  // Validate index
-  if (index >= set.size()) {
-    throw std::invalid_argument("Index is not valid");
+  for (const auto& range : rangeFilters) {
+    if (!range.contains(p.getT())) {
+      return false;
+    }
   }
 
-  // Advance an iterator to the indexed position
-  auto it = set.begin();
-  std::advance(it, index);
+  return true;
+
+}
+
+/**
+ * @brief Moves the work a search spent since the last call into its budget, and checks whether the budget allows
+ * another expansion. The search keeps its own counters and charges them here, so that the budget is only touched
+ * once per expansion.
+ * 
+ * @param budget The budget of the search
+ * @param distanceComputations The distance computations since the last call, reset to 0
+ * @param hops The expansions since the last call, reset to 0
+ * 
+ * @return true if a limit is reached, in which case the budget is marked as truncated, false otherwise
+ */
+static inline bool chargeSearchBudget(SearchBudget& budget, unsigned int& distanceComputations, unsigned int& hops) {
+
+  budget.distanceComputations += distanceComputations;
+  budget.hops += hops;
+  distanceComputations = hops = 0;
+
+  if (budget.isExhausted()) {
+    budget.truncated = true;
+    return true;
+  }
+  return false;
+
+}
+
+/**
+ * @brief Computes the distance between a point of the index and the query vector, with the method of the search.
+ */
+template <typename graph_t, typename query_t>
+static inline float getSearchDistance(
+  const VamanaIndex<graph_t>& index, const graph_t& p, const query_t& xq, const DISTANCE_SAVE_METHOD distanceSaveMethod) {
 
-  return *it; // Return the element at the specified index
+  if (distanceSaveMethod == MATRIX) {
+    return index.getDistanceMatrix()[p.getIndex()][xq.getIndex()];
+  }
+  return euclideanDistance(p, xq);
 
 }
 
+/**
+ * @brief Tracks the k nearest distances a search has found, so that it can stop once it converged, as set by the
+ * patience and the epsilon of its budget. The k-th distance is infinite until k points were found.
+ */
+class ConvergenceTracker {
+
+private:
+  const SearchBudget* budget;
+  unsigned int k;
+  std::priority_queue<float> nearest;
+  unsigned int stalled;
+
+public:
+
+  ConvergenceTracker(const SearchBudget* budget, const unsigned int k) : budget(budget), k(std::max(1u, k)), stalled(0) {}
+
+  /**
+   * @brief Returns whether the budget of the search stops it on convergence.
+   */
+  inline bool isEnabled(void) const { return this->budget != nullptr && this->budget->stopsOnConvergence(); }
+
+  /**
+   * @brief Records the distance of a point that may be returned.
+   */
+  inline void add(const float distance) {
+    this->nearest.push(distance);
+    if (this->nearest.size() > this->k) {
+      this->nearest.pop();
+    }
+  }
+
+  inline float getKthDistance(void) const {
+    return this->nearest.size() < this->k ? std::numeric_limits<float>::infinity() : this->nearest.top();
+  }
+
+  /**
+   * @brief Returns whether the nearest unvisited candidate is farther than (1 + epsilon) times the k-th distance.
+   */
+  inline bool isBeyondEpsilon(const float candidateDistance) const {
+    return this->nearest.size() >= this->k && candidateDistance > (1.0f + this->budget->epsilon) * this->nearest.top();
+  }
+
+  /**
+   * @brief Records an expansion and returns whether the k-th distance has not improved for patience expansions.
+   * The expansions before k points are tracked are not counted, since the k-th distance is not defined until then.
+   * 
+   * @param previousKthDistance the k-th distance before the expansion
+   */
+  inline bool isStalled(const float previousKthDistance) {
+    if (this->nearest.size() < this->k) {
+      this->stalled = 0;
+      return false;
+    }
+    this->stalled = this->getKthDistance() < previousKthDistance ? 0 : this->stalled + 1;
+    return this->budget->patience > 0 && this->stalled >= this->budget->patience;
+  }
+
+};
+
 /**
  * @brief Greedy search algorithm for finding the k nearest nodes in a graph relative to a query vector.
  * 
@@ -65,95 +180,93 @@ static set_t getSetItemAtIndex(const unsigned int& index, const std::set<set_t>&
  * @param xq Query vector for distance computation
  * @param k Number of nearest nodes to return
  * @param L Maximum number of nodes in the candidate set
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param budget Optional limits of the search, checked before every expansion
  * 
  * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
  */
 template <typename graph_t, typename query_t>
 std::pair<std::set<graph_t>, std::set<graph_t>>
-GreedySearch(const VamanaIndex<graph_t>& index, const GraphNode<graph_t>& s, const query_t& xq, unsigned int k, unsigned int L, const DISTANCE_SAVE_METHOD distanceSaveMethod) {
+GreedySearch(
+  const VamanaIndex<graph_t>& index, const GraphNode<graph_t>& s, const query_t& xq, unsigned int k, unsigned int L,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod, SearchBudget* budget) {
   
-  std::set<graph_t> candidates = {s.getData()};
+  // Consolidate renumbers the points, so it waits for the search to finish
+  ReentrantLockGuard updateLock(index.getUpdateLock());
+
   std::set<graph_t> visited = {};
+  unsigned int distanceComputations = 0, hops = 0;
+  auto computeDistance = [&](unsigned int i) {
+    return getSearchDistance(index, index.getGraph().getNode(i)->getData(), xq, distanceSaveMethod);
+  };
 
-  // Calculate initial difference between candidates and visited sets
-  std::set<graph_t> candidates_minus_visited = getSetDifference(candidates, visited);
-  float p_star_distance = 0, currentDistance = 0;
+  SearchCandidates candidates;
+  candidates.insert(s.getData().getIndex(), computeDistance, distanceComputations);
 
-  // Main search loop: continue until there are no unvisited candidates
-  while (!candidates_minus_visited.empty()) {
+  // The distances of the found points are only tracked when the budget stops the search on convergence
+  ConvergenceTracker convergence(budget, k);
+  std::vector<unsigned int> neighbors;
+  if (convergence.isEnabled() && !index.isDeleted(s.getData().getIndex())) {
+    convergence.add(candidates.getDistance(s.getData().getIndex()));
+  }
 
-    // Select the closest candidate to the query vector xq
-    graph_t p_star = getSetItemAtIndex(0, candidates_minus_visited);
+  // Main search loop: continue until there are no unvisited candidates, or until the budget runs out
+  while (candidates.hasUnvisited()) {
 
-    if (distanceSaveMethod == NONE) {
-      p_star_distance = euclideanDistance(p_star, xq);
-    } else if (distanceSaveMethod == MATRIX) {
-      p_star_distance = index.getDistanceMatrix()[p_star.getIndex()][xq.getIndex()];
+    if (budget != nullptr && chargeSearchBudget(*budget, distanceComputations, hops)) {
+      break;
     }
 
-    // Compare each unvisited candidate's distance to find the nearest
-    for (auto xp : candidates_minus_visited) {
-
-      if (distanceSaveMethod == NONE) {
-        currentDistance = euclideanDistance(xp, xq);
-      } else if (distanceSaveMethod == MATRIX) {
-        currentDistance = index.getDistanceMatrix()[xp.getIndex()][xq.getIndex()];
+    // Select the closest unvisited candidate to the query vector xq, by the distance it was added with
+    std::pair<float, unsigned int> p_star = candidates.visitNearest();
+    if (convergence.isEnabled() && convergence.isBeyondEpsilon(p_star.first)) {
+      budget->converged = true;
+      break;
+    }
+    float previousKthDistance = convergence.getKthDistance();
+
+    // Retrieve the unvisited neighbors of the closest node, p_star. Insertions may replace the list meanwhile, so
+    // it is read under the shared lock of the node, and the distances are computed once the lock is released
+    neighbors.clear();
+    {
+      ReadLockGuard<SpinReadWriteLock> lock(index.getGraph().getNodeSync(p_star.second).lock);
+      for (const auto& neighbor : *index.getGraph().getNodeNeighbors(p_star.second)) {
+        if (visited.find(neighbor) == visited.end()) {
+          neighbors.push_back(neighbor.getIndex());
+        }
       }
+    }
+    visited.insert(index.getGraph().getNode(p_star.second)->getData()); // Mark the closest node as visited
+    hops++;
 
-      if (currentDistance < p_star_distance) {
-        p_star_distance = currentDistance;
-        p_star = xp;
+    for (auto i : neighbors) {
+      if (candidates.insert(i, computeDistance, distanceComputations) && convergence.isEnabled() && !index.isDeleted(i)) {
+        convergence.add(candidates.getDistance(i));
       }
     }
-
-    // Retrieve neighbors of the closest node, p_star, and add them to candidates
-    GraphNode<graph_t>* p_star_node = index.getGraph().getNode(p_star.getIndex());
-    std::vector<graph_t>* p_star_neighbors = p_star_node->getNeighborsVector();
-
-    for (auto neighbor : *p_star_neighbors) {
-      candidates.insert(neighbor);
+    if (convergence.isEnabled() && convergence.isStalled(previousKthDistance)) {
+      budget->converged = true;
+      break;
     }
-    visited.insert(p_star); // Mark the closest node as visited
 
     // Limit the size of candidates to L by keeping the closest L elements to the query
-    if (candidates.size() > static_cast<size_t>(L)) {
-      std::set<graph_t, EuclideanDistanceOrder<graph_t, query_t>> newCandidates{
-        EuclideanDistanceOrder<graph_t, query_t>(xq, index.getDistanceMatrix(), distanceSaveMethod==MATRIX)
-      };
-
-      for (auto candidate : candidates) {
-        newCandidates.insert(candidate);
-      }
-      
-      // Reassign only the closest L candidates back to candidates set
-      candidates.clear();
-      auto it = newCandidates.begin();
-      for (unsigned int i = 0; i < L && it != newCandidates.end(); i++, it++) {
-        candidates.insert(*it);
-      }
-    }
-
-    // Update candidates_minus_visited with the new difference after adding p_star to visited
-    candidates_minus_visited = getSetDifference(candidates, visited);
+    candidates.trim(L);
   }
 
-  // Final selection of k closest candidates after main loop
-  std::set<graph_t, EuclideanDistanceOrder<graph_t, query_t>> newCandidates{
-    EuclideanDistanceOrder<graph_t, query_t>(xq, index.getDistanceMatrix(), distanceSaveMethod==MATRIX)
-  };
-  
-  for (auto candidate : candidates) {
-    newCandidates.insert(candidate);
+  if (budget != nullptr) {
+    budget->distanceComputations += distanceComputations;
+    budget->hops += hops;
   }
 
-  // Reassign only the closest k candidates to the candidates set for final result
-  candidates.clear();
-  auto it = newCandidates.begin();
-  for (unsigned int i = 0; i < k && it != newCandidates.end(); i++, it++) {
-    candidates.insert(*it);
+  // Final selection of the k closest candidates after the main loop, skipping the removed points
+  std::set<graph_t> nearest;
+  for (auto it = candidates.getRanked().begin(); nearest.size() < k && it != candidates.getRanked().end(); it++) {
+    if (!index.isDeleted(it->second)) {
+      nearest.insert(index.getGraph().getNode(it->second)->getData());
+    }
   }
 
-  return {candidates, visited};
+  return {nearest, visited};
 
 }
 
@@ -172,7 +285,10 @@ GreedySearch(const VamanaIndex<graph_t>& index, const GraphNode<graph_t>& s, con
  * @param k Number of nearest nodes to return
  * @param L Maximum number of nodes in the candidate set
  * @param queryFilters A vector of CategoricalAttributeFilter objects to apply to the search
- * @param mode Execution mode for the algorithm
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param rangeFilters A vector of TimestampRangeFilter objects to apply to the search
+ * @param labelMatch Whether the points must carry all the labels of queryFilters (MATCH_ALL) or any of them (MATCH_ANY)
+ * @param budget Optional limits of the search, checked before every expansion
  * 
  * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
  * 
@@ -180,130 +296,330 @@ GreedySearch(const VamanaIndex<graph_t>& index, const GraphNode<graph_t>& s, con
 template <typename graph_t, typename query_t>
 std::pair<std::set<graph_t>, std::set<graph_t>> FilteredGreedySearch(
   const FilteredVamanaIndex<graph_t>& index, const std::vector<GraphNode<graph_t>>& S, const query_t& xq,  
-  const unsigned int k, const unsigned int L, const std::vector<CategoricalAttributeFilter>& queryFilters, const DISTANCE_SAVE_METHOD distanceSaveMethod) {
-
-  float p_star_distance = 0, currentDistance = 0;
-  
-  std::set<graph_t> candidates = {};
-  std::set<graph_t> visited = {};
+  const unsigned int k, const unsigned int L, const std::vector<CategoricalAttributeFilter>& queryFilters, const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  const std::vector<TimestampRangeFilter>& rangeFilters, const LabelMatch labelMatch, SearchBudget* budget) {
 
-  // Insert starting nodes from S into candidates if they match the query filters
-  for (auto s : S) {
+  // Consolidate renumbers the points, so it waits for the search to finish
+  ReentrantLockGuard updateLock(index.getUpdateLock());
 
-    bool passFilter = true;
+  std::set<graph_t> visited = {};
+  std::vector<unsigned int> starts;
+
+  // Insertions add points and labels to the label index under the exclusive filters lock, and a new label shifts
+  // the slots of the labels after it. So the search holds the shared lock only around its label lookups, never
+  // while it waits for the lock of a node, and finds the slots of its labels again in every lookup
+  std::vector<CategoricalAttributeFilter> traversalFilters = queryFilters;
+  {
+    ReadLockGuard<ReadWriteLock> filtersLock(index.getFiltersLock());
+    const LabelIndex& labels = index.getLabelIndex();
+    std::vector<unsigned int> labelSlots = findLabelSlots(labels, queryFilters);
+
+    // The graph is navigable inside the points of every single label, but not inside the points that carry
+    // several labels at once. So a query that must match all of several labels traverses the points of its most
+    // selective label, and keeps only the points that carry every label in the final selection.
+    if (labelMatch == MATCH_ALL && labelSlots.size() > 1) {
+      auto selective = std::min_element(labelSlots.begin(), labelSlots.end(), [&](unsigned int a, unsigned int b) {
+        return labels.getCardinality(a) < labels.getCardinality(b);
+      });
+      traversalFilters = { queryFilters[selective - labelSlots.begin()] };
+    }
+    std::vector<unsigned int> traversalSlots = findLabelSlots(labels, traversalFilters);
 
-    // Check if the starting node passes all query filters
-    for (auto filter : queryFilters) {
-      if (s.getData().getC() != filter.getC()) { // IMPORTANT: In this app version, only C filter is supported
-        passFilter = false;
-        break;
+    // Start from the nodes of S that match the query filters
+    for (auto s : S) {
+      if (passesQueryFilters(labels, traversalSlots, labelMatch, s.getData(), rangeFilters)) {
+        starts.push_back(s.getData().getIndex());
       }
     }
 
-    // Only add the node to candidates if it passes the filters
-    if (passFilter) {
-      candidates.insert(s.getData());
+    // None of the start nodes carries the labels of the query, so start from the first qualifying point of the
+    // posting lists of the traversal labels
+    for (unsigned int s = 0; s < traversalSlots.size() && starts.empty(); s++) {
+      for (auto i : labels.getPoints(traversalSlots[s])) {
+        if (passesQueryFilters(labels, labelSlots, labelMatch, index.getGraph().getNode(i)->getData(), rangeFilters)) {
+          starts.push_back(i);
+          break;
+        }
+      }
     }
-
   }
+  bool postFilter = traversalFilters.size() != queryFilters.size();
 
-  // Calculate initial difference between candidates and visited sets
-  std::set<graph_t> candidates_minus_visited = getSetDifference(candidates, visited);
+  unsigned int distanceComputations = 0, hops = 0;
+  auto computeDistance = [&](unsigned int i) {
+    return getSearchDistance(index, index.getGraph().getNode(i)->getData(), xq, distanceSaveMethod);
+  };
 
-  // Main search loop: continue until there are no unvisited candidates
-  while (!candidates_minus_visited.empty()) {
+  // The distances of the points that may be returned are only tracked when the budget stops the search on
+  // convergence. Every accepted point is paired with whether it carries all the labels of the query, which is
+  // only checked when the convergence is tracked
+  ConvergenceTracker convergence(budget, k);
+  SearchCandidates candidates;
+  std::vector<unsigned int> neighbors;
+  std::vector<std::pair<unsigned int, bool>> accepted;
+  auto acceptCandidates = [&](void) {
+    for (const auto& a : accepted) {
+      if (candidates.insert(a.first, computeDistance, distanceComputations) && convergence.isEnabled() && a.second &&
+          !index.isDeleted(a.first)) {
+        convergence.add(candidates.getDistance(a.first));
+      }
+    }
+  };
 
-    // Select the closest candidate to the query vector xq
-    graph_t p_star = getSetItemAtIndex(0, candidates_minus_visited);
+  if (postFilter && convergence.isEnabled()) {
+    ReadLockGuard<ReadWriteLock> filtersLock(index.getFiltersLock());
+    std::vector<unsigned int> labelSlots = findLabelSlots(index.getLabelIndex(), queryFilters);
+    for (auto i : starts) {
+      accepted.push_back({i, passesQueryFilters(index.getLabelIndex(), labelSlots, labelMatch, index.getGraph().getNode(i)->getData(), rangeFilters)});
+    }
+  } else {
+    for (auto i : starts) {
+      accepted.push_back({i, true});
+    }
+  }
+  acceptCandidates();
+
+  // Main search loop: continue until there are no unvisited candidates, or until the budget runs out
+  while (candidates.hasUnvisited()) {
 
-    if (distanceSaveMethod == NONE) {
-      p_star_distance = euclideanDistance(p_star, xq);
-    } else if (distanceSaveMethod == MATRIX) {
-      p_star_distance = index.getDistanceMatrix()[p_star.getIndex()][xq.getIndex()];
+    if (budget != nullptr && chargeSearchBudget(*budget, distanceComputations, hops)) {
+      break;
     }
 
-    // Compare each unvisited candidate's distance to find the nearest
-    for (auto xp : candidates_minus_visited) {
-      
-      if (distanceSaveMethod == NONE) {
-        currentDistance = euclideanDistance(xp, xq);
-      } else {
-        currentDistance = index.getDistanceMatrix()[xp.getIndex()][xq.getIndex()];
+    // Select the closest unvisited candidate to the query vector xq, by the distance it was added with
+    std::pair<float, unsigned int> p_star = candidates.visitNearest();
+    if (convergence.isEnabled() && convergence.isBeyondEpsilon(p_star.first)) {
+      budget->converged = true;
+      break;
+    }
+    float previousKthDistance = convergence.getKthDistance();
+
+    visited.insert(index.getGraph().getNode(p_star.second)->getData()); // Mark the closest node as visited
+    hops++;
+
+    // Retrieve the unvisited neighbors of the closest node, p_star, under the shared lock of the node, which is
+    // released before the filters lock is taken
+    neighbors.clear();
+    {
+      ReadLockGuard<SpinReadWriteLock> nodeLock(index.getGraph().getNodeSync(p_star.second).lock);
+      for (const auto& p_tone : *index.getGraph().getNodeNeighbors(p_star.second)) {
+        if (visited.find(p_tone) == visited.end()) {
+          neighbors.push_back(p_tone.getIndex());
+        }
       }
+    }
 
-      if (currentDistance < p_star_distance) {
-        p_star_distance = currentDistance;
-        p_star = xp;
+    // Only add the neighbors that pass the filters to candidates. The nodes keep their data once appended, so the
+    // neighbors are read back from the graph by index, and their distances are computed once the lock is released
+    accepted.clear();
+    {
+      ReadLockGuard<ReadWriteLock> filtersLock(index.getFiltersLock());
+      const LabelIndex& labels = index.getLabelIndex();
+      std::vector<unsigned int> traversalSlots = findLabelSlots(labels, traversalFilters);
+      std::vector<unsigned int> labelSlots = postFilter ? findLabelSlots(labels, queryFilters) : traversalSlots;
+      for (auto i : neighbors) {
+        const graph_t& p_tone = index.getGraph().getNode(i)->getData();
+        if (passesQueryFilters(labels, traversalSlots, labelMatch, p_tone, rangeFilters)) {
+          accepted.push_back({i, !postFilter || !convergence.isEnabled() || passesQueryFilters(labels, labelSlots, labelMatch, p_tone, rangeFilters)});
+        }
       }
     }
+    acceptCandidates();
 
-    visited.insert(p_star); // Mark the closest node as visited
+    if (convergence.isEnabled() && convergence.isStalled(previousKthDistance)) {
+      budget->converged = true;
+      break;
+    }
 
-    // Retrieve neighbors of the closest node, p_star
-    GraphNode<graph_t>* p_star_node = index.getGraph().getNode(p_star.getIndex());
-    std::vector<graph_t>* p_star_neighbors = p_star_node->getNeighborsVector();
+    // Limit the size of candidates to L by keeping the closest L elements to the query
+    candidates.trim(L);
 
-    // Filter neighbors based on query filters and their existence in the visited set
-    for (auto p_tone : *p_star_neighbors) {
+  }
 
-      // Check if the current neighbor passes all query filters
-      bool passFilter = true;
-      for (auto filter : queryFilters) {
-        if (p_tone.getC() != filter.getC()) { // IMPORTANT: In this app version, only C filter is supported
-          passFilter = false;
-          break;
-        }
-      }
+  if (budget != nullptr) {
+    budget->distanceComputations += distanceComputations;
+    budget->hops += hops;
+  }
 
-      // Only add the neighbor to candidates if it passes the filters and is not visited
-      if (passFilter && visited.find(p_tone) == visited.end()) {
-        candidates.insert(p_tone);
+  // Final selection of the k closest candidates after the main loop, by the distances they were added with
+  const std::set<std::pair<float, unsigned int>>* selection = &candidates.getRanked();
+  std::set<std::pair<float, unsigned int>> matching;
+  if (postFilter) {
+
+    // Select among every traversed point that carries all the labels of the query
+    ReadLockGuard<ReadWriteLock> filtersLock(index.getFiltersLock());
+    const LabelIndex& labels = index.getLabelIndex();
+    std::vector<unsigned int> labelSlots = findLabelSlots(labels, queryFilters);
+    for (const auto& candidate : candidates.getRanked()) {
+      if (passesQueryFilters(labels, labelSlots, labelMatch, index.getGraph().getNode(candidate.second)->getData(), rangeFilters)) {
+        matching.insert(candidate);
       }
+    }
+    for (const auto& p : visited) {
+      if (passesQueryFilters(labels, labelSlots, labelMatch, p, rangeFilters)) {
+        matching.insert({candidates.getDistance(p.getIndex()), p.getIndex()});
+      }
+    }
+    selection = &matching;
 
+  }
+
+  // Keep only the closest k candidates for the final result, skipping the removed points
+  std::set<graph_t> nearest;
+  for (auto it = selection->begin(); nearest.size() < k && it != selection->end(); it++) {
+    if (!index.isDeleted(it->second)) {
+      nearest.insert(index.getGraph().getNode(it->second)->getData());
     }
+  }
 
-    // Limit the size of candidates to L by keeping the closest L elements to the query
-    if (candidates.size() > static_cast<size_t>(L)) {
+  return {nearest, visited}; // Return the set of nearest candidates and visited nodes
 
-      std::set<graph_t, EuclideanDistanceOrder<graph_t, query_t>> newCandidates{
-        EuclideanDistanceOrder<graph_t, query_t>(xq, index.getDistanceMatrix(), distanceSaveMethod==MATRIX)
-      };
+}
 
-      for (auto candidate : candidates) {
-        newCandidates.insert(candidate);
-      }
-      
-      // Reassign only the closest L candidates back to candidates set
-      candidates.clear();
-      auto it = newCandidates.begin();
-      for (unsigned int i = 0; i < L && it != newCandidates.end(); i++, it++) {
-        candidates.insert(*it);
-      }
+/**
+ * @brief Filtered greedy search that starts only from the start nodes of the labels of the query, or from the
+ * start node the navigation layer finds for a query without labels, which is the global medoid of an index
+ * without a layer. The start nodes are looked up by label slot, so the cost of starting a search does not
+ * depend on the number of labels of the index.
+ * 
+ * @param graph_t Type of data stored in the graph nodes
+ * @param query_t Type of the query vector
+ * @param index The FilteredVamanaIndex to search
+ * @param xq Query vector for distance computation
+ * @param k Number of nearest nodes to return
+ * @param L Maximum number of nodes in the candidate set
+ * @param queryFilters A vector of CategoricalAttributeFilter objects to apply to the search
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param rangeFilters A vector of TimestampRangeFilter objects to apply to the search
+ * @param labelMatch Whether the points must carry all the labels of queryFilters (MATCH_ALL) or any of them (MATCH_ANY)
+ * @param budget Optional limits of the search
+ * 
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+ */
+template <typename graph_t, typename query_t>
+std::pair<std::set<graph_t>, std::set<graph_t>> FilteredGreedySearch(
+  const FilteredVamanaIndex<graph_t>& index, const query_t& xq, const unsigned int k, const unsigned int L,
+  const std::vector<CategoricalAttributeFilter>& queryFilters, const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  const std::vector<TimestampRangeFilter>& rangeFilters, const LabelMatch labelMatch, SearchBudget* budget) {
+
+  // The start nodes depend on the query when the index has a navigation layer or a start node cache, and they are
+  // picked under the same hold of the update lock as the search
+  ReentrantLockGuard updateLock(index.getUpdateLock());
+  std::vector<GraphNode<graph_t>> S = index.getQueryStartNodes(queryFilters, xq);
+
+  return FilteredGreedySearch(index, S, xq, k, L, queryFilters, distanceSaveMethod, rangeFilters, labelMatch, budget);
 
+}
+
+/**
+ * @brief Exhaustive search over a list of points of the index. Computes the distance between the query vector and
+ * every point of the list that is not removed and keeps the k nearest ones, so the result is exact.
+ * 
+ * @param graph_t Type of data stored in the graph nodes
+ * @param query_t Type of the query vector
+ * @param index The VamanaIndex that stores the points
+ * @param points The indexes of the points to scan
+ * @param xq Query vector for distance computation
+ * @param k Number of nearest nodes to return
+ * @param distanceSaveMethod The method used to compute the distances
+ * 
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all scanned nodes
+ */
+template <typename graph_t, typename query_t>
+std::pair<std::set<graph_t>, std::set<graph_t>> ExhaustiveSearch(
+  const VamanaIndex<graph_t>& index, const std::vector<unsigned int>& points, const query_t& xq, const unsigned int k, 
+  const DISTANCE_SAVE_METHOD distanceSaveMethod) {
+
+  ReentrantLockGuard updateLock(index.getUpdateLock());
+  const Graph<graph_t>& G = index.getGraph();
+  std::vector<std::pair<double, unsigned int>> distances;
+  std::set<graph_t> visited;
+
+  for (auto i : points) {
+    if (index.isDeleted(i)) {
+      continue;
     }
+    graph_t p = G.getNode(i)->getData();
+    double distance = (distanceSaveMethod == MATRIX) ? index.getDistanceMatrix()[i][xq.getIndex()] : euclideanDistance(p, xq);
+    distances.emplace_back(distance, i);
+    visited.insert(p);
+  }
 
-    // Update candidates_minus_visited with the new difference after adding p_star to visited
-    candidates_minus_visited = getSetDifference(candidates, visited);
+  unsigned int count = std::min((size_t)k, distances.size());
+  std::partial_sort(distances.begin(), distances.begin() + count, distances.end());
 
+  std::set<graph_t> candidates;
+  for (unsigned int i = 0; i < count; i++) {
+    candidates.insert(G.getNode(distances[i].second)->getData());
   }
 
-  // Final selection of k closest candidates after main loop
-  std::set<graph_t, EuclideanDistanceOrder<graph_t, query_t>> newCandidates{
-    EuclideanDistanceOrder<graph_t, query_t>(xq, index.getDistanceMatrix(), distanceSaveMethod==MATRIX)
-  };
+  return {candidates, visited};
+
+}
 
-  for (auto candidate : candidates) {
-    newCandidates.insert(candidate);
+/**
+ * @brief Search algorithm for queries with a timestamp range filter (query types 2 and 3).
+ * 
+ * The points that satisfy the range are enumerated with the sorted-by-T index of the FilteredVamanaIndex. If at
+ * most `bruteForceLimit` points satisfy all the filters of the query, they are scanned exhaustively, which is both
+ * exact and cheaper than a graph traversal. Otherwise a FilteredGreedySearch with the range predicate is executed,
+ * seeded with the start nodes that pass the filters and with points spread evenly across the range, so that the
+ * traversal can start even when none of the start nodes lies inside the range.
+ * 
+ * @param graph_t Type of data stored in the graph nodes
+ * @param query_t Type of the query vector
+ * @param index The FilteredVamanaIndex to search
+ * @param S Starting nodes for the search
+ * @param xq Query vector for distance computation
+ * @param k Number of nearest nodes to return
+ * @param L Maximum number of nodes in the candidate set
+ * @param queryFilters A vector of CategoricalAttributeFilter objects to apply to the search
+ * @param range The TimestampRangeFilter of the query
+ * @param bruteForceLimit The maximum number of qualifying points that are scanned exhaustively
+ * @param distanceSaveMethod The method used to compute the distances
+ * @param budget Optional limits of the graph traversal
+ * 
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+ */
+template <typename graph_t, typename query_t>
+std::pair<std::set<graph_t>, std::set<graph_t>> TimestampRangeSearch(
+  const FilteredVamanaIndex<graph_t>& index, const std::vector<GraphNode<graph_t>>& S, const query_t& xq, 
+  const unsigned int k, const unsigned int L, const std::vector<CategoricalAttributeFilter>& queryFilters, 
+  const TimestampRangeFilter& range, const unsigned int bruteForceLimit, const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  SearchBudget* budget) {
+
+  ReentrantLockGuard updateLock(index.getUpdateLock());
+  const Graph<graph_t>& G = index.getGraph();
+  std::vector<TimestampRangeFilter> rangeFilters = {range};
+
+  // Enumerate the points inside the range and keep those that also pass the categorical filters
+  std::vector<unsigned int> qualifying = index.getNodesInTimestampRange(range);
+  if (!queryFilters.empty()) {
+    ReadLockGuard<ReadWriteLock> filtersLock(index.getFiltersLock());
+    const LabelIndex& labels = index.getLabelIndex();
+    std::vector<unsigned int> labelSlots = findLabelSlots(labels, queryFilters);
+    std::vector<unsigned int> matching;
+    for (auto i : qualifying) {
+      if (passesQueryFilters(labels, labelSlots, MATCH_ALL, G.getNode(i)->getData(), rangeFilters)) {
+        matching.push_back(i);
+      }
+    }
+    qualifying.swap(matching);
+  }
+
+  // Few qualifying points: scan them exhaustively
+  if (qualifying.size() <= bruteForceLimit) {
+    return ExhaustiveSearch(index, qualifying, xq, k, distanceSaveMethod);
   }
 
-  // Reassign only the closest k candidates to the candidates set for final result
-  candidates.clear();
-  auto it = newCandidates.begin();
-  for (unsigned int i = 0; i < k && it != newCandidates.end(); i++, it++) {
-    candidates.insert(*it);
+  // Many qualifying points: traverse the graph, starting also from points spread evenly across the range
+  std::vector<GraphNode<graph_t>> seeds = S;
+  unsigned int seedsCount = std::max(1u, std::min(L, (unsigned int)qualifying.size()));
+  for (unsigned int i = 0; i < seedsCount; i++) {
+    seeds.push_back(GraphNode<graph_t>(G.getNode(qualifying[(size_t)i * qualifying.size() / seedsCount])->getData()));
   }
 
-  return {candidates, visited}; // Return the set of candidates and visited nodes
+  return FilteredGreedySearch(index, seeds, xq, k, L, queryFilters, distanceSaveMethod, rangeFilters, MATCH_ALL, budget);
 
 }
 
@@ -313,7 +629,8 @@ template std::pair<std::set<DataVector<float>>, std::set<DataVector<float>>> Gre
   const DataVector<float>& xq, 
   unsigned int k, 
   unsigned int L,
-  const DISTANCE_SAVE_METHOD distanceSaveMethod
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  SearchBudget* budget
 );
 
 template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<float>>> GreedySearch(
@@ -322,7 +639,8 @@ template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<floa
   const BaseDataVector<float>& xq, 
   unsigned int k, 
   unsigned int L,
-  const DISTANCE_SAVE_METHOD distanceSaveMethod
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  SearchBudget* budget
 );
 
 template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<float>>> GreedySearch(
@@ -331,7 +649,8 @@ template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<floa
   const QueryDataVector<float>& xq, 
   unsigned int k, 
   unsigned int L,
-  const DISTANCE_SAVE_METHOD distanceSaveMethod
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  SearchBudget* budget
 );
 
 // Filtered Greedy Search
@@ -342,7 +661,10 @@ template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<floa
   const unsigned int k, 
   const unsigned int L, 
   const std::vector<CategoricalAttributeFilter>& queryFilters,
-  const DISTANCE_SAVE_METHOD distanceSaveMethod
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  const std::vector<TimestampRangeFilter>& rangeFilters,
+  const LabelMatch labelMatch,
+  SearchBudget* budget
 );
 
 template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<float>>> FilteredGreedySearch(
@@ -352,5 +674,53 @@ template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<floa
   const unsigned int k, 
   const unsigned int L, 
   const std::vector<CategoricalAttributeFilter>& queryFilters,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  const std::vector<TimestampRangeFilter>& rangeFilters,
+  const LabelMatch labelMatch,
+  SearchBudget* budget
+);
+
+template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<float>>> FilteredGreedySearch(
+  const FilteredVamanaIndex<BaseDataVector<float>>& index, 
+  const BaseDataVector<float>& xq, 
+  const unsigned int k, 
+  const unsigned int L, 
+  const std::vector<CategoricalAttributeFilter>& queryFilters,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  const std::vector<TimestampRangeFilter>& rangeFilters,
+  const LabelMatch labelMatch,
+  SearchBudget* budget
+);
+
+template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<float>>> FilteredGreedySearch(
+  const FilteredVamanaIndex<BaseDataVector<float>>& index, 
+  const QueryDataVector<float>& xq, 
+  const unsigned int k, 
+  const unsigned int L, 
+  const std::vector<CategoricalAttributeFilter>& queryFilters,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  const std::vector<TimestampRangeFilter>& rangeFilters,
+  const LabelMatch labelMatch,
+  SearchBudget* budget
+);
+
+template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<float>>> TimestampRangeSearch(
+  const FilteredVamanaIndex<BaseDataVector<float>>& index, 
+  const std::vector<GraphNode<BaseDataVector<float>>>& S, 
+  const QueryDataVector<float>& xq, 
+  const unsigned int k, 
+  const unsigned int L, 
+  const std::vector<CategoricalAttributeFilter>& queryFilters,
+  const TimestampRangeFilter& range,
+  const unsigned int bruteForceLimit,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod,
+  SearchBudget* budget
+);
+
+template std::pair<std::set<BaseDataVector<float>>, std::set<BaseDataVector<float>>> ExhaustiveSearch(
+  const VamanaIndex<BaseDataVector<float>>& index, 
+  const std::vector<unsigned int>& points, 
+  const QueryDataVector<float>& xq, 
+  const unsigned int k, 
   const DISTANCE_SAVE_METHOD distanceSaveMethod
 );
@@ -0,0 +1,120 @@
+#include "../../../include/IndexHandle.h"
+#include "../../../include/VamanaIndex.h"
+#include "../../../include/FilteredVamanaIndex.h"
+#include "../../../include/StichedVamanaIndex.h"
+#include "../../../include/RangeVamanaIndex.h"
+#include "../../../include/DataVector.h"
+#include "../../../include/BQDataVectors.h"
+
+#include <sys/stat.h>
+
+/**
+ * @brief Returns the last modification time of a file, in nanoseconds on Linux and in whole seconds elsewhere.
+ *
+ * @param filename the full path of the file
+ * @param time output parameter, set to the modification time of the file
+ * @return true if the file exists, false otherwise
+ */
+template <typename index_t>
+bool IndexHandle<index_t>::getModificationTime(const std::string& filename, long long& time) {
+
+  struct stat status;
+  if (stat(filename.c_str(), &status) != 0) {
+    return false;
+  }
+#ifdef __linux__
+  time = (long long)status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec;
+#else
+  time = (long long)status.st_mtime * 1000000000LL;
+#endif
+  return true;
+
+}
+
+/**
+ * @brief Returns the current snapshot of the index, with an atomic load of the pointer.
+ *
+ * @return the current snapshot, or an empty pointer if no index was published yet
+ */
+template <typename index_t>
+std::shared_ptr<index_t> IndexHandle<index_t>::acquire(void) const {
+
+  return std::atomic_load(&this->current);
+
+}
+
+/**
+ * @brief Publishes a new snapshot of the index with an atomic exchange of the pointer. The searches that already
+ * acquired the previous snapshot hold their own references to it, so it is not freed under them.
+ *
+ * @param index the new snapshot
+ * @return the previous snapshot
+ */
+template <typename index_t>
+std::shared_ptr<index_t> IndexHandle<index_t>::publish(const std::shared_ptr<index_t>& index) {
+
+  std::shared_ptr<index_t> previous = std::atomic_exchange(&this->current, index);
+  this->generation++;
+  return previous;
+
+}
+
+/**
+ * @brief Loads an index from a file into a new snapshot and publishes it. The modification time of the file is
+ * taken before loading, so a file that is replaced again during the load is loaded once more by reloadIfModified.
+ *
+ * @param filename the full path of the index file
+ * @param baseFile optional path of the dataset file of a graph-only index file
+ * @return true if the index was loaded and published, false otherwise
+ */
+template <typename index_t>
+bool IndexHandle<index_t>::load(const std::string& filename, const std::string& baseFile) {
+
+  std::lock_guard<std::mutex> lock(this->reloadMutex);
+
+  long long modified;
+  if (!getModificationTime(filename, modified)) {
+    std::cerr << "Error: the index file " << filename << " does not exist." << std::endl;
+    return false;
+  }
+
+  std::shared_ptr<index_t> index = std::make_shared<index_t>();
+  if (!index->loadGraph(filename, baseFile)) {
+    return false;
+  }
+
+  this->loadedFile = filename;
+  this->loadedBaseFile = baseFile;
+  this->loadedTime = modified;
+  this->publish(index);
+  return true;
+
+}
+
+/**
+ * @brief Loads the index file of the last load again if its modification time changed.
+ *
+ * @return true if a new snapshot was published, false if the file did not change or could not be loaded
+ */
+template <typename index_t>
+bool IndexHandle<index_t>::reloadIfModified(void) {
+
+  std::string filename, baseFile;
+  {
+    std::lock_guard<std::mutex> lock(this->reloadMutex);
+    long long modified;
+    if (this->loadedFile.empty() || !getModificationTime(this->loadedFile, modified) || modified == this->loadedTime) {
+      return false;
+    }
+    filename = this->loadedFile;
+    baseFile = this->loadedBaseFile;
+  }
+
+  return this->load(filename, baseFile);
+
+}
+
+template class IndexHandle<VamanaIndex<DataVector<float>>>;
+template class IndexHandle<FilteredVamanaIndex<BaseDataVector<float>>>;
+template class IndexHandle<StichedVamanaIndex<BaseDataVector<float>>>;
+template class IndexHandle<RangeVamanaIndex<BaseDataVector<float>>>;
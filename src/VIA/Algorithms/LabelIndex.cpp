@@ -0,0 +1,411 @@
+#include "../../../include/LabelIndex.h"
+
+#include <algorithm>
+
+const unsigned int LabelIndex::NO_LABEL;
+const unsigned int LabelIndex::NO_BITMAP;
+
+/**
+ * @brief Writes a single value of a trivially copyable type into a binary stream.
+ */
+template <typename value_t> static inline void writeBinary(std::ostream& out, const value_t& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/**
+ * @brief Reads a single value of a trivially copyable type from a binary stream.
+ */
+template <typename value_t> static inline bool readBinary(std::istream& in, value_t& value) {
+  in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return static_cast<bool>(in);
+}
+
+/**
+ * @brief Builds the index from the label of every point.
+ *
+ * @param pointLabels the label of every point, indexed by point
+ * @param denseDivisor a label gets a bitmap if it is carried by at least pointsCount / denseDivisor points
+ */
+void LabelIndex::build(const std::vector<unsigned int>& pointLabels, const unsigned int denseDivisor) {
+
+  this->clear();
+  this->pointsCount = pointLabels.size();
+
+  // Collect the distinct labels, so that every label gets its slot in sorted order
+  this->labels = pointLabels;
+  std::sort(this->labels.begin(), this->labels.end());
+  this->labels.erase(std::unique(this->labels.begin(), this->labels.end()), this->labels.end());
+  this->buildLabelLookup();
+
+  // Fill the posting lists with a single pass over the points, which keeps every list sorted
+  this->postings.resize(this->labels.size());
+  for (unsigned int i = 0; i < this->pointsCount; i++) {
+    this->postings[this->findLabel(pointLabels[i])].push_back(i);
+  }
+
+  this->buildPointSlots();
+  this->buildBitmaps(denseDivisor);
+
+}
+
+/**
+ * @brief Builds the index from the label set of every point.
+ *
+ * @param pointLabels the labels of every point, indexed by point (duplicates are ignored)
+ * @param denseDivisor a label gets a bitmap if it is carried by at least pointsCount / denseDivisor points
+ */
+void LabelIndex::build(const std::vector<std::vector<unsigned int>>& pointLabels, const unsigned int denseDivisor) {
+
+  this->clear();
+  this->pointsCount = pointLabels.size();
+
+  for (const auto& pointSet : pointLabels) {
+    this->labels.insert(this->labels.end(), pointSet.begin(), pointSet.end());
+  }
+  std::sort(this->labels.begin(), this->labels.end());
+  this->labels.erase(std::unique(this->labels.begin(), this->labels.end()), this->labels.end());
+  this->buildLabelLookup();
+
+  // A point is appended at most once to every list, even if its set repeats a label
+  this->postings.resize(this->labels.size());
+  for (unsigned int i = 0; i < this->pointsCount; i++) {
+    for (unsigned int label : pointLabels[i]) {
+      std::vector<unsigned int>& posting = this->postings[this->findLabel(label)];
+      if (posting.empty() || posting.back() != i) {
+        posting.push_back(i);
+      }
+    }
+  }
+
+  this->buildPointSlots();
+  this->buildBitmaps(denseDivisor);
+
+}
+
+/**
+ * @brief Builds the label sets of the points from the posting lists.
+ */
+void LabelIndex::buildPointSlots(void) {
+
+  // Count the labels of every point and turn the counts into offsets
+  this->pointOffsets.assign(this->pointsCount + 1, 0);
+  for (const auto& posting : this->postings) {
+    for (unsigned int point : posting) {
+      this->pointOffsets[point + 1]++;
+    }
+  }
+  for (unsigned int i = 0; i < this->pointsCount; i++) {
+    this->pointOffsets[i + 1] += this->pointOffsets[i];
+  }
+
+  // Visiting the labels in slot order leaves the label set of every point sorted
+  std::vector<unsigned int> next(this->pointOffsets.begin(), this->pointOffsets.end() - 1);
+  this->pointSlots.resize(this->pointOffsets.back());
+  for (unsigned int slot = 0; slot < this->postings.size(); slot++) {
+    for (unsigned int point : this->postings[slot]) {
+      this->pointSlots[next[point]++] = slot;
+    }
+  }
+
+}
+
+/**
+ * @brief Computes the label set of a point relative to the label set of a reference point, as a bitset where
+ * bit i is set if the point carries the i-th label of the reference. Two such masks turn the intersections and
+ * subset tests between label sets into a few word operations.
+ *
+ * @param point the index of the point
+ * @param reference the index of the reference point
+ * @param mask output array of getMaskWords(reference) words
+ */
+void LabelIndex::getLabelMask(const unsigned int point, const unsigned int reference, uint64_t* mask) const {
+
+  std::fill(mask, mask + this->getMaskWords(reference), 0);
+
+  // Merge the two sorted label sets
+  const unsigned int* a = this->getPointSlots(point);
+  const unsigned int* aEnd = a + this->getPointLabelsCount(point);
+  const unsigned int* b = this->getPointSlots(reference);
+  const unsigned int* bEnd = b + this->getPointLabelsCount(reference);
+
+  for (unsigned int i = 0; a != aEnd && b != bEnd; ) {
+    if (*a < *b) {
+      a++;
+    } else if (*b < *a) {
+      b++;
+      i++;
+    } else {
+      mask[i >> 6] |= (uint64_t)1 << (i & 63);
+      a++;
+      b++;
+      i++;
+    }
+  }
+
+}
+
+/**
+ * @brief Builds the bitmaps of the labels whose cardinality reaches the density threshold.
+ *
+ * @param denseDivisor a label is dense if it is carried by at least pointsCount / denseDivisor points
+ */
+void LabelIndex::buildBitmaps(const unsigned int denseDivisor) {
+
+  unsigned int words = (this->pointsCount + 63) / 64;
+  this->bitmapOffsets.assign(this->labels.size(), NO_BITMAP);
+  this->bitmaps.clear();
+
+  for (unsigned int slot = 0; slot < this->labels.size(); slot++) {
+    if ((unsigned long long)this->postings[slot].size() * std::max(1u, denseDivisor) < this->pointsCount) {
+      continue;
+    }
+
+    unsigned int offset = this->bitmaps.size();
+    this->bitmapOffsets[slot] = offset;
+    this->bitmaps.resize(offset + words, 0);
+    for (unsigned int point : this->postings[slot]) {
+      this->bitmaps[offset + (point >> 6)] |= (uint64_t)1 << (point & 63);
+    }
+  }
+  this->bitmapPoints = this->pointsCount;
+
+}
+
+/**
+ * @brief Appends a point to the index, as the point after the last one. The point is added to the end of the
+ * posting lists of its labels and is not added to the bitmaps, which keep covering the points of the last build,
+ * so appending takes amortized constant time. A label that no point carried before gets a slot of its own, which
+ * moves the slots of the labels that sort after it.
+ *
+ * @param pointLabels the labels of the point (duplicates are ignored)
+ * @return the labels that no point carried before, sorted
+ */
+std::vector<unsigned int> LabelIndex::addPoint(const std::vector<unsigned int>& pointLabels) {
+
+  std::vector<unsigned int> added;
+  for (unsigned int label : pointLabels) {
+    if (this->findLabel(label) == NO_LABEL) {
+      added.push_back(label);
+    }
+  }
+
+  // New labels are merged into the sorted labels, and the slots of the points are shifted past them. Slots keep
+  // their relative order, so the label sets of the points stay sorted.
+  if (!added.empty()) {
+    std::sort(added.begin(), added.end());
+    added.erase(std::unique(added.begin(), added.end()), added.end());
+
+    std::vector<unsigned int> labels(this->labels.size() + added.size());
+    std::merge(this->labels.begin(), this->labels.end(), added.begin(), added.end(), labels.begin());
+
+    std::vector<unsigned int> moved(this->labels.size());
+    std::vector<std::vector<unsigned int>> postings(labels.size());
+    std::vector<unsigned int> bitmapOffsets(labels.size(), NO_BITMAP);
+    for (unsigned int slot = 0, newSlot = 0; slot < this->labels.size(); slot++, newSlot++) {
+      while (labels[newSlot] != this->labels[slot]) {
+        newSlot++;
+      }
+      moved[slot] = newSlot;
+      postings[newSlot].swap(this->postings[slot]);
+      bitmapOffsets[newSlot] = this->bitmapOffsets[slot];
+    }
+    for (auto& slot : this->pointSlots) {
+      slot = moved[slot];
+    }
+
+    this->labels.swap(labels);
+    this->postings.swap(postings);
+    this->bitmapOffsets.swap(bitmapOffsets);
+    this->buildLabelLookup();
+  }
+
+  std::vector<unsigned int> slots;
+  for (unsigned int label : pointLabels) {
+    slots.push_back(this->findLabel(label));
+  }
+  std::sort(slots.begin(), slots.end());
+  slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+  for (unsigned int slot : slots) {
+    this->postings[slot].push_back(this->pointsCount);
+    this->pointSlots.push_back(slot);
+  }
+  if (this->pointOffsets.empty()) {
+    this->pointOffsets.push_back(0);
+  }
+  this->pointOffsets.push_back(this->pointSlots.size());
+  this->pointsCount++;
+
+  return added;
+
+}
+
+/**
+ * @brief Removes the contents of the index.
+ */
+void LabelIndex::clear(void) {
+
+  this->pointsCount = 0;
+  this->labels.clear();
+  this->postings.clear();
+  this->pointOffsets.clear();
+  this->pointSlots.clear();
+  this->labelSlots.clear();
+  this->bitmapOffsets.clear();
+  this->bitmaps.clear();
+  this->bitmapPoints = 0;
+
+}
+
+/**
+ * @brief Builds a direct lookup table from label values to slots, if the label values are small enough for
+ * the table to be at most a few times larger than the list of labels. Otherwise labels are found with a
+ * binary search.
+ */
+void LabelIndex::buildLabelLookup(void) {
+
+  this->labelSlots.clear();
+  if (this->labels.empty() || this->labels.back() >= 4 * this->labels.size() + 1024) {
+    return;
+  }
+
+  this->labelSlots.assign(this->labels.back() + 1, NO_LABEL);
+  for (unsigned int slot = 0; slot < this->labels.size(); slot++) {
+    this->labelSlots[this->labels[slot]] = slot;
+  }
+
+}
+
+/**
+ * @brief Returns the posting list of the label of a slot.
+ *
+ * @param slot the slot of the label
+ * @return the indexes of the points that carry the label, empty for NO_LABEL
+ */
+const std::vector<unsigned int>& LabelIndex::getPoints(const unsigned int slot) const {
+
+  static const std::vector<unsigned int> empty;
+  return slot < this->postings.size() ? this->postings[slot] : empty;
+
+}
+
+/**
+ * @brief Writes the index into a binary stream: the labels with their posting lists, followed by the bitmaps
+ * of the dense labels.
+ *
+ * @param out the stream to write to
+ * @return true if the index was written successfully, false otherwise
+ */
+bool LabelIndex::save(std::ostream& out) const {
+
+  // Points appended after the last build are not in the bitmaps, which are extended to all the points in the file
+  std::vector<unsigned int> bitmapOffsets = this->bitmapOffsets;
+  std::vector<uint64_t> extended;
+  const std::vector<uint64_t>* bitmaps = &this->bitmaps;
+  if (this->bitmapPoints != this->pointsCount) {
+    unsigned int words = (this->pointsCount + 63) / 64;
+    for (unsigned int slot = 0; slot < this->labels.size(); slot++) {
+      if (bitmapOffsets[slot] == NO_BITMAP) {
+        continue;
+      }
+      bitmapOffsets[slot] = extended.size();
+      extended.resize(extended.size() + words, 0);
+      for (unsigned int point : this->postings[slot]) {
+        extended[bitmapOffsets[slot] + (point >> 6)] |= (uint64_t)1 << (point & 63);
+      }
+    }
+    bitmaps = &extended;
+  }
+
+  writeBinary(out, static_cast<uint32_t>(this->pointsCount));
+  writeBinary(out, static_cast<uint32_t>(this->labels.size()));
+
+  for (unsigned int slot = 0; slot < this->labels.size(); slot++) {
+    writeBinary(out, static_cast<uint32_t>(this->labels[slot]));
+    writeBinary(out, static_cast<uint32_t>(bitmapOffsets[slot]));
+    writeBinary(out, static_cast<uint32_t>(this->postings[slot].size()));
+    out.write(reinterpret_cast<const char*>(this->postings[slot].data()), this->postings[slot].size() * sizeof(uint32_t));
+  }
+
+  writeBinary(out, static_cast<uint64_t>(bitmaps->size()));
+  out.write(reinterpret_cast<const char*>(bitmaps->data()), bitmaps->size() * sizeof(uint64_t));
+
+  return static_cast<bool>(out);
+
+}
+
+/**
+ * @brief Reads an index that was written with save.
+ *
+ * @param in the stream to read from
+ * @return true if the index was read successfully, false otherwise (the index is left empty)
+ */
+bool LabelIndex::load(std::istream& in) {
+
+  static_assert(sizeof(unsigned int) == sizeof(uint32_t), "Posting lists are stored as 32-bit point indexes");
+
+  this->clear();
+
+  uint32_t pointsCount, labelsCount;
+  if (!readBinary(in, pointsCount) || !readBinary(in, labelsCount)) {
+    return false;
+  }
+
+  this->pointsCount = pointsCount;
+
+  // Read the posting lists, the label sets of the points are recovered from them
+  for (uint32_t slot = 0; slot < labelsCount; slot++) {
+    uint32_t label, bitmapOffset, cardinality;
+    readBinary(in, label);
+    readBinary(in, bitmapOffset);
+    if (!readBinary(in, cardinality) || cardinality > pointsCount) {
+      this->clear();
+      return false;
+    }
+
+    this->labels.push_back(label);
+    this->bitmapOffsets.push_back(bitmapOffset);
+    this->postings.emplace_back(cardinality);
+    in.read(reinterpret_cast<char*>(this->postings[slot].data()), cardinality * sizeof(uint32_t));
+
+    for (unsigned int point : this->postings[slot]) {
+      if (point >= pointsCount) {
+        this->clear();
+        return false;
+      }
+    }
+  }
+
+  // There is at most one bitmap per label, and every bitmap must fit inside the words that were read
+  uint64_t words, wordsPerBitmap = (pointsCount + 63) / 64;
+  if (!readBinary(in, words) || words > wordsPerBitmap * labelsCount) {
+    this->clear();
+    return false;
+  }
+  this->bitmaps.resize(words);
+  in.read(reinterpret_cast<char*>(this->bitmaps.data()), words * sizeof(uint64_t));
+
+  for (unsigned int offset : this->bitmapOffsets) {
+    if (offset != NO_BITMAP && offset + wordsPerBitmap > words) {
+      this->clear();
+      return false;
+    }
+  }
+
+  if (!in) {
+    this->clear();
+    return false;
+  }
+
+  // The slots of the labels are their positions in sorted order
+  if (!std::is_sorted(this->labels.begin(), this->labels.end()) || std::adjacent_find(this->labels.begin(), this->labels.end()) != this->labels.end()) {
+    this->clear();
+    return false;
+  }
+
+  this->bitmapPoints = pointsCount;
+  this->buildLabelLookup();
+  this->buildPointSlots();
+  return true;
+
+}
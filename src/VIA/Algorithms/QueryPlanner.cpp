@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include "../../../include/QueryPlanner.h"
+#include "../../../include/GreedySearch.h"
+
+/**
+ * @brief Checks whether a point satisfies the filters of a query, according to its query type.
+ *
+ * @param labels The label index of the searched index
+ * @param slot The slot of the label of the query in the label index
+ * @param p The point to check
+ * @param xq The query vector
+ *
+ * @return true if the point satisfies the filters of the query, false otherwise
+ */
+template <typename vamana_t>
+static bool satisfiesQuery(const LabelIndex& labels, const unsigned int slot, const vamana_t& p, const QueryDataVector<float>& xq) {
+
+  unsigned int type = xq.getQueryType();
+
+  if ((type == C_EQUALS_v || type == C_EQUALS_v_AND_l_LEQ_T_LEQ_r) && !labels.contains(slot, p.getIndex())) {
+    return false;
+  }
+
+  if ((type == l_LEQ_T_LEQ_r || type == C_EQUALS_v_AND_l_LEQ_T_LEQ_r) && !TimestampRangeFilter(xq.getL(), xq.getR()).contains(p.getT())) {
+    return false;
+  }
+
+  return true;
+
+}
+
+/**
+ * @brief Constructor of the QueryPlanner.
+ *
+ * @param index The index the queries are executed on. Every traversal starts from the start nodes of the labels
+ * of its query, or from the global medoid of the index for queries without a label.
+ * @param forcedPlan The plan to use for every query, or AUTO_PLAN to let the planner choose.
+ * @param filteredPenalty The relative cost of a filtered traversal step compared to an unfiltered one.
+ * @param maxExpansion The maximum factor by which L can be enlarged for an unfiltered traversal.
+ */
+template <typename vamana_t>
+QueryPlanner<vamana_t>::QueryPlanner(
+  const FilteredVamanaIndex<vamana_t>& index, const QUERY_PLAN forcedPlan, const float filteredPenalty, const unsigned int maxExpansion)
+  : index(index), forcedPlan(forcedPlan), filteredPenalty(filteredPenalty), maxExpansion(maxExpansion) {
+
+  // The average out-degree converts the number of expanded nodes of a traversal into distance computations
+  const Graph<vamana_t>& G = index.getGraph();
+  unsigned long long edges = 0;
+  for (unsigned int i = 0; i < G.getNodesCount(); i++) {
+    edges += G.getNodeNeighbors(i)->size();
+  }
+  this->averageDegree = G.getNodesCount() == 0 ? 1.0 : std::max(1.0, (double)edges / G.getNodesCount());
+
+}
+
+/**
+ * @brief Estimates the number of points that satisfy the filters of a query.
+ *
+ * @param xq The query vector.
+ * @return The exact number of qualifying points for query types 0, 1 and 2, and an upper bound for type 3.
+ */
+template <typename vamana_t>
+unsigned int QueryPlanner<vamana_t>::estimateQualifyingPoints(const QueryDataVector<float>& xq) const {
+
+  switch (xq.getQueryType()) {
+    case C_EQUALS_v:
+      return this->index.getLabelCardinality(CategoricalAttributeFilter(xq.getV()));
+    case l_LEQ_T_LEQ_r:
+      return this->index.countNodesInTimestampRange(TimestampRangeFilter(xq.getL(), xq.getR()));
+    case C_EQUALS_v_AND_l_LEQ_T_LEQ_r:
+      return std::min(
+        this->index.getLabelCardinality(CategoricalAttributeFilter(xq.getV())),
+        this->index.countNodesInTimestampRange(TimestampRangeFilter(xq.getL(), xq.getR()))
+      );
+    default:
+      return this->index.getGraph().getNodesCount();
+  }
+
+}
+
+/**
+ * @brief Chooses the plan with the lowest estimated cost for a query.
+ *
+ * @param xq The query vector.
+ * @param L The size of the candidate list of the graph traversals.
+ * @return The chosen plan (the forced plan, if the planner was given one).
+ */
+template <typename vamana_t>
+QUERY_PLAN QueryPlanner<vamana_t>::choosePlan(const QueryDataVector<float>& xq, const unsigned int L) const {
+
+  if (this->forcedPlan != AUTO_PLAN) {
+    return this->forcedPlan;
+  }
+
+  unsigned int n = this->index.getGraph().getNodesCount();
+  unsigned int qualifying = this->estimateQualifyingPoints(xq);
+  if (qualifying == 0 || n == 0) {
+    return BRUTE_FORCE;
+  }
+
+  // Estimated number of distance computations of every plan
+  double selectivity = (double)qualifying / n;
+  double bruteForceCost = qualifying;
+  double filteredCost = L * this->averageDegree * (xq.getQueryType() == NO_FILTER ? 1.0 : this->filteredPenalty);
+  double unfilteredCost = (L / selectivity) * this->averageDegree;
+
+  // The unfiltered traversal can not keep enough qualifying candidates if L has to grow too much
+  if (L / selectivity > (double)L * this->maxExpansion) {
+    unfilteredCost = INFINITY;
+  }
+
+  if (bruteForceCost <= filteredCost && bruteForceCost <= unfilteredCost) {
+    return BRUTE_FORCE;
+  }
+
+  return unfilteredCost < filteredCost ? UNFILTERED_GRAPH : FILTERED_GRAPH;
+
+}
+
+/**
+ * @brief Executes a query with the plan chosen by choosePlan.
+ *
+ * @param xq The query vector.
+ * @param k The number of nearest neighbors to return.
+ * @param L The size of the candidate list of the graph traversals.
+ * @param plan Output parameter, set to the plan that was executed.
+ * @param budget Optional limits of the graph traversals, the exhaustive scans are not limited.
+ *
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+ */
+template <typename vamana_t>
+std::pair<std::set<vamana_t>, std::set<vamana_t>> QueryPlanner<vamana_t>::search(
+  const QueryDataVector<float>& xq, const unsigned int k, const unsigned int L, QUERY_PLAN& plan, SearchBudget* budget) const {
+
+  // The plan and the searches it runs see the same points, since consolidate waits for them
+  ReentrantLockGuard updateLock(this->index.getUpdateLock());
+  unsigned int type = xq.getQueryType();
+  bool rangeQuery = type == l_LEQ_T_LEQ_r || type == C_EQUALS_v_AND_l_LEQ_T_LEQ_r;
+  TimestampRangeFilter range(xq.getL(), xq.getR());
+
+  std::vector<CategoricalAttributeFilter> Fx;
+  if (type == C_EQUALS_v || type == C_EQUALS_v_AND_l_LEQ_T_LEQ_r) {
+    Fx.push_back(CategoricalAttributeFilter(xq.getV()));
+  }
+
+  plan = this->choosePlan(xq, L);
+
+  // Scan the qualifying points: the posting list of the label, the points of the range, or all the points
+  if (plan == BRUTE_FORCE) {
+    if (rangeQuery) {
+      return TimestampRangeSearch(this->index, this->index.getQueryStartNodes(Fx, xq), xq, k, L, Fx, range, UINT_MAX);
+    }
+    if (type == C_EQUALS_v) {
+      std::vector<unsigned int> postings;
+      {
+        ReadLockGuard<ReadWriteLock> lock(this->index.getFiltersLock());
+        postings = this->index.getNodesWithLabel(Fx[0]);
+      }
+      return ExhaustiveSearch(this->index, postings, xq, k);
+    }
+
+    std::vector<unsigned int> points(this->index.getGraph().getNodesCount());
+    for (unsigned int i = 0; i < points.size(); i++) {
+      points[i] = i;
+    }
+    return ExhaustiveSearch(this->index, points, xq, k);
+  }
+
+  // Traverse the graph visiting only the points that satisfy the filters
+  if (plan == FILTERED_GRAPH) {
+    if (rangeQuery) {
+      return TimestampRangeSearch(this->index, this->index.getQueryStartNodes(Fx, xq), xq, k, L, Fx, range, 0, NONE, budget);
+    }
+    return FilteredGreedySearch(this->index, xq, k, L, Fx, NONE, std::vector<TimestampRangeFilter>(), MATCH_ALL, budget);
+  }
+
+  // Traverse the graph ignoring the filters, with L enlarged by the inverse selectivity, and filter the results
+  unsigned int n = std::max(1u, this->index.getGraph().getNodesCount());
+  double selectivity = std::max((double)this->estimateQualifyingPoints(xq) / n, 1.0 / n);
+  unsigned int expandedL = std::min((double)L * this->maxExpansion, std::ceil(L / selectivity));
+  expandedL = std::max(expandedL, k);
+
+  std::pair<std::set<vamana_t>, std::set<vamana_t>> result = FilteredGreedySearch(
+    this->index, xq, expandedL, expandedL, std::vector<CategoricalAttributeFilter>(), NONE,
+    std::vector<TimestampRangeFilter>(), MATCH_ALL, budget
+  );
+
+  std::vector<std::pair<double, vamana_t>> qualifying;
+  {
+    ReadLockGuard<ReadWriteLock> lock(this->index.getFiltersLock());
+    const LabelIndex& labels = this->index.getLabelIndex();
+    unsigned int slot = labels.findLabel(xq.getV());
+    for (const auto& p : result.first) {
+      if (satisfiesQuery(labels, slot, p, xq)) {
+        qualifying.emplace_back(euclideanDistance(p, xq), p);
+      }
+    }
+  }
+
+  unsigned int count = std::min((size_t)k, qualifying.size());
+  std::partial_sort(qualifying.begin(), qualifying.begin() + count, qualifying.end(),
+    [](const std::pair<double, vamana_t>& a, const std::pair<double, vamana_t>& b) { return a.first < b.first; });
+
+  std::set<vamana_t> nearest;
+  for (unsigned int i = 0; i < count; i++) {
+    nearest.insert(qualifying[i].second);
+  }
+
+  return {nearest, result.second};
+
+}
+
+/**
+ * @brief Returns a printable name for a plan.
+ *
+ * @param plan The plan.
+ * @return The name of the plan.
+ */
+template <typename vamana_t>
+std::string QueryPlanner<vamana_t>::getPlanName(const QUERY_PLAN plan) {
+
+  switch (plan) {
+    case BRUTE_FORCE: return "brute-force";
+    case FILTERED_GRAPH: return "filtered";
+    case UNFILTERED_GRAPH: return "unfiltered";
+    default: return "auto";
+  }
+
+}
+
+/**
+ * @brief Parses a plan from its name, as accepted on the command line (auto, brute-force, filtered, unfiltered).
+ *
+ * @param name The name of the plan.
+ * @param plan Output parameter, set to the parsed plan.
+ * @return true if the name is valid, false otherwise.
+ */
+template <typename vamana_t>
+bool QueryPlanner<vamana_t>::parsePlan(const std::string& name, QUERY_PLAN& plan) {
+
+  for (QUERY_PLAN candidate : {AUTO_PLAN, BRUTE_FORCE, FILTERED_GRAPH, UNFILTERED_GRAPH}) {
+    if (getPlanName(candidate) == name) {
+      plan = candidate;
+      return true;
+    }
+  }
+
+  return false;
+
+}
+
+template class QueryPlanner<BaseDataVector<float>>;
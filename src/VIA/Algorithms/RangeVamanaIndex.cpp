@@ -0,0 +1,574 @@
+#include "../../../include/RangeVamanaIndex.h"
+#include "../../../include/VamanaIndex.h"
+#include "../../../include/graphics.h"
+#include "../../../include/distance.h"
+#include "../../../include/ThreadPool.h"
+#include "../../../include/SearchCandidates.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <climits>
+#include <cmath>
+#include <sstream>
+
+// Tag of the segment layers section in graph-only index files ("RNGE" when read as bytes)
+static const uint32_t RANGE_LAYERS_SECTION = 0x45474e52;
+
+// Entry of the segments of a layer that are leaves, and so have no graph
+static const unsigned int NO_ENTRY = UINT_MAX;
+
+/**
+ * @brief Returns the positions covered by a segment of a layer.
+ *
+ * @param depth the depth of the layer
+ * @param segment the index of the segment inside the layer
+ * @param begin output parameter, set to the first position of the segment
+ * @param end output parameter, set to one past the last position of the segment
+ */
+template <typename vamana_t>
+void RangeVamanaIndex<vamana_t>::getSegmentBounds(const unsigned int depth, const unsigned int segment, unsigned int& begin, unsigned int& end) const {
+
+  // Splitting at these bounds halves every segment, so the children of (d, s) are (d + 1, 2s) and (d + 1, 2s + 1)
+  unsigned long long n = this->P.size();
+  begin = (segment * n) >> depth;
+  end = ((segment + 1ULL) * n) >> depth;
+
+}
+
+/**
+ * @brief Rebuilds the root layer from the graph of the index, which is stored with the graph itself.
+ */
+template <typename vamana_t>
+void RangeVamanaIndex<vamana_t>::buildRootLayer(void) {
+
+  unsigned int n = this->P.size();
+  if (this->layers.empty()) {
+    this->layers.resize(1);
+  }
+
+  RangeLayer& root = this->layers[0];
+  root.offsets.assign(n + 1, 0);
+  root.neighbors.clear();
+
+  for (unsigned int position = 0; position < n; position++) {
+    for (const auto& neighbor : *this->G.getNode(this->timestampOrder[position])->getNeighborsVector()) {
+      root.neighbors.push_back(this->positions[neighbor.getIndex()]);
+    }
+    root.offsets[position + 1] = root.neighbors.size();
+  }
+
+  root.entries.assign(1, n == 0 ? NO_ENTRY : this->positions[this->medoid]);
+
+}
+
+/**
+ * @brief Builds the graphs of the segments of every layer from a given depth on. Every segment with more than
+ * leafSize points (more than one for the root) gets a Vamana graph built only on its own points.
+ *
+ * @param P the points of the index
+ * @param timestampOrder the indexes of the points, sorted by their timestamp
+ * @param leafSize the maximum number of points of the segments that do not get a graph
+ * @param alpha the parameter alpha of every segment graph
+ * @param L the parameter L of every segment graph
+ * @param R the parameter R of every segment graph
+ * @param layers the layers of the index, extended with the new ones
+ * @param firstDepth the depth of the first layer to build
+ * @param threads the number of threads that build the segment graphs
+ * @param visualized whether to display the progress of the construction
+ */
+template <typename vamana_t>
+static void buildSegmentLayers(
+  const std::vector<vamana_t>& P, const std::vector<unsigned int>& timestampOrder, const unsigned int leafSize, const float alpha,
+  const unsigned int L, const unsigned int R, std::vector<RangeLayer>& layers, const unsigned int firstDepth, unsigned int threads,
+  const bool visualized) {
+
+  unsigned long long n = P.size();
+
+  // Collect the segments that get a graph, layer after layer, so the largest ones are built first
+  std::vector<std::pair<unsigned int, unsigned int>> tasks;
+  std::vector<std::vector<std::vector<unsigned int>>> adjacency;
+  for (unsigned int depth = firstDepth; depth < 32; depth++) {
+    unsigned long long largest = (n + (1ULL << depth) - 1) >> depth;
+    if (largest <= (depth == 0 ? 1 : leafSize)) {
+      break;
+    }
+    for (unsigned int segment = 0; segment < (1U << depth); segment++) {
+      unsigned long long begin = (segment * n) >> depth, end = ((segment + 1ULL) * n) >> depth;
+      if (end - begin > (depth == 0 ? 1 : leafSize)) {
+        tasks.emplace_back(depth, segment);
+      }
+    }
+    layers.resize(depth + 1);
+    layers[depth].entries.assign(1U << depth, NO_ENTRY);
+    adjacency.resize(depth + 1 - firstDepth);
+    adjacency.back().resize(n);
+  }
+
+  ProgressReporter progress(tasks.size(), "Creating Range Vamana", visualized);
+
+  // The segments are handed out one at a time on the thread pool, so that a thread that is done takes the next one
+  ThreadPool::getInstance().parallelFor(0, tasks.size(), [&](unsigned int task) {
+    unsigned int depth = tasks[task].first, segment = tasks[task].second;
+    unsigned int begin = (segment * n) >> depth, end = ((segment + 1ULL) * n) >> depth;
+
+    // The sub-index numbers the points of the segment by their offset from the first position of the segment
+    std::vector<vamana_t> points;
+    points.reserve(end - begin);
+    for (unsigned int position = begin; position < end; position++) {
+      points.push_back(P[timestampOrder[position]]);
+    }
+
+    VamanaIndex<vamana_t> subIndex;
+    subIndex.createGraph(points, alpha, L, R, NONE, 1, false);
+
+    // Segments of the same layer cover disjoint positions, so every thread writes its own adjacency lists
+    std::vector<std::vector<unsigned int>>& lists = adjacency[depth - firstDepth];
+    for (unsigned int i = 0; i < subIndex.getGraph().getNodesCount(); i++) {
+      for (const auto& neighbor : *subIndex.getGraph().getNode(i)->getNeighborsVector()) {
+        lists[begin + i].push_back(begin + neighbor.getIndex());
+      }
+    }
+    layers[depth].entries[segment] = begin + subIndex.getMedoid();
+
+    progress.add();
+  }, std::max(1u, threads), 1);
+
+  progress.finish();
+
+  // Pack the adjacency lists of every layer in CSR form
+  for (unsigned int i = 0; i < adjacency.size(); i++) {
+    RangeLayer& layer = layers[firstDepth + i];
+    layer.offsets.assign(n + 1, 0);
+    layer.neighbors.clear();
+    for (unsigned int position = 0; position < n; position++) {
+      layer.neighbors.insert(layer.neighbors.end(), adjacency[i][position].begin(), adjacency[i][position].end());
+      layer.offsets[position + 1] = layer.neighbors.size();
+    }
+  }
+
+}
+
+/**
+ * @brief Creates the segment tree and the graph of every segment with more than leafSize points. The graphs of
+ * the segments are independent, so they are built in parallel, the largest ones first.
+ *
+ * @param P the vector containing the data points
+ * @param alpha the parameter alpha of every segment graph
+ * @param L the parameter L of every segment graph
+ * @param R the parameter R of every segment graph
+ * @param leafSize the maximum number of points of the segments that are scanned instead of getting a graph
+ * @param threads the number of threads that build the segment graphs
+ * @param visualized whether to display the progress of the construction
+ */
+template <typename vamana_t>
+void RangeVamanaIndex<vamana_t>::createGraph(
+  const std::vector<vamana_t>& P, const float& alpha, const unsigned int L, const unsigned int R, const unsigned int leafSize,
+  unsigned int threads, bool visualized) {
+
+  unsigned int n = P.size();
+  this->P = P;
+  this->alpha = alpha;
+  this->L = L;
+  this->R = R;
+  this->leafSize = std::max(1u, leafSize);
+  this->buildTimestampIndex();
+  this->buildLabelIndex();
+
+  this->positions.resize(n);
+  for (unsigned int position = 0; position < n; position++) {
+    this->positions[this->timestampOrder[position]] = position;
+  }
+
+  this->G.setNodesCount(n);
+  this->fillGraphNodes();
+
+  this->layers.clear();
+  buildSegmentLayers(this->P, this->timestampOrder, this->leafSize, alpha, L, R, this->layers, 0, threads, visualized);
+
+  // The graph of the root segment is the graph of the index
+  if (!this->layers.empty()) {
+    const RangeLayer& root = this->layers[0];
+    for (unsigned int position = 0; position < n; position++) {
+      for (unsigned int i = root.offsets[position]; i < root.offsets[position + 1]; i++) {
+        this->G.connectNodesByIndex(this->timestampOrder[position], this->timestampOrder[root.neighbors[i]]);
+      }
+    }
+    this->medoid = this->timestampOrder[root.entries[0]];
+  }
+  this->entryPoints.assign(1, this->medoid);
+
+  // Filtered queries keep the start node of every label, as in the other filtered indexes
+  this->buildStartNodes(1000);
+
+}
+
+/**
+ * @brief Load a graph from a file, together with its segment layers. Files without the layers (or saved with
+ * the full save mode) rebuild them with the build parameters stored in the file.
+ *
+ * @param filename the full path of the file containing the graph
+ * @param baseFile optional path of the dataset file, used by graph-only index files
+ *
+ * @return true if the graph was loaded successfully, false otherwise
+ */
+template <typename vamana_t>
+bool RangeVamanaIndex<vamana_t>::loadGraph(const std::string& filename, const std::string& baseFile) {
+
+  this->layers.clear();
+  this->leafSize = 0;
+
+  if (!FilteredVamanaIndex<vamana_t>::loadGraph(filename, baseFile)) {
+    return false;
+  }
+
+  unsigned int n = this->P.size();
+  this->positions.resize(n);
+  for (unsigned int position = 0; position < n; position++) {
+    this->positions[this->timestampOrder[position]] = position;
+  }
+
+  // Stored layers must describe the same points, otherwise they are built again
+  bool validLayers = this->leafSize > 0;
+  for (unsigned int depth = 1; validLayers && depth < this->layers.size(); depth++) {
+    validLayers = this->layers[depth].offsets.size() == n + 1 && this->layers[depth].entries.size() == (1U << depth);
+  }
+
+  if (!validLayers) {
+    this->layers.clear();
+    this->leafSize = 1024;
+    buildSegmentLayers(this->P, this->timestampOrder, this->leafSize, this->alpha, this->L, this->R, this->layers, 1, 1, false);
+  }
+
+  this->buildRootLayer();
+  return true;
+
+}
+
+/**
+ * @brief Rejects the insertion of a point. The layers address the points by their position in timestamp order, so
+ * an inserted point would shift the positions of every segment after it, and the index has to be built again.
+ *
+ * @return false, since the point is not inserted
+ */
+template <typename vamana_t>
+bool RangeVamanaIndex<vamana_t>::insert(const vamana_t&, unsigned int&) {
+
+  std::cerr << "Error: points cannot be inserted into a range index, it must be built again." << std::endl;
+  return false;
+
+}
+
+/**
+ * @brief Rejects the insertion of a point with a label set, for the same reason as any other insertion.
+ *
+ * @return false, since the point is not inserted
+ */
+template <typename vamana_t>
+bool RangeVamanaIndex<vamana_t>::insert(const vamana_t& point, const std::vector<unsigned int>&, unsigned int& index) {
+
+  return this->insert(point, index);
+
+}
+
+/**
+ * @brief Rejects the removal of a point. The segment searches do not skip removed points, and consolidating them
+ * would renumber the positions the layers are stored with.
+ *
+ * @return false, since the point is not removed
+ */
+template <typename vamana_t>
+bool RangeVamanaIndex<vamana_t>::remove(const unsigned int) {
+
+  std::cerr << "Error: points cannot be removed from a range index, it must be built again." << std::endl;
+  return false;
+
+}
+
+/**
+ * @brief Searches the graph of a single segment, with a best-first traversal of at most L candidates.
+ *
+ * @param depth the depth of the layer of the segment
+ * @param segment the index of the segment inside the layer
+ * @param xq the query vector
+ * @param k the number of nearest points to return
+ * @param L the size of the candidate list
+ * @param slot the slot of the label the results must carry, or LabelIndex::NO_LABEL for no label
+ * @param results output vector, receives the distances and the indexes of the nearest points of the segment
+ * @param visited output vector, receives the indexes of the expanded points
+ */
+template <typename vamana_t>
+void RangeVamanaIndex<vamana_t>::searchSegment(
+  const unsigned int depth, const unsigned int segment, const QueryDataVector<float>& xq, const unsigned int k,
+  const unsigned int L, const unsigned int slot, std::vector<std::pair<double, unsigned int>>& results,
+  std::vector<unsigned int>& visited) const {
+
+  const RangeLayer& layer = this->layers[depth];
+  unsigned int entry = layer.entries[segment];
+  if (entry == NO_ENTRY) {
+    return;
+  }
+
+  // Every point of the segment satisfies the range, so the traversal only checks the label of the results. The
+  // candidates are positions in timestamp order, and every position is scored once, when it is first reached
+  std::vector<std::pair<double, unsigned int>> matches;
+  SearchCandidates candidates;
+  std::unordered_set<unsigned int> seen = {entry};
+  unsigned int distanceComputations = 0;
+
+  auto score = [&](unsigned int position) {
+    unsigned int point = this->timestampOrder[position];
+    double distance = euclideanDistance(this->P[point], xq);
+    if (slot == LabelIndex::NO_LABEL || this->labels.contains(slot, point)) {
+      matches.emplace_back(distance, point);
+    }
+    return distance;
+  };
+  candidates.insert(entry, score, distanceComputations);
+
+  // Expand the nearest candidate that was not expanded yet, until all the L nearest ones are expanded
+  while (candidates.hasUnvisited()) {
+    unsigned int position = candidates.visitNearest().second;
+    visited.push_back(this->timestampOrder[position]);
+
+    for (unsigned int i = layer.offsets[position]; i < layer.offsets[position + 1]; i++) {
+      if (seen.insert(layer.neighbors[i]).second) {
+        candidates.insert(layer.neighbors[i], score, distanceComputations);
+      }
+    }
+    candidates.trim(L);
+  }
+
+  unsigned int count = std::min((size_t)k, matches.size());
+  std::partial_sort(matches.begin(), matches.begin() + count, matches.end());
+  results.insert(results.end(), matches.begin(), matches.begin() + count);
+
+}
+
+/**
+ * @brief Searches the k nearest points of a query whose timestamp lies inside [l, r]. Query types 2 and 3 use
+ * the segments that cover the range, the label of a type 3 query is checked on the results of every segment.
+ * Ranges or label subsets with at most bruteForceLimit points are scanned exhaustively.
+ *
+ * @param xq the query vector, of type 2 or 3
+ * @param k the number of nearest points to return
+ * @param L the size of the candidate list of every segment search
+ * @param threads the number of threads that search the covering segments
+ * @param bruteForceLimit the maximum number of qualifying points that are scanned exhaustively
+ *
+ * @return Pair of sets: the first set contains the k nearest nodes, and the second set contains all visited nodes
+ */
+template <typename vamana_t>
+std::pair<std::set<vamana_t>, std::set<vamana_t>> RangeVamanaIndex<vamana_t>::rangeSearch(
+  const QueryDataVector<float>& xq, const unsigned int k, const unsigned int L, const unsigned int threads,
+  const unsigned int bruteForceLimit) const {
+
+  // The segment searches run on the threads of the pool without the lock, under the hold of the calling thread
+  ReentrantLockGuard updateLock(this->updateLock);
+  unsigned int type = xq.getQueryType();
+  bool labeled = type == C_EQUALS_v || type == C_EQUALS_v_AND_l_LEQ_T_LEQ_r;
+  bool ranged = type == l_LEQ_T_LEQ_r || type == C_EQUALS_v_AND_l_LEQ_T_LEQ_r;
+
+  // Find the positions of the range in timestamp order, queries without a range cover all of them
+  unsigned int first = 0, last = this->P.size();
+  if (ranged) {
+    first = std::lower_bound(this->sortedTimestamps.begin(), this->sortedTimestamps.end(), xq.getL()) - this->sortedTimestamps.begin();
+    last = std::upper_bound(this->sortedTimestamps.begin() + first, this->sortedTimestamps.end(), xq.getR()) - this->sortedTimestamps.begin();
+  }
+
+  unsigned int slot = labeled ? this->labels.findLabel(xq.getV()) : LabelIndex::NO_LABEL;
+  if ((labeled && slot == LabelIndex::NO_LABEL) || first >= last) {
+    return {};
+  }
+
+  // Resolve the points that satisfy a label and a range from the smaller of the two lists
+  std::vector<unsigned int> scanned;
+  unsigned int qualifying = last - first;
+  if (labeled) {
+    const std::vector<unsigned int>& postings = this->labels.getPoints(slot);
+    if (postings.size() < last - first) {
+      for (auto point : postings) {
+        if (this->positions[point] >= first && this->positions[point] < last) {
+          scanned.push_back(point);
+        }
+      }
+    } else {
+      for (unsigned int position = first; position < last; position++) {
+        if (this->labels.contains(slot, this->timestampOrder[position])) {
+          scanned.push_back(this->timestampOrder[position]);
+        }
+      }
+    }
+    qualifying = scanned.size();
+  }
+
+  // Few qualifying points: scan them exhaustively
+  unsigned int limit = bruteForceLimit == 0 ? this->leafSize : bruteForceLimit;
+  if (qualifying <= limit || this->layers.empty()) {
+    if (!labeled) {
+      scanned.assign(this->timestampOrder.begin() + first, this->timestampOrder.begin() + last);
+    }
+    return ExhaustiveSearch(*this, scanned, xq, k);
+  }
+  scanned.clear();
+
+  // Decompose the range into the segments that it covers completely, and the leaves it covers partially
+  std::vector<std::pair<unsigned int, unsigned int>> covering;
+  std::vector<std::pair<unsigned int, unsigned int>> stack = {{0, 0}};
+  while (!stack.empty()) {
+    unsigned int depth = stack.back().first, segment = stack.back().second, begin, end;
+    stack.pop_back();
+    this->getSegmentBounds(depth, segment, begin, end);
+    if (end <= first || begin >= last) {
+      continue;
+    }
+
+    bool leaf = depth >= this->layers.size() || this->layers[depth].entries[segment] == NO_ENTRY;
+    if (leaf) {
+      for (unsigned int position = std::max(begin, first); position < std::min(end, last); position++) {
+        unsigned int point = this->timestampOrder[position];
+        if (!labeled || this->labels.contains(slot, point)) {
+          scanned.push_back(point);
+        }
+      }
+    } else if (first <= begin && end <= last) {
+      covering.emplace_back(depth, segment);
+    } else {
+      stack.emplace_back(depth + 1, 2 * segment + 1);
+      stack.emplace_back(depth + 1, 2 * segment);
+    }
+  }
+
+  // A label keeps only a part of the points of every segment, so the candidate lists grow with its selectivity
+  unsigned int segmentL = std::max(L, k);
+  if (labeled) {
+    segmentL = std::max(segmentL, (unsigned int)std::min(10.0 * segmentL, std::ceil((double)segmentL * (last - first) / qualifying)));
+  }
+
+  std::vector<std::vector<std::pair<double, unsigned int>>> segmentResults(covering.size());
+  std::vector<std::vector<unsigned int>> segmentVisited(covering.size());
+  ThreadPool::getInstance().parallelFor(0, covering.size(), [&](unsigned int i) {
+    this->searchSegment(covering[i].first, covering[i].second, xq, k, segmentL, slot, segmentResults[i], segmentVisited[i]);
+  }, std::max(1u, threads), 1);
+
+  // Merge the nearest points of every covering segment with the scanned points of the partial leaves
+  std::pair<std::set<vamana_t>, std::set<vamana_t>> scan = ExhaustiveSearch(*this, scanned, xq, k);
+  std::vector<std::pair<double, unsigned int>> merged;
+  for (const auto& p : scan.first) {
+    merged.emplace_back(euclideanDistance(p, xq), p.getIndex());
+  }
+  std::set<vamana_t> visited = scan.second;
+  for (unsigned int i = 0; i < covering.size(); i++) {
+    merged.insert(merged.end(), segmentResults[i].begin(), segmentResults[i].end());
+    for (auto point : segmentVisited[i]) {
+      visited.insert(this->G.getNode(point)->getData());
+    }
+  }
+
+  unsigned int count = std::min((size_t)k, merged.size());
+  std::partial_sort(merged.begin(), merged.begin() + count, merged.end());
+
+  std::set<vamana_t> nearest;
+  for (unsigned int i = 0; i < count; i++) {
+    nearest.insert(this->G.getNode(merged[i].second)->getData());
+  }
+
+  return {nearest, visited};
+
+}
+
+/**
+ * @brief Returns the segment layers (all but the root) as a section of graph-only index files, together with the
+ * sections of the filtered index.
+ *
+ * @return the sections of the index
+ */
+template <typename vamana_t>
+std::vector<GraphFileSection> RangeVamanaIndex<vamana_t>::getGraphFileSections(void) const {
+
+  std::vector<GraphFileSection> sections = FilteredVamanaIndex<vamana_t>::getGraphFileSections();
+
+  std::ostringstream out;
+  uint32_t leafSize = this->leafSize, layersCount = this->layers.size();
+  out.write(reinterpret_cast<const char*>(&leafSize), sizeof(leafSize));
+  out.write(reinterpret_cast<const char*>(&layersCount), sizeof(layersCount));
+
+  // The root layer is the graph of the index, which the file already contains
+  for (unsigned int depth = 1; depth < this->layers.size(); depth++) {
+    const RangeLayer& layer = this->layers[depth];
+    uint64_t neighborsCount = layer.neighbors.size();
+    out.write(reinterpret_cast<const char*>(layer.entries.data()), layer.entries.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(layer.offsets.data()), layer.offsets.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(&neighborsCount), sizeof(neighborsCount));
+    out.write(reinterpret_cast<const char*>(layer.neighbors.data()), layer.neighbors.size() * sizeof(uint32_t));
+  }
+
+  sections.push_back(GraphFileSection{RANGE_LAYERS_SECTION, out.str()});
+  return sections;
+
+}
+
+/**
+ * @brief Loads the segment layers from their section of a graph-only index file, or passes the section on to
+ * the filtered index.
+ *
+ * @param section the section that was read
+ *
+ * @return true if the section was recognized and loaded, false otherwise
+ */
+template <typename vamana_t>
+bool RangeVamanaIndex<vamana_t>::loadGraphFileSection(const GraphFileSection& section) {
+
+  static_assert(sizeof(unsigned int) == sizeof(uint32_t), "Segment layers are stored as 32-bit positions");
+
+  if (section.tag != RANGE_LAYERS_SECTION) {
+    return FilteredVamanaIndex<vamana_t>::loadGraphFileSection(section);
+  }
+
+  // The points are read before the sections, so the sizes of the layers can be checked against them
+  std::istringstream in(section.bytes);
+  uint64_t n = this->P.size();
+  uint32_t leafSize = 0, layersCount = 0;
+  in.read(reinterpret_cast<char*>(&leafSize), sizeof(leafSize));
+  in.read(reinterpret_cast<char*>(&layersCount), sizeof(layersCount));
+  if (!in || leafSize == 0 || layersCount > 32) {
+    return false;
+  }
+
+  std::vector<RangeLayer> layers(layersCount);
+  for (unsigned int depth = 1; depth < layersCount; depth++) {
+    RangeLayer& layer = layers[depth];
+    layer.entries.resize(1U << depth);
+    layer.offsets.resize(n + 1);
+    in.read(reinterpret_cast<char*>(layer.entries.data()), layer.entries.size() * sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(layer.offsets.data()), layer.offsets.size() * sizeof(uint32_t));
+
+    uint64_t neighborsCount = 0;
+    in.read(reinterpret_cast<char*>(&neighborsCount), sizeof(neighborsCount));
+    if (!in || neighborsCount > section.bytes.size() / sizeof(uint32_t) || layer.offsets[0] != 0 || layer.offsets[n] != neighborsCount) {
+      return false;
+    }
+    layer.neighbors.resize(neighborsCount);
+    in.read(reinterpret_cast<char*>(layer.neighbors.data()), neighborsCount * sizeof(uint32_t));
+
+    if (!in || !std::is_sorted(layer.offsets.begin(), layer.offsets.end())) {
+      return false;
+    }
+    for (unsigned int position : layer.neighbors) {
+      if (position >= n) {
+        return false;
+      }
+    }
+    for (unsigned int entry : layer.entries) {
+      if (entry != NO_ENTRY && entry >= n) {
+        return false;
+      }
+    }
+  }
+
+  this->leafSize = leafSize;
+  this->layers = std::move(layers);
+  return true;
+
+}
+
+template class RangeVamanaIndex<BaseDataVector<float>>;
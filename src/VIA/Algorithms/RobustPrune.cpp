@@ -2,6 +2,8 @@
 #include "../../../include/DataVector.h"
 #include "../../../include/distance.h"
 
+#include <algorithm>
+
 /**
  * @brief Retrieves the element at a specific index in a set. This function enables index-based access in a set, 
  * even though sets are not indexed containers.
@@ -152,6 +154,10 @@ void FilteredRobustPrune(FilteredVamanaIndex<graph_t>& index, GraphNode<graph_t>
   // Get the data of the node p_node
   graph_t p = p_node.getData();
 
+  // Label sets are compared as bitsets over the labels of p: bit i of a mask is set if the point carries the i-th label of p
+  const LabelIndex& labels = index.getLabelIndex();
+  std::vector<uint64_t> p_star_mask(labels.getMaskWords(p.getIndex())), p_tone_mask(p_star_mask.size());
+
   // Retrieve all neighbors of p_node and insert them into set V
   std::vector<graph_t>* neighbors = p_node.getNeighborsVector();
   for (auto neighbor : *neighbors) {
@@ -199,20 +205,22 @@ void FilteredRobustPrune(FilteredVamanaIndex<graph_t>& index, GraphNode<graph_t>
     }
 
     // Filtering logic for V
+    labels.getLabelMask(p_star.getIndex(), p.getIndex(), p_star_mask.data());
     std::set<graph_t> V_copy = V; // Create a copy of V
     for (auto p_tone : V_copy) {
 
-      // Checking if the operation Fp' interst Fp is not a proper subset of Fp*
-      if (p_tone.getC() != p.getC()) {
-        if ((int)p_star.getC() == -1) {
-          continue;
-        }
-      } 
-      else {
-        if (p_star.getC() != p_tone.getC()) {
-          continue;
+      // Keep p' if F_p' intersect F_p is not a subset of F_p*, i.e. p* does not carry every label p and p' share
+      labels.getLabelMask(p_tone.getIndex(), p.getIndex(), p_tone_mask.data());
+      bool subset = true;
+      for (unsigned int w = 0; w < p_tone_mask.size(); w++) {
+        if (p_tone_mask[w] & ~p_star_mask[w]) {
+          subset = false;
+          break;
         }
       }
+      if (!subset) {
+        continue;
+      }
 
       // Remove neighbors that are too far from p_star based on alpha and euclideanDistance
       if (distanceSaveMethod == NONE) {
@@ -234,6 +242,84 @@ void FilteredRobustPrune(FilteredVamanaIndex<graph_t>& index, GraphNode<graph_t>
 }
 
 
+/**
+ * @brief Prunes a candidate list of neighbors of a point with the filtered robust pruning rule, working only on
+ * point indexes. The candidates are sorted once by their distance to the point and then scanned in that order,
+ * so every selected neighbor p* removes the later candidates p' that it occludes (alpha * d(p*, p') <= d(p, p'))
+ * and that share no label with p which p* does not carry as well.
+ *
+ * @tparam graph_t The type of the graph nodes.
+ * @param index The filtered index that holds the points and their labels.
+ * @param p The index of the point whose neighbors are pruned.
+ * @param V The indexes of the candidate neighbors, replaced by the selected neighbors in ascending distance.
+ * @param alpha A float value used as a multiplier for the distance threshold.
+ * @param R An integer specifying the maximum number of neighbors to retain.
+ * @param distanceSaveMethod The method used to compute the distances.
+ */
+template <typename graph_t>
+void FilteredRobustPrune(const FilteredVamanaIndex<graph_t>& index, const unsigned int p, std::vector<unsigned int>& V, float alpha, unsigned int R, const DISTANCE_SAVE_METHOD distanceSaveMethod) {
+
+  auto distance = [&](const unsigned int a, const unsigned int b) -> float {
+    if (distanceSaveMethod == MATRIX) {
+      return index.getDistanceMatrix()[a][b];
+    }
+    return euclideanDistance(index.getPoint(a), index.getPoint(b));
+  };
+
+  // Sort the distinct candidates by their distance to p, which is the order the closest candidate is picked in
+  std::vector<std::pair<float, unsigned int>> candidates;
+  candidates.reserve(V.size());
+  for (auto v : V) {
+    if (v != p) {
+      candidates.emplace_back(distance(p, v), v);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  // The label set of every candidate, as a bitset over the labels of p
+  const LabelIndex& labels = index.getLabelIndex();
+  unsigned int words = labels.getMaskWords(p);
+  std::vector<uint64_t> masks(candidates.size() * words);
+  for (unsigned int i = 0; i < candidates.size(); i++) {
+    labels.getLabelMask(candidates[i].second, p, masks.data() + i * words);
+  }
+
+  std::vector<bool> removed(candidates.size(), false);
+  V.clear();
+
+  for (unsigned int i = 0; i < candidates.size() && V.size() < R; i++) {
+    if (removed[i]) {
+      continue;
+    }
+
+    unsigned int p_star = candidates[i].second;
+    const uint64_t* p_star_mask = masks.data() + i * words;
+    V.push_back(p_star);
+
+    for (unsigned int j = i + 1; j < candidates.size(); j++) {
+      if (removed[j]) {
+        continue;
+      }
+
+      // Keep p' if F_p' intersect F_p is not a subset of F_p*, i.e. p* does not carry every label p and p' share
+      const uint64_t* p_tone_mask = masks.data() + j * words;
+      bool subset = true;
+      for (unsigned int w = 0; w < words; w++) {
+        if (p_tone_mask[w] & ~p_star_mask[w]) {
+          subset = false;
+          break;
+        }
+      }
+
+      if (subset && alpha * distance(p_star, candidates[j].second) <= candidates[j].first) {
+        removed[j] = true;
+      }
+    }
+  }
+
+}
+
 /// Explicit instantiations for RobustPrune and FilteredRobustPrune
 
 
@@ -266,3 +352,13 @@ template void FilteredRobustPrune<BaseDataVector<float>>(
   int R,
   const DISTANCE_SAVE_METHOD distanceSaveMethod
 );
+
+// Explicit instantiation for the index-based FilteredRobustPrune with float data type
+template void FilteredRobustPrune<BaseDataVector<float>>(
+  const FilteredVamanaIndex<BaseDataVector<float>>& index, 
+  const unsigned int p, 
+  std::vector<unsigned int>& V, 
+  float alpha, 
+  unsigned int R,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod
+);
@@ -1,19 +1,76 @@
 #include "../../../include/VamanaIndex.h"
 #include "../../../include/DataVector.h"
 #include "../../../include/BQDataVectors.h"
+#include "../../../include/read_data.h"
+#include "../../../include/ThreadPool.h"
+#include "../../../include/SearchCandidates.h"
 
-#include <thread>
+#include <cstdint>
+#include <cstdio>
 #include <chrono>
 #include <atomic>
 #include <mutex>
+#include <unordered_set>
 #include <random>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
+#include <limits>
 #include <fstream>
 #include <iostream>
 
-// Mutex for synchronizing distance calculations
-std::mutex distanceMutex;
+// Identifier and version of the graph-only index files. Version 2 appends the sections of derived indexes.
+static const char GRAPH_FILE_MAGIC[4] = {'V', 'I', 'A', 'G'};
+static const uint32_t GRAPH_FILE_VERSION = 2;
+
+// Tag of the navigation layer section in graph-only index files ("NAVL" when read as bytes), which the plain index
+// writes itself, and of the navigation layer block that follows the edges in full index files
+static const uint32_t NAVIGATION_LAYER_SECTION = 0x4c56414e;
+static const char NAVIGATION_LAYER_TAG[] = "NAVL";
+
+// Tag of the start node cache section in graph-only index files ("STNC" when read as bytes), and of the start node
+// cache block of full index files
+static const uint32_t START_NODE_CACHE_SECTION = 0x434e5453;
+static const char START_NODE_CACHE_TAG[] = "STNC";
+
+/**
+ * @brief Writes a single value of a trivially copyable type into a binary stream.
+ */
+template <typename value_t> static inline void writeBinary(std::ostream& out, const value_t& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/**
+ * @brief Reads a single value of a trivially copyable type from a binary stream.
+ */
+template <typename value_t> static inline bool readBinary(std::istream& in, value_t& value) {
+  in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return static_cast<bool>(in);
+}
+
+/**
+ * @brief Completes an index file that was written into a temporary file next to it, by renaming the temporary file
+ * over the index file. The rename is atomic, so a process that watches the index file, such as one that reloads it
+ * through an IndexHandle, never reads a file that is half written. The temporary file is removed on failure.
+ * 
+ * @param outFile the stream of the temporary file, which is closed
+ * @param tempFile the full path of the temporary file
+ * @param filename the full path of the index file
+ * 
+ * @return true if the whole file was written and renamed, false otherwise
+ */
+static bool replaceIndexFile(std::ofstream& outFile, const std::string& tempFile, const std::string& filename) {
+
+  outFile.close();
+  if (!outFile || std::rename(tempFile.c_str(), filename.c_str()) != 0) {
+    std::cerr << "Error writing file " << filename << std::endl;
+    std::remove(tempFile.c_str());
+    return false;
+  }
+
+  return true;
+
+}
 
 /**
  * @brief Generates a random permutation of integers in a specified range. This function creates a vector 
@@ -126,50 +183,147 @@ template <typename vamana_t> void VamanaIndex<vamana_t>::createRandomEdges(const
 template <typename vamana_t>
 void VamanaIndex<vamana_t>::computeDistances(const bool visualize, const unsigned int numThreads) {
 
-  std::atomic<int> progress(0);
-  auto startTime = std::chrono::steady_clock::now();
+  ProgressReporter progress(this->P.size(), "Computing Distances", visualize);
 
-  // Define a lambda function to compute the distances between points
-  auto compute = [&](int start, int end) {
-    for (int i = start; i < end; ++i) {
-      for (unsigned int j = i; j < this->P.size(); ++j) {
-        double dist = euclideanDistance(this->P.at(i), this->P.at(j));
-        this->distanceMatrix[i][j] = dist;
-        this->distanceMatrix[j][i] = dist;
-      }
-      progress++;
-      if (visualize && progress % 100 == 0) {
-        std::lock_guard<std::mutex> lock(distanceMutex);
-        displayProgressBar(progress, this->P.size(), "Computing Distances", startTime, 30);
-      }
+  // Compute the distances of every row on the threads of the pool. The rows get shorter towards the end of the
+  // matrix, so they are handed out in small chunks that keep the threads balanced.
+  ThreadPool::getInstance().parallelFor(0, this->P.size(), [&](unsigned int i) {
+    for (unsigned int j = i; j < this->P.size(); ++j) {
+      double dist = euclideanDistance(this->P.at(i), this->P.at(j));
+      this->distanceMatrix[i][j] = dist;
+      this->distanceMatrix[j][i] = dist;
     }
-  };
+    progress.add();
+  }, std::max(1u, numThreads), 16);
 
-  // Compute distances using multiple threads if numThreads > 1 or a single thread otherwise
-  if (numThreads > 1) {
-    std::vector<std::thread> threads;
-    int chunkSize = this->P.size() / numThreads;
-    for (unsigned int t = 0; t < numThreads; ++t) {
-      int start = t * chunkSize;
-      int end = (t == numThreads - 1) ? this->P.size() : start + chunkSize;
-      threads.emplace_back(compute, start, end);
-    }
+  progress.finish();
+}
 
-    for (auto& thread : threads) {
-      thread.join();
-    }
-    if (visualize) {
-      displayProgressBar(this->P.size(), this->P.size(), "Computing Distances", startTime, 30);
-      std::cout << std::endl;
+/**
+ * @brief Searches the candidate neighbors of a point that is inserted into the graph, with a GreedySearch from the
+ * start node.
+ *
+ * @param point the index of the inserted point
+ * @param s the start node of the search
+ * @param L the parameter L
+ * @param distanceSaveMethod the method used to compute the distances
+ *
+ * @return the visited nodes of the search
+ */
+template <typename vamana_t>
+std::set<vamana_t> VamanaIndex<vamana_t>::searchInsertCandidates(
+  const unsigned int point, const GraphNode<vamana_t>& s, const unsigned int L, const DISTANCE_SAVE_METHOD distanceSaveMethod) const {
+
+  return GreedySearch(*this, s, this->getPoint(point), 1, L, distanceSaveMethod).second;
+
+}
+
+/**
+ * @brief Prunes the neighbors of a node, together with a set of candidates, with RobustPrune.
+ *
+ * @param node the node whose neighbors are pruned
+ * @param V the candidate neighbors of the node
+ * @param alpha the parameter alpha
+ * @param R the parameter R
+ * @param distanceSaveMethod the method used to compute the distances
+ */
+template <typename vamana_t>
+void VamanaIndex<vamana_t>::pruneInsertNeighbors(
+  GraphNode<vamana_t>& node, std::set<vamana_t>& V, const float alpha, const unsigned int R, const DISTANCE_SAVE_METHOD distanceSaveMethod) {
+
+  RobustPrune(*this, node, V, alpha, R, distanceSaveMethod);
+
+}
+
+/**
+ * @brief Inserts the points into the graph in batches of growing size, where the points of a batch are inserted
+ * in parallel. Every batch first searches all of its points on the graph left by the previous batches and prunes
+ * their neighbors, with every thread writing only the lists of its own points. The reverse edges of the batch are
+ * then grouped by their target, so that every target is updated (and pruned if needed) by a single thread. The
+ * batches start from a single point and double up to a small fraction of the dataset, which keeps the early
+ * points, that shape the navigable core of the graph, close to the sequential insertion. The searches and the
+ * prunes go through searchInsertCandidates and pruneInsertNeighbors, so derived indexes insert their points with
+ * their own rules.
+ *
+ * @param sigma the insertion order of the points
+ * @param s the start node of the searches
+ * @param alpha the parameter alpha
+ * @param L the parameter L
+ * @param R the parameter R
+ * @param distanceSaveMethod the method used to compute the distances
+ * @param threads the number of threads that insert the points
+ * @param visualize whether to visualize the progress
+ */
+template <typename vamana_t> 
+void VamanaIndex<vamana_t>::insertBatches(
+  const std::vector<int>& sigma, const GraphNode<vamana_t>& s, const float alpha, const unsigned int L, const unsigned int R,
+  const DISTANCE_SAVE_METHOD distanceSaveMethod, const unsigned int threads, const bool visualize) {
+
+  unsigned int n = sigma.size();
+  unsigned int maxBatch = std::max(1u, n / 50);
+  ProgressReporter progress(n, "Creating Vamana", visualize);
+  ThreadPool& pool = ThreadPool::getInstance();
+
+  std::vector<std::set<vamana_t>> visited;
+  std::vector<std::pair<unsigned int, vamana_t>> reverseEdges;
+  std::vector<unsigned int> targets;
+
+  for (unsigned int begin = 0; begin < n; ) {
+    unsigned int end = std::min(n, begin + std::max(1u, std::min(begin, maxBatch)));
+
+    // Search every point of the batch on the graph of the previous batches, which no thread modifies meanwhile
+    visited.assign(end - begin, std::set<vamana_t>());
+    pool.parallelFor(begin, end, [&](unsigned int i) {
+      visited[i - begin] = this->searchInsertCandidates(sigma[i], s, L, distanceSaveMethod);
+    }, threads, 16);
+
+    // Prune the neighbors of every point of the batch, every point only reads and writes its own list
+    pool.parallelFor(begin, end, [&](unsigned int i) {
+      this->pruneInsertNeighbors(*this->G.getNode(sigma[i]), visited[i - begin], alpha, R, distanceSaveMethod);
+    }, threads, 16);
+
+    // Group the reverse edges of the batch by target, so that every target is updated by a single thread
+    reverseEdges.clear();
+    for (unsigned int i = begin; i < end; i++) {
+      GraphNode<vamana_t>* node = this->G.getNode(sigma[i]);
+      for (const auto& j : *node->getNeighborsVector()) {
+        reverseEdges.emplace_back(j.getIndex(), node->getData());
+      }
     }
-  } 
-  else {
-    if (visualize) {
-      withProgress(0, this->P.size(), "Computing Distances", [&](int i) { compute(i, i + 1); });
-    } else {
-      compute(0, this->P.size());
+    std::stable_sort(reverseEdges.begin(), reverseEdges.end(), [](const std::pair<unsigned int, vamana_t>& a, const std::pair<unsigned int, vamana_t>& b) {
+      return a.first < b.first;
+    });
+
+    targets.clear();
+    for (unsigned int e = 0; e < reverseEdges.size(); e++) {
+      if (e == 0 || reverseEdges[e].first != reverseEdges[e - 1].first) {
+        targets.push_back(e);
+      }
     }
+    targets.push_back(reverseEdges.size());
+
+    pool.parallelFor(0, targets.size() - 1, [&](unsigned int t) {
+      GraphNode<vamana_t>* j_node = this->G.getNode(reverseEdges[targets[t]].first);
+      std::set<vamana_t> outgoing(j_node->getNeighborsVector()->begin(), j_node->getNeighborsVector()->end());
+      for (unsigned int e = targets[t]; e < targets[t + 1]; e++) {
+        outgoing.insert(reverseEdges[e].second);
+      }
+
+      if (outgoing.size() > (long unsigned int)R) {
+        this->pruneInsertNeighbors(*j_node, outgoing, alpha, R, distanceSaveMethod);
+      } else {
+        for (unsigned int e = targets[t]; e < targets[t + 1]; e++) {
+          j_node->addNeighbor(reverseEdges[e].second);
+        }
+      }
+    }, threads, 16);
+
+    progress.add(end - begin);
+    begin = end;
   }
+
+  progress.finish();
+
 }
 
 /**
@@ -187,11 +341,12 @@ void VamanaIndex<vamana_t>::computeDistances(const bool visualize, const unsigne
  * @param R the parameter R
  * @param visualize whether to visualize the progress
  * @param distanceMatrix optional precomputed distance matrix
+ * @param build_threads the number of threads that insert the points, 1 for the sequential insertion order
  */
 template <typename vamana_t> 
 void VamanaIndex<vamana_t>::createGraph(
   const std::vector<vamana_t>& P, const float& alpha, const unsigned int L, const unsigned int& R, const DISTANCE_SAVE_METHOD distanceSaveMethod, 
-  unsigned int distance_threads, bool visualize, double** distanceMatrix) {
+  unsigned int distance_threads, bool visualize, double** distanceMatrix, unsigned int build_threads) {
 
   using GreedyResult = std::pair<std::set<vamana_t>, std::set<vamana_t>>;
   GreedyResult greedyResult;
@@ -200,6 +355,9 @@ void VamanaIndex<vamana_t>::createGraph(
 
   unsigned int n = P.size();
   this->P = P;
+  this->alpha = alpha;
+  this->L = L;
+  this->R = R;
 
   if (distanceSaveMethod == MATRIX) {
     if (distanceMatrix != nullptr) {
@@ -219,6 +377,8 @@ void VamanaIndex<vamana_t>::createGraph(
 
  // Replace the call to findMedoid with the selection of a random point as the medoid
   GraphNode<vamana_t> s = *(this->G.getNode(generateRandomIndex(0, n-1)));
+  this->medoid = s.getData().getIndex();
+  this->entryPoints.assign(1, this->medoid);
 
   std::vector<int> sigma = generateRandomPermutation(0, n-1);
 
@@ -247,7 +407,9 @@ void VamanaIndex<vamana_t>::createGraph(
     }
   };
 
-  if (visualize) {
+  if (build_threads > 1) {
+    this->insertBatches(sigma, s, alpha, L, R, distanceSaveMethod, build_threads, visualize);
+  } else if (visualize) {
     withProgress(0, n, "Creating Vamana", processNode);
   } else {
     for (unsigned int i = 0; i < n; i++) {
@@ -263,10 +425,658 @@ void VamanaIndex<vamana_t>::createGraph(
   }
 }
 
+/**
+ * @brief Appends a point to the vector store and a node to the graph, when a point is inserted into the index.
+ * The first point of an empty index becomes its medoid.
+ * 
+ * @param point the point to append
+ * 
+ * @return the index of the appended point
+ */
+template <typename vamana_t> unsigned int VamanaIndex<vamana_t>::appendPoint(const vamana_t& point) {
+
+  vamana_t data = point;
+  data.setIndex(this->P.size());
+  this->P.push_back(data);
+  unsigned int index = this->G.addNode(data);
+
+  if (index == 0) {
+    this->medoid = 0;
+    this->entryPoints.assign(1, 0);
+  }
+
+  return index;
+
+}
+
+/**
+ * @brief Adds neighbors to the list of a node while searches may be reading it. The list is copied under the shared
+ * lock of the node together with its version, the new list is built and pruned on the copy without holding any
+ * lock, and it replaces the list under the exclusive lock if the version did not change. Otherwise another thread
+ * replaced the list meanwhile, and the new list is built again from the current one.
+ * 
+ * @param index the index of the node
+ * @param added the neighbors to add, which are skipped if the node already links to them
+ */
+template <typename vamana_t>
+void VamanaIndex<vamana_t>::linkNeighbors(const unsigned int index, const std::vector<vamana_t>& added) {
+
+  GraphNode<vamana_t>* node = this->G.getNode(index);
+  GraphNodeSync& sync = this->G.getNodeSync(index);
+
+  while (true) {
+    GraphNode<vamana_t> updated(node->getData());
+    unsigned int version;
+    {
+      ReadLockGuard<SpinReadWriteLock> lock(sync.lock);
+      *updated.getNeighborsVector() = *node->getNeighborsVector();
+      version = sync.version;
+    }
+
+    std::vector<vamana_t>* neighbors = updated.getNeighborsVector();
+    std::set<vamana_t> outgoing(neighbors->begin(), neighbors->end());
+    bool changed = false;
+    for (const auto& j : added) {
+      if (j.getIndex() != index && outgoing.insert(j).second) {
+        neighbors->push_back(j);
+        changed = true;
+      }
+    }
+    if (!changed) {
+      return;
+    }
+
+    if (outgoing.size() > (long unsigned int)this->R) {
+      this->pruneInsertNeighbors(updated, outgoing, this->alpha, this->R, NONE);
+    }
+
+    std::lock_guard<SpinReadWriteLock> lock(sync.lock);
+    if (sync.version == version) {
+      node->getNeighborsVector()->swap(*neighbors);
+      sync.version++;
+      return;
+    }
+  }
+
+}
+
+/**
+ * @brief Inserts a single point into the index. The point is appended first, under the append mutex, so that it
+ * gets its index. Its candidates are then searched and pruned into a detached node, and finally the neighbors of
+ * the point and the reverse edges are added with linkNeighbors, the same way as createGraph does. Everything after
+ * the append runs in parallel with the other insertions and with the queries, under the shared update lock, which
+ * only keeps consolidate out.
+ * 
+ * @param point the point to insert
+ * @param index output parameter, set to the index of the inserted point
+ * 
+ * @return true if the point was inserted, false if the index has no build parameters
+ */
+template <typename vamana_t> bool VamanaIndex<vamana_t>::insert(const vamana_t& point, unsigned int& index) {
+
+  if (this->L == 0 || this->R == 0) {
+    std::cerr << "Error: the index has no build parameters to insert points with." << std::endl;
+    return false;
+  }
+
+  ReentrantLockGuard lock(this->updateLock);
+  {
+    std::lock_guard<std::mutex> append(this->appendMutex);
+    index = this->appendPoint(point);
+  }
+  this->linkInsertedPoint(index);
+
+  return true;
+
+}
+
+/**
+ * @brief Links an appended point into the graph: searches its candidate neighbors, prunes them, and adds the
+ * reverse edges. The first point of an empty index has nobody to link to.
+ * 
+ * @param index the index of the appended point
+ */
+template <typename vamana_t> void VamanaIndex<vamana_t>::linkInsertedPoint(const unsigned int index) {
+
+  if (index == 0) {
+    return;
+  }
+
+  GraphNode<vamana_t> s(this->G.getNode(this->medoid)->getData());
+  std::set<vamana_t> visited = this->searchInsertCandidates(index, s, this->L, NONE);
+
+  GraphNode<vamana_t> pruned(this->G.getNode(index)->getData());
+  this->pruneInsertNeighbors(pruned, visited, this->alpha, this->R, NONE);
+
+  // Other insertions may have linked to the point meanwhile, if it is a start node, so their edges are kept
+  this->linkNeighbors(index, *pruned.getNeighborsVector());
+
+  std::vector<vamana_t> reverse = {pruned.getData()};
+  for (const auto& j : *pruned.getNeighborsVector()) {
+    this->linkNeighbors(j.getIndex(), reverse);
+  }
+
+}
+
+/**
+ * @brief Removes a point from the index lazily, by marking the tombstone of its graph node.
+ * 
+ * @param index the index of the point
+ * 
+ * @return true if the point was removed, false if it does not exist or is already removed
+ */
+template <typename vamana_t> bool VamanaIndex<vamana_t>::remove(const unsigned int index) {
+
+  ReentrantLockGuard lock(this->updateLock);
+  if (index >= this->G.getNodesCount() || this->G.getNodeSync(index).removed.exchange(true)) {
+    return false;
+  }
+
+  this->deletedCount++;
+  return true;
+
+}
+
+/**
+ * @brief Consolidates the removed points. Every remaining point that links to a removed point v gets the
+ * candidates N_out(p) \ D together with N_out(v) \ D of every removed neighbor v, pruned down to R neighbors with
+ * pruneInsertNeighbors. Removed neighbors of removed neighbors are crossed as well, up to R^2 removed points per
+ * repaired point, since regions removed as a whole would otherwise split the graph. Every point only writes its
+ * own list and reads the lists of removed points, which nobody modifies, so the points are repaired in parallel.
+ * A removed medoid is replaced by the nearest remaining point, and compactPoints drops the removed points and
+ * renumbers the rest. The whole consolidation holds the update lock exclusively, so it stops the world: searches,
+ * insertions and removals wait for it, and the search for the new medoid runs under the same hold.
+ * 
+ * @param threads the number of threads of the pool that repair the neighbors
+ * 
+ * @return the new index of every point, or NO_POINT for the removed points
+ */
+template <typename vamana_t> std::vector<unsigned int> VamanaIndex<vamana_t>::consolidate(const unsigned int threads) {
+
+  ReentrantLockGuard lock(this->updateLock, true);
+  unsigned int n = this->G.getNodesCount();
+
+  std::vector<unsigned int> newIndexes(n);
+  unsigned int next = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    newIndexes[i] = this->isDeleted(i) ? NO_POINT : next++;
+  }
+  if (this->deletedCount == 0) {
+    return newIndexes;
+  }
+
+  // Bounds the removed points a single repair crosses, so that a large removed region costs each of its remaining
+  // neighbors a fixed amount of work
+  unsigned int maxCrossed = std::max(1u, this->R * this->R);
+
+  ThreadPool::getInstance().parallelFor(0, n, [&](unsigned int p) {
+    if (this->isDeleted(p)) {
+      return;
+    }
+
+    GraphNode<vamana_t>* node = this->G.getNode(p);
+    std::vector<vamana_t>* neighbors = node->getNeighborsVector();
+    bool linksRemoved = false;
+    for (const auto& v : *neighbors) {
+      linksRemoved = linksRemoved || this->isDeleted(v.getIndex());
+    }
+    if (!linksRemoved) {
+      return;
+    }
+
+    // Removed neighbors are crossed breadth-first, so that a point next to a run of removed points is relinked to
+    // the remaining points beyond the run rather than only to the points on its own side
+    std::set<vamana_t> candidates;
+    std::vector<unsigned int> crossed;
+    std::unordered_set<unsigned int> seen = {p};
+    for (const auto& v : *neighbors) {
+      if (!seen.insert(v.getIndex()).second) {
+        continue;
+      }
+      if (this->isDeleted(v.getIndex())) {
+        crossed.push_back(v.getIndex());
+      } else {
+        candidates.insert(v);
+      }
+    }
+    for (unsigned int c = 0; c < crossed.size() && c < maxCrossed; c++) {
+      for (const auto& w : *this->G.getNode(crossed[c])->getNeighborsVector()) {
+        if (!seen.insert(w.getIndex()).second) {
+          continue;
+        }
+        if (this->isDeleted(w.getIndex())) {
+          crossed.push_back(w.getIndex());
+        } else {
+          candidates.insert(w);
+        }
+      }
+    }
+
+    node->clearNeighbors();
+    this->pruneInsertNeighbors(*node, candidates, this->alpha, this->R, NONE);
+  }, std::max(1u, threads), 64);
+
+  // Searches skip removed points, so the search for the removed medoid ends at its nearest remaining point
+  if (this->isDeleted(this->medoid) && next > 0) {
+    const GraphNode<vamana_t>& s = *this->G.getNode(this->medoid);
+    std::set<vamana_t> nearest = GreedySearch(*this, s, this->P[this->medoid], 1, std::max(1u, this->L), NONE).first;
+    unsigned int replacement = 0;
+    while (this->isDeleted(replacement)) {
+      replacement++;
+    }
+    this->medoid = nearest.empty() ? replacement : nearest.begin()->getIndex();
+  }
+
+  // The graph is rebuilt without the removed points, so their tombstones are dropped with them
+  this->compactPoints(newIndexes);
+  this->deletedCount = 0;
+
+  // The navigation layer follows the new indexes, and is sampled again if it lost some of its points
+  NavigationLayer& layer = this->navigation;
+  bool layerIntact = true;
+  for (unsigned int& node : layer.nodes) {
+    node = newIndexes[node];
+    layerIntact = layerIntact && node != NO_POINT;
+  }
+  if (!layerIntact) {
+    this->buildNavigationLayer(layer.samplingRate, layer.maxSize, threads);
+  }
+  this->compactStartNodes(this->startCache, newIndexes);
+
+  return newIndexes;
+
+}
+
+/**
+ * @brief Renumbers the points after the removed points are consolidated. The vector store and the graph are
+ * filled again with the remaining points, whose neighbors are translated to the new indexes in parallel.
+ * 
+ * @param newIndexes the new index of every point, or NO_POINT for the removed points
+ */
+template <typename vamana_t> void VamanaIndex<vamana_t>::compactPoints(const std::vector<unsigned int>& newIndexes) {
+
+  unsigned int n = newIndexes.size();
+  std::vector<vamana_t> points;
+  std::vector<std::vector<unsigned int>> adjacency;
+  for (unsigned int i = 0; i < n; i++) {
+    if (newIndexes[i] == NO_POINT) {
+      continue;
+    }
+
+    points.push_back(this->P[i]);
+    points.back().setIndex(newIndexes[i]);
+    adjacency.emplace_back();
+    for (const auto& neighbor : *this->G.getNode(i)->getNeighborsVector()) {
+      if (newIndexes[neighbor.getIndex()] != NO_POINT) {
+        adjacency.back().push_back(newIndexes[neighbor.getIndex()]);
+      }
+    }
+  }
+
+  this->P.swap(points);
+  this->G.setNodesCount(this->P.size());
+  this->fillGraphNodes();
+
+  ThreadPool::getInstance().parallelFor(0, this->P.size(), [&](unsigned int i) {
+    std::vector<vamana_t>* neighbors = this->G.getNode(i)->getNeighborsVector();
+    neighbors->reserve(adjacency[i].size());
+    for (unsigned int j : adjacency[i]) {
+      neighbors->push_back(this->P[j]);
+    }
+  });
+
+  this->medoid = this->P.empty() ? 0 : newIndexes[this->medoid];
+  this->entryPoints.assign(1, this->medoid);
+
+}
+
+/**
+ * @brief Builds the navigation layer of the index over a random sample of its points, replacing the current one.
+ * The layer is a Vamana graph with the build parameters of the index, and index files store it next to the graph.
+ * 
+ * @param samplingRate the fraction of the points that are sampled, between 0 and 1
+ * @param maxSize the maximum number of sampled points
+ * @param threads the number of threads that build the layer
+ * 
+ * @return the number of sampled points, or 0 if the index has too few points for a layer
+ */
+template <typename vamana_t>
+unsigned int VamanaIndex<vamana_t>::buildNavigationLayer(const float samplingRate, const unsigned int maxSize, const unsigned int threads) {
+
+  this->clearNavigationLayer();
+
+  // Removed points are never sampled, since consolidate would drop them from the layer
+  std::vector<int> sample;
+  for (unsigned int i = 0; i < this->G.getNodesCount(); i++) {
+    if (!this->isDeleted(i)) {
+      sample.push_back(i);
+    }
+  }
+  double wanted = std::round(std::min(1.0f, std::max(0.0f, samplingRate)) * (double)sample.size());
+  unsigned int size = std::min((double)maxSize, wanted);
+  if (size < 2) {
+    return 0;
+  }
+  std::shuffle(sample.begin(), sample.end(), std::mt19937{std::random_device{}()});
+  sample.resize(size);
+
+  // The sub-index numbers the sampled points by their position in the sample
+  std::vector<vamana_t> points;
+  points.reserve(size);
+  for (int point : sample) {
+    points.push_back(this->getPoint(point));
+  }
+
+  // Indexes loaded from full index files do not know their build parameters, so the layer falls back to defaults
+  VamanaIndex<vamana_t> subIndex;
+  subIndex.createGraph(
+    points, this->alpha > 0 ? this->alpha : 1.2f, this->L > 0 ? this->L : 50, this->R > 0 ? this->R : 16,
+    NONE, 1, false, nullptr, std::max(1u, threads)
+  );
+
+  NavigationLayer& layer = this->navigation;
+  layer.nodes.assign(sample.begin(), sample.end());
+  layer.offsets.assign(size + 1, 0);
+  for (unsigned int position = 0; position < size; position++) {
+    for (const auto& neighbor : *subIndex.getGraph().getNode(position)->getNeighborsVector()) {
+      layer.neighbors.push_back(neighbor.getIndex());
+    }
+    layer.offsets[position + 1] = layer.neighbors.size();
+  }
+  layer.entry = subIndex.getMedoid();
+  layer.samplingRate = samplingRate;
+  layer.maxSize = maxSize;
+
+  return size;
+
+}
+
+/**
+ * @brief Finds the start node of the search of a query. Indexes with a navigation layer walk the layer with a
+ * best-first traversal of at most L candidates and return the nearest sampled point they reach, indexes with a
+ * start node cache return the cached node nearest to the query, and others return the medoid.
+ * 
+ * @param xq the query vector
+ * @param L the size of the candidate list of the traversal of the layer
+ * 
+ * @return the index of the start node
+ */
+template <typename vamana_t>
+unsigned int VamanaIndex<vamana_t>::findSearchStart(const DataVector<float>& xq, const unsigned int L) const {
+
+  ReentrantLockGuard updateLock(this->updateLock);
+  const NavigationLayer& layer = this->navigation;
+  if (layer.nodes.empty()) {
+    unsigned int cached = this->findNearestStartNode(this->startCache, xq);
+    return cached != NO_POINT ? cached : this->medoid;
+  }
+
+  // The candidates are positions in the layer, and every position is scored once, when it is first reached
+  SearchCandidates candidates;
+  std::unordered_set<unsigned int> seen = {layer.entry};
+  unsigned int maxCandidates = std::max(1u, L), distanceComputations = 0;
+
+  auto score = [&](unsigned int position) {
+    return euclideanDistance(this->getPoint(layer.nodes[position]), xq);
+  };
+  candidates.insert(layer.entry, score, distanceComputations);
+
+  // Expand the nearest candidate that was not expanded yet, until all the L nearest ones are expanded
+  while (candidates.hasUnvisited()) {
+    unsigned int position = candidates.visitNearest().second;
+    for (unsigned int i = layer.offsets[position]; i < layer.offsets[position + 1]; i++) {
+      if (seen.insert(layer.neighbors[i]).second) {
+        candidates.insert(layer.neighbors[i], score, distanceComputations);
+      }
+    }
+    candidates.trim(maxCandidates);
+  }
+
+  return layer.nodes[candidates.getRanked().begin()->second];
+
+}
+
+/**
+ * @brief Replaces the navigation layer with a layer read from an index file, if the layer is consistent with the
+ * points of the index.
+ * 
+ * @param layer the layer that was read
+ * 
+ * @return true if the layer was valid and replaced the current one, false otherwise
+ */
+template <typename vamana_t> bool VamanaIndex<vamana_t>::setNavigationLayer(NavigationLayer& layer) {
+
+  unsigned int size = layer.nodes.size();
+  if (size == 0 || layer.entry >= size || layer.offsets.size() != size + 1 || layer.offsets[0] != 0) {
+    return false;
+  }
+  if (layer.offsets[size] != layer.neighbors.size() || !std::is_sorted(layer.offsets.begin(), layer.offsets.end())) {
+    return false;
+  }
+  for (unsigned int node : layer.nodes) {
+    if (node >= this->G.getNodesCount()) {
+      return false;
+    }
+  }
+  for (unsigned int position : layer.neighbors) {
+    if (position >= size) {
+      return false;
+    }
+  }
+
+  this->navigation = std::move(layer);
+  return true;
+
+}
+
+/**
+ * @brief Fills the vectors of the start nodes of a cache from the points of an index, checking that the index has
+ * the start nodes.
+ */
+template <typename vamana_t> static bool fillStartNodeVectors(const VamanaIndex<vamana_t>& index, StartNodeCache& cache) {
+
+  cache.vectors.clear();
+  for (unsigned int node : cache.nodes) {
+    if (node >= index.getGraph().getNodesCount()) {
+      return false;
+    }
+    const vamana_t& point = index.getPoint(node);
+    cache.vectors.insert(cache.vectors.end(), point.getRawData(), point.getRawData() + point.getDimension());
+  }
+  return true;
+
+}
+
+/**
+ * @brief Chooses diverse start nodes among a set of points with k-means++ seeding: the first start node is given,
+ * and every next one is drawn with probability proportional to the squared distance of a point to its nearest
+ * start node so far. The seeding stops early once every point coincides with a start node.
+ * 
+ * @param points the indexes of the points
+ * @param first the index of the first start node
+ * @param K the maximum number of start nodes
+ * @param generator the random number generator of the seeding
+ * @param threads the number of threads of the pool that compute the distances
+ * 
+ * @return the start nodes, with their vectors
+ */
+template <typename vamana_t>
+StartNodeCache VamanaIndex<vamana_t>::seedStartNodes(
+  const std::vector<unsigned int>& points, const unsigned int first, const unsigned int K, std::mt19937& generator, 
+  const unsigned int threads) const {
+
+  StartNodeCache cache;
+  if (points.empty() || K == 0) {
+    return cache;
+  }
+
+  unsigned int dimension = this->getPoint(first).getDimension();
+  auto addStartNode = [&](unsigned int node) {
+    const float* vector = this->getPoint(node).getRawData();
+    cache.nodes.push_back(node);
+    cache.vectors.insert(cache.vectors.end(), vector, vector + dimension);
+  };
+
+  // D[i] is the squared distance of the i-th point to its nearest start node so far
+  std::vector<float> D(points.size(), std::numeric_limits<float>::max());
+  addStartNode(first);
+
+  while (cache.nodes.size() < K) {
+    const float* latest = &cache.vectors[(cache.nodes.size() - 1) * dimension];
+    ThreadPool::getInstance().parallelFor(0, points.size(), [&](unsigned int i) {
+      D[i] = std::min(D[i], squaredEuclideanDistance(latest, this->getPoint(points[i]).getRawData(), dimension));
+    }, std::max(1u, threads), 1024);
+
+    // The start nodes so far have no weight, so they are never drawn again
+    double total = std::accumulate(D.begin(), D.end(), 0.0);
+    if (total <= 0) {
+      break;
+    }
+    double target = std::uniform_real_distribution<double>(0.0, total)(generator);
+    unsigned int next = 0;
+    for (double sum = D[0]; sum <= target && next + 1 < points.size(); sum += D[++next]) {}
+    while (D[next] <= 0 && next > 0) {
+      next--;
+    }
+    if (D[next] <= 0) {
+      break;
+    }
+    addStartNode(points[next]);
+  }
+
+  return cache;
+
+}
+
+/**
+ * @brief Finds the start node of a cache that is nearest to a query, scanning the rows of the cache.
+ * 
+ * @param cache the start node cache
+ * @param xq the query vector
+ * 
+ * @return the index of the nearest start node, or NO_POINT if the cache is empty or has another dimension
+ */
+template <typename vamana_t>
+unsigned int VamanaIndex<vamana_t>::findNearestStartNode(const StartNodeCache& cache, const DataVector<float>& xq) const {
+
+  unsigned int count = cache.nodes.size(), dimension = xq.getDimension();
+  if (count == 0 || cache.vectors.size() != (size_t)count * dimension) {
+    return NO_POINT;
+  }
+
+  unsigned int nearest = 0;
+  float nearestDistance = std::numeric_limits<float>::max();
+  for (unsigned int i = 0; i < count; i++) {
+    float distance = squaredEuclideanDistance(xq.getRawData(), &cache.vectors[(size_t)i * dimension], dimension);
+    if (distance < nearestDistance) {
+      nearestDistance = distance;
+      nearest = i;
+    }
+  }
+
+  return cache.nodes[nearest];
+
+}
+
+/**
+ * @brief Renumbers the start nodes of a cache after the removed points are consolidated, dropping the removed ones.
+ * 
+ * @param cache the start node cache
+ * @param newIndexes the new index of every point, or NO_POINT for the removed points
+ */
+template <typename vamana_t>
+void VamanaIndex<vamana_t>::compactStartNodes(StartNodeCache& cache, const std::vector<unsigned int>& newIndexes) const {
+
+  if (cache.nodes.empty()) {
+    return;
+  }
+
+  size_t dimension = cache.vectors.size() / cache.nodes.size();
+  StartNodeCache compacted;
+  for (unsigned int i = 0; i < cache.nodes.size(); i++) {
+    if (cache.nodes[i] < newIndexes.size() && newIndexes[cache.nodes[i]] != NO_POINT) {
+      compacted.nodes.push_back(newIndexes[cache.nodes[i]]);
+      compacted.vectors.insert(compacted.vectors.end(), cache.vectors.begin() + i * dimension, cache.vectors.begin() + (i + 1) * dimension);
+    }
+  }
+  cache = std::move(compacted);
+
+}
+
+/**
+ * @brief Writes the start nodes of a cache into a binary stream. The vectors are not written, since they are
+ * read again from the points.
+ * 
+ * @param out the output stream
+ * @param cache the start node cache
+ */
+template <typename vamana_t>
+void VamanaIndex<vamana_t>::writeStartNodes(std::ostream& out, const StartNodeCache& cache) const {
+
+  writeBinary(out, static_cast<uint32_t>(cache.nodes.size()));
+  out.write(reinterpret_cast<const char*>(cache.nodes.data()), cache.nodes.size() * sizeof(uint32_t));
+
+}
+
+/**
+ * @brief Reads the start nodes of a cache from a binary stream, and fills their vectors from the points.
+ * 
+ * @param in the input stream
+ * @param cache output parameter, set to the cache that was read
+ * 
+ * @return false if the stream ended or refers to points the index does not have, true otherwise
+ */
+template <typename vamana_t>
+bool VamanaIndex<vamana_t>::readStartNodes(std::istream& in, StartNodeCache& cache) const {
+
+  uint32_t count = 0;
+  if (!readBinary(in, count) || count > this->G.getNodesCount()) {
+    return false;
+  }
+  cache.nodes.resize(count);
+  in.read(reinterpret_cast<char*>(cache.nodes.data()), count * sizeof(uint32_t));
+  return in && fillStartNodeVectors(*this, cache);
+
+}
+
+/**
+ * @brief Builds the start node cache of the index: K diverse start nodes chosen with k-means++ seeding over its
+ * points, starting from the medoid, replacing the current cache. Queries start from the cached node nearest to
+ * them, and index files store the cache next to the graph.
+ * 
+ * @param K the number of start nodes
+ * @param threads the number of threads of the pool that build the cache
+ * 
+ * @return the number of start nodes, which is less than K if the index has fewer distinct points
+ */
+template <typename vamana_t>
+unsigned int VamanaIndex<vamana_t>::buildStartNodeCache(const unsigned int K, const unsigned int threads) {
+
+  this->startCache = StartNodeCache();
+
+  // Removed points are never chosen, since consolidate would drop them from the cache
+  std::vector<unsigned int> points;
+  for (unsigned int i = 0; i < this->G.getNodesCount(); i++) {
+    if (!this->isDeleted(i)) {
+      points.push_back(i);
+    }
+  }
+  if (points.empty()) {
+    return 0;
+  }
+
+  unsigned int first = this->medoid < this->G.getNodesCount() && !this->isDeleted(this->medoid) ? this->medoid : points[0];
+  std::mt19937 generator(std::random_device{}());
+  this->startCache = this->seedStartNodes(points, first, K, generator, threads);
+
+  return this->startCache.nodes.size();
+
+}
+
 /**
  * @brief Saves a specific graph into a file. Specifically this method is used to save the contents of a Vamana 
  * Index Graph, inside a file in order to be loaded later for further usage. The main point of this method is to 
- * reduce the time of the production.
+ * reduce the time of the production. The graph is written into a temporary file that replaces the file at the end.
  * 
  * @param filename the full path of the file in which the graph is going to be saved
  * 
@@ -274,8 +1084,9 @@ void VamanaIndex<vamana_t>::createGraph(
  */
 template <typename vamana_t> bool VamanaIndex<vamana_t>::saveGraph(const std::string& filename) {
 
-  // Open the file for writing and check if it was opened successfully
-  std::ofstream outFile(filename, std::ios::binary);
+  // Open the temporary file for writing and check if it was opened successfully
+  const std::string tempFile = filename + ".tmp";
+  std::ofstream outFile(tempFile, std::ios::binary);
   if (!outFile) {
     std::cerr << "Error opening file for writing." << std::endl;
     return false;
@@ -297,7 +1108,35 @@ template <typename vamana_t> bool VamanaIndex<vamana_t>::saveGraph(const std::st
     outFile << std::endl;
   });
 
-  return true;
+  // Indexes with a navigation layer or a start node cache append them after the edges, followed by the blocks of
+  // derived indexes, which readers without them never reach
+  const NavigationLayer& layer = this->navigation;
+  if (!layer.nodes.empty()) {
+    outFile << NAVIGATION_LAYER_TAG << " " << layer.samplingRate << " " << layer.maxSize << " " << layer.entry << " " << layer.nodes.size() << std::endl;
+    for (unsigned int node : layer.nodes) {
+      outFile << node << " ";
+    }
+    outFile << std::endl;
+    for (unsigned int offset : layer.offsets) {
+      outFile << offset << " ";
+    }
+    outFile << std::endl;
+    for (unsigned int position : layer.neighbors) {
+      outFile << position << " ";
+    }
+    outFile << std::endl;
+  }
+
+  if (!this->startCache.nodes.empty()) {
+    outFile << START_NODE_CACHE_TAG << " " << this->startCache.nodes.size() << std::endl;
+    for (unsigned int node : this->startCache.nodes) {
+      outFile << node << " ";
+    }
+    outFile << std::endl;
+  }
+  this->saveGraphTextBlocks(outFile);
+
+  return replaceIndexFile(outFile, tempFile, filename);
 
 }
 
@@ -310,7 +1149,7 @@ template <typename vamana_t> bool VamanaIndex<vamana_t>::saveGraph(const std::st
  * 
  * @return true if the graph was loaded successfully, false otherwise
  */
-template <typename vamana_t> bool VamanaIndex<vamana_t>::loadGraph(const std::string& filename) {
+template <typename vamana_t> bool VamanaIndex<vamana_t>::loadGraph(const std::string& filename, const std::string& baseFile) {
 
   // Open the file for reading and check if it was opened successfully
   std::ifstream inFile(filename);
@@ -319,9 +1158,25 @@ template <typename vamana_t> bool VamanaIndex<vamana_t>::loadGraph(const std::st
     return false;
   }
 
+  this->clearNavigationLayer();
+  this->clearStartNodeCache();
+
+  // Graph-only files start with a magic identifier, in which case the base vectors are read from the dataset
+  char magic[4] = {0, 0, 0, 0};
+  inFile.read(magic, sizeof(magic));
+  if (inFile && std::equal(magic, magic + 4, GRAPH_FILE_MAGIC)) {
+    inFile.close();
+    return this->loadGraphStructure(filename, baseFile);
+  }
+  inFile.clear();
+  inFile.seekg(0);
+
   // Read the number of nodes in the graph and initialize the graph with that number
-  unsigned int nodesCount;
-  inFile >> nodesCount;
+  unsigned int nodesCount = 0;
+  if (!(inFile >> nodesCount)) {
+    std::cerr << "Error: Corrupted graph file " << filename << std::endl;
+    return false;
+  }
   this->G.setNodesCount(nodesCount);
 
   // Read the nodes and their neighbors from the file and populate the graph
@@ -333,17 +1188,379 @@ template <typename vamana_t> bool VamanaIndex<vamana_t>::loadGraph(const std::st
     this->P.push_back(currentData);
   });
 
-  // Read the edges of each node from the file and connect the nodes in the graph
+  if (!inFile) {
+    std::cerr << "Error: Unexpected end of graph file " << filename << std::endl;
+    return false;
+  }
+
+  // Read the edges of each node from the file and connect the nodes in the graph, stopping at the first list that
+  // cannot be valid
+  bool validEdges = true;
   withProgress(0, nodesCount, "Loading edges", [&](int i) {
-    unsigned int neighborsCount;
-    inFile >> neighborsCount;
+    unsigned int neighborsCount = 0;
+    if (!validEdges || !(inFile >> neighborsCount) || neighborsCount > nodesCount) {
+      validEdges = false;
+      return;
+    }
     for (unsigned int j = 0; j < neighborsCount; j++) {
       vamana_t currentData;
-      inFile >> currentData;
+      if (!(inFile >> currentData) || currentData.getIndex() >= nodesCount) {
+        validEdges = false;
+        return;
+      }
       this->G.connectNodesByIndex(i, this->G.getNode(currentData.getIndex())->getIndex());
     }
   });
 
+  if (!validEdges) {
+    std::cerr << "Error: Corrupted edges in graph file " << filename << std::endl;
+    return false;
+  }
+
+  // The navigation layer, the start node cache and the blocks of derived indexes follow the edges, if the index was
+  // saved with them
+  std::string tag;
+  while (inFile >> tag) {
+    if (tag == NAVIGATION_LAYER_TAG) {
+      NavigationLayer layer;
+      unsigned int size = 0;
+      inFile >> layer.samplingRate >> layer.maxSize >> layer.entry >> size;
+      if (!inFile || size > nodesCount) {
+        std::cerr << "Error: Corrupted navigation layer in " << filename << std::endl;
+        return false;
+      }
+
+      layer.nodes.resize(size);
+      layer.offsets.resize(size + 1);
+      for (unsigned int& node : layer.nodes) {
+        inFile >> node;
+      }
+      for (unsigned int& offset : layer.offsets) {
+        inFile >> offset;
+      }
+      if (inFile && layer.offsets.back() <= (unsigned long long)size * size) {
+        layer.neighbors.resize(layer.offsets.back());
+        for (unsigned int& position : layer.neighbors) {
+          inFile >> position;
+        }
+      }
+      if (!inFile || !this->setNavigationLayer(layer)) {
+        std::cerr << "Error: Corrupted navigation layer in " << filename << std::endl;
+        return false;
+      }
+    } else if (tag == START_NODE_CACHE_TAG) {
+      StartNodeCache cache;
+      unsigned int size = 0;
+      inFile >> size;
+      cache.nodes.resize(inFile && size <= nodesCount ? size : 0);
+      for (unsigned int& node : cache.nodes) {
+        inFile >> node;
+      }
+      if (!inFile || size > nodesCount || !fillStartNodeVectors(*this, cache)) {
+        std::cerr << "Error: Corrupted start node cache in " << filename << std::endl;
+        return false;
+      }
+      this->startCache = std::move(cache);
+    } else if (this->loadGraphTextBlock(tag, inFile)) {
+      if (!inFile) {
+        std::cerr << "Error: Corrupted " << tag << " block in " << filename << std::endl;
+        return false;
+      }
+    } else {
+      break;
+    }
+  }
+
+  return true;
+
+}
+
+/**
+ * @brief Saves only the structure of the graph into a binary file, without the base vectors. Specifically the
+ * file contains the metadata of the index (nodes count, dimension and build parameters), the medoid and the entry
+ * points, the adjacency lists as node indexes, and a reference to the base vectors file together with its size
+ * and checksum. The base vectors are read again from the dataset file when the index is loaded.
+ * The file ends with the sections of derived indexes, such as the label index of a filtered index, and
+ * the navigation layer and the start node cache of the index if it has them. The graph is written into a
+ * temporary file that replaces the file at the end.
+ * 
+ * @param filename the full path of the file in which the graph is going to be saved
+ * @param baseFile the full path of the dataset file the graph was built on
+ * 
+ * @return true if the graph was saved successfully, false otherwise
+ */
+template <typename vamana_t> bool VamanaIndex<vamana_t>::saveGraphStructure(const std::string& filename, const std::string& baseFile) {
+
+  // Fingerprint the base file, so that loading fails if the dataset changes under the graph
+  unsigned long long checksum = 0, fileSize = 0;
+  if (!ComputeFileChecksum(baseFile, checksum, fileSize)) {
+    return false;
+  }
+
+  // Open the temporary file for writing and check if it was opened successfully
+  const std::string tempFile = filename + ".tmp";
+  std::ofstream outFile(tempFile, std::ios::binary);
+  if (!outFile) {
+    std::cerr << "Error opening file for writing." << std::endl;
+    return false;
+  }
+
+  uint32_t nodesCount = this->G.getNodesCount();
+  uint32_t dimension = nodesCount > 0 ? this->P.at(0).getDimension() : 0;
+
+  // Write the header with the metadata of the index and the reference to the base file
+  outFile.write(GRAPH_FILE_MAGIC, sizeof(GRAPH_FILE_MAGIC));
+  writeBinary(outFile, GRAPH_FILE_VERSION);
+  writeBinary(outFile, nodesCount);
+  writeBinary(outFile, dimension);
+  writeBinary(outFile, this->alpha);
+  writeBinary(outFile, static_cast<uint32_t>(this->L));
+  writeBinary(outFile, static_cast<uint32_t>(this->R));
+
+  writeBinary(outFile, static_cast<uint32_t>(baseFile.size()));
+  outFile.write(baseFile.data(), baseFile.size());
+  writeBinary(outFile, static_cast<uint64_t>(fileSize));
+  writeBinary(outFile, static_cast<uint64_t>(checksum));
+
+  // Write the medoid and the entry points of the graph
+  writeBinary(outFile, static_cast<uint32_t>(this->medoid));
+  writeBinary(outFile, static_cast<uint32_t>(this->entryPoints.size()));
+  for (unsigned int entryPoint : this->entryPoints) {
+    writeBinary(outFile, static_cast<uint32_t>(entryPoint));
+  }
+
+  // Write the adjacency list of every node as indexes of its neighbors
+  std::vector<uint32_t> neighborIndexes;
+  withProgress(0, nodesCount, "Saving Edges", [&](int i) {
+    std::vector<vamana_t>* neighbors = this->G.getNode(i)->getNeighborsVector();
+    neighborIndexes.clear();
+    for (const auto& neighbor : *neighbors) {
+      neighborIndexes.push_back(neighbor.getIndex());
+    }
+    writeBinary(outFile, static_cast<uint32_t>(neighborIndexes.size()));
+    outFile.write(reinterpret_cast<const char*>(neighborIndexes.data()), neighborIndexes.size() * sizeof(uint32_t));
+  });
+
+  // Write the sections of the derived indexes, each one prefixed by its tag and its size, the navigation layer and
+  // the start node cache
+  std::vector<GraphFileSection> sections = this->getGraphFileSections();
+  const NavigationLayer& layer = this->navigation;
+  if (!layer.nodes.empty()) {
+    std::ostringstream layerOut;
+    uint32_t size = layer.nodes.size();
+    uint64_t neighborsCount = layer.neighbors.size();
+    writeBinary(layerOut, layer.samplingRate);
+    writeBinary(layerOut, static_cast<uint32_t>(layer.maxSize));
+    writeBinary(layerOut, static_cast<uint32_t>(layer.entry));
+    writeBinary(layerOut, size);
+    layerOut.write(reinterpret_cast<const char*>(layer.nodes.data()), size * sizeof(uint32_t));
+    layerOut.write(reinterpret_cast<const char*>(layer.offsets.data()), (size + 1) * sizeof(uint32_t));
+    writeBinary(layerOut, neighborsCount);
+    layerOut.write(reinterpret_cast<const char*>(layer.neighbors.data()), neighborsCount * sizeof(uint32_t));
+    sections.push_back(GraphFileSection{NAVIGATION_LAYER_SECTION, layerOut.str()});
+  }
+  if (!this->startCache.nodes.empty()) {
+    std::ostringstream cacheOut;
+    this->writeStartNodes(cacheOut, this->startCache);
+    sections.push_back(GraphFileSection{START_NODE_CACHE_SECTION, cacheOut.str()});
+  }
+  writeBinary(outFile, static_cast<uint32_t>(sections.size()));
+  for (const auto& section : sections) {
+    writeBinary(outFile, section.tag);
+    writeBinary(outFile, static_cast<uint64_t>(section.bytes.size()));
+    outFile.write(section.bytes.data(), section.bytes.size());
+  }
+
+  return replaceIndexFile(outFile, tempFile, filename);
+
+}
+
+/**
+ * @brief Loads a graph that was saved with saveGraphStructure. The base vectors are read from the dataset file
+ * the graph refers to, or from the given base file if it is not empty.
+ * 
+ * @param filename the full path of the file containing the graph
+ * @param baseFile optional path of the dataset file that overrides the one stored in the graph file
+ * 
+ * @return true if the graph was loaded successfully, false otherwise
+ */
+template <typename vamana_t> bool VamanaIndex<vamana_t>::loadGraphStructure(const std::string& filename, const std::string& baseFile) {
+
+  std::ifstream inFile(filename, std::ios::binary);
+  if (!inFile) {
+    std::cerr << "Error opening file for reading.\n";
+    return false;
+  }
+
+  this->clearNavigationLayer();
+  this->clearStartNodeCache();
+
+  // Read and validate the header of the graph file
+  char magic[4];
+  uint32_t version, nodesCount, dimension, L, R, pathLength;
+  uint64_t expectedSize, expectedChecksum;
+
+  inFile.read(magic, sizeof(magic));
+  if (!readBinary(inFile, version) || version < 1 || version > GRAPH_FILE_VERSION) {
+    std::cerr << "Error: Unsupported graph file version in " << filename << std::endl;
+    return false;
+  }
+
+  readBinary(inFile, nodesCount);
+  readBinary(inFile, dimension);
+  readBinary(inFile, this->alpha);
+  readBinary(inFile, L);
+  readBinary(inFile, R);
+  this->L = L;
+  this->R = R;
+
+  readBinary(inFile, pathLength);
+  std::string storedBaseFile(pathLength, '\0');
+  inFile.read(&storedBaseFile[0], pathLength);
+  readBinary(inFile, expectedSize);
+  if (!readBinary(inFile, expectedChecksum)) {
+    std::cerr << "Error: Corrupted graph file header in " << filename << std::endl;
+    return false;
+  }
+
+  // Make sure the base file is the exact dataset the graph was built on
+  std::string basePath = baseFile.empty() ? storedBaseFile : baseFile;
+  unsigned long long checksum = 0, fileSize = 0;
+  if (!ComputeFileChecksum(basePath, checksum, fileSize)) {
+    return false;
+  }
+  if (fileSize != expectedSize || checksum != expectedChecksum) {
+    std::cerr << "Error: Base file " << basePath << " does not match the one the graph was built on" << std::endl;
+    return false;
+  }
+
+  // Read the base vectors directly from the dataset file, which must hold exactly one vector per node
+  std::vector<vamana_t> points;
+  if (!ReadBaseVectors(basePath, points)) {
+    std::cerr << "Error: Could not read the base vectors from " << basePath << std::endl;
+    return false;
+  }
+  if (points.size() != nodesCount || (nodesCount > 0 && points.at(0).getDimension() != dimension)) {
+    std::cerr << "Error: Base file " << basePath << " holds " << points.size() << " vectors, the graph file expects " << nodesCount << std::endl;
+    return false;
+  }
+
+  this->P = std::move(points);
+  this->G.setNodesCount(nodesCount);
+  this->fillGraphNodes();
+
+  // Read the medoid and the entry points of the graph, which must all be nodes of the graph
+  uint32_t medoid = 0, entryPointsCount = 0;
+  readBinary(inFile, medoid);
+  if (!readBinary(inFile, entryPointsCount) || (nodesCount > 0 && medoid >= nodesCount) || entryPointsCount > nodesCount) {
+    std::cerr << "Error: Corrupted medoid or entry points in graph file " << filename << std::endl;
+    return false;
+  }
+  this->medoid = medoid;
+  this->entryPoints.resize(entryPointsCount);
+  for (uint32_t i = 0; i < entryPointsCount; i++) {
+    uint32_t entryPoint = 0;
+    if (!readBinary(inFile, entryPoint) || entryPoint >= nodesCount) {
+      std::cerr << "Error: Corrupted medoid or entry points in graph file " << filename << std::endl;
+      return false;
+    }
+    this->entryPoints[i] = entryPoint;
+  }
+
+  // Read the adjacency lists of all the nodes one after the other, stopping at the first list that cannot be valid
+  std::vector<uint64_t> offsets(nodesCount + 1, 0);
+  std::vector<uint32_t> neighborIndexes;
+  bool validEdges = true;
+  withProgress(0, nodesCount, "Loading edges", [&](int i) {
+    uint32_t neighborsCount = 0;
+    if (!validEdges || !readBinary(inFile, neighborsCount) || neighborsCount > nodesCount) {
+      validEdges = false;
+      offsets[i + 1] = offsets[i];
+      return;
+    }
+    neighborIndexes.resize(offsets[i] + neighborsCount);
+    inFile.read(reinterpret_cast<char*>(neighborIndexes.data() + offsets[i]), neighborsCount * sizeof(uint32_t));
+    offsets[i + 1] = neighborIndexes.size();
+  });
+
+  if (!inFile || !validEdges) {
+    std::cerr << "Error: Unexpected end of graph file " << filename << std::endl;
+    return false;
+  }
+  for (uint32_t neighbor : neighborIndexes) {
+    if (neighbor >= nodesCount) {
+      std::cerr << "Error: Graph file " << filename << " links to node " << neighbor << " of " << nodesCount << std::endl;
+      return false;
+    }
+  }
+
+  // Connect the nodes on the threads of the pool, every node only receives the edges of its own list
+  ThreadPool::getInstance().parallelFor(0, nodesCount, [&](unsigned int i) {
+    for (uint64_t e = offsets[i]; e < offsets[i + 1]; e++) {
+      this->G.connectNodesByIndex(i, neighborIndexes[e]);
+    }
+  });
+
+  // Version 1 files end with the adjacency lists, later versions continue with the sections of derived indexes
+  uint32_t sectionsCount = 0;
+  if (version >= 2 && !readBinary(inFile, sectionsCount)) {
+    std::cerr << "Error: Unexpected end of graph file " << filename << std::endl;
+    return false;
+  }
+
+  for (uint32_t i = 0; i < sectionsCount; i++) {
+    GraphFileSection section;
+    uint64_t size = 0;
+    readBinary(inFile, section.tag);
+    if (!readBinary(inFile, size)) {
+      std::cerr << "Error: Corrupted section in graph file " << filename << std::endl;
+      return false;
+    }
+
+    section.bytes.resize(size);
+    if (!inFile.read(&section.bytes[0], size)) {
+      std::cerr << "Error: Corrupted section in graph file " << filename << std::endl;
+      return false;
+    }
+    // The navigation layer and the start node cache belong to the plain index, the other sections are passed on to
+    // derived indexes
+    if (section.tag == NAVIGATION_LAYER_SECTION) {
+      std::istringstream in(section.bytes);
+      NavigationLayer layer;
+      uint32_t size = 0, entry = 0, maxSize = 0;
+      uint64_t neighborsCount = 0;
+      readBinary(in, layer.samplingRate);
+      readBinary(in, maxSize);
+      readBinary(in, entry);
+      if (readBinary(in, size) && size <= nodesCount) {
+        layer.nodes.resize(size);
+        layer.offsets.resize(size + 1);
+        in.read(reinterpret_cast<char*>(layer.nodes.data()), size * sizeof(uint32_t));
+        in.read(reinterpret_cast<char*>(layer.offsets.data()), (size + 1) * sizeof(uint32_t));
+      }
+      if (readBinary(in, neighborsCount) && neighborsCount <= section.bytes.size() / sizeof(uint32_t)) {
+        layer.neighbors.resize(neighborsCount);
+        in.read(reinterpret_cast<char*>(layer.neighbors.data()), neighborsCount * sizeof(uint32_t));
+      }
+      layer.entry = entry;
+      layer.maxSize = maxSize;
+      if (!in || !this->setNavigationLayer(layer)) {
+        std::cerr << "Error: Corrupted navigation layer in graph file " << filename << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (section.tag == START_NODE_CACHE_SECTION) {
+      std::istringstream in(section.bytes);
+      if (!this->readStartNodes(in, this->startCache)) {
+        std::cerr << "Error: Corrupted start node cache in graph file " << filename << std::endl;
+        return false;
+      }
+      continue;
+    }
+    this->loadGraphFileSection(section);
+  }
+
   return true;
 
 }
@@ -398,6 +1615,8 @@ template <typename vamana_t> GraphNode<vamana_t> VamanaIndex<vamana_t>::findMedo
 
 }
 
+template <typename vamana_t> const unsigned int VamanaIndex<vamana_t>::NO_POINT;
+
 // Explicit template instantiation for specific types
 template class VamanaIndex<DataVector<float>>;
 template class VamanaIndex<BaseDataVector<float>>;
@@ -1,62 +1,312 @@
 #include <algorithm>
 #include "../../../include/groundtruth.h"
+#include "../../../include/ThreadPool.h"
+
+typedef std::vector<std::pair<float, int>> CandidateHeap;
+
+// Number of queries and base vectors processed together, so that a tile of base vectors stays in cache while it is
+// compared against a whole tile of queries
+static const unsigned int QUERY_TILE_SIZE = 64;
+static const unsigned int BASE_TILE_SIZE = 256;
+
+// Number of in-memory base vectors processed between two updates of the progress bar
+static const unsigned int BASE_BLOCK_SIZE = 65536;
+
+/**
+ * @brief Offers a candidate to the bounded max-heap of a query. The heap keeps the `maxBaseVectors` nearest
+ * candidates seen so far, with the farthest of them on top.
+ * 
+ * @param heap The candidates heap of the query
+ * @param distance The squared distance between the query and the candidate
+ * @param index The index of the candidate base vector
+ * @param maxBaseVectors The maximum number of candidates to keep
+ */
+static inline void pushCandidate(CandidateHeap& heap, const float distance, const int index, const unsigned int maxBaseVectors) {
+  std::pair<float, int> candidate(distance, index);
+
+  if (heap.size() < maxBaseVectors) {
+    heap.push_back(candidate);
+    std::push_heap(heap.begin(), heap.end());
+  }
+  else if (maxBaseVectors > 0 && candidate < heap.front()) {
+    std::pop_heap(heap.begin(), heap.end());
+    heap.back() = candidate;
+    std::push_heap(heap.begin(), heap.end());
+  }
+}
+
+/**
+ * @brief Compares a tile of queries against the base vectors [begin, end) of a store and offers every qualifying
+ * base vector to the heaps of the queries.
+ * 
+ * @param base The base vectors, the index of every vector is its position plus the offset of the store
+ * @param begin The first base vector to compare
+ * @param end One past the last base vector to compare
+ * @param queries The query vectors
+ * @param queryBegin The first query of the tile
+ * @param queryEnd One past the last query of the tile
+ * @param heaps The candidates heaps of all the queries
+ * @param maxBaseVectors The maximum number of candidates to keep for each query
+ */
+static void collectTileCandidates(
+  const VectorStore& base, const unsigned int begin, const unsigned int end,
+  const VectorStore& queries, const unsigned int queryBegin, const unsigned int queryEnd,
+  std::vector<CandidateHeap>& heaps, const unsigned int maxBaseVectors) {
+
+  const unsigned int dimension = queries.dimension;
+  float distances[BASE_TILE_SIZE];
+
+  for (unsigned int tileBegin = begin; tileBegin < end; tileBegin += BASE_TILE_SIZE) {
+
+    unsigned int tileEnd = std::min(tileBegin + BASE_TILE_SIZE, end);
+    const float* tile = base.getVector(tileBegin);
+
+    for (unsigned int q = queryBegin; q < queryEnd; q++) {
+
+      const float* query = queries.getVector(q);
+      CandidateHeap& heap = heaps[q];
+
+      // Compute the distances between the query vector and all base vectors of the tile
+      if (queries.queryType[q] == NO_FILTER) {
+        squaredEuclideanDistances(query, tile, tileEnd - tileBegin, dimension, distances);
+        for (unsigned int j = tileBegin; j < tileEnd; j++) {
+          pushCandidate(heap, distances[j - tileBegin], base.offset + j, maxBaseVectors);
+        }
+      }
+
+      // If the filter type is C_EQUALS_v then only the base vectors with the same C value are considered
+      else if (queries.queryType[q] == C_EQUALS_v) {
+        for (unsigned int j = tileBegin; j < tileEnd; j++) {
+          if (base.C[j] == queries.V[q]) {
+            pushCandidate(heap, squaredEuclideanDistance(query, base.getVector(j), dimension), base.offset + j, maxBaseVectors);
+          }
+        }
+      }
+
+      // If the filter type is l_LEQ_T_LEQ_r then only the base vectors with a timestamp inside [l, r] are considered
+      else if (queries.queryType[q] == l_LEQ_T_LEQ_r) {
+        for (unsigned int j = tileBegin; j < tileEnd; j++) {
+          if (queries.L[q] <= base.T[j] && base.T[j] <= queries.R[q]) {
+            pushCandidate(heap, squaredEuclideanDistance(query, base.getVector(j), dimension), base.offset + j, maxBaseVectors);
+          }
+        }
+      }
+
+      // If the filter type is C_EQUALS_v_AND_l_LEQ_T_LEQ_r then both constraints must hold
+      else if (queries.queryType[q] == C_EQUALS_v_AND_l_LEQ_T_LEQ_r) {
+        for (unsigned int j = tileBegin; j < tileEnd; j++) {
+          if (base.C[j] == queries.V[q] && queries.L[q] <= base.T[j] && base.T[j] <= queries.R[q]) {
+            pushCandidate(heap, squaredEuclideanDistance(query, base.getVector(j), dimension), base.offset + j, maxBaseVectors);
+          }
+        }
+      }
+
+    }
+  }
+}
+
+/**
+ * @brief Compares all the queries against the base vectors [begin, end) of a store, on the threads of the pool.
+ * The queries are split into tiles that the threads pick dynamically, so every heap is only touched by one thread.
+ * 
+ * @param base The base vectors, the index of every vector is its position plus the offset of the store
+ * @param begin The first base vector to compare
+ * @param end One past the last base vector to compare
+ * @param queries The query vectors
+ * @param heaps The candidates heaps of all the queries
+ * @param maxBaseVectors The maximum number of candidates to keep for each query
+ * @param numThreads The maximum number of threads to use
+ */
+static void collectCandidates(
+  const VectorStore& base, const unsigned int begin, const unsigned int end,
+  const VectorStore& queries, std::vector<CandidateHeap>& heaps, const unsigned int maxBaseVectors, const unsigned int numThreads) {
+
+  const unsigned int tilesCount = (queries.count + QUERY_TILE_SIZE - 1) / QUERY_TILE_SIZE;
+
+  ThreadPool::getInstance().parallelFor(0, tilesCount, [&](unsigned int tile) {
+    unsigned int queryBegin = tile * QUERY_TILE_SIZE;
+    unsigned int queryEnd = std::min(queryBegin + QUERY_TILE_SIZE, queries.count);
+    collectTileCandidates(base, begin, end, queries, queryBegin, queryEnd, heaps, maxBaseVectors);
+  }, std::max(1u, numThreads), 1);
+}
+
+/**
+ * @brief Turns the candidates heaps of the queries into the sorted indexes of their nearest base vectors.
+ * 
+ * @param heaps The candidates heaps of all the queries
+ * 
+ * @return A 2D vector containing the indexes of the nearest base vectors for each query vector
+ */
+static std::vector<std::vector<int>> extractGroundtruth(std::vector<CandidateHeap>& heaps) {
+  std::vector<std::vector<int>> base_vectors_indexes(heaps.size());
+
+  for (unsigned int i = 0; i < heaps.size(); i++) {
+    std::sort_heap(heaps[i].begin(), heaps[i].end());
+    base_vectors_indexes[i].reserve(heaps[i].size());
+    for (const auto& pair : heaps[i]) {
+      base_vectors_indexes[i].push_back(pair.second);
+    }
+    CandidateHeap().swap(heaps[i]);
+  }
+
+  return base_vectors_indexes;
+}
 
 /**
  * @brief Compute the groundtruth for a set of base and query vectors.
  * 
  * This function computes the groundtruth for a set of base and query vectors by calculating the Euclidean distance
- * between each query vector and all base vectors. The function supports only two query types: 0 and 1. For query type 0,
- * the function computes the distances between the query vector and all base vectors. For query type 1, the function computes
- * the distances between the query vector and the base vectors with the same C value.
+ * between each query vector and all base vectors. The function supports all four query types. For query type 0, the
+ * function computes the distances between the query vector and all base vectors. For query type 1, the function computes
+ * the distances between the query vector and the base vectors with the same C value. For query type 2, only the base
+ * vectors with l ≤ T ≤ r are considered, and for query type 3 both constraints must hold.
  * 
  * @param base_vectors A vector of BaseDataVector objects representing the base vectors
  * @param query_vectors A vector of QueryDataVector objects representing the query vectors
- * @param maxDistances The maximum number of distances to compute for each query vector
+ * @param maxBaseVectors The maximum number of nearest base vectors to keep for each query vector
+ * @param numThreads The number of threads to use
  * 
- * @return A 2D vector containing the computed distances for each query vector
+ * @return A 2D vector containing the indexes of the nearest base vectors for each query vector
  */
 std::vector<std::vector<int>> computeGroundtruth(
-  const std::vector<BaseDataVector<float>> base_vectors, const std::vector<QueryDataVector<float>> query_vectors, const unsigned int maxBaseVectors) {
+  const std::vector<BaseDataVector<float>>& base_vectors, const std::vector<QueryDataVector<float>>& query_vectors, 
+  const unsigned int maxBaseVectors, const unsigned int numThreads) {
 
-  // Allocate memory for the distance vector and the indexes of the base vectors
-  std::vector<std::vector<int>> base_vectors_indexes(query_vectors.size());
+  // Pack the vectors into contiguous stores so that they can be processed by the batched distance kernel
+  VectorStore base, queries;
+  base.count = base_vectors.size();
+  base.dimension = base_vectors.empty() ? 0 : base_vectors[0].getDimension();
+  base.data.resize((size_t)base.count * base.dimension);
+  base.C.resize(base.count);
+  base.T.resize(base.count);
+  for (unsigned int i = 0; i < base.count; i++) {
+    for (unsigned int d = 0; d < base.dimension; d++) {
+      base.data[(size_t)i * base.dimension + d] = base_vectors[i].getDataAtIndex(d);
+    }
+    base.C[i] = base_vectors[i].getC();
+    base.T[i] = base_vectors[i].getT();
+  }
 
-  // Compute the distances between the query vectors and the base vectors (with the same filter)
-  // If no filter provided then compute to the whole graph
-  withProgress(0, query_vectors.size(), "Computing Groundtruth", [&](int i) {
+  queries.count = query_vectors.size();
+  queries.dimension = query_vectors.empty() ? base.dimension : query_vectors[0].getDimension();
+  queries.data.resize((size_t)queries.count * queries.dimension);
+  queries.queryType.resize(queries.count);
+  queries.V.resize(queries.count);
+  queries.L.resize(queries.count);
+  queries.R.resize(queries.count);
+  for (unsigned int i = 0; i < queries.count; i++) {
+    for (unsigned int d = 0; d < queries.dimension; d++) {
+      queries.data[(size_t)i * queries.dimension + d] = query_vectors[i].getDataAtIndex(d);
+    }
+    queries.queryType[i] = query_vectors[i].getQueryType();
+    queries.V[i] = query_vectors[i].getV();
+    queries.L[i] = query_vectors[i].getL();
+    queries.R[i] = query_vectors[i].getR();
+  }
 
-    auto query = query_vectors[i];
-    std::vector<std::pair<float, int>> paired_vec;
+  std::vector<std::vector<int>> packed_indexes = computeGroundtruth(base, queries, maxBaseVectors, numThreads);
 
-    // Compute the distances between the query vector and all base vectors
-    if (query.getQueryType() == NO_FILTER) {
-      for (auto base : base_vectors) {
-        paired_vec.emplace_back(euclideanDistance(base, query), base.getIndex());
-      }
+  // Map the positions of the packed vectors back to the indexes of the vectors
+  std::vector<std::vector<int>> base_vectors_indexes(packed_indexes.size());
+  for (unsigned int i = 0; i < packed_indexes.size(); i++) {
+    auto& indexes = base_vectors_indexes[query_vectors[i].getIndex()];
+    for (int position : packed_indexes[i]) {
+      indexes.push_back(base_vectors[position].getIndex());
     }
+  }
 
-    // If the filter type is C_EQUALS_v then compute the distances between the query vector 
-    // and the base vectors with the same C value
-    else if (query.getQueryType() == C_EQUALS_v) {
-      for (auto base : base_vectors) {
-        if (base.getC() == query.getV()) {
-          paired_vec.emplace_back(euclideanDistance(base, query), base.getIndex());
-        }
-      }
-    }
+  return base_vectors_indexes;
+
+}
+
+/**
+ * @brief Compute the groundtruth for a set of base and query vectors stored in contiguous stores.
+ * 
+ * The queries and the base vectors are compared tile by tile with the batched distance kernel, using multiple
+ * threads, and a bounded max-heap keeps the nearest base vectors of every query. The supported query types
+ * are the same as in the version of the function that takes vectors of DataVector objects.
+ * 
+ * @param base The base vectors, together with their C and T values
+ * @param queries The query vectors, together with their query type and filter value
+ * @param maxBaseVectors The maximum number of nearest base vectors to keep for each query vector
+ * @param numThreads The number of threads to use
+ * 
+ * @return A 2D vector containing the indexes of the nearest base vectors for each query vector
+ */
+std::vector<std::vector<int>> computeGroundtruth(
+  const VectorStore& base, const VectorStore& queries, const unsigned int maxBaseVectors, const unsigned int numThreads) {
+
+  if (base.count > 0 && base.dimension != queries.dimension) {
+    std::cerr << "Error: Base and query vectors have different dimensions" << std::endl;
+    return {};
+  }
 
-    // Sort the distances and keep only the first `maxBaseVectors` vectors
-    std::sort(paired_vec.begin(), paired_vec.end());
-    paired_vec.resize(std::min((int)maxBaseVectors, (int)paired_vec.size()));
+  std::vector<CandidateHeap> heaps(queries.count);
+  unsigned int blocksCount = (base.count + BASE_BLOCK_SIZE - 1) / BASE_BLOCK_SIZE;
 
-    // Store the indexes of the nearest base vectors
-    for (const auto& pair : paired_vec) {
-      base_vectors_indexes[query.getIndex()].push_back(pair.second);
+  // Compare all the queries against one block of base vectors at a time
+  withProgress(0, blocksCount, "Computing Groundtruth", [&](int block) {
+    unsigned int begin = block * BASE_BLOCK_SIZE;
+    unsigned int end = std::min(begin + BASE_BLOCK_SIZE, base.count);
+    collectCandidates(base, begin, end, queries, heaps, maxBaseVectors, numThreads);
+  });
+
+  return extractGroundtruth(heaps);
+
+}
+
+/**
+ * @brief Compute the groundtruth for a set of query vectors by streaming the base vectors from their file.
+ * 
+ * The base file is scanned in chunks of `chunkSize` vectors with a ChunkedVectorReader, so only one chunk of base
+ * vectors is kept in memory at a time. Every chunk is compared against all the queries in the same way as in the
+ * in-memory version of the function, and the bounded heaps of the queries carry the nearest base vectors from one
+ * chunk to the next.
+ * 
+ * @param baseFile The path of the base vectors file (SIGMOD base format)
+ * @param queries The query vectors, together with their query type and filter value
+ * @param maxBaseVectors The maximum number of nearest base vectors to keep for each query vector
+ * @param chunkSize The number of base vectors read from the file at a time
+ * @param numThreads The number of threads to use
+ * 
+ * @return A 2D vector containing the indexes of the nearest base vectors for each query vector, or an empty vector
+ * if the base file could not be read
+ */
+std::vector<std::vector<int>> computeGroundtruth(
+  const std::string& baseFile, const VectorStore& queries, const unsigned int maxBaseVectors, const unsigned int chunkSize, 
+  const unsigned int numThreads) {
+
+  ChunkedVectorReader reader;
+  if (!reader.open(baseFile, SIGMOD_BASE, chunkSize)) {
+    return {};
+  }
+
+  if (reader.getCount() > 0 && reader.getDimension() != queries.dimension) {
+    std::cerr << "Error: Base and query vectors have different dimensions" << std::endl;
+    return {};
+  }
+
+  std::vector<CandidateHeap> heaps(queries.count);
+  VectorStore chunk;
+  bool failed = false;
+
+  // Scan the base file one chunk at a time and compare all the queries against every chunk
+  withProgress(0, reader.getChunksCount(), "Computing Groundtruth", [&](int) {
+
+    if (failed || !reader.next(chunk)) {
+      failed = true;
+      return;
     }
 
+    collectCandidates(chunk, 0, chunk.count, queries, heaps, maxBaseVectors, numThreads);
+
   });
 
-  return base_vectors_indexes;
+  if (failed) {
+    return {};
+  }
+
+  return extractGroundtruth(heaps);
 
 }
 
@@ -1,5 +1,19 @@
 #include "../include/FilteredVamanaIndex.h"
+#include "../include/GreedySearch.h"
+#include "../include/QueryPlanner.h"
+#include "../include/RangeVamanaIndex.h"
+#include "../include/StichedVamanaIndex.h"
 #include "../include/Filter.h"
+#include "../include/LabelIndex.h"
+#include "../include/read_data.h"
+#include "../include/ThreadPool.h"
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <chrono>
 #include "../include/acutest.h"
 
 
@@ -22,7 +36,1056 @@ void test_filtered_vamana_get_filters(void) {
 
 }
 
+/**
+ * @brief Creates a small filtered index over points on a line, where the i-th point has coordinates (i, i),
+ * categorical value i % 2 and timestamp i / 10.
+ */
+static void createLineIndex(FilteredVamanaIndex<BaseDataVector<float>>& index, const unsigned int n) {
+
+    std::vector<BaseDataVector<float>> points;
+    std::set<CategoricalAttributeFilter> filters;
+    for (unsigned int i = 0; i < n; i++) {
+        BaseDataVector<float> point(2, i, i % 2, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+        filters.insert(CategoricalAttributeFilter(i % 2));
+    }
+
+    index.setFilters(filters);
+    index.createGraph(points, 1.2, 10, 4, NONE, 1, false);
+
+}
+
+void test_filtered_vamana_timestamp_range(void) {
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+
+    std::vector<unsigned int> nodes = index.getNodesInTimestampRange(TimestampRangeFilter(1.0f, 1.95f));
+    TEST_CHECK(nodes.size() == 10);
+    TEST_CHECK(index.countNodesInTimestampRange(TimestampRangeFilter(1.0f, 1.95f)) == 10);
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        TEST_CHECK(nodes[i] == 10 + i);
+    }
+
+    TEST_CHECK(index.countNodesInTimestampRange(TimestampRangeFilter(5.0f, 6.0f)) == 0);
+
+    // The query lies next to point 0, but only points 20 to 29 with C = 1 satisfy its filters
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v_AND_l_LEQ_T_LEQ_r, 1, 2.0f, 2.9f);
+    xq.setDataAtIndex(0.0f, 0);
+    xq.setDataAtIndex(0.0f, 1);
+
+    std::vector<GraphNode<BaseDataVector<float>>> S = { *index.getGraph().getNode(0) };
+    std::vector<CategoricalAttributeFilter> Fx = { CategoricalAttributeFilter(1) };
+    TimestampRangeFilter range(xq.getL(), xq.getR());
+
+    std::set<BaseDataVector<float>> exact = TimestampRangeSearch(index, S, xq, 2, 10, Fx, range).first;
+    TEST_CHECK(exact.size() == 2);
+    for (auto p : exact) {
+        TEST_CHECK(p.getIndex() == 21 || p.getIndex() == 23);
+    }
+
+    // Force the graph traversal, all its results must still satisfy the filters
+    std::set<BaseDataVector<float>> approximate = TimestampRangeSearch(index, S, xq, 2, 10, Fx, range, 0).first;
+    TEST_CHECK(!approximate.empty());
+    for (auto p : approximate) {
+        TEST_CHECK(p.getC() == 1 && range.contains(p.getT()));
+    }
+
+}
+
+void test_query_planner(void) {
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+    TEST_CHECK(index.getLabelCardinality(CategoricalAttributeFilter(1)) == 20);
+    TEST_CHECK(index.getLabelCardinality(CategoricalAttributeFilter(7)) == 0);
+
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 1, -1, -1);
+    xq.setDataAtIndex(0.0f, 0);
+    xq.setDataAtIndex(0.0f, 1);
+
+    // Queries start only from the start node of their own label, or from the global medoid without a label
+    std::vector<GraphNode<BaseDataVector<float>>> S = index.getQueryStartNodes({ CategoricalAttributeFilter(1) });
+    TEST_CHECK(S.size() == 1 && S[0].getData().getC() == 1);
+    TEST_CHECK(index.getQueryStartNodes({ CategoricalAttributeFilter(7) }).empty());
+    S = index.getQueryStartNodes(std::vector<CategoricalAttributeFilter>());
+    TEST_CHECK(S.size() == 1 && S[0].getData().getIndex() == index.getMedoid());
+
+    // Scanning the 20 points of the label is cheaper than any traversal with L = 10
+    QueryPlanner<BaseDataVector<float>> planner(index);
+    TEST_CHECK(planner.estimateQualifyingPoints(xq) == 20);
+    TEST_CHECK(planner.choosePlan(xq, 10) == BRUTE_FORCE);
+
+    QUERY_PLAN plan;
+    std::set<BaseDataVector<float>> nearest = planner.search(xq, 2, 10, plan).first;
+    TEST_CHECK(plan == BRUTE_FORCE);
+    TEST_CHECK(nearest.size() == 2);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() == 1 || p.getIndex() == 3);
+    }
+
+    // A forced unfiltered traversal must still return only points that satisfy the filter
+    QueryPlanner<BaseDataVector<float>> unfilteredPlanner(index, UNFILTERED_GRAPH);
+    std::set<BaseDataVector<float>> postFiltered = unfilteredPlanner.search(xq, 2, 10, plan).first;
+    TEST_CHECK(plan == UNFILTERED_GRAPH);
+    for (auto p : postFiltered) {
+        TEST_CHECK(p.getC() == 1);
+    }
+
+    QUERY_PLAN parsed;
+    TEST_CHECK(QueryPlanner<BaseDataVector<float>>::parsePlan("filtered", parsed) && parsed == FILTERED_GRAPH);
+    TEST_CHECK(!QueryPlanner<BaseDataVector<float>>::parsePlan("fastest", parsed));
+
+}
+
+void test_label_index(void) {
+
+    // Label 0 is carried by every other point and label 5 only by point 3, so only label 0 gets a bitmap
+    std::vector<unsigned int> pointLabels = { 0, 2, 0, 5, 0, 2, 0, 2 };
+    LabelIndex labels;
+    labels.build(pointLabels, 4);
+
+    TEST_CHECK(labels.getLabels() == std::vector<unsigned int>({ 0, 2, 5 }));
+    TEST_CHECK(labels.findLabel(7) == LabelIndex::NO_LABEL);
+    TEST_CHECK(labels.isDense(labels.findLabel(0)) && !labels.isDense(labels.findLabel(5)));
+    TEST_CHECK(labels.getPoints(labels.findLabel(2)) == std::vector<unsigned int>({ 1, 5, 7 }));
+    TEST_CHECK(labels.getCardinality(LabelIndex::NO_LABEL) == 0);
+
+    for (unsigned int i = 0; i < pointLabels.size(); i++) {
+        TEST_CHECK(labels.contains(labels.findLabel(0), i) == (pointLabels[i] == 0));
+        TEST_CHECK(labels.contains(labels.findLabel(5), i) == (pointLabels[i] == 5));
+        TEST_CHECK(!labels.contains(LabelIndex::NO_LABEL, i));
+    }
+
+    // The index must answer the same after a round trip through a stream
+    std::stringstream stream;
+    TEST_CHECK(labels.save(stream));
+    LabelIndex loaded;
+    TEST_CHECK(loaded.load(stream));
+    TEST_CHECK(loaded.getPointsCount() == pointLabels.size());
+    TEST_CHECK(loaded.getLabels() == labels.getLabels());
+    for (unsigned int slot = 0; slot < labels.getLabels().size(); slot++) {
+        TEST_CHECK(loaded.getPoints(slot) == labels.getPoints(slot));
+        TEST_CHECK(loaded.isDense(slot) == labels.isDense(slot));
+        for (unsigned int i = 0; i < pointLabels.size(); i++) {
+            TEST_CHECK(loaded.contains(slot, i) == labels.contains(slot, i));
+        }
+    }
+
+    // A truncated stream must be rejected
+    std::stringstream truncated(stream.str().substr(0, 10));
+    TEST_CHECK(!loaded.load(truncated));
+    TEST_CHECK(loaded.getPointsCount() == 0);
+
+    // The filtered index serves its posting lists from the label index
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+    std::vector<GraphNode<BaseDataVector<float>>> nodes = index.getNodesWithCategoricalValueFilter(CategoricalAttributeFilter(1));
+    TEST_CHECK(nodes.size() == 20);
+    for (auto node : nodes) {
+        TEST_CHECK(node.getData().getC() == 1);
+    }
+
+}
+
+void test_multi_label_filters(void) {
+
+    // Masks relative to a point with labels { 1, 4, 9 }: bit i is set if the other point carries its i-th label
+    LabelIndex labels;
+    labels.build(std::vector<std::vector<unsigned int>>({ { 9, 1, 4 }, { 4, 2, 4 }, { 1, 9 }, {} }));
+    TEST_CHECK(labels.getPointLabelsCount(0) == 3 && labels.getPointLabelsCount(1) == 2 && labels.getPointLabelsCount(3) == 0);
+    TEST_CHECK(labels.getPoints(labels.findLabel(4)) == std::vector<unsigned int>({ 0, 1 }));
+
+    uint64_t mask = 0;
+    labels.getLabelMask(1, 0, &mask);
+    TEST_CHECK(mask == 2);
+    labels.getLabelMask(2, 0, &mask);
+    TEST_CHECK(mask == 5);
+    labels.getLabelMask(3, 0, &mask);
+    TEST_CHECK(mask == 0);
+
+    // Points on a line, where point i carries the labels i % 2 and 10 + i % 3
+    std::vector<BaseDataVector<float>> points;
+    std::vector<std::vector<unsigned int>> labelSets;
+    for (unsigned int i = 0; i < 40; i++) {
+        BaseDataVector<float> point(2, i, i % 2, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+        labelSets.push_back({ i % 2, 10 + i % 3 });
+    }
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    index.setLabelSets(labelSets);
+    index.createGraph(points, 1.2, 10, 8, NONE, 1, false);
+    TEST_CHECK(index.getFilters().size() == 5);
+    TEST_CHECK(index.getLabelCardinality(CategoricalAttributeFilter(10)) == 14);
+
+    std::map<CategoricalAttributeFilter, GraphNode<BaseDataVector<float>>> st = index.findFilteredMedoid(10);
+    TEST_CHECK(st.size() == 5);
+    for (auto& start : st) {
+        TEST_CHECK(index.getLabelIndex().contains(index.getLabelIndex().findLabel(start.first.getC()), start.second.getData().getIndex()));
+    }
+
+    std::vector<GraphNode<BaseDataVector<float>>> S;
+    for (auto& start : st) {
+        S.push_back(start.second);
+    }
+
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 1, -1, -1);
+    xq.setDataAtIndex(0.0f, 0);
+    xq.setDataAtIndex(0.0f, 1);
+
+    // AND: odd points that are multiples of 3, the nearest ones being 3 and 9
+    std::vector<CategoricalAttributeFilter> both = { CategoricalAttributeFilter(1), CategoricalAttributeFilter(10) };
+    std::set<BaseDataVector<float>> all = FilteredGreedySearch(index, S, xq, 2, 20, both).first;
+    TEST_CHECK(all.size() == 2);
+    for (auto p : all) {
+        TEST_CHECK(p.getIndex() == 3 || p.getIndex() == 9);
+    }
+
+    // OR: even points or points with i % 3 == 1, the nearest ones being 0 and 1
+    std::vector<CategoricalAttributeFilter> either = { CategoricalAttributeFilter(0), CategoricalAttributeFilter(11) };
+    std::set<BaseDataVector<float>> any = FilteredGreedySearch(index, S, xq, 2, 20, either, NONE, std::vector<TimestampRangeFilter>(), MATCH_ANY).first;
+    TEST_CHECK(any.size() == 2);
+    for (auto p : any) {
+        TEST_CHECK(p.getIndex() == 0 || p.getIndex() == 1);
+    }
+
+}
+
+void test_persisted_start_nodes(void) {
+
+    // Write the line points of createLineIndex as a SIGMOD base file, so that a graph-only index can refer to it
+    const std::string baseFilename = "sample_line_base.bin";
+    const std::string graphFilename = "sample_line_graph.bin";
+    std::ofstream file(baseFilename, std::ios::binary);
+    unsigned int count = 40;
+    file.write(reinterpret_cast<char*>(&count), sizeof(count));
+    for (unsigned int i = 0; i < count; i++) {
+        float record[4] = { (float)(i % 2), i / 10.0f, (float)i, (float)i };
+        file.write(reinterpret_cast<char*>(record), sizeof(record));
+    }
+    file.close();
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    index.createGraph(ReadFilteredBaseVectorFile(baseFilename), 1.2, 10, 4, NONE, 1, false);
+
+    // Every label has a start node that carries it
+    TEST_CHECK(index.getStartNodes().size() == 2);
+    for (unsigned int label = 0; label < 2; label++) {
+        unsigned int startNode = index.getStartNode(CategoricalAttributeFilter(label));
+        TEST_CHECK(startNode < count && startNode % 2 == label);
+    }
+    TEST_CHECK(index.getStartNode(CategoricalAttributeFilter(5)) == LabelIndex::NO_LABEL);
+
+    // The start nodes and the label index are read back from the graph file
+    TEST_CHECK(index.saveGraphStructure(graphFilename, baseFilename));
+    FilteredVamanaIndex<BaseDataVector<float>> loaded;
+    TEST_CHECK(loaded.loadGraph(graphFilename));
+    TEST_CHECK(loaded.getStartNodes() == index.getStartNodes());
+    TEST_CHECK(loaded.getLabelIndex().getLabels() == index.getLabelIndex().getLabels());
+    TEST_CHECK(loaded.getNodesWithLabel(CategoricalAttributeFilter(1)) == index.getNodesWithLabel(CategoricalAttributeFilter(1)));
+    TEST_CHECK(loaded.getFilters() == index.getFilters());
+
+    // Text index files keep them as well, in a block keyed by label value
+    const std::string textFilename = "sample_line_text.bin";
+    TEST_CHECK(index.saveGraph(textFilename));
+    FilteredVamanaIndex<BaseDataVector<float>> loadedText;
+    TEST_CHECK(loadedText.loadGraph(textFilename));
+    TEST_CHECK(loadedText.getStartNodes() == index.getStartNodes());
+
+    // The start nodes are read from the block, not selected again
+    std::ifstream in(textFilename);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    size_t block = text.find("STRT 2\n");
+    TEST_CHECK(block != std::string::npos);
+    std::ofstream out(textFilename);
+    out << text.substr(0, block) << "STRT 2\n0 38 1 7 \n";
+    out.close();
+    FilteredVamanaIndex<BaseDataVector<float>> patched;
+    TEST_CHECK(patched.loadGraph(textFilename));
+    TEST_CHECK(patched.getStartNode(CategoricalAttributeFilter(0)) == 38 && patched.getStartNode(CategoricalAttributeFilter(1)) == 7);
+
+    // A start node that does not exist makes the file corrupted
+    out.open(textFilename);
+    out << text.substr(0, block) << "STRT 2\n0 38 1 40 \n";
+    out.close();
+    FilteredVamanaIndex<BaseDataVector<float>> corrupted;
+    TEST_CHECK(!corrupted.loadGraph(textFilename));
+
+    std::remove(baseFilename.c_str());
+    std::remove(graphFilename.c_str());
+    std::remove(textFilename.c_str());
+
+}
+
+void test_range_vamana_index(void) {
+
+    // Points on a line whose timestamps decrease along the line, so that the timestamp order is reversed
+    const std::string baseFilename = "sample_range_base.bin";
+    const std::string graphFilename = "sample_range_graph.bin";
+    std::ofstream file(baseFilename, std::ios::binary);
+    unsigned int count = 64;
+    file.write(reinterpret_cast<char*>(&count), sizeof(count));
+    for (unsigned int i = 0; i < count; i++) {
+        float record[4] = { (float)(i % 2), (count - 1 - i) / 10.0f, (float)i, (float)i };
+        file.write(reinterpret_cast<char*>(record), sizeof(record));
+    }
+    file.close();
+
+    RangeVamanaIndex<BaseDataVector<float>> index;
+    index.createGraph(ReadFilteredBaseVectorFile(baseFilename), 1.2, 10, 4, 4, 2, false);
+    TEST_CHECK(index.getLayersCount() > 1);
+
+    // The range [1, 4] keeps the points 23 to 53, searched through their covering segments
+    QueryDataVector<float> xq(2, 0, l_LEQ_T_LEQ_r, -1, 1.0f, 4.0f);
+    xq.setDataAtIndex(30.0f, 0);
+    xq.setDataAtIndex(30.0f, 1);
+    std::set<BaseDataVector<float>> nearest = index.rangeSearch(xq, 3, 10, 2, 1).first;
+    TEST_CHECK(nearest.size() == 3);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() >= 29 && p.getIndex() <= 31);
+    }
+
+    xq.setDataAtIndex(5.0f, 0);
+    xq.setDataAtIndex(5.0f, 1);
+    nearest = index.rangeSearch(xq, 3, 10, 1, 1).first;
+    TEST_CHECK(nearest.size() == 3);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() >= 23 && p.getIndex() <= 25);
+    }
+
+    // A label and a range: only the odd points inside the range qualify
+    QueryDataVector<float> labeled(2, 0, C_EQUALS_v_AND_l_LEQ_T_LEQ_r, 1, 1.0f, 4.0f);
+    labeled.setDataAtIndex(30.0f, 0);
+    labeled.setDataAtIndex(30.0f, 1);
+    nearest = index.rangeSearch(labeled, 2, 10, 1, 1).first;
+    TEST_CHECK(nearest.size() == 2);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() == 29 || p.getIndex() == 31);
+    }
+
+    // The segment layers are stored with the graph and give the same results after loading
+    TEST_CHECK(index.saveGraphStructure(graphFilename, baseFilename));
+    RangeVamanaIndex<BaseDataVector<float>> loaded;
+    TEST_CHECK(loaded.loadGraph(graphFilename));
+    TEST_CHECK(loaded.getLayersCount() == index.getLayersCount());
+    TEST_CHECK(loaded.getLeafSize() == 4);
+    TEST_CHECK(loaded.rangeSearch(labeled, 2, 10, 1, 1).first == nearest);
+
+    std::remove(baseFilename.c_str());
+    std::remove(graphFilename.c_str());
+
+}
+
+void test_stiched_parallel_build(void) {
+
+    // Run the parallel phases on several threads of the pool, whatever the number of hardware threads
+    ThreadPool::configure(4);
+
+    // Points on a line with a skewed label distribution: label 0 holds most of the points, labels 1 to 3 the rest
+    std::vector<BaseDataVector<float>> points;
+    std::set<CategoricalAttributeFilter> filters;
+    unsigned int count = 120;
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned int label = i < 90 ? 0 : 1 + i % 3;
+        BaseDataVector<float> point(2, i, label, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+        filters.insert(CategoricalAttributeFilter(label));
+    }
+
+    // Label 0 is larger than the share of a single thread, so it is built with all the threads
+    StichedVamanaIndex<BaseDataVector<float>> index(filters);
+    index.createGraph(points, 1.2, 20, 20, 24, NONE, 1, 4, false);
+
+    // The stitched edges never cross labels, whichever thread built the sub-index
+    for (unsigned int i = 0; i < count; i++) {
+        GraphNode<BaseDataVector<float>>* node = index.getGraph().getNode(i);
+        TEST_CHECK(!node->getNeighborsVector()->empty());
+        for (auto neighbor : *node->getNeighborsVector()) {
+            TEST_CHECK(neighbor.getC() == node->getData().getC());
+        }
+    }
+
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 0, -1, -1);
+    xq.setDataAtIndex(40.2f, 0);
+    xq.setDataAtIndex(40.2f, 1);
+    std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 3, 20, { CategoricalAttributeFilter(0) }).first;
+    TEST_CHECK(nearest.size() == 3);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() >= 39 && p.getIndex() <= 41);
+    }
+
+    xq.setDataAtIndex(100.4f, 0);
+    xq.setDataAtIndex(100.4f, 1);
+    nearest = FilteredGreedySearch(index, xq, 2, 20, { CategoricalAttributeFilter(2) }).first;
+    TEST_CHECK(nearest.size() == 2);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() == 100 || p.getIndex() == 103);
+    }
+
+    // The batched parallel insertion of a plain index keeps the degree bound and finds the exact neighbors
+    VamanaIndex<BaseDataVector<float>> plain;
+    plain.createGraph(points, 1.2, 20, 6, NONE, 1, false, nullptr, 4);
+    for (unsigned int i = 0; i < count; i++) {
+        TEST_CHECK(plain.getGraph().getNode(i)->getNeighborsVector()->size() <= 6);
+    }
+    nearest = GreedySearch(plain, *plain.getGraph().getNode(plain.getMedoid()), xq, 3, 20).first;
+    TEST_CHECK(nearest.size() == 3);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() >= 99 && p.getIndex() <= 101);
+    }
+
+}
+
+void test_filtered_prune_indexes(void) {
+
+    ThreadPool::configure(4);
+
+    // Points on a line that all carry label 0, and every third point carries label 1 as well
+    std::vector<BaseDataVector<float>> points;
+    std::vector<std::vector<unsigned int>> labelSets;
+    std::set<CategoricalAttributeFilter> filters;
+    unsigned int count = 90;
+    for (unsigned int i = 0; i < count; i++) {
+        BaseDataVector<float> point(2, i, 0, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+        labelSets.push_back(i % 3 == 0 ? std::vector<unsigned int>({ 0, 1 }) : std::vector<unsigned int>({ 0 }));
+    }
+    filters.insert(CategoricalAttributeFilter(0));
+    filters.insert(CategoricalAttributeFilter(1));
+
+    // Point 1 occludes points 2 and 4 for point 0, but not point 3, which shares label 1 with point 0
+    FilteredVamanaIndex<BaseDataVector<float>> labeled(filters);
+    labeled.setLabelSets(labelSets);
+    labeled.createGraph(points, 1.2, 10, 8, NONE, 1, false);
+    std::vector<unsigned int> V = { 4, 3, 2, 1, 1, 0 };
+    FilteredRobustPrune(labeled, 0, V, 1.0f, 8, NONE);
+    TEST_CHECK(V == std::vector<unsigned int>({ 1, 3 }));
+    V = { 4, 3, 2, 1 };
+    FilteredRobustPrune(labeled, 0, V, 1.0f, 1, NONE);
+    TEST_CHECK(V == std::vector<unsigned int>({ 1 }));
+
+    // The points with both labels get the union of two sub-graphs, each bounded by R_small
+    StichedVamanaIndex<BaseDataVector<float>> index(filters);
+    index.setLabelSets(labelSets);
+    index.createGraph(points, 1.2, 20, 6, 6, NONE, 1, 2, false, true);
+    for (unsigned int i = 0; i < count; i++) {
+        TEST_CHECK(index.getGraph().getNode(i)->getNeighborsVector()->size() <= (i % 3 == 0 ? 12u : 6u));
+    }
+
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 1, -1, -1);
+    xq.setDataAtIndex(50.0f, 0);
+    xq.setDataAtIndex(50.0f, 1);
+    std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 2, 20, { CategoricalAttributeFilter(1) }).first;
+    TEST_CHECK(nearest.size() == 2);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() == 48 || p.getIndex() == 51);
+    }
+
+}
+
+void test_filtered_parallel_build(void) {
+
+    ThreadPool::configure(4);
+
+    // Points on a line, where point i carries the labels i % 2 and 10 + i % 3
+    std::vector<BaseDataVector<float>> points;
+    std::vector<std::vector<unsigned int>> labelSets;
+    unsigned int count = 120;
+    for (unsigned int i = 0; i < count; i++) {
+        BaseDataVector<float> point(2, i, i % 2, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+        labelSets.push_back({ i % 2, 10 + i % 3 });
+    }
+
+    // The batched parallel insertion keeps the degree bound and connects only points that share a label
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    index.setLabelSets(labelSets);
+    index.createGraph(points, 1.2, 20, 8, NONE, 1, false, true, 4);
+    for (unsigned int i = 0; i < count; i++) {
+        std::vector<BaseDataVector<float>>* neighbors = index.getGraph().getNode(i)->getNeighborsVector();
+        TEST_CHECK(!neighbors->empty() && neighbors->size() <= 8);
+        for (auto neighbor : *neighbors) {
+            unsigned int j = neighbor.getIndex();
+            TEST_CHECK(i % 2 == j % 2 || i % 3 == j % 3);
+        }
+    }
+
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 11, -1, -1);
+    xq.setDataAtIndex(60.4f, 0);
+    xq.setDataAtIndex(60.4f, 1);
+    std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 2, 20, { CategoricalAttributeFilter(11) }).first;
+    TEST_CHECK(nearest.size() == 2);
+    for (auto p : nearest) {
+        TEST_CHECK(p.getIndex() == 61 || p.getIndex() == 58);
+    }
+
+}
+
+void test_label_index_append(void) {
+
+    std::vector<unsigned int> pointLabels = { 0, 2, 0, 5, 0, 2, 0, 2 };
+    LabelIndex labels;
+    labels.build(pointLabels, 4);
+
+    // Appended points join the posting lists of their labels, and a new label moves the slots after it
+    TEST_CHECK(labels.addPoint({ 0 }).empty());
+    TEST_CHECK(labels.addPoint({ 3, 5 }) == std::vector<unsigned int>({ 3 }));
+    pointLabels.push_back(0);
+    TEST_CHECK(labels.getPointsCount() == 10);
+    TEST_CHECK(labels.getLabels() == std::vector<unsigned int>({ 0, 2, 3, 5 }));
+    TEST_CHECK(labels.getPoints(labels.findLabel(3)) == std::vector<unsigned int>({ 9 }));
+    TEST_CHECK(labels.getPoints(labels.findLabel(5)) == std::vector<unsigned int>({ 3, 9 }));
+    TEST_CHECK(labels.getPoints(labels.findLabel(0)).back() == 8);
+    TEST_CHECK(labels.getPointLabelsCount(9) == 2);
+    TEST_CHECK(labels.getPointSlots(3)[0] == labels.findLabel(5));
+
+    for (unsigned int i = 0; i < pointLabels.size(); i++) {
+        TEST_CHECK(labels.contains(labels.findLabel(0), i) == (pointLabels[i] == 0));
+        TEST_CHECK(labels.contains(labels.findLabel(2), i) == (pointLabels[i] == 2));
+    }
+    TEST_CHECK(labels.contains(labels.findLabel(3), 9) && labels.contains(labels.findLabel(5), 9));
+
+    // The bitmaps are extended to the appended points when the index is saved
+    std::stringstream stream;
+    TEST_CHECK(labels.save(stream));
+    LabelIndex loaded;
+    TEST_CHECK(loaded.load(stream));
+    TEST_CHECK(loaded.getLabels() == labels.getLabels());
+    for (unsigned int slot = 0; slot < labels.getLabels().size(); slot++) {
+        TEST_CHECK(loaded.getPoints(slot) == labels.getPoints(slot));
+        for (unsigned int i = 0; i < labels.getPointsCount(); i++) {
+            TEST_CHECK(loaded.contains(slot, i) == labels.contains(slot, i));
+        }
+    }
+
+}
+
+void test_filtered_insert(void) {
+
+    ThreadPool::configure(4);
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+
+    // Insert the next points of the line from several threads, the last ones with a label of their own
+    std::vector<BaseDataVector<float>> points;
+    for (unsigned int i = 40; i < 80; i++) {
+        BaseDataVector<float> point(2, 0, i < 70 ? i % 2 : 7, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+    }
+
+    std::vector<unsigned int> indexes(points.size());
+    std::atomic<int> inserted(0);
+    ThreadPool::getInstance().parallelFor(0, points.size(), [&](unsigned int i) {
+        inserted += index.insert(points[i], indexes[i]);
+    }, 0, 1);
+
+    TEST_CHECK(inserted == 40);
+    TEST_CHECK(index.getGraph().getNodesCount() == 80 && index.getLabelIndex().getPointsCount() == 80);
+    TEST_CHECK(index.getLabelCardinality(CategoricalAttributeFilter(7)) == 10);
+    TEST_CHECK(index.getFilters().count(CategoricalAttributeFilter(7)) == 1);
+    TEST_CHECK(index.getStartNodes().size() == 3 && index.getStartNode(CategoricalAttributeFilter(7)) != LabelIndex::NO_LABEL);
+    TEST_CHECK(index.countNodesInTimestampRange(TimestampRangeFilter(4.0f, 7.95f)) == 40);
+
+    // Every point keeps the degree bound and links only to points of its own label
+    for (unsigned int i = 0; i < 80; i++) {
+        const BaseDataVector<float>& p = index.getGraph().getNode(i)->getData();
+        std::vector<BaseDataVector<float>>* neighbors = index.getGraph().getNode(i)->getNeighborsVector();
+        TEST_CHECK(neighbors->size() <= 4);
+        for (auto neighbor : *neighbors) {
+            TEST_CHECK(neighbor.getC() == p.getC());
+        }
+    }
+
+    // The inserted points are found by filtered searches, through the start node of the new label as well
+    for (unsigned int label : { 0u, 7u }) {
+        QueryDataVector<float> xq(2, 0, C_EQUALS_v, label, -1, -1);
+        xq.setDataAtIndex(74.2f, 0);
+        xq.setDataAtIndex(74.2f, 1);
+        std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 2, 10, { CategoricalAttributeFilter(label) }).first;
+        TEST_CHECK(nearest.size() == 2);
+        for (auto p : nearest) {
+            float x = p.getDataAtIndex(0);
+            TEST_CHECK(label == 0 ? (x == 66 || x == 68) : (x == 74 || x == 75));
+        }
+    }
+
+    // Range indexes address their points by timestamp order and refuse insertions
+    RangeVamanaIndex<BaseDataVector<float>> range;
+    unsigned int index_;
+    TEST_CHECK(!range.insert(points[0], index_));
+
+}
+
+void test_filtered_search_during_inserts(void) {
+
+    ThreadPool::configure(4);
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+
+    // Filtered searches for the initial points run while the line grows, the last points with a label of their own
+    std::vector<BaseDataVector<float>> points;
+    for (unsigned int i = 40; i < 120; i++) {
+        BaseDataVector<float> point(2, 0, i < 110 ? i % 2 : 9, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+    }
+
+    std::atomic<int> inserted(0), searches(0), found(0), invalid(0);
+    ThreadPool::getInstance().parallelFor(0, 160, [&](unsigned int t) {
+        if (t % 2 == 0) {
+            unsigned int i;
+            inserted += index.insert(points[t / 2], i);
+            return;
+        }
+
+        unsigned int target = (t / 2) % 40;
+        QueryDataVector<float> xq(2, 0, C_EQUALS_v, target % 2, -1, -1);
+        xq.setDataAtIndex(target, 0);
+        xq.setDataAtIndex(target, 1);
+        std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 1, 10, { CategoricalAttributeFilter(target % 2) }).first;
+        searches++;
+        for (auto p : nearest) {
+            found += p.getIndex() == target;
+            invalid += p.getC() != target % 2;
+        }
+    }, 0, 1);
+
+    TEST_CHECK(inserted == 80);
+    TEST_CHECK(index.getGraph().getNodesCount() == 120 && index.getLabelIndex().getPointsCount() == 120);
+    TEST_CHECK(index.getLabelCardinality(CategoricalAttributeFilter(9)) == 10);
+    TEST_CHECK(invalid == 0 && found == searches);
+    TEST_MSG("%d of %d searches found their point", (int)found, (int)searches);
+
+}
+
+void test_filtered_search_beside_blocked_insert(void) {
+
+    ThreadPool::configure(4);
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+
+    // Hold the lock of the start node of label 0, so that the searches and the insertions of label 0 wait for it
+    SpinReadWriteLock& startLock = index.getGraph().getNodeSync(index.getStartNode(CategoricalAttributeFilter(0))).lock;
+    startLock.lock();
+
+    std::atomic<bool> searched(false), inserted(false), otherSearched(false);
+    auto search = [&index](unsigned int label, std::atomic<bool>* done) {
+        QueryDataVector<float> xq(2, 0, C_EQUALS_v, label, -1, -1);
+        xq.setDataAtIndex(20.0f, 0);
+        xq.setDataAtIndex(20.0f, 1);
+        FilteredGreedySearch(index, xq, 1, 10, { CategoricalAttributeFilter(label) });
+        *done = true;
+    };
+
+    // A search of label 0 waits for the start node, and then an insertion of label 0 waits for it as well, in its
+    // own search of the graph
+    std::thread first(search, 0, &searched);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::thread insertion([&]() {
+        BaseDataVector<float> point(2, 0, 0, 4.0f);
+        point.setDataAtIndex(40, 0);
+        point.setDataAtIndex(40, 1);
+        unsigned int i;
+        inserted = index.insert(point, i);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // A search of label 1 still completes, since neither of them holds the filters lock while it waits
+    std::thread second(search, 1, &otherSearched);
+    for (unsigned int i = 0; i < 500 && !otherSearched; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    TEST_CHECK(otherSearched);
+    TEST_CHECK(!searched && !inserted);
+
+    startLock.unlock();
+    first.join();
+    insertion.join();
+    second.join();
+    TEST_CHECK(searched && inserted);
+    TEST_CHECK(index.getGraph().getNodesCount() == 41 && index.getLabelCardinality(CategoricalAttributeFilter(0)) == 21);
+
+}
+
+void test_filtered_remove(void) {
+
+    ThreadPool::configure(4);
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 60);
+
+    // Remove the start node of label 1 and the points 20 to 39
+    unsigned int start = index.getStartNode(CategoricalAttributeFilter(1));
+    TEST_CHECK(index.remove(start));
+    for (unsigned int i = 20; i < 40; i++) {
+        if (i != start) {
+            TEST_CHECK(index.remove(i));
+        }
+    }
+    unsigned int removedCount = index.getDeletedCount();
+
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 1, -1, -1);
+    xq.setDataAtIndex(30.0f, 0);
+    xq.setDataAtIndex(30.0f, 1);
+    for (auto p : FilteredGreedySearch(index, xq, 2, 10, { CategoricalAttributeFilter(1) }).first) {
+        TEST_CHECK(!index.isDeleted(p.getIndex()));
+    }
+
+    index.consolidate(4);
+    unsigned int n = index.getGraph().getNodesCount();
+    TEST_CHECK(n == 60 - removedCount && index.getLabelIndex().getPointsCount() == n);
+    TEST_CHECK(index.getStartNodes().size() == 2);
+    TEST_CHECK(index.getStartNode(CategoricalAttributeFilter(1)) < n);
+    TEST_CHECK(index.getLabelCardinality(CategoricalAttributeFilter(0)) + index.getLabelCardinality(CategoricalAttributeFilter(1)) == n);
+    TEST_CHECK(index.countNodesInTimestampRange(TimestampRangeFilter(2.0f, 3.95f)) == 0);
+
+    for (unsigned int i = 0; i < n; i++) {
+        const BaseDataVector<float>& p = index.getGraph().getNode(i)->getData();
+        for (auto neighbor : *index.getGraph().getNode(i)->getNeighborsVector()) {
+            TEST_CHECK(neighbor.getIndex() < n && neighbor.getC() == p.getC());
+        }
+    }
+
+    // The nearest points of label 1 around the removed range are now 19 and 41
+    std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 2, 10, { CategoricalAttributeFilter(1) }).first;
+    TEST_CHECK(nearest.size() == 2);
+    for (auto p : nearest) {
+        float x = p.getDataAtIndex(0);
+        TEST_CHECK(x == 19 || x == 41);
+    }
+
+    RangeVamanaIndex<BaseDataVector<float>> range;
+    TEST_CHECK(!range.remove(0));
+
+}
+
+void test_filtered_search_during_consolidate(void) {
+
+    ThreadPool::configure(4);
+
+    // Point i lies at (i, i) and carries the label i % 2
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 400);
+
+    // Searches for label 1 run on their own while points are removed and consolidated in rounds, and only return
+    // odd points, whatever the numbering of the index at the time
+    std::atomic<bool> done(false);
+    std::atomic<int> searches(0), invalid(0);
+    std::vector<std::thread> searchers;
+    for (unsigned int t = 0; t < 3; t++) {
+        searchers.emplace_back([&, t]() {
+            for (unsigned int i = t; !done || i < t + 30; i += 3) {
+                QueryDataVector<float> xq(2, 0, C_EQUALS_v, 1, -1, -1);
+                xq.setDataAtIndex(i % 400, 0);
+                xq.setDataAtIndex(i % 400, 1);
+                std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 2, 10, { CategoricalAttributeFilter(1) }).first;
+                searches++;
+                for (auto p : nearest) {
+                    invalid += p.getC() != 1 || (int)p.getDataAtIndex(0) % 2 != 1;
+                }
+            }
+        });
+    }
+
+    unsigned int remaining = 400;
+    for (unsigned int round = 0; round < 4; round++) {
+        for (unsigned int i = round; i < remaining; i += 5) {
+            index.remove(i);
+        }
+        remaining -= index.getDeletedCount();
+        index.consolidate(2);
+    }
+    done = true;
+    for (auto& searcher : searchers) {
+        searcher.join();
+    }
+
+    TEST_CHECK(index.getGraph().getNodesCount() == remaining);
+    TEST_CHECK(searches >= 90 && invalid == 0);
+    TEST_MSG("%d of %d searches returned invalid points", (int)invalid, (int)searches);
+
+}
+
+void test_filtered_search_budget(void) {
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 1, -1, -1);
+    xq.setDataAtIndex(39.0f, 0);
+    xq.setDataAtIndex(39.0f, 1);
+    std::vector<CategoricalAttributeFilter> Fx = { CategoricalAttributeFilter(1) };
+
+    SearchBudget unbounded;
+    auto full = FilteredGreedySearch(index, xq, 2, 10, Fx, NONE, std::vector<TimestampRangeFilter>(), MATCH_ALL, &unbounded);
+    TEST_CHECK(full.first == FilteredGreedySearch(index, xq, 2, 10, Fx).first);
+    TEST_CHECK(!unbounded.truncated && unbounded.hops == full.second.size() && unbounded.hops > 2);
+
+    // The truncated search still returns only points with the label of the query
+    SearchBudget hops;
+    hops.maxHops = 2;
+    auto truncated = FilteredGreedySearch(index, xq, 2, 10, Fx, NONE, std::vector<TimestampRangeFilter>(), MATCH_ALL, &hops);
+    TEST_CHECK(hops.truncated && hops.hops == 2 && truncated.second.size() == 2);
+    TEST_CHECK(!truncated.first.empty());
+    for (auto p : truncated.first) {
+        TEST_CHECK(p.getC() == 1);
+    }
+
+    // A search that stops on convergence still finds the nearest points of the label at the end of the line
+    SearchBudget patience;
+    patience.patience = 2;
+    auto converged = FilteredGreedySearch(index, xq, 2, 10, Fx, NONE, std::vector<TimestampRangeFilter>(), MATCH_ALL, &patience);
+    TEST_CHECK(converged.first == full.first && !patience.truncated && patience.hops <= unbounded.hops);
+
+    // Only the points of the label count towards the k nearest, so the expansions over points without it are not
+    // stalls either
+    for (unsigned int patienceLimit = 1; patienceLimit <= 2; patienceLimit++) {
+        SearchBudget small;
+        small.patience = patienceLimit;
+        auto nearest = FilteredGreedySearch(index, xq, 5, 10, Fx, NONE, std::vector<TimestampRangeFilter>(), MATCH_ALL, &small);
+        TEST_CHECK(small.converged && nearest.first.size() == 5);
+        TEST_MSG("patience %u returned %zu points", patienceLimit, nearest.first.size());
+    }
+
+    // The planner passes the budget to its graph traversals
+    QueryPlanner<BaseDataVector<float>> planner(index, FILTERED_GRAPH);
+    SearchBudget planned;
+    planned.maxHops = 2;
+    QUERY_PLAN plan;
+    planner.search(xq, 2, 10, plan, &planned);
+    TEST_CHECK(plan == FILTERED_GRAPH && planned.truncated && planned.hops == 2);
+
+}
+
+void test_label_start_caches(void) {
+
+    ThreadPool::configure(4);
+
+    // Write 200 line points as a SIGMOD base file, so that a graph-only index can refer to it
+    const std::string baseFilename = "sample_start_caches_base.bin";
+    const std::string graphFilename = "sample_start_caches_graph.bin";
+    std::ofstream file(baseFilename, std::ios::binary);
+    unsigned int count = 200;
+    file.write(reinterpret_cast<char*>(&count), sizeof(count));
+    for (unsigned int i = 0; i < count; i++) {
+        float record[4] = { (float)(i % 2), i / 10.0f, (float)i, (float)i };
+        file.write(reinterpret_cast<char*>(record), sizeof(record));
+    }
+    file.close();
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    index.createGraph(ReadFilteredBaseVectorFile(baseFilename), 1.2, 10, 4, NONE, 1, false);
+    TEST_CHECK(index.buildStartNodeCache(8, 2) == 8);
+
+    // Every label caches distinct points that carry it, starting from its start node
+    const std::vector<StartNodeCache>& caches = index.getLabelStartCaches();
+    TEST_CHECK(caches.size() == 2);
+    for (unsigned int slot = 0; slot < caches.size(); slot++) {
+        unsigned int label = index.getLabelIndex().getLabels()[slot];
+        std::set<unsigned int> distinct(caches[slot].nodes.begin(), caches[slot].nodes.end());
+        TEST_CHECK(caches[slot].nodes.size() == 8 && distinct.size() == 8 && caches[slot].vectors.size() == 16);
+        TEST_CHECK(caches[slot].nodes[0] == index.getStartNodes()[slot]);
+        for (unsigned int node : caches[slot].nodes) {
+            TEST_CHECK(node % 2 == label);
+        }
+    }
+
+    // A labeled query starts from the cached node of its label nearest to it, an unlabeled one from the global cache
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 1, -1, -1);
+    xq.setDataAtIndex(150.2f, 0);
+    xq.setDataAtIndex(150.2f, 1);
+    std::vector<GraphNode<BaseDataVector<float>>> S = index.getQueryStartNodes({ CategoricalAttributeFilter(1) }, xq);
+    const StartNodeCache& labelCache = caches[index.getLabelIndex().findLabel(1)];
+    TEST_CHECK(S.size() == 1 && std::find(labelCache.nodes.begin(), labelCache.nodes.end(), S[0].getData().getIndex()) != labelCache.nodes.end());
+    for (unsigned int node : labelCache.nodes) {
+        TEST_CHECK(std::fabs(S[0].getData().getDataAtIndex(0) - 150.2f) <= std::fabs(node - 150.2f));
+    }
+    S = index.getQueryStartNodes({}, xq);
+    TEST_CHECK(S.size() == 1 && S[0].getData().getIndex() == index.findSearchStart(xq));
+
+    std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 2, 10, { CategoricalAttributeFilter(1) }).first;
+    TEST_CHECK(nearest.size() == 2);
+    for (auto p : nearest) {
+        float x = p.getDataAtIndex(0);
+        TEST_CHECK(x == 149 || x == 151);
+    }
+
+    // Graph-only files store the caches of the labels
+    TEST_CHECK(index.saveGraphStructure(graphFilename, baseFilename));
+    FilteredVamanaIndex<BaseDataVector<float>> loaded;
+    TEST_CHECK(loaded.loadGraph(graphFilename));
+    TEST_CHECK(loaded.getLabelStartCaches().size() == 2);
+    for (unsigned int slot = 0; slot < loaded.getLabelStartCaches().size(); slot++) {
+        TEST_CHECK(loaded.getLabelStartCaches()[slot].nodes == caches[slot].nodes);
+        TEST_CHECK(loaded.getLabelStartCaches()[slot].vectors == caches[slot].vectors);
+    }
+
+    // A point with a new label is the only cached node of its label
+    BaseDataVector<float> point(2, 0, 7, 20.0f);
+    point.setDataAtIndex(200.0f, 0);
+    point.setDataAtIndex(200.0f, 1);
+    unsigned int inserted;
+    TEST_CHECK(index.insert(point, inserted));
+    TEST_CHECK(caches.size() == 3 && caches[index.getLabelIndex().findLabel(7)].nodes == std::vector<unsigned int>{ inserted });
+    TEST_CHECK(caches[index.getLabelIndex().findLabel(1)].nodes == loaded.getLabelStartCaches()[loaded.getLabelIndex().findLabel(1)].nodes);
+
+    // Consolidating drops the removed nodes from the caches of their labels
+    unsigned int slot = index.getLabelIndex().findLabel(0);
+    unsigned int removed = caches[slot].nodes[1];
+    TEST_CHECK(index.remove(removed));
+    index.consolidate(2);
+    slot = index.getLabelIndex().findLabel(0);
+    TEST_CHECK(caches.size() == 3 && caches[slot].nodes.size() == 7 && caches[slot].vectors.size() == 14);
+    for (unsigned int node : caches[slot].nodes) {
+        TEST_CHECK(node < index.getGraph().getNodesCount() && index.getGraph().getNode(node)->getData().getC() == 0);
+    }
+
+    std::remove(baseFilename.c_str());
+    std::remove(graphFilename.c_str());
+
+}
+
+void test_filtered_insert_label_sets(void) {
+
+    // Points on a line, where point i carries the labels i % 2 and 10 + i % 3
+    std::vector<BaseDataVector<float>> points;
+    std::vector<std::vector<unsigned int>> labelSets;
+    for (unsigned int i = 0; i < 40; i++) {
+        BaseDataVector<float> point(2, i, i % 2, i / 10.0f);
+        point.setDataAtIndex(i, 0);
+        point.setDataAtIndex(i, 1);
+        points.push_back(point);
+        labelSets.push_back({ i % 2, 10 + i % 3 });
+    }
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    index.setLabelSets(labelSets);
+    index.createGraph(points, 1.2, 10, 8, NONE, 1, false);
+
+    // A multi-label index refuses points without their label set, and keeps every label of the inserted ones
+    BaseDataVector<float> point(2, 0, 1, 4.0f);
+    point.setDataAtIndex(40.2f, 0);
+    point.setDataAtIndex(40.2f, 1);
+    unsigned int inserted = 0;
+    TEST_CHECK(!index.insert(point, inserted));
+    TEST_CHECK(index.getGraph().getNodesCount() == 40);
+    TEST_CHECK(!index.insert(point, std::vector<unsigned int>(), inserted));
+
+    TEST_CHECK(index.insert(point, { 1, 11, 20 }, inserted) && inserted == 40);
+    const LabelIndex& labels = index.getLabelIndex();
+    TEST_CHECK(labels.getPointLabelsCount(40) == 3);
+    for (unsigned int label : { 1u, 11u, 20u }) {
+        TEST_CHECK(labels.contains(labels.findLabel(label), 40));
+    }
+    TEST_CHECK(index.getStartNode(CategoricalAttributeFilter(20)) == 40 && index.getFilters().size() == 6);
+
+    // The point is found through each of its labels, and by AND queries over them
+    QueryDataVector<float> xq(2, 0, C_EQUALS_v, 11, -1, -1);
+    xq.setDataAtIndex(40.0f, 0);
+    xq.setDataAtIndex(40.0f, 1);
+    for (unsigned int label : { 11u, 20u }) {
+        std::set<BaseDataVector<float>> nearest = FilteredGreedySearch(index, xq, 1, 10, { CategoricalAttributeFilter(label) }).first;
+        TEST_CHECK(nearest.size() == 1 && nearest.begin()->getIndex() == 40);
+    }
+    std::vector<CategoricalAttributeFilter> both = { CategoricalAttributeFilter(1), CategoricalAttributeFilter(11) };
+    std::set<BaseDataVector<float>> all = FilteredGreedySearch(index, xq, 1, 10, both).first;
+    TEST_CHECK(all.size() == 1 && all.begin()->getIndex() == 40);
+
+    // Consolidating keeps the label sets of the inserted points
+    TEST_CHECK(index.remove(0));
+    index.consolidate(1);
+    TEST_CHECK(index.getLabelIndex().getPointLabelsCount(39) == 3);
+
+    // A point whose labels differ from its attribute C turns a single-label index into a multi-label one
+    FilteredVamanaIndex<BaseDataVector<float>> single;
+    createLineIndex(single, 40);
+    TEST_CHECK(single.insert(point, inserted) && single.getLabelIndex().getPointLabelsCount(inserted) == 1);
+    TEST_CHECK(single.insert(point, { 1, 7 }, inserted) && single.getLabelIndex().getPointLabelsCount(inserted) == 2);
+    TEST_CHECK(!single.insert(point, inserted));
+    TEST_CHECK(single.getLabelIndex().getPointLabelsCount(3) == 1 && single.getLabelIndex().contains(single.getLabelIndex().findLabel(1), 3));
+
+}
+
+void test_timestamp_side_run(void) {
+
+    FilteredVamanaIndex<BaseDataVector<float>> index;
+    createLineIndex(index, 40);
+
+    // Compares the timestamp index with a scan over the points
+    auto matchesScan = [&](const float l, const float r) {
+        std::vector<unsigned int> nodes = index.getNodesInTimestampRange(TimestampRangeFilter(l, r));
+        unsigned int expected = 0;
+        for (unsigned int i = 0; i < index.getGraph().getNodesCount(); i++) {
+            float t = index.getGraph().getNode(i)->getData().getT();
+            expected += t >= l && t <= r;
+        }
+        bool sorted = true;
+        for (unsigned int i = 1; i < nodes.size(); i++) {
+            sorted = sorted && index.getGraph().getNode(nodes[i - 1])->getData().getT() <= index.getGraph().getNode(nodes[i])->getData().getT();
+        }
+        return sorted && nodes.size() == expected && index.countNodesInTimestampRange(TimestampRangeFilter(l, r)) == expected;
+    };
+
+    // Inserted points with timestamps among the existing ones wait in the side run, which the lookups merge in,
+    // until there are enough of them to merge the runs
+    bool consistent = true;
+    for (unsigned int i = 0; i < 1100; i++) {
+        BaseDataVector<float> point(2, 0, i % 2, (i * 7 % 50) / 10.0f);
+        point.setDataAtIndex(40.0f + i, 0);
+        point.setDataAtIndex(40.0f + i, 1);
+        unsigned int inserted;
+        TEST_CHECK(index.insert(point, inserted));
+        if (i == 10 || i == 500 || i == 1099) {
+            consistent = consistent && matchesScan(0.0f, 10.0f) && matchesScan(1.0f, 1.95f) && matchesScan(3.3f, 3.3f) && matchesScan(4.5f, 4.0f);
+        }
+    }
+    TEST_CHECK(consistent);
+
+    // Rebuilding the index, as consolidation does, empties the side run
+    TEST_CHECK(index.remove(5));
+    index.consolidate(1);
+    TEST_CHECK(matchesScan(0.0f, 10.0f) && matchesScan(1.0f, 1.95f));
+
+}
+
 TEST_LIST = {
     { "filtered_vamana_get_filters", test_filtered_vamana_get_filters },
+    { "filtered_vamana_timestamp_range", test_filtered_vamana_timestamp_range },
+    { "query_planner", test_query_planner },
+    { "label_index", test_label_index },
+    { "multi_label_filters", test_multi_label_filters },
+    { "persisted_start_nodes", test_persisted_start_nodes },
+    { "range_vamana_index", test_range_vamana_index },
+    { "stiched_parallel_build", test_stiched_parallel_build },
+    { "filtered_prune_indexes", test_filtered_prune_indexes },
+    { "filtered_parallel_build", test_filtered_parallel_build },
+    { "label_index_append", test_label_index_append },
+    { "filtered_insert", test_filtered_insert },
+    { "filtered_remove", test_filtered_remove },
+    { "filtered_search_during_inserts", test_filtered_search_during_inserts },
+    { "filtered_search_beside_blocked_insert", test_filtered_search_beside_blocked_insert },
+    { "filtered_search_budget", test_filtered_search_budget },
+    { "filtered_search_during_consolidate", test_filtered_search_during_consolidate },
+    { "label_start_caches", test_label_start_caches },
+    { "filtered_insert_label_sets", test_filtered_insert_label_sets },
+    { "timestamp_side_run", test_timestamp_side_run },
     { NULL, NULL }
 };
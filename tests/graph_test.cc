@@ -97,10 +97,40 @@ void test_graph_get_nodes_vector(void) {
 
 }
 
+void test_graph_add_node(void) {
+
+    Graph<int> graph1(3);
+    for (unsigned int i = 0; i < graph1.getNodesCount(); i++) {
+        graph1.setNodeData(i, i);
+    }
+    graph1.connectNodesByIndex(0, 1);
+    GraphNode<int>* first = graph1.getNode(0);
+
+    // Nodes added past the first segment get the next indexes, and the existing nodes are not moved
+    for (int i = 3; i < 5000; i++) {
+        TEST_CHECK(graph1.addNode(i) == (unsigned int)i);
+    }
+    TEST_CHECK(graph1.getNodesCount() == 5000);
+    TEST_CHECK(graph1.getNode(0) == first);
+    TEST_CHECK(graph1.getNodesVector().size() == 5000);
+
+    bool consistent = true;
+    for (unsigned int i = 0; i < graph1.getNodesCount(); i++) {
+        consistent = consistent && graph1.getNodeData(i) == (int)i && graph1.getNode(i)->getIndex() == (int)i;
+    }
+    TEST_CHECK(consistent);
+    TEST_CHECK(graph1.getNode(5000) == nullptr);
+
+    TEST_CHECK(graph1.connectNodesByIndex(4999, 0));
+    TEST_CHECK(graph1.getNodeNeighbors(4999)->size() == 1 && graph1.getNodeNeighbors(0)->at(0) == 1);
+
+}
+
 TEST_LIST = {
     { "graph_initialization_test", test_graph_initialization },
     { "graph_setting_and_fetching_data_test", test_graph_node_data_setting_and_fetching },
     { "graph_nodes_connectivity_test", test_graph_nodes_connectivity },
     { "graph_get_nodes_vector_test", test_graph_get_nodes_vector },
+    { "graph_add_node_test", test_graph_add_node },
     { NULL, NULL }
 };
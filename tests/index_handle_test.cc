@@ -0,0 +1,133 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <utime.h>
+#include "../include/IndexHandle.h"
+#include "../include/VamanaIndex.h"
+#include "../include/GreedySearch.h"
+#include "../include/ThreadPool.h"
+#include "../include/acutest.h"
+
+typedef VamanaIndex<DataVector<float>> Index;
+
+
+/**
+ * @brief Creates an index over random points of the unit square shifted by an offset, so that the indexes of two
+ * offsets can be told apart by the points their searches return.
+ */
+static std::shared_ptr<Index> createShiftedIndex(const float offset, const unsigned int seed) {
+
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+  std::vector<DataVector<float>> points;
+  for (unsigned int i = 0; i < 100; i++) {
+    DataVector<float> point(2, i);
+    point.setDataAtIndex(offset + distribution(generator), 0);
+    point.setDataAtIndex(offset + distribution(generator), 1);
+    points.push_back(point);
+  }
+
+  std::shared_ptr<Index> index = std::make_shared<Index>();
+  index->createGraph(points, 1.2, 20, 6, NONE, 1, false);
+  return index;
+
+}
+
+/**
+ * @brief Searches a snapshot for the nearest point of a query and returns its first coordinate.
+ */
+static float searchNearest(const Index& index, const DataVector<float>& xq) {
+
+  GraphNode<DataVector<float>> s(index.getGraph().getNode(index.getMedoid())->getData());
+  std::set<DataVector<float>> nearest = GreedySearch(index, s, xq, 1, 20, NONE).first;
+  return nearest.empty() ? -1.0f : nearest.begin()->getDataAtIndex(0);
+
+}
+
+void test_publish_snapshots(void) {
+
+  ThreadPool::configure(4);
+
+  IndexHandle<Index> handle;
+  TEST_CHECK(!handle.acquire() && handle.getGeneration() == 0);
+
+  handle.publish(createShiftedIndex(0.0f, 1));
+  std::weak_ptr<Index> first = handle.acquire();
+  TEST_CHECK(handle.getGeneration() == 1);
+
+  // Searches keep the snapshot they acquired while the second index is published halfway through them
+  DataVector<float> xq(2, 0);
+  xq.setDataAtIndex(0.5f, 0);
+  xq.setDataAtIndex(0.5f, 1);
+  std::atomic<int> consistent(0), onFirst(0), onSecond(0);
+  ThreadPool::getInstance().parallelFor(0, 200, [&](unsigned int i) {
+    if (i == 100) {
+      handle.publish(createShiftedIndex(10.0f, 2));
+      return;
+    }
+    std::shared_ptr<Index> snapshot = handle.acquire();
+    float before = searchNearest(*snapshot, xq);
+    float after = searchNearest(*snapshot, xq);
+    consistent += before == after;
+    onFirst += before < 5.0f;
+    onSecond += before > 5.0f;
+  }, 0, 1);
+
+  TEST_CHECK(consistent == 199 && onFirst + onSecond == 199);
+  TEST_CHECK(handle.getGeneration() == 2);
+
+  // The first snapshot was freed with its last search, and new searches see the second index
+  TEST_CHECK(first.expired());
+  TEST_CHECK(searchNearest(*handle.acquire(), xq) > 5.0f);
+
+  // A snapshot that is still held outlives its replacement
+  std::shared_ptr<Index> held = handle.acquire();
+  std::shared_ptr<Index> previous = handle.publish(createShiftedIndex(20.0f, 3));
+  TEST_CHECK(previous == held);
+  previous.reset();
+  TEST_CHECK(searchNearest(*held, xq) > 5.0f && searchNearest(*held, xq) < 15.0f);
+  TEST_CHECK(searchNearest(*handle.acquire(), xq) > 15.0f);
+
+}
+
+void test_load_and_reload(void) {
+
+  const std::string filename = "sample_handle_graph.bin";
+  IndexHandle<Index> handle;
+
+  // Missing files do not publish anything
+  TEST_CHECK(!handle.load("non_existent_graph.bin"));
+  TEST_CHECK(!handle.reloadIfModified() && !handle.acquire());
+
+  TEST_CHECK(createShiftedIndex(0.0f, 4)->saveGraph(filename));
+  TEST_CHECK(handle.load(filename));
+  std::shared_ptr<Index> loaded = handle.acquire();
+  TEST_CHECK(loaded && loaded->getGraph().getNodesCount() == 100 && handle.getGeneration() == 1);
+
+  // An unchanged file is not loaded again, a replaced one is
+  TEST_CHECK(!handle.reloadIfModified() && handle.getGeneration() == 1);
+  TEST_CHECK(createShiftedIndex(10.0f, 5)->saveGraph(filename));
+
+  // Move the modification time forward, in case the file system records it too coarsely to tell the saves apart
+  struct utimbuf times;
+  times.actime = times.modtime = std::time(nullptr) + 60;
+  TEST_CHECK(utime(filename.c_str(), &times) == 0);
+  TEST_CHECK(handle.reloadIfModified() && handle.getGeneration() == 2);
+  TEST_CHECK(handle.acquire()->getPoint(0).getDataAtIndex(0) > 5.0f);
+  TEST_CHECK(loaded->getPoint(0).getDataAtIndex(0) < 5.0f);
+
+  // A file that cannot be loaded any more leaves the current snapshot published
+  std::remove(filename.c_str());
+  TEST_CHECK(!handle.reloadIfModified() && handle.getGeneration() == 2 && handle.acquire());
+
+}
+
+TEST_LIST = {
+  {"publish_snapshots", test_publish_snapshots},
+  {"load_and_reload", test_load_and_reload},
+  {NULL, NULL}
+};
@@ -0,0 +1,246 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../include/QueryServer.h"
+#include "../include/ThreadPool.h"
+#include "../include/acutest.h"
+
+
+/**
+ * @brief Answers a query with k neighbors whose indexes count up from the first coordinate of the query, and fails
+ * the queries without a vector, or without neighbors with an exception that is not an std::exception.
+ */
+static std::vector<QueryResult> countingExecutor(const QueryRequest& request) {
+
+  if (request.vector.empty()) {
+    throw std::invalid_argument("Error: Empty query");
+  }
+  if (request.k == 0) {
+    throw 0;
+  }
+  std::vector<QueryResult> results;
+  for (uint32_t i = 0; i < request.k; i++) {
+    results.push_back({(uint32_t)request.vector[0] + i, (float)i});
+  }
+  return results;
+
+}
+
+/**
+ * @brief Creates a request with a one-dimensional query, or without a vector if the value is negative.
+ */
+static QueryRequest createRequest(const uint32_t id, const uint32_t k, const float value) {
+
+  QueryRequest request = {id, k, 10, 0, 0.0f, 0.0f, 0.0f, std::vector<float>()};
+  if (value >= 0) {
+    request.vector.push_back(value);
+  }
+  return request;
+
+}
+
+/**
+ * @brief Reads from a descriptor until the expected number of responses was decoded or the descriptor ends.
+ */
+static std::vector<std::pair<uint32_t, std::vector<QueryResult>>> readResponses(const int fd, const unsigned int expected, std::vector<QUERY_STATUS>& statuses) {
+
+  std::vector<std::pair<uint32_t, std::vector<QueryResult>>> responses;
+  std::string buffer;
+  char chunk[4096];
+  while (responses.size() < expected) {
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) {
+      break;
+    }
+    buffer.append(chunk, n);
+    size_t consumed;
+    uint32_t id;
+    QUERY_STATUS status;
+    std::vector<QueryResult> results;
+    while ((consumed = decodeQueryResponse(buffer.data(), buffer.size(), id, status, results)) > 0) {
+      responses.push_back({id, results});
+      statuses.push_back(status);
+      buffer.erase(0, consumed);
+    }
+  }
+  return responses;
+
+}
+
+void test_encode_decode(void) {
+
+  QueryRequest request = {7, 10, 50, 3, 2.0f, 0.25f, 0.75f, {1.0f, -2.5f, 3.0f}};
+  std::string bytes = encodeQueryRequest(request);
+  TEST_CHECK(bytes.size() == 8 * 4 + 3 * 4);
+
+  // Partial requests are not decoded until the rest arrives
+  QueryRequest decoded;
+  size_t consumed;
+  TEST_CHECK(decodeQueryRequest(bytes.data(), 20, decoded, consumed) && consumed == 0);
+  TEST_CHECK(decodeQueryRequest(bytes.data(), bytes.size() - 1, decoded, consumed) && consumed == 0);
+
+  bytes += encodeQueryRequest(createRequest(8, 1, 4.0f));
+  TEST_CHECK(decodeQueryRequest(bytes.data(), bytes.size(), decoded, consumed) && consumed == 44);
+  TEST_CHECK(decoded.id == 7 && decoded.k == 10 && decoded.L == 50 && decoded.queryType == 3);
+  TEST_CHECK(decoded.v == 2.0f && decoded.l == 0.25f && decoded.r == 0.75f);
+  TEST_CHECK(decoded.vector == request.vector);
+  TEST_CHECK(decodeQueryRequest(bytes.data() + consumed, bytes.size() - consumed, decoded, consumed) && decoded.id == 8);
+
+  // A dimension no query can have marks the stream as corrupted
+  std::string corrupted = encodeQueryRequest(request);
+  uint32_t dimension = 1u << 30;
+  std::memcpy(&corrupted[7 * 4], &dimension, 4);
+  TEST_CHECK(!decodeQueryRequest(corrupted.data(), corrupted.size(), decoded, consumed));
+
+  std::string response = encodeQueryResponse(9, QUERY_OK, {{3, 0.5f}, {1, 1.5f}});
+  uint32_t id;
+  QUERY_STATUS status;
+  std::vector<QueryResult> results;
+  TEST_CHECK(decodeQueryResponse(response.data(), response.size() - 1, id, status, results) == 0);
+  TEST_CHECK(decodeQueryResponse(response.data(), response.size(), id, status, results) == response.size());
+  TEST_CHECK(id == 9 && status == QUERY_OK && results.size() == 2);
+  TEST_CHECK(results[0].index == 3 && results[0].distance == 0.5f && results[1].index == 1 && results[1].distance == 1.5f);
+
+}
+
+void test_latency_histogram(void) {
+
+  LatencyHistogram histogram;
+  TEST_CHECK(histogram.getCount() == 0 && histogram.getPercentile(50) == 0.0);
+
+  // 1 to 1000 milliseconds, one latency each
+  for (unsigned int i = 1; i <= 1000; i++) {
+    histogram.record(i / 1000.0);
+  }
+  TEST_CHECK(histogram.getCount() == 1000);
+
+  double p50 = histogram.getPercentile(50), p99 = histogram.getPercentile(99);
+  TEST_CHECK(p50 >= 0.5 && p50 <= 0.5 * 1.03);
+  TEST_MSG("p50 = %f", p50);
+  TEST_CHECK(p99 >= 0.99 && p99 <= 0.99 * 1.03);
+  TEST_MSG("p99 = %f", p99);
+
+  // Latencies out of range are kept in the outer buckets
+  histogram.clear();
+  histogram.record(0.0);
+  histogram.record(1e6);
+  TEST_CHECK(histogram.getCount() == 2 && histogram.getPercentile(0) <= 1e-6 * 1.03 && histogram.getPercentile(100) >= 999.0);
+
+}
+
+void test_serve_pipe(void) {
+
+  ThreadPool::configure(4);
+
+  int requests[2], responses[2];
+  TEST_CHECK(pipe(requests) == 0 && pipe(responses) == 0);
+
+  // All the requests are written at once, so that the server reads them into batches of the given size
+  std::string bytes;
+  for (uint32_t i = 0; i < 50; i++) {
+    if (i == 17 || i == 33) {
+      bytes += encodeQueryRequest(i == 17 ? createRequest(i, 3, -1.0f) : createRequest(i, 0, 100.0f * i));
+      continue;
+    }
+    bytes += encodeQueryRequest(createRequest(i, 1 + i % 5, 100.0f * i));
+  }
+  TEST_CHECK(write(requests[1], bytes.data(), bytes.size()) == (ssize_t)bytes.size());
+  close(requests[1]);
+
+  QueryServer server(countingExecutor, 8, 0);
+  std::thread serving([&]() { server.serve(requests[0], responses[1]); });
+
+  std::vector<QUERY_STATUS> statuses;
+  std::vector<std::pair<uint32_t, std::vector<QueryResult>>> received = readResponses(responses[0], 50, statuses);
+  serving.join();
+
+  // The responses keep the order of the requests, and the failed queries do not affect the others
+  TEST_CHECK(received.size() == 50);
+  bool correct = received.size() == 50;
+  for (uint32_t i = 0; correct && i < 50; i++) {
+    correct = received[i].first == i;
+    if (i == 17 || i == 33) {
+      correct = correct && statuses[i] == QUERY_FAILED && received[i].second.empty();
+      continue;
+    }
+    correct = correct && statuses[i] == QUERY_OK && received[i].second.size() == 1 + i % 5;
+    correct = correct && received[i].second[0].index == 100 * i;
+  }
+  TEST_CHECK(correct);
+  TEST_CHECK(server.getLatencies().getCount() == 50);
+
+  close(requests[0]);
+  close(responses[0]);
+  close(responses[1]);
+
+}
+
+void test_serve_socket(void) {
+
+  ThreadPool::configure(4);
+
+  const std::string path = "sample_query_server.sock";
+  QueryServer server(countingExecutor, 16, 0);
+  std::atomic<bool> served(false);
+  std::thread serving([&]() { served = server.serveSocket(path); });
+
+  // Clients connect while the server starts, and each gets the answers to its own queries
+  std::atomic<int> correct(0);
+  std::vector<std::thread> clients;
+  for (unsigned int c = 0; c < 3; c++) {
+    clients.push_back(std::thread([&, c]() {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      struct sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      std::strcpy(address.sun_path, path.c_str());
+      for (unsigned int attempt = 0; attempt < 500 && connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0; attempt++) {
+        usleep(10000);
+      }
+
+      std::string bytes;
+      for (uint32_t i = 0; i < 20; i++) {
+        bytes += encodeQueryRequest(createRequest(i, 2, 1000.0f * c + i));
+      }
+      if (write(fd, bytes.data(), bytes.size()) != (ssize_t)bytes.size()) {
+        close(fd);
+        return;
+      }
+
+      std::vector<QUERY_STATUS> statuses;
+      std::vector<std::pair<uint32_t, std::vector<QueryResult>>> received = readResponses(fd, 20, statuses);
+      bool valid = received.size() == 20;
+      for (uint32_t i = 0; valid && i < 20; i++) {
+        valid = received[i].first == i && statuses[i] == QUERY_OK && received[i].second.size() == 2;
+        valid = valid && received[i].second[0].index == 1000 * c + i;
+      }
+      correct += valid;
+      close(fd);
+    }));
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+
+  server.stop();
+  serving.join();
+  TEST_CHECK(served);
+  TEST_CHECK(correct == 3);
+  TEST_CHECK(server.getLatencies().getCount() == 60);
+  TEST_CHECK(access(path.c_str(), F_OK) != 0);
+
+}
+
+TEST_LIST = {
+  {"encode_decode", test_encode_decode},
+  {"latency_histogram", test_latency_histogram},
+  {"serve_pipe", test_serve_pipe},
+  {"serve_socket", test_serve_socket},
+  {NULL, NULL}
+};
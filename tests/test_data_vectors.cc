@@ -5,6 +5,8 @@
 #include "../include/read_data.h"
 #include "../include/DataVector.h"
 #include <cmath>  // Ensure cmath is included for fabs
+#include <cstdio>
+#include <iterator>
 
 /**
  * @brief Function to create a sample binary file for testing.
@@ -44,6 +46,112 @@ void testReadVectorFile() {
     TEST_CHECK(fabs(dataVectors[0].getDataAtIndex(2) - 3.0f) < 1e-6);
 }
 
+/**
+ * @brief Function to create a sample SIGMOD base vectors file for testing. It contains two vectors of
+ * dimension 4, each one preceded by its C and T attributes.
+ *
+ * @param filename The name of the binary file to create.
+ */
+void createSampleFilteredBaseFile(const std::string& filename) {
+    std::ofstream file(filename, std::ios::binary);
+    unsigned int count = 2;
+    file.write(reinterpret_cast<char*>(&count), sizeof(count));
+    float records[2][6] = {
+        {3.0f, 0.25f, 1.0f, 2.0f, 3.0f, 4.0f},
+        {7.0f, 0.75f, 5.0f, 6.0f, 7.0f, 8.0f}
+    };
+    file.write(reinterpret_cast<char*>(records), sizeof(records));
+    file.close();
+}
+
+/**
+ * @brief Test case for the contiguous vector store readers. It checks that the `.fvecs` reader places the
+ * values in the store, and that the dimension of a SIGMOD base file is derived from its size instead of
+ * being assumed.
+ */
+void testReadVectorStore() {
+    const std::string fvecsFilename = "sample_vectors.bin";
+    createSampleBinaryFile(fvecsFilename);
+
+    VectorStore store;
+    TEST_CHECK(ReadVectorStore(fvecsFilename, store));
+    TEST_CHECK(store.count == 1);
+    TEST_CHECK(store.dimension == 3);
+    TEST_CHECK(fabs(store.getVector(0)[2] - 3.0f) < 1e-6);
+
+    // Files shorter than the header of a vector, or with a partial vector at the end, are rejected
+    const std::string truncatedFilename = "sample_truncated_vectors.bin";
+    for (size_t size : { (size_t)0, (size_t)2, (size_t)10, (size_t)20 }) {
+        std::ifstream in(fvecsFilename, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        bytes.resize(size, '\0');
+        std::ofstream out(truncatedFilename, std::ios::binary);
+        out.write(bytes.data(), bytes.size());
+        out.close();
+        VectorStore truncated;
+        TEST_CHECK(!ReadVectorStore(truncatedFilename, truncated));
+        TEST_CHECK(truncated.count == 0);
+    }
+    std::remove(truncatedFilename.c_str());
+
+    const std::string baseFilename = "sample_base_vectors.bin";
+    createSampleFilteredBaseFile(baseFilename);
+
+    VectorStore baseStore;
+    TEST_CHECK(ReadFilteredBaseVectorStore(baseFilename, baseStore));
+    TEST_CHECK(baseStore.count == 2);
+    TEST_CHECK(baseStore.dimension == 4);
+    TEST_CHECK(baseStore.C[1] == 7);
+    TEST_CHECK(fabs(baseStore.T[0] - 0.25f) < 1e-6);
+    TEST_CHECK(fabs(baseStore.getVector(1)[0] - 5.0f) < 1e-6);
+
+    std::vector<BaseDataVector<float>> baseVectors = ReadFilteredBaseVectorFile(baseFilename);
+    TEST_CHECK(baseVectors.size() == 2);
+    TEST_CHECK(baseVectors[1].getDimension() == 4);
+    TEST_CHECK(baseVectors[1].getIndex() == 1);
+    TEST_CHECK(baseVectors[1].getC() == 7);
+    TEST_CHECK(fabs(baseVectors[1].getDataAtIndex(3) - 8.0f) < 1e-6);
+
+    std::remove(baseFilename.c_str());
+}
+
+/**
+ * @brief Tests that the ChunkedVectorReader yields the vectors of a file chunk by chunk, with the offset of every
+ * chunk inside the file, and that it can be rewound to the start of the file.
+ */
+void testChunkedVectorReader() {
+    const std::string baseFilename = "sample_chunked_base_vectors.bin";
+    createSampleFilteredBaseFile(baseFilename);
+
+    ChunkedVectorReader reader;
+    TEST_CHECK(reader.open(baseFilename, SIGMOD_BASE, 1));
+    TEST_CHECK(reader.getCount() == 2);
+    TEST_CHECK(reader.getDimension() == 4);
+    TEST_CHECK(reader.getChunksCount() == 2);
+
+    VectorStore chunk;
+    TEST_CHECK(reader.next(chunk));
+    TEST_CHECK(chunk.count == 1);
+    TEST_CHECK(chunk.offset == 0);
+    TEST_CHECK(fabs(chunk.T[0] - 0.25f) < 1e-6);
+
+    TEST_CHECK(reader.next(chunk));
+    TEST_CHECK(chunk.count == 1);
+    TEST_CHECK(chunk.offset == 1);
+    TEST_CHECK(chunk.C[0] == 7);
+    TEST_CHECK(fabs(chunk.getVector(0)[3] - 8.0f) < 1e-6);
+
+    TEST_CHECK(!reader.next(chunk));
+
+    reader.rewind();
+    TEST_CHECK(reader.next(chunk));
+    TEST_CHECK(chunk.offset == 0);
+
+    TEST_CHECK(!reader.open("non_existent_file.bin", SIGMOD_BASE, 1));
+
+    std::remove(baseFilename.c_str());
+}
+
 /**
  * @brief Tests the comparison operators for DataVector objects.
  *
@@ -110,6 +218,8 @@ void test_data_vectors_equality(void) {
 // Register the test cases in the TEST_LIST defined by Acutest
 TEST_LIST = {
     {"Test Read Vector File", testReadVectorFile},
+    {"Test Read Vector Store", testReadVectorStore},
+    {"Test Chunked Vector Reader", testChunkedVectorReader},
     {"test Data Vector comparison", test_data_vectors_comparison},
     {"test Data Vector equality", test_data_vectors_equality},
     {nullptr, nullptr} // Termination
@@ -66,8 +66,38 @@ void testEuclideanDistanceDifferentDimensions() {
     TEST_CHECK(exceptionThrown);
 }
 
+/**
+ * @brief Test case for the SIMD squared Euclidean Distance and its batched version. Uses dimensions
+ * that are not multiples of the SIMD width, so that the scalar tail of the kernel is covered too.
+*/
+void testSquaredEuclideanDistance() {
+    for (unsigned int dimension : {1u, 7u, 100u, 131u}) {
+        std::vector<float> query(dimension);
+        std::vector<float> vectors(3 * dimension);
+        for (unsigned int i = 0; i < dimension; ++i) {
+            query[i] = 0.5f * i;
+            for (unsigned int j = 0; j < 3; ++j) {
+                vectors[j * dimension + i] = static_cast<float>(i + j) - 1.0f;
+            }
+        }
+
+        float distances[3];
+        squaredEuclideanDistances(query.data(), vectors.data(), 3, dimension, distances);
+
+        for (unsigned int j = 0; j < 3; ++j) {
+            double expectedDistance = euclideanDistance(query.data(), vectors.data() + j * dimension, dimension);
+            expectedDistance *= expectedDistance;
+
+            float calculatedDistance = squaredEuclideanDistance(query.data(), vectors.data() + j * dimension, dimension);
+            TEST_CHECK(fabs(expectedDistance - calculatedDistance) <= 1e-5 * (1.0 + expectedDistance));
+            TEST_CHECK(calculatedDistance == distances[j]);
+        }
+    }
+}
+
 TEST_LIST = {
     {"Euclidean Distance 128 dimenstions", testEuclideanDistance},
     {"Test Euclidean Distance (Different Dimensions)", testEuclideanDistanceDifferentDimensions},
+    {"Squared Euclidean Distance (SIMD and batched)", testSquaredEuclideanDistance},
     {nullptr, nullptr} // Termination
 };
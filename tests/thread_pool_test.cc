@@ -0,0 +1,119 @@
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include "../include/ThreadPool.h"
+#include "../include/acutest.h"
+
+
+void test_parallel_for_covers_range(void) {
+
+  ThreadPool::configure(4);
+  ThreadPool& pool = ThreadPool::getInstance();
+  TEST_CHECK(pool.getThreadsCount() == 4);
+
+  // Every index is visited exactly once, whatever the chunk size
+  for (unsigned int chunk : {0u, 1u, 7u, 1000u}) {
+    std::vector<std::atomic<int>> visits(1000);
+    for (auto& visit : visits) {
+      visit = 0;
+    }
+
+    pool.parallelFor(10, 1000, [&](unsigned int i) { visits[i]++; }, 0, chunk);
+
+    bool exact = true;
+    for (unsigned int i = 0; i < visits.size(); i++) {
+      exact = exact && visits[i] == (i < 10 ? 0 : 1);
+    }
+    TEST_CHECK(exact);
+    TEST_MSG("chunk %u", chunk);
+  }
+
+  // Empty ranges do not run the function at all
+  std::atomic<int> calls(0);
+  pool.parallelFor(5, 5, [&](unsigned int) { calls++; });
+  TEST_CHECK(calls == 0);
+
+}
+
+void test_parallel_for_single_thread(void) {
+
+  ThreadPool::configure(4);
+  ThreadPool& pool = ThreadPool::getInstance();
+
+  // A loop limited to one thread runs on the calling thread, in order
+  std::vector<unsigned int> order;
+  std::thread::id caller = std::this_thread::get_id();
+  bool sameThread = true;
+  pool.parallelFor(0, 100, [&](unsigned int i) {
+    order.push_back(i);
+    sameThread = sameThread && std::this_thread::get_id() == caller;
+  }, 1);
+
+  TEST_CHECK(sameThread);
+  TEST_CHECK(order.size() == 100);
+  bool sorted = true;
+  for (unsigned int i = 0; i < order.size(); i++) {
+    sorted = sorted && order[i] == i;
+  }
+  TEST_CHECK(sorted);
+
+}
+
+void test_parallel_for_nested(void) {
+
+  ThreadPool::configure(3);
+  ThreadPool& pool = ThreadPool::getInstance();
+
+  // Loops started from inside other loops run on the same threads and complete every index
+  std::vector<std::atomic<int>> visits(50 * 40);
+  for (auto& visit : visits) {
+    visit = 0;
+  }
+
+  pool.parallelFor(0, 50, [&](unsigned int i) {
+    pool.parallelFor(0, 40, [&](unsigned int j) {
+      visits[i * 40 + j]++;
+    }, 0, 3);
+  }, 0, 1);
+
+  bool exact = true;
+  for (auto& visit : visits) {
+    exact = exact && visit == 1;
+  }
+  TEST_CHECK(exact);
+
+}
+
+void test_parallel_for_exception(void) {
+
+  ThreadPool::configure(4);
+  ThreadPool& pool = ThreadPool::getInstance();
+
+  // The exception of a chunk reaches the caller, and the pool keeps working afterwards
+  bool caught = false;
+  try {
+    pool.parallelFor(0, 1000, [&](unsigned int i) {
+      if (i == 500) {
+        throw std::runtime_error("failed");
+      }
+    }, 0, 10);
+  } catch (const std::runtime_error&) {
+    caught = true;
+  }
+  TEST_CHECK(caught);
+
+  std::atomic<int> sum(0);
+  pool.parallelFor(0, 100, [&](unsigned int i) { sum += i; });
+  TEST_CHECK(sum == 4950);
+
+}
+
+TEST_LIST = {
+  {"parallel_for_covers_range", test_parallel_for_covers_range},
+  {"parallel_for_single_thread", test_parallel_for_single_thread},
+  {"parallel_for_nested", test_parallel_for_nested},
+  {"parallel_for_exception", test_parallel_for_exception},
+  {NULL, NULL}
+};
@@ -0,0 +1,707 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include "../include/VamanaIndex.h"
+#include "../include/GreedySearch.h"
+#include "../include/ThreadPool.h"
+#include "../include/acutest.h"
+
+
+/**
+ * @brief Creates random points of the unit square, with a fixed seed.
+ */
+static std::vector<DataVector<float>> createRandomPoints(const unsigned int n, const unsigned int seed) {
+
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+  std::vector<DataVector<float>> points;
+  for (unsigned int i = 0; i < n; i++) {
+    DataVector<float> point(2, i);
+    point.setDataAtIndex(distribution(generator), 0);
+    point.setDataAtIndex(distribution(generator), 1);
+    points.push_back(point);
+  }
+  return points;
+
+}
+
+/**
+ * @brief Writes the points as an fvecs file, so that a graph-only index can refer to it.
+ */
+static void writeBaseFile(const std::string& filename, const std::vector<DataVector<float>>& points) {
+
+  std::ofstream file(filename, std::ios::binary);
+  for (const auto& point : points) {
+    int dimension = 2;
+    float values[2] = {point.getDataAtIndex(0), point.getDataAtIndex(1)};
+    file.write(reinterpret_cast<char*>(&dimension), sizeof(dimension));
+    file.write(reinterpret_cast<char*>(values), sizeof(values));
+  }
+
+}
+
+/**
+ * @brief Counts the points of the index that a GreedySearch from the medoid finds as their own nearest point.
+ */
+static unsigned int countSelfHits(const VamanaIndex<DataVector<float>>& index, const unsigned int L) {
+
+  GraphNode<DataVector<float>> s = *index.getGraph().getNode(index.getMedoid());
+  unsigned int hits = 0;
+  for (unsigned int i = 0; i < index.getGraph().getNodesCount(); i++) {
+    std::set<DataVector<float>> nearest = GreedySearch(index, s, index.getPoint(i), 1, L, NONE).first;
+    hits += !nearest.empty() && nearest.begin()->getIndex() == i;
+  }
+  return hits;
+
+}
+
+/**
+ * @brief Returns whether the result of a search holds the point with the given index.
+ */
+static bool containsPoint(const std::set<DataVector<float>>& result, const unsigned int i) {
+
+  for (const auto& p : result) {
+    if (p.getIndex() == i) {
+      return true;
+    }
+  }
+  return false;
+
+}
+
+void test_insert_concurrent(void) {
+
+  ThreadPool::configure(4);
+
+  VamanaIndex<DataVector<float>> index;
+  index.createGraph(createRandomPoints(100, 1), 1.2, 30, 8, NONE, 1, false);
+
+  // Insert three times as many points from the threads of the pool, one insertion per task
+  std::vector<DataVector<float>> points = createRandomPoints(300, 2);
+  std::vector<unsigned int> indexes(points.size());
+  std::atomic<int> inserted(0);
+  ThreadPool::getInstance().parallelFor(0, points.size(), [&](unsigned int i) {
+    inserted += index.insert(points[i], indexes[i]);
+  }, 0, 1);
+
+  TEST_CHECK(inserted == 300);
+  TEST_CHECK(index.getGraph().getNodesCount() == 400);
+
+  // Every insertion got its own index, and the point and the node at that index hold the inserted point
+  std::vector<bool> seen(400, false);
+  for (unsigned int i = 0; i < points.size(); i++) {
+    TEST_CHECK(indexes[i] >= 100 && indexes[i] < 400 && !seen[indexes[i]]);
+    seen[indexes[i]] = true;
+    TEST_CHECK(index.getPoint(indexes[i]).getDataAtIndex(0) == points[i].getDataAtIndex(0));
+    TEST_CHECK(index.getGraph().getNode(indexes[i])->getData().getIndex() == indexes[i]);
+  }
+
+  // The degree bound holds and every inserted point is reachable from some other point
+  std::vector<unsigned int> inDegree(400, 0);
+  for (unsigned int i = 0; i < 400; i++) {
+    std::vector<DataVector<float>>* neighbors = index.getGraph().getNode(i)->getNeighborsVector();
+    TEST_CHECK(neighbors->size() <= 8);
+    for (auto neighbor : *neighbors) {
+      TEST_CHECK(neighbor.getIndex() != i);
+      inDegree[neighbor.getIndex()]++;
+    }
+  }
+  unsigned int unreachable = 0;
+  for (unsigned int i = 100; i < 400; i++) {
+    unreachable += inDegree[i] == 0;
+  }
+  TEST_CHECK(unreachable == 0);
+
+  unsigned int hits = countSelfHits(index, 30);
+  TEST_CHECK(hits >= 390);
+  TEST_MSG("%u of 400 points found", hits);
+
+}
+
+void test_insert_empty(void) {
+
+  // An index without build parameters cannot insert points
+  VamanaIndex<DataVector<float>> index;
+  std::vector<DataVector<float>> points = createRandomPoints(200, 3);
+  unsigned int i0;
+  TEST_CHECK(!index.insert(points[0], i0));
+
+  // Once the parameters are set, the index grows from nothing, and its first point is the medoid
+  index.setParameters(1.2, 20, 6);
+  for (unsigned int i = 0; i < points.size(); i++) {
+    unsigned int inserted;
+    TEST_CHECK(index.insert(points[i], inserted) && inserted == i);
+  }
+  TEST_CHECK(index.getMedoid() == 0 && index.getEntryPoints().size() == 1);
+  TEST_CHECK(index.getGraph().getNodesCount() == 200);
+
+  unsigned int hits = countSelfHits(index, 20);
+  TEST_CHECK(hits >= 195);
+  TEST_MSG("%u of 200 points found", hits);
+
+}
+
+void test_remove_consolidate(void) {
+
+  ThreadPool::configure(4);
+
+  VamanaIndex<DataVector<float>> index;
+  std::vector<DataVector<float>> points = createRandomPoints(300, 4);
+  index.createGraph(points, 1.2, 30, 8, NONE, 1, false);
+
+  // Remove every third point and the medoid, which searches still start from
+  unsigned int medoid = index.getMedoid();
+  std::vector<bool> removed(300, false);
+  for (unsigned int i = 0; i < 300; i += 3) {
+    TEST_CHECK(index.remove(i));
+    removed[i] = true;
+  }
+  if (!removed[medoid]) {
+    TEST_CHECK(index.remove(medoid));
+    removed[medoid] = true;
+  }
+  TEST_CHECK(!index.remove(0) && !index.remove(300));
+  unsigned int removedCount = index.getDeletedCount();
+
+  // Removed points are traversed but never returned
+  GraphNode<DataVector<float>> s = *index.getGraph().getNode(medoid);
+  bool excluded = true;
+  for (unsigned int i = 0; i < 300; i += 7) {
+    for (auto p : GreedySearch(index, s, points[i], 5, 30, NONE).first) {
+      excluded = excluded && !removed[p.getIndex()];
+    }
+  }
+  TEST_CHECK(excluded);
+
+  // Consolidation drops the removed points and renumbers the rest in their order
+  std::vector<unsigned int> newIndexes = index.consolidate(4);
+  TEST_CHECK(index.getDeletedCount() == 0);
+  TEST_CHECK(index.getGraph().getNodesCount() == 300 - removedCount && index.getPoints().size() == 300 - removedCount);
+  TEST_CHECK(index.getMedoid() < index.getGraph().getNodesCount());
+
+  bool renumbered = true;
+  for (unsigned int i = 0, next = 0; i < 300; i++) {
+    if (removed[i]) {
+      renumbered = renumbered && newIndexes[i] == VamanaIndex<DataVector<float>>::NO_POINT;
+    } else {
+      renumbered = renumbered && newIndexes[i] == next && index.getPoint(next).getDataAtIndex(0) == points[i].getDataAtIndex(0);
+      next++;
+    }
+  }
+  TEST_CHECK(renumbered);
+
+  // The repaired graph only links remaining points and keeps the degree bound
+  bool valid = true;
+  for (unsigned int i = 0; i < index.getGraph().getNodesCount(); i++) {
+    std::vector<DataVector<float>>* neighbors = index.getGraph().getNode(i)->getNeighborsVector();
+    valid = valid && !neighbors->empty() && neighbors->size() <= 8 && index.getGraph().getNode(i)->getData().getIndex() == i;
+    for (auto neighbor : *neighbors) {
+      valid = valid && neighbor.getIndex() < index.getGraph().getNodesCount() && neighbor.getIndex() != i;
+    }
+  }
+  TEST_CHECK(valid);
+
+  unsigned int hits = countSelfHits(index, 30);
+  TEST_CHECK(hits >= index.getGraph().getNodesCount() - 5);
+  TEST_MSG("%u of %u points found", hits, index.getGraph().getNodesCount());
+
+  // Points can still be inserted after consolidating
+  unsigned int inserted;
+  TEST_CHECK(index.insert(points[0], inserted) && inserted == 300 - removedCount);
+
+}
+
+void test_search_during_inserts(void) {
+
+  ThreadPool::configure(4);
+
+  VamanaIndex<DataVector<float>> index;
+  std::vector<DataVector<float>> base = createRandomPoints(200, 5);
+  index.createGraph(base, 1.2, 30, 8, NONE, 1, false);
+
+  // Insertions, searches for the first half of the initial points and removals of the second half, interleaved on
+  // the threads of the pool
+  std::vector<DataVector<float>> points = createRandomPoints(400, 6);
+  std::atomic<int> inserted(0), removed(0), searches(0), found(0), invalid(0);
+  ThreadPool::getInstance().parallelFor(0, 800, [&](unsigned int t) {
+    if (t % 2 == 0) {
+      unsigned int i;
+      inserted += index.insert(points[t / 2], i);
+      return;
+    }
+    if (t % 4 == 3) {
+      removed += index.remove(100 + (t / 4) % 100);
+      return;
+    }
+
+    unsigned int target = (t / 4) % 100;
+    GraphNode<DataVector<float>> s(index.getGraph().getNode(index.getMedoid())->getData());
+    std::set<DataVector<float>> nearest = GreedySearch(index, s, base[target], 5, 30, NONE).first;
+    searches++;
+    for (auto p : nearest) {
+      found += p.getIndex() == target;
+      invalid += p.getIndex() >= index.getGraph().getNodesCount() || index.getPoint(p.getIndex()).getDataAtIndex(0) != p.getDataAtIndex(0);
+    }
+  }, 0, 1);
+
+  TEST_CHECK(inserted == 400 && removed == 100);
+  TEST_CHECK(index.getGraph().getNodesCount() == 600 && index.getDeletedCount() == 100);
+  TEST_CHECK(invalid == 0);
+  TEST_CHECK(found >= searches - 5);
+  TEST_MSG("%d of %d searches found their point", (int)found, (int)searches);
+
+  // The lists that were replaced concurrently keep the degree bound and link every inserted point
+  std::vector<unsigned int> inDegree(600, 0);
+  bool bounded = true;
+  for (unsigned int i = 0; i < 600; i++) {
+    std::vector<DataVector<float>>* neighbors = index.getGraph().getNode(i)->getNeighborsVector();
+    bounded = bounded && neighbors->size() <= 8;
+    for (auto neighbor : *neighbors) {
+      bounded = bounded && neighbor.getIndex() != i && neighbor.getIndex() < 600;
+      inDegree[neighbor.getIndex()]++;
+    }
+  }
+  TEST_CHECK(bounded);
+  unsigned int unreachable = 0;
+  for (unsigned int i = 200; i < 600; i++) {
+    unreachable += inDegree[i] == 0;
+  }
+  TEST_CHECK(unreachable == 0);
+
+  index.consolidate(4);
+  unsigned int hits = countSelfHits(index, 30);
+  TEST_CHECK(hits >= 490);
+  TEST_MSG("%u of 500 points found", hits);
+
+}
+
+void test_search_during_consolidate(void) {
+
+  ThreadPool::configure(4);
+
+  VamanaIndex<DataVector<float>> index;
+  std::vector<DataVector<float>> points = createRandomPoints(600, 11);
+  index.createGraph(points, 1.2, 30, 8, NONE, 1, false);
+
+  // Searches keep running while points are removed and consolidated in rounds. Every search picks its start node
+  // and reads its results under one hold of the update lock, so it never sees a half renumbered index
+  std::atomic<bool> done(false);
+  std::atomic<int> searches(0), invalid(0);
+  std::vector<std::thread> searchers;
+  for (unsigned int t = 0; t < 3; t++) {
+    searchers.emplace_back([&, t]() {
+      for (unsigned int i = t; !done || i < t + 30; i += 3) {
+        ReentrantLockGuard hold(index.getUpdateLock());
+        GraphNode<DataVector<float>> s(index.getGraph().getNode(index.findSearchStart(points[i % 600]))->getData());
+        std::set<DataVector<float>> nearest = GreedySearch(index, s, points[i % 600], 5, 30, NONE).first;
+        searches++;
+        for (auto p : nearest) {
+          invalid += p.getIndex() >= index.getGraph().getNodesCount() || index.getPoint(p.getIndex()).getDataAtIndex(0) != p.getDataAtIndex(0);
+        }
+      }
+    });
+  }
+
+  unsigned int remaining = 600;
+  for (unsigned int round = 0; round < 4; round++) {
+    for (unsigned int i = round; i < remaining; i += 5) {
+      index.remove(i);
+    }
+    remaining -= index.getDeletedCount();
+    index.consolidate(2);
+  }
+  done = true;
+  for (auto& searcher : searchers) {
+    searcher.join();
+  }
+
+  TEST_CHECK(index.getGraph().getNodesCount() == remaining && index.getDeletedCount() == 0);
+  TEST_CHECK(searches >= 90 && invalid == 0);
+  TEST_MSG("%d of %d searches returned invalid points", (int)invalid, (int)searches);
+
+}
+
+void test_search_budget(void) {
+
+  VamanaIndex<DataVector<float>> index;
+  index.createGraph(createRandomPoints(500, 7), 1.2, 30, 8, NONE, 1, false);
+  GraphNode<DataVector<float>> s = *index.getGraph().getNode(index.getMedoid());
+  DataVector<float> xq = createRandomPoints(1, 8)[0];
+
+  // Without limits the budget only records the work of the search, which returns what it returns without one
+  SearchBudget unbounded;
+  auto full = GreedySearch(index, s, xq, 5, 30, NONE, &unbounded);
+  TEST_CHECK(full.first == GreedySearch(index, s, xq, 5, 30, NONE).first);
+  TEST_CHECK(!unbounded.truncated && unbounded.hops == full.second.size());
+  TEST_CHECK(unbounded.distanceComputations > unbounded.hops);
+
+  // Every distance is computed once, when its point becomes a candidate, so the count is bounded by the points
+  // that the expansions reached
+  TEST_CHECK(unbounded.distanceComputations <= 1 + 8 * unbounded.hops && unbounded.distanceComputations <= 500);
+
+  // A hop limit stops the search after that many expansions with the best points found so far
+  SearchBudget hops;
+  hops.maxHops = 3;
+  auto truncated = GreedySearch(index, s, xq, 5, 30, NONE, &hops);
+  TEST_CHECK(hops.truncated && hops.hops == 3 && truncated.second.size() == 3);
+  TEST_CHECK(truncated.first.size() == 5);
+
+  // A distance limit may be overshot by the neighbors of the last expanded node
+  SearchBudget distances;
+  distances.maxDistanceComputations = 40;
+  GreedySearch(index, s, xq, 5, 30, NONE, &distances);
+  TEST_CHECK(distances.truncated && distances.distanceComputations >= 40 && distances.distanceComputations < 40 + 8);
+  TEST_CHECK(distances.hops < unbounded.hops);
+
+  // A deadline that passed already returns the start node
+  SearchBudget expired;
+  expired.setTimeout(0.0);
+  auto started = GreedySearch(index, s, xq, 5, 30, NONE, &expired);
+  TEST_CHECK(expired.truncated && expired.hops == 0 && started.first.size() == 1);
+
+  // A budget shared by two searches bounds them together
+  SearchBudget shared;
+  shared.maxHops = unbounded.hops + 2;
+  GreedySearch(index, s, xq, 5, 30, NONE, &shared);
+  TEST_CHECK(!shared.truncated);
+  GreedySearch(index, s, xq, 5, 30, NONE, &shared);
+  TEST_CHECK(shared.truncated && shared.hops == unbounded.hops + 2);
+
+}
+
+void test_search_convergence(void) {
+
+  VamanaIndex<DataVector<float>> index;
+  std::vector<DataVector<float>> points = createRandomPoints(1000, 9);
+  index.createGraph(points, 1.2, 60, 12, NONE, 1, false);
+  GraphNode<DataVector<float>> s = *index.getGraph().getNode(index.getMedoid());
+
+  // Queries that coincide with points of the index converge long before a large L is exhausted, and still find
+  // their point
+  unsigned int fixedHops = 0, patienceHops = 0, epsilonHops = 0, found = 0, converged = 0;
+  for (unsigned int i = 0; i < 1000; i += 20) {
+    SearchBudget fixed;
+    GreedySearch(index, s, points[i], 5, 100, NONE, &fixed);
+    TEST_CHECK(!fixed.converged && !fixed.truncated);
+    fixedHops += fixed.hops;
+
+    SearchBudget patience;
+    patience.patience = 8;
+    std::set<DataVector<float>> nearest = GreedySearch(index, s, points[i], 5, 100, NONE, &patience).first;
+    patienceHops += patience.hops;
+    converged += patience.converged;
+    found += containsPoint(nearest, i);
+
+    SearchBudget epsilon;
+    epsilon.epsilon = 0.5f;
+    nearest = GreedySearch(index, s, points[i], 5, 100, NONE, &epsilon).first;
+    epsilonHops += epsilon.hops;
+    found += containsPoint(nearest, i);
+  }
+
+  TEST_CHECK(converged == 50);
+  TEST_CHECK(patienceHops < fixedHops / 2 && epsilonHops < fixedHops / 2);
+  TEST_MSG("%u hops with a fixed L, %u with patience, %u with epsilon", fixedHops, patienceHops, epsilonHops);
+  TEST_CHECK(found >= 98);
+  TEST_MSG("%u of 100 searches found their point", found);
+
+  // With epsilon 0 the search stops as soon as no candidate can enter the k nearest, so it never expands more
+  // nodes than without early termination
+  SearchBudget strict, unbounded;
+  strict.epsilon = 0.0f;
+  GreedySearch(index, s, points[1], 5, 100, NONE, &strict);
+  GreedySearch(index, s, points[1], 5, 100, NONE, &unbounded);
+  TEST_CHECK(strict.converged && strict.hops <= unbounded.hops);
+
+  // The expansions before k points are found do not count as stalls, so a search for more points than the start
+  // node has neighbors still returns k points with a small patience
+  for (unsigned int patienceLimit = 1; patienceLimit <= 2; patienceLimit++) {
+    SearchBudget patience;
+    patience.patience = patienceLimit;
+    std::set<DataVector<float>> nearest = GreedySearch(index, s, points[1], 30, 100, NONE, &patience).first;
+    TEST_CHECK(patience.converged && nearest.size() == 30);
+    TEST_MSG("patience %u returned %zu points", patienceLimit, nearest.size());
+  }
+
+}
+
+void test_navigation_layer(void) {
+
+  ThreadPool::configure(4);
+
+  const std::string baseFilename = "sample_navigation_base.bin";
+  const std::string fullFilename = "sample_navigation_full.bin";
+  const std::string graphFilename = "sample_navigation_graph.bin";
+  std::vector<DataVector<float>> points = createRandomPoints(4000, 10);
+  writeBaseFile(baseFilename, points);
+
+  VamanaIndex<DataVector<float>> index;
+  index.createGraph(points, 1.2, 40, 8, NONE, 1, false);
+  TEST_CHECK(index.getNavigationLayer().nodes.empty() && index.findSearchStart(points[0]) == index.getMedoid());
+
+  // The size of the layer follows the sampling rate up to its maximum size
+  TEST_CHECK(index.buildNavigationLayer(0.05f, 100, 4) == 100);
+  TEST_CHECK(index.buildNavigationLayer(0.0f, 100) == 0 && index.getNavigationLayer().nodes.empty());
+  TEST_CHECK(index.buildNavigationLayer(0.05f, 1000, 4) == 200);
+  const NavigationLayer& layer = index.getNavigationLayer();
+  TEST_CHECK(layer.offsets.size() == 201 && layer.offsets.back() == layer.neighbors.size() && layer.entry < 200);
+
+  // Searches that start from the layer reach the neighborhood of the query in fewer hops, and converge sooner
+  GraphNode<DataVector<float>> medoid = *index.getGraph().getNode(index.getMedoid());
+  unsigned int medoidHops = 0, layerHops = 0, found = 0;
+  for (unsigned int i = 0; i < 4000; i += 40) {
+    SearchBudget fromMedoid, fromLayer;
+    fromMedoid.patience = fromLayer.patience = 4;
+    GreedySearch(index, medoid, points[i], 5, 40, NONE, &fromMedoid);
+    GraphNode<DataVector<float>> s = *index.getGraph().getNode(index.findSearchStart(points[i]));
+    found += containsPoint(GreedySearch(index, s, points[i], 5, 40, NONE, &fromLayer).first, i);
+    medoidHops += fromMedoid.hops;
+    layerHops += fromLayer.hops;
+  }
+  TEST_CHECK(layerHops < medoidHops);
+  TEST_MSG("%u hops from the medoid, %u from the navigation layer", medoidHops, layerHops);
+  TEST_CHECK(found >= 98);
+  TEST_MSG("%u of 100 searches found their point", found);
+
+  // Both kinds of index files store the layer
+  TEST_CHECK(index.saveGraph(fullFilename) && index.saveGraphStructure(graphFilename, baseFilename));
+  for (const std::string& filename : {fullFilename, graphFilename}) {
+    VamanaIndex<DataVector<float>> loaded;
+    TEST_CHECK(loaded.loadGraph(filename));
+    const NavigationLayer& loadedLayer = loaded.getNavigationLayer();
+    TEST_CHECK(loadedLayer.nodes == layer.nodes && loadedLayer.offsets == layer.offsets && loadedLayer.neighbors == layer.neighbors);
+    TEST_CHECK(loadedLayer.entry == layer.entry && loadedLayer.maxSize == 1000 && loadedLayer.samplingRate == 0.05f);
+    TEST_CHECK(loaded.findSearchStart(points[123]) == index.findSearchStart(points[123]));
+  }
+
+  // Consolidating renumbers the layer, and samples it again once it loses one of its points
+  std::vector<unsigned int> sampled = layer.nodes;
+  for (unsigned int i = 0; i < 4000; i++) {
+    if (std::find(sampled.begin(), sampled.end(), i) == sampled.end()) {
+      TEST_CHECK(index.remove(i));
+      break;
+    }
+  }
+  std::vector<unsigned int> newIndexes = index.consolidate(4);
+  bool renumbered = layer.nodes.size() == 200;
+  for (unsigned int j = 0; renumbered && j < 200; j++) {
+    renumbered = layer.nodes[j] == newIndexes[sampled[j]];
+  }
+  TEST_CHECK(renumbered);
+
+  TEST_CHECK(index.remove(layer.nodes[0]));
+  index.consolidate(4);
+  bool valid = layer.nodes.size() == 200;
+  for (unsigned int node : layer.nodes) {
+    valid = valid && node < index.getGraph().getNodesCount();
+  }
+  TEST_CHECK(valid);
+
+  std::remove(baseFilename.c_str());
+  std::remove(fullFilename.c_str());
+  std::remove(graphFilename.c_str());
+
+}
+
+void test_start_node_cache(void) {
+
+  ThreadPool::configure(4);
+
+  const std::string baseFilename = "sample_start_cache_base.bin";
+  const std::string fullFilename = "sample_start_cache_full.bin";
+  const std::string graphFilename = "sample_start_cache_graph.bin";
+  std::vector<DataVector<float>> points = createRandomPoints(4000, 10);
+  writeBaseFile(baseFilename, points);
+
+  VamanaIndex<DataVector<float>> index;
+  index.createGraph(points, 1.2, 40, 8, NONE, 1, false);
+  TEST_CHECK(index.getStartNodeCache().nodes.empty() && index.findSearchStart(points[0]) == index.getMedoid());
+
+  // The seeding starts from the medoid and picks distinct points, with their vectors in contiguous rows
+  TEST_CHECK(index.buildStartNodeCache(64, 4) == 64);
+  const StartNodeCache& cache = index.getStartNodeCache();
+  std::vector<unsigned int> distinct = cache.nodes;
+  std::sort(distinct.begin(), distinct.end());
+  TEST_CHECK(cache.nodes[0] == index.getMedoid() && std::unique(distinct.begin(), distinct.end()) == distinct.end());
+  TEST_CHECK(cache.vectors.size() == 64 * 2 && cache.vectors[2 * 5 + 1] == points[cache.nodes[5]].getDataAtIndex(1));
+
+  // The start node of a query is the cached node nearest to it, which shortens the searches
+  GraphNode<DataVector<float>> medoid = *index.getGraph().getNode(index.getMedoid());
+  unsigned int medoidHops = 0, cacheHops = 0, found = 0;
+  bool nearest = true;
+  for (unsigned int i = 0; i < 4000; i += 40) {
+    unsigned int start = index.findSearchStart(points[i]);
+    for (unsigned int node : cache.nodes) {
+      nearest = nearest && euclideanDistance(points[start], points[i]) <= euclideanDistance(points[node], points[i]);
+    }
+    SearchBudget fromMedoid, fromCache;
+    fromMedoid.patience = fromCache.patience = 4;
+    GreedySearch(index, medoid, points[i], 5, 40, NONE, &fromMedoid);
+    GraphNode<DataVector<float>> s = *index.getGraph().getNode(start);
+    found += containsPoint(GreedySearch(index, s, points[i], 5, 40, NONE, &fromCache).first, i);
+    medoidHops += fromMedoid.hops;
+    cacheHops += fromCache.hops;
+  }
+  TEST_CHECK(nearest);
+  TEST_CHECK(cacheHops < medoidHops);
+  TEST_MSG("%u hops from the medoid, %u from the start node cache", medoidHops, cacheHops);
+  TEST_CHECK(found >= 98);
+  TEST_MSG("%u of 100 searches found their point", found);
+
+  // Both kinds of index files store the cached nodes, and the rows are filled from the loaded points
+  TEST_CHECK(index.saveGraph(fullFilename) && index.saveGraphStructure(graphFilename, baseFilename));
+  for (const std::string& filename : {fullFilename, graphFilename}) {
+    VamanaIndex<DataVector<float>> loaded;
+    TEST_CHECK(loaded.loadGraph(filename));
+    const StartNodeCache& loadedCache = loaded.getStartNodeCache();
+    bool rows = loadedCache.nodes == cache.nodes && loadedCache.vectors.size() == cache.vectors.size();
+    for (unsigned int j = 0; rows && j < loadedCache.nodes.size(); j++) {
+      rows = loadedCache.vectors[2 * j] == loaded.getPoint(loadedCache.nodes[j]).getDataAtIndex(0);
+    }
+    TEST_CHECK(rows);
+    TEST_CHECK(loaded.findSearchStart(points[123]) == index.findSearchStart(points[123]));
+  }
+
+  // Consolidating drops the removed start nodes and renumbers the others
+  std::vector<unsigned int> cached = cache.nodes;
+  TEST_CHECK(index.remove(cached[3]));
+  for (unsigned int i = 0; i < 4000; i++) {
+    if (std::find(cached.begin(), cached.end(), i) == cached.end()) {
+      TEST_CHECK(index.remove(i));
+      break;
+    }
+  }
+  std::vector<unsigned int> newIndexes = index.consolidate(4);
+  bool compacted = cache.nodes.size() == 63 && cache.vectors.size() == 63 * 2;
+  for (unsigned int j = 0, position = 0; compacted && j < 64; j++) {
+    if (j == 3) {
+      continue;
+    }
+    compacted = cache.nodes[position] == newIndexes[cached[j]];
+    compacted = compacted && cache.vectors[2 * position] == index.getPoint(cache.nodes[position]).getDataAtIndex(0);
+    position++;
+  }
+  TEST_CHECK(compacted);
+
+  index.clearStartNodeCache();
+  TEST_CHECK(index.getStartNodeCache().nodes.empty() && index.findSearchStart(points[0]) == index.getMedoid());
+
+  std::remove(baseFilename.c_str());
+  std::remove(fullFilename.c_str());
+  std::remove(graphFilename.c_str());
+
+}
+
+void test_corrupted_graph_file(void) {
+
+  const std::string baseFilename = "sample_corrupted_base.bin";
+  const std::string graphFilename = "sample_corrupted_graph.bin";
+  std::vector<DataVector<float>> points = createRandomPoints(300, 11);
+  writeBaseFile(baseFilename, points);
+
+  VamanaIndex<DataVector<float>> index;
+  index.createGraph(points, 1.2, 30, 8, NONE, 1, false);
+  TEST_CHECK(index.saveGraphStructure(graphFilename, baseFilename));
+
+  std::ifstream in(graphFilename, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+
+  // The medoid follows the header, which ends with the path of the base file, its size and its checksum
+  size_t medoidOffset = 8 * 4 + baseFilename.size() + 2 * 8;
+  size_t neighborsOffset = medoidOffset + 2 * 4 + index.getEntryPoints().size() * 4 + 4;
+  auto loadPatched = [&](const size_t offset, const uint32_t value, const size_t size) {
+    std::string patched = bytes.substr(0, size);
+    if (offset + 4 <= size) {
+      std::memcpy(&patched[offset], &value, sizeof(value));
+    }
+    std::ofstream out(graphFilename, std::ios::binary);
+    out.write(patched.data(), patched.size());
+    out.close();
+    VamanaIndex<DataVector<float>> loaded;
+    return loaded.loadGraph(graphFilename);
+  };
+
+  uint32_t medoid = index.getMedoid(), neighbor = index.getGraph().getNode(0)->getNeighborsVector()->at(0).getIndex();
+  TEST_CHECK(loadPatched(medoidOffset, medoid, bytes.size()));
+  TEST_CHECK(loadPatched(neighborsOffset, neighbor, bytes.size()));
+
+  // Indexes out of the graph and truncated files are rejected instead of being followed
+  TEST_CHECK(!loadPatched(medoidOffset, 300, bytes.size()));
+  TEST_CHECK(!loadPatched(neighborsOffset, 1u << 20, bytes.size()));
+  TEST_CHECK(!loadPatched(neighborsOffset - 4, 1u << 30, bytes.size()));
+  TEST_CHECK(!loadPatched(bytes.size(), 0, neighborsOffset + 40));
+
+  std::remove(baseFilename.c_str());
+  std::remove(graphFilename.c_str());
+
+}
+
+void test_corrupted_text_graph_file(void) {
+
+  const std::string filename = "sample_corrupted_text_graph.txt";
+  std::vector<DataVector<float>> points = createRandomPoints(300, 12);
+
+  VamanaIndex<DataVector<float>> index;
+  index.createGraph(points, 1.2, 30, 8, NONE, 1, false);
+  TEST_CHECK(index.saveGraph(filename));
+
+  // The file is written into a temporary file that is renamed over it
+  TEST_CHECK(!std::ifstream(filename + ".tmp"));
+  TEST_CHECK(index.saveGraph(filename) && !std::ifstream(filename + ".tmp"));
+
+  std::ifstream in(filename);
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(in, line); ) {
+    lines.push_back(line);
+  }
+  in.close();
+
+  auto loadLines = [&](const std::vector<std::string>& fileLines) {
+    std::ofstream out(filename);
+    for (const auto& line : fileLines) {
+      out << line << "\n";
+    }
+    out.close();
+    VamanaIndex<DataVector<float>> loaded;
+    return loaded.loadGraph(filename);
+  };
+  TEST_CHECK(loadLines(lines));
+
+  // Files cut in the nodes or in the edges are rejected
+  TEST_CHECK(!loadLines(std::vector<std::string>(lines.begin(), lines.begin() + 150)));
+  TEST_CHECK(!loadLines(std::vector<std::string>(lines.begin(), lines.begin() + 450)));
+
+  // So are edges to nodes out of the graph: the first neighbor of a list is its second token after the count
+  std::vector<std::string> patched = lines;
+  std::string& edges = patched[301];
+  size_t first = edges.find(' ', edges.find(' ') + 1) + 1;
+  edges.replace(first, edges.find(' ', first) - first, "300");
+  TEST_CHECK(!loadLines(patched));
+
+  std::remove(filename.c_str());
+
+}
+
+TEST_LIST = {
+  {"insert_concurrent", test_insert_concurrent},
+  {"insert_empty", test_insert_empty},
+  {"remove_consolidate", test_remove_consolidate},
+  {"search_during_inserts", test_search_during_inserts},
+  {"search_during_consolidate", test_search_during_consolidate},
+  {"search_budget", test_search_budget},
+  {"search_convergence", test_search_convergence},
+  {"navigation_layer", test_navigation_layer},
+  {"start_node_cache", test_start_node_cache},
+  {"corrupted_graph_file", test_corrupted_graph_file},
+  {"corrupted_text_graph_file", test_corrupted_text_graph_file},
+  {NULL, NULL}
+};